@@ -0,0 +1,100 @@
+﻿/*********************************************************************************
+ *
+ * Copyright (c) 2016, Daniel Jönsson
+ * All rights reserved.
+ * 
+ * This work is licensed under a Creative Commons Attribution-NonCommercial 4.0 International License.
+ * http://creativecommons.org/licenses/by-nc/4.0/
+ * 
+ * You are free to:
+ * 
+ * Share — copy and redistribute the material in any medium or format
+ * Adapt — remix, transform, and build upon the material
+ * The licensor cannot revoke these freedoms as long as you follow the license terms.
+ * Under the following terms:
+ * 
+ * Attribution — You must give appropriate credit, provide a link to the license, and indicate if changes were made. You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+ * NonCommercial — You may not use the material for commercial purposes.
+ * No additional restrictions — You may not apply legal terms or technological measures that legally restrict others from doing anything the license permits.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include "uniformgrid/uniformgrid.cl"  
+#include "transferfunctionminmaxtable.cl" 
+
+/*
+ * Distance along x + t*dir, t in [0 1], until the grid [0 gridDim] is exited.
+ * x must be inside the grid.
+ */
+float exitGrid(float3 x, float3 dir, float3 gridDim) {
+    float3 invDir = 1.f / dir;
+    float3 tExit = select((-x)*invDir, (gridDim - x)*invDir, dir > 0.f);
+    tExit = select(tExit, (float3)(FLT_MAX), dir == 0.f);
+    return min(1.f, min(tExit.x, min(tExit.y, tExit.z)));
+}
+
+/*
+ * Estimate visibility of each grid cell from the camera by accumulating
+ * opacity of the cells between the cell and the camera.
+ * The minimum opacity within each cell is used so that only cells 
+ * certainly hidden behind opaque material are considered occluded.
+ * Importance is scaled in place by mix(1, visibility, visibilityWeight).
+ */
+__kernel void cameraVisibilityImportanceKernel(
+      __global const ushort2* minMaxUniformGrid3D
+    , int4 gridDim
+    , float3 cameraPos // Grid cell coordinates, [0 gridDim]
+    , float3 cellSize  // Size of a grid cell in voxels
+    , __global float4 const* __restrict tfMinTable // See transferfunctionminmaxtable.cl
+    , __global float4 const* __restrict tfMaxTable
+    , int tfTableSize
+    , float visibilityWeight
+    , __global float* importanceUniformGrid3D) {
+    int id = get_global_id(0);
+    if (id >= uniformGridStorageSize(gridDim)) {
+        return;
+    }
+    int3 cell = uniformGridCellCoordinate(id, gridDim);
+    // Skip padding of the grid layout
+    if (any(cell >= gridDim.xyz)) {
+        return;
+    }
+    float importance = importanceUniformGrid3D[id];
+    if (importance <= 0.f) {
+        return;
+    }
+    float3 x1 = convert_float3(cell) + 0.5f;
+    float3 x2 = x1 + exitGrid(x1, cameraPos - x1, convert_float3(gridDim.xyz))*(cameraPos - x1);
+    // Length of segment in voxels
+    float len = length((x2 - x1)*cellSize);
+    
+    int3 cellCoord, cellCoordEnd, di;
+    float3 dt, deltatx;
+    setupUniformGridTraversal(x1, x2, (float3)(1.f), gridDim.xyz
+        , &cellCoord, &cellCoordEnd, &di, &dt, &deltatx);
+    float dt1 = 0.f;
+    // Skip the cell itself
+    bool continueTraversal = stepToNextCellNextHit(deltatx, di, cellCoordEnd, &dt, &cellCoord, &dt1);
+    float transmittance = 1.f;
+    while (continueTraversal && transmittance > 1e-3f) {
+        float2 gridMinMaxVal = (1.f / 65535.f)*convert_float2(minMaxUniformGrid3D[uniformGridCellIndex(cellCoord, gridDim)]);
+        float4 minColor, maxColor;
+        transferFunctionMinMaxForRange(gridMinMaxVal, tfMinTable, tfMaxTable, tfTableSize, &minColor, &maxColor);
+        float dt0 = dt1;
+        continueTraversal = stepToNextCellNextHit(deltatx, di, cellCoordEnd, &dt, &cellCoord, &dt1);
+        // Opacity is defined per voxel
+        transmittance *= pow(1.f - clamp(minColor.w, 0.f, 1.f), (min(1.f, dt1) - dt0)*len);
+    }
+    importanceUniformGrid3D[id] = importance*mix(1.f, transmittance, visibilityWeight);
+}
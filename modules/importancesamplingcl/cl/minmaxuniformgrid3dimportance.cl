@@ -34,6 +34,7 @@
 #include "transformations.cl" 
 #include "uniformgrid/uniformgrid.cl"  
 #include "colorconversion.cl" 
+#include "transferfunctionminmaxtable.cl" 
 
 /*
  * Step to next grid cell using parameters calculated in setupUniformGridTraversal.
@@ -77,7 +78,7 @@ bool stepToNextCell2(float3 deltatx, int3 di, int3 cellCoordEnd, float3 *dt, int
  * @param direction Normalized direction
  * @param cellDim Dimension of a grid cell
  * @param volume Data containing maximum data value within each grid cell
- * @param volumeMaxSize Size of volume
+ * @param volumeMaxSize Number of grid cells, w grid layout (see uniformGridCellIndex)
  * @param dataMinMaxValueThreshold All grids with value below min and above max value will be culled
  * @param tHit Output the distance to the hitpoint along the direction from x1
  * @return True if a hit is found, false otherwise
@@ -115,7 +116,7 @@ float uniformGridImportance(float3 x1, float3 x2
     float accum = 0;
     while(continueTraversal) {  
         // Visit cell      
-        float2 gridMinMaxVal = (1.f / 65535.f)*convert_float2(uniformGrid3D[cellCoord.x + cellCoord.y*volumeMaxSize.x + cellCoord.z * volumeMaxSize.x*volumeMaxSize.y]);
+        float2 gridMinMaxVal = (1.f / 65535.f)*convert_float2(uniformGrid3D[uniformGridCellIndex(cellCoord, volumeMaxSize)]);
         
         dt0 = dt1; 
         continueTraversal = stepToNextCell2(deltatx, di, cellCoordEnd, &dt, &cellCoord, &dt1); 
@@ -183,69 +184,10 @@ float tfPointsImportance(float4 color, float4 nextColor, ImportanceWeights weigh
 }
 #endif
 
-float importanceForRangeTF(float2 dataRange, __global float const* __restrict positions, __global float4 const* __restrict colors, int nPoints, ImportanceWeights weights) {
-    int i = 0;
-    float importance = 0.f;
-    // Skip until we reach first range
-    while (i < nPoints - 1 && dataRange.x > positions[i + 1]) {
-        ++i;
-    }
-
-    // Interpolate start color
-    float4 color = mix(colors[i], colors[i + 1], (dataRange.x - positions[i]) / (positions[i + 1] - positions[i]));
-
-    float4 minColor = color;
-    float4 maxColor = minColor;
-    if (dataRange.y <= positions[i + 1]) {
-        float4 nextColor = mix(colors[i], colors[i + 1], (dataRange.y - positions[i]) / (positions[i + 1] - positions[i]));
-
-        minColor = min(minColor, nextColor);
-        maxColor = max(maxColor, nextColor);
-        return tfPointsImportance(minColor, maxColor, weights);
-    } else {
-
-        float4 nextColor = colors[i + 1];
-        minColor = min(minColor, nextColor);
-        maxColor = max(maxColor, nextColor);
-        ++i;
-    }
-    while (i < nPoints - 1 && dataRange.y > positions[i + 1]) {
-
-        float4 nextColor = colors[i + 1];
-        minColor = min(minColor, nextColor);
-        maxColor = max(maxColor, nextColor);
-        ++i;
-    }
-    if (i < nPoints - 1) {
-        color = mix(colors[i], colors[i + 1], (dataRange.y - positions[i]) / (positions[i + 1] - positions[i]));
-
-        float4 nextColor = color;
-        minColor = min(minColor, nextColor);
-        maxColor = max(maxColor, nextColor);
-    }
-    
+float importanceForRangeTF(float2 dataRange, __global float4 const* __restrict tfMinTable, __global float4 const* __restrict tfMaxTable, int tfTableSize, ImportanceWeights weights) {
+    float4 minColor, maxColor;
+    transferFunctionMinMaxForRange(dataRange, tfMinTable, tfMaxTable, tfTableSize, &minColor, &maxColor);
     return tfPointsImportance(minColor, maxColor, weights);
-
-    //// Interpolate start color
-    //float4 color = mix(colors[i], colors[i + 1], (dataRange.x - positions[i]) / (positions[i + 1] - positions[i]));
-    //if (dataRange.y <= positions[i + 1]) {
-    //    float4 nextColor = mix(colors[i], colors[i + 1], (dataRange.y - positions[i]) / (positions[i + 1] - positions[i]));
-    //    return tfPointsImportance(color, nextColor, weights);
-    //} else {
-    //    importance = tfPointsImportance(color, colors[i + 1], weights);
-    //    ++i;
-    //}
-    //while (i < nPoints - 1 && dataRange.y > positions[i + 1]) {
-    //    importance = max(importance, tfPointsImportance(colors[i], colors[i + 1], weights));
-    //    ++i;
-    //}
-    //if (i < nPoints - 1) {
-    //    color = mix(colors[i], colors[i + 1], (dataRange.y - positions[i]) / (positions[i + 1] - positions[i]));
-    //    importance = max(importance, tfPointsImportance(colors[i], color, weights));
-    //}
-
-
-    return importance;
 }
 
 __kernel void minMaxUniformGrid3DImportanceKernel(
@@ -269,9 +211,9 @@ __kernel void minMaxUniformGrid3DImportanceKernel(
 __kernel void classifyMinMaxUniformGrid3DImportanceKernel(
     __global const ushort2* minMaxUniformGrid3D
     , int nElements
-    , __global float const* __restrict positions
-    , __global float4 const* __restrict colors
-    , int nPoints
+    , __global float4 const* __restrict tfMinTable // See transferfunctionminmaxtable.cl
+    , __global float4 const* __restrict tfMaxTable
+    , int tfTableSize
     , float colorWeight, float colorDiffWeight, float opacityDiffWeight, float opacityWeight
     , __global float* importanceUniformGrid3D) {
     if (get_global_id(0) >= nElements) {
@@ -283,7 +225,7 @@ __kernel void classifyMinMaxUniformGrid3DImportanceKernel(
     weights.colorDiffWeight = colorDiffWeight;
     weights.opacityDiffWeight = opacityDiffWeight;
     weights.opacityWeight = opacityWeight;
-    float importance = importanceForRangeTF(gridMinMaxVal, positions, colors, nPoints, weights);
+    float importance = importanceForRangeTF(gridMinMaxVal, tfMinTable, tfMaxTable, tfTableSize, weights);
     //importanceUniformGrid3D[get_global_id(0)] = convert_uchar_sat_rte(255.f*importance);
     importanceUniformGrid3D[get_global_id(0)] = importance;
 }
@@ -291,11 +233,13 @@ __kernel void classifyMinMaxUniformGrid3DImportanceKernel(
 __kernel void classifyTimeVaryingMinMaxUniformGrid3DImportanceKernel(
       __global const ushort2* minMaxUniformGrid3D
     , __global const ushort2* prevMinMaxUniformGrid3D
-    , __global const float* volumeDiffInfoUniformGrid3D
+    , __global const uchar* volumeDiffInfoUniformGrid3D // float, or quantized uchar/ushort, see uniformGridValue
+    , int volumeDiffInfoElementSize
+    , __global const float* volumeDiffInfoValueScale // See uniformGridValueScale
     , int nElements
-    , __global float const* __restrict positions
-    , __global float4 const* __restrict colors
-    , int nPoints
+    , __global float4 const* __restrict tfMinTable // See transferfunctionminmaxtable.cl
+    , __global float4 const* __restrict tfMaxTable
+    , int tfTableSize
     , float colorWeight, float colorDiffWeight, float opacityDiffWeight, float opacityWeight
     , __global float* importanceUniformGrid3D) {
     if (get_global_id(0) >= nElements) {
@@ -321,9 +265,10 @@ __kernel void classifyTimeVaryingMinMaxUniformGrid3DImportanceKernel(
     //    importance = volumeDiffInfoUniformGrid3D[get_global_id(0)] * (prevImportance + nextImportance);
     //}
 
-    importance = volumeDiffInfoUniformGrid3D[get_global_id(0)] * importanceForRangeTF(gridMinMaxVal, positions, colors, nPoints, weights);
+    float volumeDiffInfoScale = uniformGridValueScale(volumeDiffInfoValueScale, volumeDiffInfoElementSize);
+    importance = uniformGridValue(volumeDiffInfoUniformGrid3D, get_global_id(0), volumeDiffInfoElementSize, volumeDiffInfoScale) * importanceForRangeTF(gridMinMaxVal, tfMinTable, tfMaxTable, tfTableSize, weights);
     //} else {
-    //    importance = importanceForRangeTF(gridMinMaxVal, positions, colors, nPoints, weights);
+    //    importance = importanceForRangeTF(gridMinMaxVal, tfMinTable, tfMaxTable, tfTableSize, weights);
     //}
     //importanceUniformGrid3D[get_global_id(0)] = convert_uchar_sat_rte(255.f*importance);
     importanceUniformGrid3D[get_global_id(0)] = importance;
@@ -0,0 +1,119 @@
+﻿/*********************************************************************************
+ *
+ * Copyright (c) 2016, Daniel Jönsson
+ * All rights reserved.
+ * 
+ * This work is licensed under a Creative Commons Attribution-NonCommercial 4.0 International License.
+ * http://creativecommons.org/licenses/by-nc/4.0/
+ * 
+ * You are free to:
+ * 
+ * Share — copy and redistribute the material in any medium or format
+ * Adapt — remix, transform, and build upon the material
+ * The licensor cannot revoke these freedoms as long as you follow the license terms.
+ * Under the following terms:
+ * 
+ * Attribution — You must give appropriate credit, provide a link to the license, and indicate if changes were made. You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+ * NonCommercial — You may not use the material for commercial purposes.
+ * No additional restrictions — You may not apply legal terms or technological measures that legally restrict others from doing anything the license permits.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+
+#ifndef TRANSFER_FUNCTION_MIN_MAX_TABLE_CL
+#define TRANSFER_FUNCTION_MIN_MAX_TABLE_CL
+
+#include "samplers.cl" 
+
+/*
+ * Sparse table for O(1) min/max queries of the transfer function over a data range.
+ * The transfer function is sampled at tableSize positions, i/(tableSize-1).
+ * Level l, entry i, holds min/max over samples [i, i + 2^l) and 
+ * levels are stored consecutively, i.e. index = l*tableSize + i.
+ */
+
+/*
+ * Get minimum and maximum transfer function values within dataRange.
+ * Range is extended to the closest samples outside so that the result is conservative.
+ */
+void transferFunctionMinMaxForRange(float2 dataRange
+    , __global float4 const* __restrict minTable
+    , __global float4 const* __restrict maxTable
+    , int tableSize
+    , float4* minColor, float4* maxColor) {
+    int i0 = clamp((int)floor(dataRange.x*(float)(tableSize - 1)), 0, tableSize - 1);
+    int i1 = clamp((int)ceil(dataRange.y*(float)(tableSize - 1)), i0, tableSize - 1);
+    // floor(log2(number of samples))
+    int level = 31 - clz(i1 - i0 + 1);
+    int offset = level*tableSize;
+    int i1Start = i1 - (1 << level) + 1;
+    *minColor = min(minTable[offset + i0], minTable[offset + i1Start]);
+    *maxColor = max(maxTable[offset + i0], maxTable[offset + i1Start]);
+}
+
+__kernel void sampleTransferFunctionKernel(read_only image2d_t tf
+    , int tableSize
+    , int useAssociatedColor
+    , __global float4* samples) {
+    if (get_global_id(0) >= tableSize) {
+        return;
+    }
+    float x = (float)get_global_id(0) / (float)(tableSize - 1);
+    float4 color = read_imagef(tf, smpNormClampEdgeLinear, (float2)(x, 0.5f));
+    if (useAssociatedColor) {
+        color *= color.w;
+    }
+    samples[get_global_id(0)] = color;
+}
+
+/*
+ * First level of the table is either the transfer function or 
+ * the absolute difference between current and previous transfer function.
+ */
+__kernel void transferFunctionMinMaxTableBaseKernel(__global float4 const* __restrict samples
+    , __global float4 const* __restrict prevSamples
+    , int useDifference
+    , float epsilon // Threshold for considering two samples different
+    , int tableSize
+    , __global float4* minTable
+    , __global float4* maxTable) {
+    if (get_global_id(0) >= tableSize) {
+        return;
+    }
+    float4 value = samples[get_global_id(0)];
+    if (useDifference) {
+        value = fabs(value - prevSamples[get_global_id(0)]);
+        if (all(value <= (float4)(epsilon))) {
+            value = (float4)(0.f);
+        }
+    }
+    minTable[get_global_id(0)] = value;
+    maxTable[get_global_id(0)] = value;
+}
+
+__kernel void transferFunctionMinMaxTableLevelKernel(int level
+    , int tableSize
+    , __global float4* minTable
+    , __global float4* maxTable) {
+    int i = get_global_id(0);
+    if (i >= tableSize) {
+        return;
+    }
+    int prevOffset = (level - 1)*tableSize;
+    int j = min(i + (1 << (level - 1)), tableSize - 1);
+    minTable[level*tableSize + i] = min(minTable[prevOffset + i], minTable[prevOffset + j]);
+    maxTable[level*tableSize + i] = max(maxTable[prevOffset + i], maxTable[prevOffset + j]);
+}
+
+#endif // TRANSFER_FUNCTION_MIN_MAX_TABLE_CL
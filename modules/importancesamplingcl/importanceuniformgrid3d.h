@@ -44,6 +44,9 @@ namespace inviwo {
 
 //< Information about the importance of each grid cell.
 using ImportanceUniformGrid3D = UniformGrid3D<DataFloat32::type>;
+//< Importance quantized to [0 1] times UniformGrid3DBase::getValueScale, see util::quantizeUniformGrid3D
+using ImportanceUniformGrid3DUInt16 = UniformGrid3D<DataUInt16::type>;
+using ImportanceUniformGrid3DUInt8 = UniformGrid3D<DataUInt8::type>;
 
 using ImportanceUniformGrid3DInport = DataInport<ImportanceUniformGrid3D>;
 using ImportanceUniformGrid3DOutport = DataOutport<ImportanceUniformGrid3D>;
@@ -111,7 +111,7 @@ bool MinMaxUniformGrid3DImportanceCL::computeImportance(const Volume* origVolume
         int argIndex = 0;
         tracerKernel_->setArg(argIndex++, *uniformGridCL);
         //tracerKernel_->setArg(argIndex++, *volumeMax);
-        tracerKernel_->setArg(argIndex++, ivec3(uniformGrid3D->getDimensions()));
+        tracerKernel_->setArg(argIndex++, util::uniformGrid3DDimensionsCL(*uniformGrid3D));
         tracerKernel_->setArg(argIndex++, entryPoints);
         tracerKernel_->setArg(argIndex++, exitPoints);
         tracerKernel_->setArg(argIndex++, transferFunctionMaxMin);
@@ -33,8 +33,11 @@
 #include "minmaxuniformgrid3dimportanceclprocessor.h"
 #include <inviwo/core/util/colorconversion.h>
 #include <modules/opencl/buffer/buffercl.h>
+#include <modules/opencl/image/layercl.h>
+#include <modules/opencl/image/layerclgl.h>
 #include <modules/opencl/syncclgl.h>
-#include <glm/gtc/epsilon.hpp>
+#include <inviwo/core/common/inviwoapplication.h>
+#include <inviwo/core/network/processornetwork.h>
 #define IVW_DETAILED_PROFILING
 namespace inviwo {
     
@@ -63,8 +66,11 @@ MinMaxUniformGrid3DImportanceCLProcessor::MinMaxUniformGrid3DImportanceCLProcess
 , colorWeight_("colorWeight", "Color weight", 0.f, 0.f, 1.f)
 , colorDiffWeight_("colorDiffWeight", "Color difference weight", 0.f, 0.f, 1.f)
 , useAssociatedColor_("useAssociatedColor", "Associated color", false)
+, visibilityWeight_("visibilityWeight", "Camera visibility weight", 0.f, 0.f, 1.f)
+, camera_("camera", "Camera", vec3(0.0f, 0.0f, -2.0f), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f), nullptr, InvalidationLevel::Valid)
 , TFPointEpsilon_("TFPointEpsilon", "Minimum change threshold", 1e-4f, 0.f, 1e-2f, 1e-3f)
 , transferFunction_("transferfunction", "Transfer function")
+, precision_("precision", "Importance precision")
 , workGroupSize_("wgsize", "Work group size", 128, 1, 4096)
 , useGLSharing_("glsharing", "Use OpenGL sharing", true)
 , importanceUniformGrid3D_(std::make_shared<ImportanceUniformGrid3D>()) {
@@ -81,6 +87,15 @@ MinMaxUniformGrid3DImportanceCLProcessor::MinMaxUniformGrid3DImportanceCLProcess
     addProperty(colorWeight_);
     addProperty(colorDiffWeight_);
     addProperty(useAssociatedColor_);
+    addProperty(visibilityWeight_);
+    visibilityWeight_.onChange([this]() {
+        if (visibilityWeight_.get() > 0.f && !isCameraLinked()) {
+            LogWarn("Camera visibility is not applied until the camera is linked to the rendering camera");
+        }
+    });
+    // Visibility is only updated together with the importance,
+    // i.e. camera changes alone do not require recomputation
+    addProperty(camera_);
     addProperty(TFPointEpsilon_);
     // opacityWeight_.onChange([this](){
     // setInvalidationReason(InvalidationReason::TransferFunction); });
@@ -94,6 +109,13 @@ MinMaxUniformGrid3DImportanceCLProcessor::MinMaxUniformGrid3DImportanceCLProcess
     addProperty(transferFunction_);
     transferFunction_.onChange(
                                [this]() { setInvalidationReason(InvalidationReason::TransferFunction); });
+    // Quantized grids reduce memory and bandwidth of the detector, importance is still computed in float
+    precision_.addOption("float32", "32-bit float", 32);
+    precision_.addOption("uint16", "16-bit normalized", 16);
+    precision_.addOption("uint8", "8-bit normalized", 8);
+    precision_.setSelectedIndex(0);
+    precision_.setCurrentStateAsDefault();
+    addProperty(precision_);
     addProperty(workGroupSize_);
     addProperty(useGLSharing_);
     kernel_ =
@@ -101,14 +123,16 @@ MinMaxUniformGrid3DImportanceCLProcessor::MinMaxUniformGrid3DImportanceCLProcess
               "", " -D INCREMENTAL_TF_IMPORTANCE");
     timeVaryingKernel_ = addKernel("minmaxuniformgrid3dimportance.cl",
                                    "classifyTimeVaryingMinMaxUniformGrid3DImportanceKernel");
+    sampleTransferFunctionKernel_ = addKernel("transferfunctionminmaxtable.cl", "sampleTransferFunctionKernel");
+    tfTableBaseKernel_ = addKernel("transferfunctionminmaxtable.cl", "transferFunctionMinMaxTableBaseKernel");
+    tfTableLevelKernel_ = addKernel("transferfunctionminmaxtable.cl", "transferFunctionMinMaxTableLevelKernel");
+    visibilityKernel_ = addKernel("cameravisibility.cl", "cameraVisibilityImportanceKernel");
     
     importanceUniformGrid3DOutport_.setData(importanceUniformGrid3D_);
-    // Count as unused if cleared
-    prevTransferFunction_.clear();
 }
 
 void MinMaxUniformGrid3DImportanceCLProcessor::process() {
-    if (!kernel_ || !timeVaryingKernel_) {
+    if (!kernel_ || !timeVaryingKernel_ || !sampleTransferFunctionKernel_ || !tfTableBaseKernel_ || !tfTableLevelKernel_ || !visibilityKernel_) {
         return;
     }
     const MinMaxUniformGrid3D *minMaxUniformGrid3D =
@@ -118,7 +142,10 @@ void MinMaxUniformGrid3DImportanceCLProcessor::process() {
         return;
     }
     if (glm::any(glm::notEqual(minMaxUniformGrid3D->getDimensions(),
-                               importanceUniformGrid3D_->getDimensions()))) {
+                               importanceUniformGrid3D_->getDimensions())) ||
+        minMaxUniformGrid3D->getLayout() != importanceUniformGrid3D_->getLayout()) {
+        // Importance is computed element-wise and must be stored in the same order
+        importanceUniformGrid3D_->setLayout(minMaxUniformGrid3D->getLayout());
         importanceUniformGrid3D_->setDimensions(minMaxUniformGrid3D->getDimensions());
         importanceUniformGrid3D_->setCellDimension(minMaxUniformGrid3D->getCellDimension());
         importanceUniformGrid3D_->setModelMatrix(minMaxUniformGrid3D->getModelMatrix());
@@ -126,17 +153,12 @@ void MinMaxUniformGrid3DImportanceCLProcessor::process() {
     }
     if (static_cast<int>(invalidationFlag_) &
         static_cast<int>(InvalidationReason::TransferFunction)) {
-        if (prevTransferFunction_.size() == 0 || !incrementalImportance) {
-            updateTransferFunctionData();
-        } else {
-            updateTransferFunctionDifferenceData();
-        }
-        prevTransferFunction_ = transferFunction_.get();
+        updateTransferFunctionTable(true, hasPrevTfSamples_ && incrementalImportance);
     } else if (static_cast<int>(invalidationFlag_) & static_cast<int>(InvalidationReason::Volume)) {
-        updateTransferFunctionData();
+        updateTransferFunctionTable(!hasPrevTfSamples_, false);
     }
-    size3_t dim = importanceUniformGrid3D_->getDimensions();
-    size_t nElements = dim.x * dim.y * dim.z;
+    // Including padding of the grid layout
+    size_t nElements = importanceUniformGrid3D_->data.getSize();
     
     size_t localWorkGroupSize(workGroupSize_.get());
     size_t globalWorkGroupSize(getGlobalWorkGroupSize(nElements, localWorkGroupSize));
@@ -149,12 +171,18 @@ void MinMaxUniformGrid3DImportanceCLProcessor::process() {
     if (volumeDifferenceInfoInport_.isReady() && prevMinMaxUniformGrid3D_ != nullptr &&
         prevMinMaxUniformGrid3D_.get() != minMaxUniformGrid3D) {
         // Time varying data changed
-        auto volumeDifferenceData = dynamic_cast<const DynamicVolumeInfoUniformGrid3D *>(
-                                                                                         volumeDifferenceInfoInport_.getData().get());
-        if (!volumeDifferenceData) {
+        // Float or quantized difference, read by uniformGridValue
+        auto volumeDifferenceData = volumeDifferenceInfoInport_.getData().get();
+        if (!util::isScalarUniformGrid3DFormat(volumeDifferenceData->getDataFormat())) {
             LogError(
                      "volumeDifferenceInfoInport_ expects "
-                     "DynamicVolumeInfoUniformGrid3D as input");
+                     "DynamicVolumeInfoUniformGrid3D (float32, uint16 or uint8) as input");
+            return;
+        }
+        auto volumeDifferenceElementSize = static_cast<int>(volumeDifferenceData->getDataFormat()->getSize());
+        auto volumeDifferenceScaleCL = volumeDifferenceData->getValueScaleBuffer().getRepresentation<BufferCL>();
+        if (volumeDifferenceData->getLayout() != minMaxUniformGrid3D->getLayout()) {
+            LogError("volumeDifferenceInfoInport_ and minMaxUniformGrid3DInport_ must have the same grid layout");
             return;
         }
         if (useGLSharing_) {
@@ -163,7 +191,7 @@ void MinMaxUniformGrid3DImportanceCLProcessor::process() {
             auto prevMinMaxUniformGrid3DCL =
             prevMinMaxUniformGrid3D_->data.getRepresentation<BufferCLGL>();
             auto volumeDifferenceInfoCL =
-            volumeDifferenceData->data.getRepresentation<BufferCLGL>();
+            volumeDifferenceData->getBuffer().getRepresentation<BufferCLGL>();
             
             auto importanceUniformGrid3DCL =
             importanceUniformGrid3D_->data.getEditableRepresentation<BufferCLGL>();
@@ -174,17 +202,19 @@ void MinMaxUniformGrid3DImportanceCLProcessor::process() {
             
             glSync.aquireAllObjects();
             computeImportance(minMaxUniformGrid3DCL, prevMinMaxUniformGrid3DCL,
-                              volumeDifferenceInfoCL, nElements, importanceUniformGrid3DCL,
+                              volumeDifferenceInfoCL, volumeDifferenceElementSize, volumeDifferenceScaleCL,
+                              nElements, importanceUniformGrid3DCL,
                               globalWorkGroupSize, localWorkGroupSize, profilingEvent);
         } else {
             auto minMaxUniformGrid3DCL = minMaxUniformGrid3D->data.getRepresentation<BufferCL>();
-            auto volumeDifferenceInfoCL = volumeDifferenceData->data.getRepresentation<BufferCL>();
+            auto volumeDifferenceInfoCL = volumeDifferenceData->getBuffer().getRepresentation<BufferCL>();
             auto prevMinMaxUniformGrid3DCL =
             prevMinMaxUniformGrid3D_->data.getRepresentation<BufferCL>();
             auto importanceUniformGrid3DCL =
             importanceUniformGrid3D_->data.getEditableRepresentation<BufferCL>();
             computeImportance(minMaxUniformGrid3DCL, prevMinMaxUniformGrid3DCL,
-                              volumeDifferenceInfoCL, nElements, importanceUniformGrid3DCL,
+                              volumeDifferenceInfoCL, volumeDifferenceElementSize, volumeDifferenceScaleCL,
+                              nElements, importanceUniformGrid3DCL,
                               globalWorkGroupSize, localWorkGroupSize, profilingEvent);
         }
         
@@ -209,6 +239,31 @@ void MinMaxUniformGrid3DImportanceCLProcessor::process() {
                               globalWorkGroupSize, localWorkGroupSize, profilingEvent);
         }
     }
+    // The default camera does not correspond to any view
+    if (visibilityWeight_.get() > 0.f && isCameraLinked()) {
+        if (useGLSharing_) {
+            SyncCLGL glSync;
+            auto minMaxUniformGrid3DCL = minMaxUniformGrid3D->data.getRepresentation<BufferCLGL>();
+            auto importanceUniformGrid3DCL =
+            importanceUniformGrid3D_->data.getEditableRepresentation<BufferCLGL>();
+            glSync.addToAquireGLObjectList(minMaxUniformGrid3DCL);
+            glSync.addToAquireGLObjectList(importanceUniformGrid3DCL);
+            glSync.aquireAllObjects();
+            applyCameraVisibility(minMaxUniformGrid3D, minMaxUniformGrid3DCL, importanceUniformGrid3DCL,
+                                  globalWorkGroupSize, localWorkGroupSize, nullptr);
+        } else {
+            auto minMaxUniformGrid3DCL = minMaxUniformGrid3D->data.getRepresentation<BufferCL>();
+            auto importanceUniformGrid3DCL =
+            importanceUniformGrid3D_->data.getEditableRepresentation<BufferCL>();
+            applyCameraVisibility(minMaxUniformGrid3D, minMaxUniformGrid3DCL, importanceUniformGrid3DCL,
+                                  globalWorkGroupSize, localWorkGroupSize, nullptr);
+        }
+    }
+    if (precision_.get() < 32) {
+        quantizeImportance(nElements);
+    } else if (importanceUniformGrid3DOutport_.getData() != importanceUniformGrid3D_) {
+        importanceUniformGrid3DOutport_.setData(importanceUniformGrid3D_);
+    }
     prevMinMaxUniformGrid3D_ =
     std::dynamic_pointer_cast<const MinMaxUniformGrid3D>(minMaxUniformGrid3DInport_.getData());
     
@@ -222,8 +277,8 @@ void MinMaxUniformGrid3DImportanceCLProcessor::computeImportance(
     // Transfer function parameters
     
     try {
-        auto positionsCL = tfPointPositions_.getRepresentation<BufferCL>();
-        auto colorsCL = tfPointColors_.getRepresentation<BufferCL>();
+        auto tfMinTableCL = tfMinTable_.getRepresentation<BufferCL>();
+        auto tfMaxTableCL = tfMaxTable_.getRepresentation<BufferCL>();
         // Make weights sum to 1
         auto weightNormalization = colorWeight_.get() + colorDiffWeight_.get() +
         opacityDiffWeight_.get() + opacityWeight_.get();
@@ -236,10 +291,9 @@ void MinMaxUniformGrid3DImportanceCLProcessor::computeImportance(
         int argIndex = 0;
         kernel_->setArg(argIndex++, *minMaxUniformGridCL);
         kernel_->setArg(argIndex++, static_cast<int>(nElements));
-        kernel_->setArg(argIndex++, *positionsCL);
-        kernel_->setArg(argIndex++, *colorsCL);
-        kernel_->setArg(argIndex++,
-                        std::min(static_cast<int>(positionsCL->getSize()), tfPointImportanceSize_));
+        kernel_->setArg(argIndex++, *tfMinTableCL);
+        kernel_->setArg(argIndex++, *tfMaxTableCL);
+        kernel_->setArg(argIndex++, static_cast<int>(tfSamples_.getSize()));
         kernel_->setArg(argIndex++,
                         colorWeight_.get() * labColorNormalizationFactor / (weightNormalization));
         kernel_->setArg(argIndex++, colorDiffWeight_.get() * labColorNormalizationFactor /
@@ -257,12 +311,13 @@ void MinMaxUniformGrid3DImportanceCLProcessor::computeImportance(
 
 void MinMaxUniformGrid3DImportanceCLProcessor::computeImportance(
                                                                  const BufferCLBase *minMaxUniformGridCL, const BufferCLBase *prevMinMaxUniformGridCL,
-                                                                 const BufferCLBase *volumeDifferenceInfoUniformGridCL, size_t nElements,
+                                                                 const BufferCLBase *volumeDifferenceInfoUniformGridCL,
+                                                                 int volumeDifferenceElementSize, const BufferCLBase *volumeDifferenceScaleCL, size_t nElements,
                                                                  BufferCLBase *importanceUniformGridCL, const size_t &globalWorkGroupSize,
                                                                  const size_t &localWorkgroupSize, cl::Event *event) {
     try {
-        auto positionsCL = tfPointPositions_.getRepresentation<BufferCL>();
-        auto colorsCL = tfPointColors_.getRepresentation<BufferCL>();
+        auto tfMinTableCL = tfMinTable_.getRepresentation<BufferCL>();
+        auto tfMaxTableCL = tfMaxTable_.getRepresentation<BufferCL>();
         // Make weights sum to 1
         auto weightNormalization = colorWeight_.get() + colorDiffWeight_.get() +
         opacityDiffWeight_.get() + opacityWeight_.get();
@@ -275,10 +330,12 @@ void MinMaxUniformGrid3DImportanceCLProcessor::computeImportance(
         timeVaryingKernel_->setArg(argIndex++, *minMaxUniformGridCL);
         timeVaryingKernel_->setArg(argIndex++, *prevMinMaxUniformGridCL);
         timeVaryingKernel_->setArg(argIndex++, *volumeDifferenceInfoUniformGridCL);
+        timeVaryingKernel_->setArg(argIndex++, volumeDifferenceElementSize);
+        timeVaryingKernel_->setArg(argIndex++, *volumeDifferenceScaleCL);
         timeVaryingKernel_->setArg(argIndex++, static_cast<int>(nElements));
-        timeVaryingKernel_->setArg(argIndex++, *positionsCL);
-        timeVaryingKernel_->setArg(argIndex++, *colorsCL);
-        timeVaryingKernel_->setArg(argIndex++, static_cast<int>(tfPointImportanceSize_));
+        timeVaryingKernel_->setArg(argIndex++, *tfMinTableCL);
+        timeVaryingKernel_->setArg(argIndex++, *tfMaxTableCL);
+        timeVaryingKernel_->setArg(argIndex++, static_cast<int>(tfSamples_.getSize()));
         timeVaryingKernel_->setArg(
                                    argIndex++, colorWeight_.get() * labColorNormalizationFactor / (weightNormalization));
         timeVaryingKernel_->setArg(
@@ -296,214 +353,166 @@ void MinMaxUniformGrid3DImportanceCLProcessor::computeImportance(
     }
 }
 
-float MinMaxUniformGrid3DImportanceCLProcessor::getLabColorNormalizationFactor() const {
-    vec3 labColorSpaceExtent{100.f, 500.f, 400.f};
-    return 1.f / glm::length(labColorSpaceExtent);
+bool MinMaxUniformGrid3DImportanceCLProcessor::isCameraLinked() const {
+    auto network = InviwoApplication::getPtr()->getProcessorNetwork();
+    return network && !network->getPropertiesLinkedTo(const_cast<CameraProperty*>(&camera_)).empty();
 }
 
-void MinMaxUniformGrid3DImportanceCLProcessor::updateTransferFunctionData() {
-    if (transferFunction_.get().size() == 0) {
-        tfPointImportanceSize_ = 2;
-        if (static_cast<int>(tfPointPositions_.getSize()) < tfPointImportanceSize_) {
-            tfPointPositions_.setSize(tfPointImportanceSize_);
-            tfPointColors_.setSize(tfPointImportanceSize_);
-        }
-        auto positions = tfPointPositions_.getEditableRAMRepresentation();
-        auto colors = tfPointColors_.getEditableRAMRepresentation();
-        (*positions)[0] = 0;
-        (*colors)[0] = vec4(0.f);
-        (*positions)[1] = 1;
-        (*colors)[1] = vec4(0.f);
-        
-    } else {
-        auto firstPoint = transferFunction_.get().get(0);
-        auto lastPoint =
-        transferFunction_.get().get(static_cast<int>(transferFunction_.get().size() - 1));
-        tfPointImportanceSize_ = static_cast<int>(transferFunction_.get().size());
-        if (firstPoint.getPosition() > 0.f) {
-            ++tfPointImportanceSize_;
-        }
-        if (lastPoint.getPosition() < 1.f) {
-            ++tfPointImportanceSize_;
-        }
-        
-        if (static_cast<int>(tfPointPositions_.getSize()) < tfPointImportanceSize_) {
-            tfPointPositions_.setSize(tfPointImportanceSize_);
-            tfPointColors_.setSize(tfPointImportanceSize_);
-        }
-        auto positions = tfPointPositions_.getEditableRAMRepresentation();
-        auto colors = tfPointColors_.getEditableRAMRepresentation();
-        
-        int pointId = 0;
-        if (firstPoint.getPosition() > 0.f) {
-            (*positions)[0] = 0;
-            if (useAssociatedColor_)
-            (*colors)[0] = firstPoint.getColor() * firstPoint.getAlpha();
-            else
-            (*colors)[0] = firstPoint.getColor();
-            ++pointId;
-        }
-        for (auto i = 0u; i < transferFunction_.get().size(); ++i, ++pointId) {
-            auto point = transferFunction_.get().get(i);
-            (*positions)[pointId] = static_cast<float>(point.getPosition());
-            if (useAssociatedColor_)
-            (*colors)[pointId] = point.getColor() * point.getAlpha();
-            else
-            (*colors)[pointId] = point.getColor();
-        }
-        if (lastPoint.getPosition() < 1.) {
-            (*positions)[pointId] = 1.f;
-            if (useAssociatedColor_)
-            (*colors)[pointId++] = lastPoint.getColor() * lastPoint.getAlpha();
-            else
-            (*colors)[pointId++] = lastPoint.getColor();
-        }
+void MinMaxUniformGrid3DImportanceCLProcessor::applyCameraVisibility(
+    const MinMaxUniformGrid3D* minMaxUniformGrid3D, const BufferCLBase *minMaxUniformGridCL,
+    BufferCLBase *importanceUniformGridCL, const size_t &globalWorkGroupSize,
+    const size_t &localWorkgroupSize, cl::Event *event) {
+    try {
+        // Opacity of the current transfer function is required
+        auto tfMinTableCL = (tfTableIsDifference_ ? tfVisibilityMinTable_ : tfMinTable_).getRepresentation<BufferCL>();
+        auto tfMaxTableCL = (tfTableIsDifference_ ? tfVisibilityMaxTable_ : tfMaxTable_).getRepresentation<BufferCL>();
+        // Camera position in grid cell coordinates
+        vec3 cameraPos{ minMaxUniformGrid3D->getCoordinateTransformer().getWorldToIndexMatrix() *
+                        vec4(camera_.getLookFrom(), 1.f) };
+        int argIndex = 0;
+        visibilityKernel_->setArg(argIndex++, *minMaxUniformGridCL);
+        visibilityKernel_->setArg(argIndex++, util::uniformGrid3DDimensionsCL(*minMaxUniformGrid3D));
+        visibilityKernel_->setArg(argIndex++, cameraPos);
+        visibilityKernel_->setArg(argIndex++, vec3(minMaxUniformGrid3D->getCellDimension()));
+        visibilityKernel_->setArg(argIndex++, *tfMinTableCL);
+        visibilityKernel_->setArg(argIndex++, *tfMaxTableCL);
+        visibilityKernel_->setArg(argIndex++, static_cast<int>(tfSamples_.getSize()));
+        visibilityKernel_->setArg(argIndex++, visibilityWeight_.get());
+        visibilityKernel_->setArg(argIndex++, *importanceUniformGridCL);
+        OpenCL::getPtr()->getQueue().enqueueNDRangeKernel(
+            *visibilityKernel_, cl::NullRange, globalWorkGroupSize, localWorkgroupSize, NULL, event);
+    } catch (cl::Error &err) {
+        LogError(getCLErrorString(err));
     }
 }
 
-void MinMaxUniformGrid3DImportanceCLProcessor::updateTransferFunctionDifferenceData() {
-    if (transferFunction_.get().size() == 0 && prevTransferFunction_.size() == 0) {
-        tfPointImportanceSize_ = 2;
-        if (static_cast<int>(tfPointPositions_.getSize()) < tfPointImportanceSize_) {
-            tfPointPositions_.setSize(tfPointImportanceSize_);
-            tfPointColors_.setSize(tfPointImportanceSize_);
-        }
-        auto positions = tfPointPositions_.getEditableRAMRepresentation();
-        auto colors = tfPointColors_.getEditableRAMRepresentation();
-        (*positions)[0] = 0;
-        (*colors)[0] = vec4(0.f);
-        (*positions)[1] = 0;
-        (*colors)[1] = vec4(0.f);
-        
-    } else {
-        auto maxSize = transferFunction_.get().size() + prevTransferFunction_.size() + 2;
-        if (tfPointPositions_.getSize() < maxSize) {
-            tfPointPositions_.setSize(maxSize);
-            tfPointColors_.setSize(maxSize);
-        }
-        auto positions = tfPointPositions_.getEditableRAMRepresentation();
-        auto colors = tfPointColors_.getEditableRAMRepresentation();
-        
-        auto firstPoint = transferFunction_.get().get(0);
-        //auto lastPoint =
-        //    transferFunction_.get().get(static_cast<int>(transferFunction_.get().size() - 1));
-        auto prevFirstPoint = prevTransferFunction_.get(0);
-        //auto prevLastPoint =
-        //    prevTransferFunction_.get(static_cast<int>(prevTransferFunction_.size() - 1));
-        
-        int outId = 0;
-        int id = 0, prevId = 0;
-        TFPrimitive p1, p2;
-        p1 = p2 = TFPrimitive(firstPoint < prevFirstPoint ? firstPoint.getPosition()
-                              : prevFirstPoint.getPosition(),
-                              tfPointColorDiff(firstPoint.getColor(), prevFirstPoint.getColor()));
-        if (firstPoint.getPosition() != prevFirstPoint.getPosition() &&
-            firstPoint.getAlpha() == 0.f && prevFirstPoint.getAlpha() == 0.f) {
-            // Moved first point with zero opacity
-            if (firstPoint < prevFirstPoint) {
-                auto a2 = transferFunction_.get().get(
-                                                      std::min(1, static_cast<int>(transferFunction_.get().size() - 1)));
-                auto p = mix(firstPoint, a2, prevFirstPoint);
-                p2 = TFPrimitive(prevFirstPoint.getPosition(),
-                                 tfPointColorDiff(prevFirstPoint.getColor(), p.getColor()));
-            } else {
-                auto a2 = prevTransferFunction_.get(
-                                                    std::min(1, static_cast<int>(prevTransferFunction_.size() - 1)));
-                auto p = mix(prevFirstPoint, a2, firstPoint);
-                p2 = TFPrimitive(firstPoint.getPosition(),
-                                 tfPointColorDiff(firstPoint.getColor(), p.getColor()));
-            }
+void MinMaxUniformGrid3DImportanceCLProcessor::quantizeImportance(size_t nElements) {
+    const DataFormatBase* format = precision_.get() == 8 ? DataUInt8::get() : DataUInt16::get();
+    if (!quantizedImportanceUniformGrid3D_ || quantizedImportanceUniformGrid3D_->getDataFormat() != format ||
+        glm::any(glm::notEqual(quantizedImportanceUniformGrid3D_->getDimensions(), importanceUniformGrid3D_->getDimensions())) ||
+        quantizedImportanceUniformGrid3D_->getLayout() != importanceUniformGrid3D_->getLayout()) {
+        if (format == DataUInt8::get()) {
+            quantizedImportanceUniformGrid3D_ = std::make_shared<ImportanceUniformGrid3DUInt8>(
+                importanceUniformGrid3D_->getDimensions(), importanceUniformGrid3D_->getCellDimension(), BufferUsage::Static, importanceUniformGrid3D_->getLayout());
+        } else {
+            quantizedImportanceUniformGrid3D_ = std::make_shared<ImportanceUniformGrid3DUInt16>(
+                importanceUniformGrid3D_->getDimensions(), importanceUniformGrid3D_->getCellDimension(), BufferUsage::Static, importanceUniformGrid3D_->getLayout());
         }
-        if (p1.getPosition() > 0.f &&
-            (firstPoint.getAlpha() > 0.f || prevFirstPoint.getAlpha() > 0.f) &&
-            glm::any(glm::epsilonNotEqual(p1.getColor(), vec4(0), TFPointEpsilon_.get()))) {
-            (*positions)[outId] = 0.f;
-            (*colors)[outId] = p1.getColor();
-            ++outId;
-            // This point will be added in the loop
-            //(*positions)[outId] = p1.getPosition().x;
-            //(*colors)[outId] = p1.getColor();
-            //++outId;
+    }
+    quantizedImportanceUniformGrid3D_->setCellDimension(importanceUniformGrid3D_->getCellDimension());
+    quantizedImportanceUniformGrid3D_->setModelMatrix(importanceUniformGrid3D_->getModelMatrix());
+    quantizedImportanceUniformGrid3D_->setWorldMatrix(importanceUniformGrid3D_->getWorldMatrix());
+    try {
+        quantizer_.workGroupSize(static_cast<size_t>(workGroupSize_.get()));
+        if (useGLSharing_) {
+            SyncCLGL glSync;
+            auto importanceUniformGrid3DCL = importanceUniformGrid3D_->data.getRepresentation<BufferCLGL>();
+            glSync.addToAquireGLObjectList(importanceUniformGrid3DCL);
+            glSync.aquireAllObjects();
+            quantizer_.quantize(importanceUniformGrid3DCL, nElements, *quantizedImportanceUniformGrid3D_, true);
         } else {
-            // Add a point with zero difference
-            (*positions)[outId] = 0.f;
-            (*colors)[outId] = vec4(0.f);
-            ++outId;
+            auto importanceUniformGrid3DCL = importanceUniformGrid3D_->data.getRepresentation<BufferCL>();
+            quantizer_.quantize(importanceUniformGrid3DCL, nElements, *quantizedImportanceUniformGrid3D_, false);
         }
-        
-        while (id < static_cast<int>(transferFunction_.get().size()) || prevId < static_cast<int>(prevTransferFunction_.size())) {
-            // Only store point if difference is non-zero
-            // And the opacity is greater than zero
-            if ((glm::any(glm::epsilonNotEqual(p1.getColor(), vec4(0), TFPointEpsilon_.get())) ||
-                 glm::any(glm::epsilonNotEqual(p2.getColor(), vec4(0), TFPointEpsilon_.get()))) &&
-                (p1.getAlpha() > 0. || p2.getAlpha() > 0.)) {
-                if (outId == 1) {
-                    // Add point if all previous have been equal.
-                    (*positions)[outId] = static_cast<float>(p1.getPosition());
-                    (*colors)[outId] = p1.getColor();
-                    ++outId;
-                }
-                (*positions)[outId] = static_cast<float>(p2.getPosition());
-                (*colors)[outId] = p2.getColor();
-                ++outId;
-            }
-            // Advance to next point
-            const auto a1 = transferFunction_.get().get(
-                                                        std::min(id, static_cast<int>(transferFunction_.get().size()) - 1));
-            TFPrimitive a2;
-            if (id + 1 < static_cast<int>(transferFunction_.get().size()) - 1) {
-                a2 = transferFunction_.get().get(id + 1);
-            } else {
-                const auto a = transferFunction_.get().get(transferFunction_.get().size() - 1);
-                a2 = TFPrimitive(1., a.getColor());
-            }
-            const auto b1 = prevTransferFunction_.get(
-                                                      std::min(prevId, static_cast<int>(prevTransferFunction_.size()) - 1));
-            TFPrimitive b2;
-            if (prevId + 1 < static_cast<int>(prevTransferFunction_.size()) - 1) {
-                b2 = prevTransferFunction_.get(prevId + 1);
-            } else {
-                const auto b = prevTransferFunction_.get(prevTransferFunction_.size() - 1);
-                b2 = TFPrimitive(1., b.getColor());
+    } catch (cl::Error &err) {
+        LogError(getCLErrorString(err));
+    }
+    // Set every time, the value scale changes with each update
+    importanceUniformGrid3DOutport_.setData(quantizedImportanceUniformGrid3D_);
+}
+
+float MinMaxUniformGrid3DImportanceCLProcessor::getLabColorNormalizationFactor() const {
+    vec3 labColorSpaceExtent{100.f, 500.f, 400.f};
+    return 1.f / glm::length(labColorSpaceExtent);
+}
+
+void MinMaxUniformGrid3DImportanceCLProcessor::updateTransferFunctionTable(bool sampleTransferFunction, bool useDifference) {
+    const Layer* tfLayer = transferFunction_.get().getData();
+    auto tableSize = tfLayer->getDimensions().x;
+    // floor(log2(tableSize)) + 1 levels
+    size_t nLevels = 1;
+    while ((size_t(1) << nLevels) <= tableSize) {
+        ++nLevels;
+    }
+    if (tfSamples_.getSize() != tableSize) {
+        tfSamples_.setSize(tableSize);
+        prevTfSamples_.setSize(tableSize);
+        tfMinTable_.setSize(tableSize * nLevels);
+        tfMaxTable_.setSize(tableSize * nLevels);
+        tfVisibilityMinTable_.setSize(tableSize * nLevels);
+        tfVisibilityMaxTable_.setSize(tableSize * nLevels);
+        hasPrevTfSamples_ = false;
+        sampleTransferFunction = true;
+        useDifference = false;
+    }
+    size_t localWorkGroupSize(workGroupSize_.get());
+    size_t globalWorkGroupSize(getGlobalWorkGroupSize(tableSize, localWorkGroupSize));
+    try {
+        auto samplesCL = tfSamples_.getEditableRepresentation<BufferCL>();
+        auto prevSamplesCL = prevTfSamples_.getEditableRepresentation<BufferCL>();
+        if (sampleTransferFunction) {
+            if (hasPrevTfSamples_) {
+                OpenCL::getPtr()->getQueue().enqueueCopyBuffer(samplesCL->get(), prevSamplesCL->getEditable(), 0, 0, tfSamples_.getSizeInBytes());
             }
-            p1 = p2;
-            if (a2 < b2) {
-                // Interpolate point in prev TF
-                auto p = mix(b1, b2, a2);
-                p2 = TFPrimitive(a2.getPosition(), tfPointColorDiff(a2.getColor(), p.getColor()));
-                ++id;
-                
-            } else if (b2 < a2) {
-                auto p = mix(a1, a2, b2);
-                p2 = TFPrimitive(b2.getPosition(), tfPointColorDiff(b2.getColor(), p.getColor()));
-                ++prevId;
+            std::unique_ptr<SyncCLGL> glSync = nullptr;
+            const LayerCLBase* tfCL = nullptr;
+            if (useGLSharing_) {
+                glSync = std::make_unique<SyncCLGL>();
+                auto tfCLGL = tfLayer->getRepresentation<LayerCLGL>();
+                glSync->addToAquireGLObjectList(tfCLGL);
+                glSync->aquireAllObjects();
+                tfCL = tfCLGL;
             } else {
-                p2 =
-                TFPrimitive(a2.getAlpha() < b2.getAlpha() ? b2.getPosition() : a2.getPosition(),
-                            tfPointColorDiff(a2.getColor(), b2.getColor()));
-                ++id;
-                ++prevId;
+                tfCL = tfLayer->getRepresentation<LayerCL>();
             }
+            int argIndex = 0;
+            sampleTransferFunctionKernel_->setArg(argIndex++, *tfCL);
+            sampleTransferFunctionKernel_->setArg(argIndex++, static_cast<int>(tableSize));
+            sampleTransferFunctionKernel_->setArg(argIndex++, useAssociatedColor_.get() ? 1 : 0);
+            sampleTransferFunctionKernel_->setArg(argIndex++, *samplesCL);
+            OpenCL::getPtr()->getQueue().enqueueNDRangeKernel(
+                *sampleTransferFunctionKernel_, cl::NullRange, globalWorkGroupSize, localWorkGroupSize);
         }
-        if (p2.getPosition() < 1. && p2.getAlpha() > 0.) {
-            (*positions)[outId] = static_cast<float>(p2.getPosition());
-            (*colors)[outId] = p2.getColor();
-            ++outId;
-        }
-        if ((*positions)[outId - 1] < 1.) {
-            // Add a point with zero difference
-            (*positions)[outId] = 1.;
-            (*colors)[outId] = vec4(0.f);
-            ++outId;
+        buildTransferFunctionTable(samplesCL, prevSamplesCL, useDifference, tfMinTable_, tfMaxTable_);
+        if (useDifference) {
+            // Camera visibility depends on the opacity, not the difference
+            buildTransferFunctionTable(samplesCL, prevSamplesCL, false, tfVisibilityMinTable_, tfVisibilityMaxTable_);
         }
-        tfPointImportanceSize_ = outId;
+        tfTableIsDifference_ = useDifference;
+    } catch (cl::Error &err) {
+        LogError(getCLErrorString(err));
+    }
+    if (sampleTransferFunction) {
+        hasPrevTfSamples_ = true;
     }
 }
 
-inviwo::vec4 MinMaxUniformGrid3DImportanceCLProcessor::tfPointColorDiff(const vec4 &p1,
-                                                                        const vec4 &p2) {
-    return glm::abs(p2 * (useAssociatedColor_ ? p2.w : 1.f) -
-                    p1 * (useAssociatedColor_ ? p1.w : 1.f));
+void MinMaxUniformGrid3DImportanceCLProcessor::buildTransferFunctionTable(const BufferCLBase* samplesCL, const BufferCLBase* prevSamplesCL, bool useDifference,
+                                                                          Buffer<vec4>& minTable, Buffer<vec4>& maxTable) {
+    auto tableSize = tfSamples_.getSize();
+    auto nLevels = minTable.getSize() / tableSize;
+    size_t localWorkGroupSize(workGroupSize_.get());
+    size_t globalWorkGroupSize(getGlobalWorkGroupSize(tableSize, localWorkGroupSize));
+    auto minTableCL = minTable.getEditableRepresentation<BufferCL>();
+    auto maxTableCL = maxTable.getEditableRepresentation<BufferCL>();
+    int argIndex = 0;
+    tfTableBaseKernel_->setArg(argIndex++, *samplesCL);
+    tfTableBaseKernel_->setArg(argIndex++, *prevSamplesCL);
+    tfTableBaseKernel_->setArg(argIndex++, useDifference ? 1 : 0);
+    tfTableBaseKernel_->setArg(argIndex++, TFPointEpsilon_.get());
+    tfTableBaseKernel_->setArg(argIndex++, static_cast<int>(tableSize));
+    tfTableBaseKernel_->setArg(argIndex++, *minTableCL);
+    tfTableBaseKernel_->setArg(argIndex++, *maxTableCL);
+    OpenCL::getPtr()->getQueue().enqueueNDRangeKernel(
+        *tfTableBaseKernel_, cl::NullRange, globalWorkGroupSize, localWorkGroupSize);
+    tfTableLevelKernel_->setArg(1, static_cast<int>(tableSize));
+    tfTableLevelKernel_->setArg(2, *minTableCL);
+    tfTableLevelKernel_->setArg(3, *maxTableCL);
+    for (auto level = 1; level < static_cast<int>(nLevels); ++level) {
+        tfTableLevelKernel_->setArg(0, level);
+        OpenCL::getPtr()->getQueue().enqueueNDRangeKernel(
+            *tfTableLevelKernel_, cl::NullRange, globalWorkGroupSize, localWorkGroupSize);
+    }
 }
 
 void MinMaxUniformGrid3DImportanceCLProcessor::setInvalidationReason(
@@ -511,16 +520,4 @@ void MinMaxUniformGrid3DImportanceCLProcessor::setInvalidationReason(
     invalidationFlag_ |= invalidationFlag;
 }
 
-TFPrimitive MinMaxUniformGrid3DImportanceCLProcessor::mix(const TFPrimitive &a,
-                                                          const TFPrimitive &b,
-                                                          const TFPrimitive &t) {
-    return mix(a, b, (t.getPosition() - a.getPosition()) / (b.getPosition() - a.getPosition()));
-}
-
-inviwo::TFPrimitive MinMaxUniformGrid3DImportanceCLProcessor::mix(const TFPrimitive &a,
-                                                                  const TFPrimitive &b, double t) {
-    return TFPrimitive(glm::mix(a.getPosition(), b.getPosition(), t),
-                       glm::mix(a.getColor(), b.getColor(), t));
-}
-
 }  // namespace inviwo
@@ -36,6 +36,8 @@
 #include <inviwo/core/common/inviwo.h>
 #include <inviwo/core/processors/processor.h>
 #include <inviwo/core/properties/boolproperty.h>
+#include <inviwo/core/properties/cameraproperty.h>
+#include <inviwo/core/properties/optionproperty.h>
 #include <inviwo/core/properties/ordinalproperty.h>
 #include <inviwo/core/properties/transferfunctionproperty.h>
 
@@ -46,6 +48,7 @@
 
 
 #include <modules/uniformgridcl/minmaxuniformgrid3d.h>
+#include <modules/uniformgridcl/uniformgrid3dquantizercl.h>
 #include <modules/importancesamplingcl/importanceuniformgrid3d.h>
 #include <modules/uniformgridcl/processors/dynamicvolumedifferenceanalysis.h>
 
@@ -96,6 +99,7 @@ public:
                            const size_t &localWorkgroupSize, cl::Event *event);
     void computeImportance(const BufferCLBase *minMaxUniformGridCL, const BufferCLBase *prevMinMaxUniformGridCL,
                            const BufferCLBase *volumeDifferenceInfoUniformGridCL,
+                           int volumeDifferenceElementSize, const BufferCLBase *volumeDifferenceScaleCL,
                            size_t nElements,
                            BufferCLBase *importanceUniformGridCL,
                            const size_t &globalWorkGroupSize,
@@ -103,21 +107,35 @@ public:
     
     float getLabColorNormalizationFactor() const;
     
-    void updateTransferFunctionData();
+    /**
+     * \brief Sample transfer function and build min/max table used for classifying data ranges.
+     * @param sampleTransferFunction Resample transfer function, previous samples are kept for difference computation.
+     * @param useDifference Build table from absolute difference between current and previous transfer function.
+     */
+    void updateTransferFunctionTable(bool sampleTransferFunction, bool useDifference);
     
-    void updateTransferFunctionDifferenceData();
-    
-    vec4 tfPointColorDiff(const vec4 &p1, const vec4 &p2);
+    /**
+     * \brief Scale importance of each cell by how visible it is from the camera.
+     * Visibility is estimated by accumulating the minimum opacity of the cells between the cell and the camera.
+     */
+    void applyCameraVisibility(const MinMaxUniformGrid3D* minMaxUniformGrid3D, const BufferCLBase *minMaxUniformGridCL,
+                               BufferCLBase *importanceUniformGridCL, const size_t &globalWorkGroupSize,
+                               const size_t &localWorkgroupSize, cl::Event *event);
+    // True if camera_ is linked to another camera, it otherwise has the default view
+    bool isCameraLinked() const;
     
     BoolProperty incrementalImportance;
     
+    /**
+     * \brief Quantize the float importance into quantizedImportanceUniformGrid3D_, normalized by its largest value.
+     * @param nElements Number of elements including padding of the grid layout
+     */
+    void quantizeImportance(size_t nElements);
+    
 protected:
     void setInvalidationReason(InvalidationReason invalidationFlag);
-    TFPrimitive mix(const TFPrimitive &a,
-                    const TFPrimitive &b,
-                    const TFPrimitive &t);
-    TFPrimitive mix(const TFPrimitive &a,
-                    const TFPrimitive &b, double t);
+    void buildTransferFunctionTable(const BufferCLBase* samplesCL, const BufferCLBase* prevSamplesCL, bool useDifference,
+                                    Buffer<vec4>& minTable, Buffer<vec4>& maxTable);
     UniformGrid3DInport minMaxUniformGrid3DInport_;  // Uniform grid with minimum
     // and maximum volume data
     // values
@@ -132,26 +150,41 @@ protected:
     FloatProperty colorWeight_;
     FloatProperty colorDiffWeight_;
     BoolProperty useAssociatedColor_;
+    FloatProperty visibilityWeight_; // Zero disables camera visibility
+    CameraProperty camera_; // Must be linked to the rendering camera, visibility is not applied otherwise
     
     FloatProperty TFPointEpsilon_; // Threshold for considering two TF points different
     
     TransferFunctionProperty transferFunction_;
-    TransferFunction prevTransferFunction_;
+    OptionPropertyInt precision_; // Bits per output value, 8 and 16 bits are quantized with a per-grid value scale
     IntProperty workGroupSize_;
     BoolProperty useGLSharing_;
     
-    Buffer<float> tfPointPositions_;
-    Buffer<vec4> tfPointColors_;
-    int tfPointImportanceSize_ = 0;
+    Buffer<vec4> tfSamples_;
+    Buffer<vec4> prevTfSamples_;
+    bool hasPrevTfSamples_ = false;
+    // Min/max of transfer function (difference) for O(1) range classification, see transferfunctionminmaxtable.cl
+    Buffer<vec4> tfMinTable_;
+    Buffer<vec4> tfMaxTable_;
+    bool tfTableIsDifference_ = false;
+    // Table of current transfer function, only used for visibility when tfMinTable_ contains differences
+    Buffer<vec4> tfVisibilityMinTable_;
+    Buffer<vec4> tfVisibilityMaxTable_;
     InvalidationReason invalidationFlag_ = InvalidationReason::All;
     bool tfChanged_ = true;
     cl::Kernel *kernel_;
     cl::Kernel *timeVaryingKernel_;
+    cl::Kernel *sampleTransferFunctionKernel_;
+    cl::Kernel *tfTableBaseKernel_;
+    cl::Kernel *tfTableLevelKernel_;
+    cl::Kernel *visibilityKernel_;
     
     std::shared_ptr<const MinMaxUniformGrid3D>
     prevMinMaxUniformGrid3D_; ///< Previous time-step
     
-    std::shared_ptr<ImportanceUniformGrid3D> importanceUniformGrid3D_;
+    std::shared_ptr<ImportanceUniformGrid3D> importanceUniformGrid3D_; // Always computed in float
+    std::shared_ptr<UniformGrid3DBase> quantizedImportanceUniformGrid3D_; // Output if precision_ is below 32 bits
+    UniformGrid3DQuantizerCL quantizer_;
 };
 
 inline MinMaxUniformGrid3DImportanceCLProcessor::InvalidationReason
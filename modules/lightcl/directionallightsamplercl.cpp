@@ -73,6 +73,7 @@ void DirectionalLightSamplerCL::sampleLightSource(const Mesh* mesh, const Sample
     std::tie(lightOrigin, u, v) = geometry::fitPlaneAlignedOrientedBoundingBox2D(vertices->getDataContainer(), Plane(lightOrigin, lightDirection));
     
     float area = glm::length(u) * glm::length(v);
+    lightSamplesOut.setLightDirection(lightDirection);
     //LogInfo("Bounding box center: " << lightOrigin + 0.5f*(u + v));
     //LogInfo("direction, o, lightU, lightV:" << lightDirection << o << u << v);
     bool useGLSharing = true;
@@ -152,6 +153,7 @@ void DirectionalLightSamplerCL::sampleLightSource(const Mesh* mesh, LightSamples
     std::tie(lightOrigin, u, v) = geometry::fitPlaneAlignedOrientedBoundingBox2D(vertices->getDataContainer(), Plane(lightOrigin, lightDirection));
     
     float area = glm::length(u) * glm::length(v);
+    lightSamplesOut.setLightDirection(lightDirection);
     //LogInfo("Bounding box center: " << lightOrigin + 0.5f*(u + v));
     //LogInfo("direction, o, lightU, lightV:" << lightDirection << o << u << v);
     bool useGLSharing = true;
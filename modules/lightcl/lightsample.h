@@ -108,10 +108,18 @@ public:
     bool isReset() const { return iteration_ <= 1; }
     size_t getIteration() const { return iteration_; }
     void setIteration(size_t val) { iteration_ = val; }
+    /**
+     * \brief Main direction of the light source in data space.
+     * Zero if the light source does not have a main direction, e.g. point light.
+     * Used to measure how much the light source changed.
+     */
+    vec3 getLightDirection() const { return lightDirection_; }
+    void setLightDirection(vec3 val) { lightDirection_ = val; }
 private:
     Buffer<unsigned char> lightSamples_;
     Buffer<vec2> intersectionPoints_; // tStart, tEnd for each light sample
     size_t iteration_ = 0; // Resets when light source changes
+    vec3 lightDirection_{ 0.f };
 };
 
 template<>
@@ -0,0 +1,391 @@
+/*********************************************************************************
+ *
+ * Copyright (c) 2016, Daniel Jönsson
+ * All rights reserved.
+ * 
+ * This work is licensed under a Creative Commons Attribution-NonCommercial 4.0 International License.
+ * http://creativecommons.org/licenses/by-nc/4.0/
+ * 
+ * You are free to:
+ * 
+ * Share — copy and redistribute the material in any medium or format
+ * Adapt — remix, transform, and build upon the material
+ * The licensor cannot revoke these freedoms as long as you follow the license terms.
+ * Under the following terms:
+ * 
+ * Attribution — You must give appropriate credit, provide a link to the license, and indicate if changes were made. You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+ * NonCommercial — You may not use the material for commercial purposes.
+ * No additional restrictions — You may not apply legal terms or technological measures that legally restrict others from doing anything the license permits.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/*
+ * light-volume-batch: computes light volumes of a volume sequence without a display.
+ *
+ * Builds the OpenCL part of the CorrelatedPhotonMappingSingleVolume workspace
+ * (min-max grid, recomputation importance, light sampling, photon tracing and splatting)
+ * with OpenGL sharing disabled and evaluates it once per timestep.
+ * Photons are recomputed between consecutive timesteps exactly as in the interactive network.
+ *
+ * Example:
+ *   light-volume-batch -v sequence.dat -t tf.itf --light-direction "0 -1 0" --photons 1048576 -o out/
+ */
+
+#include <inviwo/core/common/inviwoapplication.h>
+#include <inviwo/core/datastructures/light/directionallight.h>
+#include <inviwo/core/datastructures/transferfunction.h>
+#include <inviwo/core/datastructures/volume/volume.h>
+#include <inviwo/core/io/datareaderfactory.h>
+#include <inviwo/core/io/datawriterfactory.h>
+#include <inviwo/core/network/networklock.h>
+#include <inviwo/core/network/processornetwork.h>
+#include <inviwo/core/ports/volumeport.h>
+#include <inviwo/core/processors/processor.h>
+#include <inviwo/core/properties/boolproperty.h>
+#include <inviwo/core/properties/optionproperty.h>
+#include <inviwo/core/properties/ordinalproperty.h>
+#include <inviwo/core/properties/transferfunctionproperty.h>
+#include <inviwo/core/util/consolelogger.h>
+#include <inviwo/core/util/exception.h>
+#include <inviwo/core/util/logcentral.h>
+#include <inviwo/core/util/raiiutils.h>
+#include <inviwo/sys/moduleloading.h>
+
+#include <modules/base/processors/cubeproxygeometryprocessor.h>
+#include <modules/importancesamplingcl/processors/minmaxuniformgrid3dimportanceclprocessor.h>
+#include <modules/importancesamplingcl/processors/uniformsamplegenerator2dprocessorcl.h>
+#include <modules/lightcl/processors/directionallightsamplerclprocessor.h>
+#include <modules/opencl/inviwoopencl.h>
+#include <modules/progressivephotonmapping/processor/photontolightvolumeprocessorcl.h>
+#include <modules/progressivephotonmapping/processor/progressivephotontracercl.h>
+#include <modules/uniformgridcl/processors/volumeminmaxclprocessor.h>
+#include <modules/uniformgridcl/uniformgrid3d.h>
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <tclap/CmdLine.h>
+#include <warn/pop>
+
+#include <fmt/format.h>
+
+#include <cmath>
+#include <sstream>
+
+namespace inviwo {
+
+/**
+ * \brief Provides the current timestep and light source to the network.
+ * Data is set from outside the network, process() does nothing.
+ */
+class BatchSequenceSource : public Processor {
+public:
+    BatchSequenceSource() : Processor(), volume_("volume"), minMaxGrid_("minMaxGrid"), light_("light") {
+        addPort(volume_);
+        addPort(minMaxGrid_);
+        addPort(light_);
+    }
+    virtual ~BatchSequenceSource() = default;
+    
+    virtual void process() override {}
+    
+    void setTimestep(std::shared_ptr<Volume> volume, std::shared_ptr<UniformGrid3DBase> minMaxGrid) {
+        volume_.setData(volume);
+        if (minMaxGrid) {
+            minMaxGrid_.setData(minMaxGrid);
+        }
+        invalidate(InvalidationLevel::InvalidOutput);
+    }
+    void setLight(std::shared_ptr<LightSource> light) {
+        light_.setData(light);
+        invalidate(InvalidationLevel::InvalidOutput);
+    }
+    
+    virtual const ProcessorInfo getProcessorInfo() const override { return processorInfo_; }
+    static const ProcessorInfo processorInfo_;
+    
+    VolumeOutport volume_;
+    UniformGrid3DOutport minMaxGrid_; // Only connected if min-max grids are precomputed
+    DataOutport<LightSource> light_;
+};
+const ProcessorInfo BatchSequenceSource::processorInfo_{
+    "org.inviwo.BatchSequenceSource",   // Class identifier
+    "Batch Sequence Source",            // Display name
+    "Data Input",                       // Category
+    CodeState::Experimental,            // Code state
+    Tags::CPU,                          // Tags
+};
+
+/**
+ * \brief Pulls the light volume through the network, it is written to disk by the caller.
+ */
+class BatchLightVolumeSink : public Processor {
+public:
+    BatchLightVolumeSink() : Processor(), lightVolume_("lightVolume") {
+        addPort(lightVolume_);
+    }
+    virtual ~BatchLightVolumeSink() = default;
+    
+    virtual void process() override {}
+    
+    virtual const ProcessorInfo getProcessorInfo() const override { return processorInfo_; }
+    static const ProcessorInfo processorInfo_;
+    
+    VolumeInport lightVolume_;
+};
+const ProcessorInfo BatchLightVolumeSink::processorInfo_{
+    "org.inviwo.BatchLightVolumeSink",  // Class identifier
+    "Batch Light Volume Sink",          // Display name
+    "Data Output",                      // Category
+    CodeState::Experimental,            // Code state
+    Tags::CPU,                          // Tags
+};
+
+namespace {
+
+template <typename P, typename T>
+void setProperty(Processor* processor, const std::string& identifier, const T& value) {
+    if (auto property = dynamic_cast<P*>(processor->getPropertyByIdentifier(identifier))) {
+        property->set(value);
+    } else {
+        throw Exception(fmt::format("Property '{}' not found in {}", identifier, processor->getIdentifier()), IVW_CONTEXT_CUSTOM("light-volume-batch"));
+    }
+}
+
+template <typename P>
+void setSelectedOption(Processor* processor, const std::string& identifier, const std::string& option) {
+    auto property = dynamic_cast<P*>(processor->getPropertyByIdentifier(identifier));
+    if (!property || !property->setSelectedIdentifier(option)) {
+        throw Exception(fmt::format("Option '{}' of '{}' not found in {}", option, identifier, processor->getIdentifier()), IVW_CONTEXT_CUSTOM("light-volume-batch"));
+    }
+}
+
+vec3 parseVec3(const std::string& str) {
+    std::istringstream ss(str);
+    vec3 v;
+    if (!(ss >> v.x >> v.y >> v.z)) {
+        throw Exception(fmt::format("Expected three values separated by space, got '{}'", str), IVW_CONTEXT_CUSTOM("light-volume-batch"));
+    }
+    return v;
+}
+
+// Prefer a CPU device if requested, otherwise keep the device selected in the OpenCL settings
+cl::Device selectDevice(bool preferCPU) {
+    if (preferCPU) {
+        std::vector<cl::Platform> platforms;
+        cl::Platform::get(&platforms);
+        for (auto& platform : platforms) {
+            std::vector<cl::Device> devices;
+            try {
+                platform.getDevices(CL_DEVICE_TYPE_CPU, &devices);
+            } catch (cl::Error&) {
+                // Platform without CPU devices
+                continue;
+            }
+            if (!devices.empty()) {
+                return devices.front();
+            }
+        }
+        LogWarnCustom("light-volume-batch", "No CPU OpenCL device found, using default device");
+    }
+    return OpenCL::getPtr()->getDevice();
+}
+
+VolumeSequence readVolumes(InviwoApplication& app, const std::vector<std::string>& files) {
+    VolumeSequence volumes;
+    auto factory = app.getDataReaderFactory();
+    for (const auto& file : files) {
+        if (auto reader = factory->getReaderForTypeAndExtension<VolumeSequence>(file)) {
+            auto sequence = reader->readData(file);
+            volumes.insert(volumes.end(), sequence->begin(), sequence->end());
+        } else if (auto volumeReader = factory->getReaderForTypeAndExtension<Volume>(file)) {
+            volumes.push_back(volumeReader->readData(file));
+        } else {
+            throw Exception(fmt::format("No reader found for '{}'", file), IVW_CONTEXT_CUSTOM("light-volume-batch"));
+        }
+    }
+    return volumes;
+}
+
+UniformGrid3DVector readGrids(InviwoApplication& app, const std::vector<std::string>& files) {
+    UniformGrid3DVector grids;
+    auto factory = app.getDataReaderFactory();
+    for (const auto& file : files) {
+        auto reader = factory->getReaderForTypeAndExtension<UniformGrid3DVector>(file);
+        if (!reader) {
+            throw Exception(fmt::format("No reader found for '{}'", file), IVW_CONTEXT_CUSTOM("light-volume-batch"));
+        }
+        auto sequence = reader->readData(file);
+        grids.insert(grids.end(), sequence->begin(), sequence->end());
+    }
+    return grids;
+}
+
+} // namespace
+
+} // namespace inviwo
+
+int main(int argc, char** argv) {
+    using namespace inviwo;
+    
+    TCLAP::CmdLine cmd("Computes light volumes of a volume sequence using correlated photon mapping", ' ', "1.0");
+    TCLAP::MultiArg<std::string> volumeArg("v", "volume", "Volume or volume sequence file, timesteps of several files are concatenated", true, "file", cmd);
+    TCLAP::MultiArg<std::string> minMaxArg("m", "minmax", "Precomputed min-max grids (.u3d), one per timestep. Computed from the volumes if not given", false, "file", cmd);
+    TCLAP::ValueArg<std::string> tfArg("t", "transferfunction", "Transfer function file", true, "", "file", cmd);
+    TCLAP::ValueArg<std::string> lightDirectionArg("", "light-direction", "Direction the light travels in world space", false, "0 0 1", "\"x y z\"", cmd);
+    TCLAP::ValueArg<std::string> lightColorArg("", "light-color", "Light color", false, "1 1 1", "\"r g b\"", cmd);
+    TCLAP::ValueArg<float> lightPowerArg("", "light-power", "Light power", false, 1.f, "float", cmd);
+    TCLAP::ValueArg<int> photonsArg("p", "photons", "Photon budget per timestep", false, 256 * 256, "int", cmd);
+    TCLAP::ValueArg<int> scatteringArg("s", "scattering", "Max scattering events per photon", false, 1, "int", cmd);
+    TCLAP::ValueArg<std::string> sizeArg("", "light-volume-size", "Light volume size relative to the volume: radius, 1, 1/2 or 1/4", false, "radius", "string", cmd);
+    TCLAP::ValueArg<std::string> typeArg("", "light-volume-type", "Light volume data type: float16, float32, 4xfloat16 or 4xfloat32", false, "float32", "string", cmd);
+    TCLAP::ValueArg<std::string> outputArg("o", "output", "Output directory", false, ".", "directory", cmd);
+    TCLAP::ValueArg<std::string> extensionArg("e", "extension", "Output file extension, selects the volume writer", false, "dat", "string", cmd);
+    TCLAP::SwitchArg cpuArg("", "cpu", "Run on a CPU OpenCL device", cmd);
+    cmd.parse(argc, argv);
+    
+    LogCentral::init();
+    util::OnScopeExit deleteLogcentral([]() { LogCentral::deleteInstance(); });
+    auto logger = std::make_shared<ConsoleLogger>();
+    LogCentral::getPtr()->registerLogger(logger);
+    
+    // Arguments of the tool are not meant for the application
+    InviwoApplication inviwoApp(1, argv, "light-volume-batch");
+    util::registerModules(inviwoApp.getModuleManager(),
+                          inviwoApp.getSystemSettings().moduleSearchPaths_.get(),
+                          inviwoApp.getCommandLineParser().getModuleSearchPaths());
+    
+    try {
+        // No OpenGL context is needed when sharing is disabled
+        OpenCL::getPtr()->setDevice(selectDevice(cpuArg.getValue()), false);
+        
+        auto volumes = readVolumes(inviwoApp, volumeArg.getValue());
+        auto minMaxGrids = readGrids(inviwoApp, minMaxArg.getValue());
+        if (volumes.empty()) {
+            throw Exception("No volumes to process", IVW_CONTEXT_CUSTOM("light-volume-batch"));
+        }
+        if (!minMaxGrids.empty() && minMaxGrids.size() != volumes.size()) {
+            throw Exception(fmt::format("{} min-max grids given for {} timesteps", minMaxGrids.size(), volumes.size()), IVW_CONTEXT_CUSTOM("light-volume-batch"));
+        }
+        auto tfReader = inviwoApp.getDataReaderFactory()->getReaderForTypeAndExtension<TransferFunction>(tfArg.getValue());
+        if (!tfReader) {
+            throw Exception(fmt::format("No reader found for '{}'", tfArg.getValue()), IVW_CONTEXT_CUSTOM("light-volume-batch"));
+        }
+        auto transferFunction = tfReader->readData(tfArg.getValue());
+        auto writer = inviwoApp.getDataWriterFactory()->getWriterForTypeAndExtension<Volume>(extensionArg.getValue());
+        if (!writer) {
+            throw Exception(fmt::format("No volume writer for extension '{}'", extensionArg.getValue()), IVW_CONTEXT_CUSTOM("light-volume-batch"));
+        }
+        writer->setOverwrite(Overwrite::Yes);
+        
+        auto light = std::make_shared<DirectionalLight>();
+        light->setDirection(glm::normalize(parseVec3(lightDirectionArg.getValue())));
+        light->setIntensity(lightPowerArg.getValue() * parseVec3(lightColorArg.getValue()));
+        light->setEnabled(true);
+        
+        auto network = inviwoApp.getProcessorNetwork();
+        auto source = std::make_shared<BatchSequenceSource>();
+        auto proxyGeometry = std::make_shared<CubeProxyGeometry>();
+        auto sampleGenerator = std::make_shared<UniformSampleGenerator2DProcessorCL>();
+        auto lightSampler = std::make_shared<DirectionalLightSamplerCLProcessor>();
+        auto minMax = std::make_shared<VolumeMinMaxCLProcessor>();
+        auto importance = std::make_shared<MinMaxUniformGrid3DImportanceCLProcessor>();
+        auto photonTracer = std::make_shared<ProgressivePhotonTracerCL>();
+        auto photonsToLightVolume = std::make_shared<PhotonToLightVolumeProcessorCL>();
+        auto sink = std::make_shared<BatchLightVolumeSink>();
+        
+        {
+            NetworkLock lock(network);
+            std::vector<std::pair<std::shared_ptr<Processor>, std::string>> processors = {
+                {source, "Source"}, {proxyGeometry, "Cube Proxy Geometry"},
+                {sampleGenerator, "UniformSampleGenerator2D"}, {lightSampler, "Directional light sampler"},
+                {importance, "MinMaxUniformGrid3DImportance"}, {photonTracer, "ProgressivePhotonTracer"},
+                {photonsToLightVolume, "PhotonToLightVolumeProcessorCL"}, {sink, "Sink"}};
+            if (minMaxGrids.empty()) {
+                processors.emplace_back(minMax, "Min-max uniform grid");
+            }
+            for (auto& p : processors) {
+                p.first->setIdentifier(p.second);
+                // Pure OpenCL path
+                if (auto glSharing = dynamic_cast<BoolProperty*>(p.first->getPropertyByIdentifier("glsharing"))) {
+                    glSharing->set(false);
+                }
+                network->addProcessor(p.first);
+            }
+            
+            network->addConnection(source->getOutport("volume"), proxyGeometry->getInport("volume"));
+            network->addConnection(proxyGeometry->getOutport("proxyGeometry"), lightSampler->getInport("SceneGeometry"));
+            network->addConnection(sampleGenerator->getOutport("samples"), lightSampler->getInport("samples"));
+            network->addConnection(source->getOutport("light"), lightSampler->getInport("light"));
+            if (minMaxGrids.empty()) {
+                network->addConnection(source->getOutport("volume"), minMax->getInport("volume"));
+                network->addConnection(minMax->getOutport("output"), importance->getInport("minMaxUniformGrid3D"));
+            } else {
+                network->addConnection(source->getOutport("minMaxGrid"), importance->getInport("minMaxUniformGrid3D"));
+            }
+            network->addConnection(importance->getOutport("importanceUniformGrid3D"), photonTracer->getInport("recomputationImportance"));
+            network->addConnection(source->getOutport("volume"), photonTracer->getInport("volume"));
+            network->addConnection(lightSampler->getOutport("LightSamples"), photonTracer->getInport("LightSamples"));
+            network->addConnection(source->getOutport("volume"), photonsToLightVolume->getInport("volume"));
+            network->addConnection(photonTracer->getOutport("photons"), photonsToLightVolume->getInport("photons"));
+            network->addConnection(photonTracer->getOutport("recomputedIndices"), photonsToLightVolume->getInport("recomputedPhotonIndices"));
+            network->addConnection(photonsToLightVolume->getOutport("lightvolume"), sink->getInport("lightVolume"));
+            
+            // Photon budget as a close to square grid of light samples
+            auto nPhotons = std::max(photonsArg.getValue(), 4);
+            auto samplesX = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(nPhotons))));
+            setProperty<IntVec2Property>(sampleGenerator.get(), "nSamples", ivec2(samplesX, (nPhotons + samplesX - 1) / samplesX));
+            
+            // The camera is unknown, importance only depends on the transfer function and data changes
+            setProperty<FloatProperty>(importance.get(), "visibilityWeight", 0.f);
+            setProperty<TransferFunctionProperty>(importance.get(), "transferfunction", *transferFunction);
+            setProperty<TransferFunctionProperty>(photonTracer.get(), "transferFunction", *transferFunction);
+            setProperty<IntProperty>(photonTracer.get(), "maxScatteringEvents", scatteringArg.getValue());
+            // Each timestep must be complete after a single evaluation
+            setProperty<BoolProperty>(photonTracer.get(), "enableRefinement", false);
+            setProperty<FloatProperty>(photonTracer.get(), "maxIncrementalPhotonsToUpdate", 100.f);
+            setSelectedOption<OptionPropertyInt>(photonsToLightVolume.get(), "volumeSizeOption", sizeArg.getValue());
+            setSelectedOption<OptionPropertyString>(photonsToLightVolume.get(), "volumeDataType", typeArg.getValue());
+            
+            source->setLight(light);
+        }
+        
+        std::filesystem::path outputDir(outputArg.getValue());
+        std::filesystem::create_directories(outputDir);
+        for (size_t timestep = 0; timestep < volumes.size(); ++timestep) {
+            {
+                // Evaluated when the lock is released
+                NetworkLock lock(network);
+                source->setTimestep(volumes[timestep], minMaxGrids.empty() ? nullptr : minMaxGrids[timestep]);
+            }
+            inviwoApp.processFront();
+            OpenCL::getPtr()->getQueue().finish();
+            
+            auto lightVolume = sink->lightVolume_.getData();
+            if (!lightVolume) {
+                throw Exception(fmt::format("No light volume computed for timestep {}", timestep), IVW_CONTEXT_CUSTOM("light-volume-batch"));
+            }
+            auto path = outputDir / fmt::format("lightvolume_{:04}.{}", timestep, extensionArg.getValue());
+            writer->writeData(lightVolume.get(), path);
+            LogInfoCustom("light-volume-batch", fmt::format("Timestep {}/{} written to {}", timestep + 1, volumes.size(), path.string()));
+        }
+    } catch (const Exception& e) {
+        LogErrorCustom("light-volume-batch", e.getMessage());
+        return 1;
+    } catch (cl::Error& err) {
+        LogErrorCustom("light-volume-batch", getCLErrorString(err));
+        return 1;
+    }
+    
+    return 0;
+}
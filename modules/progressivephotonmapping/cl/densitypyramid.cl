@@ -0,0 +1,110 @@
+﻿/*********************************************************************************
+ *
+ * Copyright (c) 2016, Daniel Jönsson
+ * All rights reserved.
+ * 
+ * This work is licensed under a Creative Commons Attribution-NonCommercial 4.0 International License.
+ * http://creativecommons.org/licenses/by-nc/4.0/
+ * 
+ * You are free to:
+ * 
+ * Share — copy and redistribute the material in any medium or format
+ * Adapt — remix, transform, and build upon the material
+ * The licensor cannot revoke these freedoms as long as you follow the license terms.
+ * Under the following terms:
+ * 
+ * Attribution — You must give appropriate credit, provide a link to the license, and indicate if changes were made. You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+ * NonCommercial — You may not use the material for commercial purposes.
+ * No additional restrictions — You may not apply legal terms or technological measures that legally restrict others from doing anything the license permits.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+#ifndef DENSITY_PYRAMID_CL
+#define DENSITY_PYRAMID_CL
+
+#include "samplers.cl"
+
+// Density mip pyramid stored as a single atlas image. 
+// Levels 1..N are placed next to each other along x, level 0 is the volume itself.
+// densityPyramidLevels[level] = (dimensions.xyz, x-offset into atlas)
+
+__constant sampler_t smpDensityPyramidLinear = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_LINEAR;
+
+int densityPyramidIndex(int3 coord, int4 level, int4 atlasDim) {
+    return level.w + coord.x + atlasDim.x*(coord.y + atlasDim.y*coord.z);
+}
+
+/**
+* \brief Sample pyramid level >= 1 at texture space position pos.
+* Coordinates are clamped to the level so that linear filtering does not
+* blend in neighboring levels of the atlas.
+*/
+float getDensityPyramidVoxel(read_only image3d_t densityPyramid, __constant int4* densityPyramidLevels, int level, float3 pos) {
+    int4 levelInfo = densityPyramidLevels[level];
+    float3 levelDim = convert_float3(levelInfo.xyz);
+    float3 coord = clamp(pos*levelDim, 0.5f, levelDim-0.5f);
+    coord.x += convert_float(levelInfo.w);
+    return read_imagef(densityPyramid, smpDensityPyramidLinear, (float4)(coord, 0.f)).x;
+}
+
+// Average 2x2x2 voxels of the volume into the first pyramid level
+__kernel void densityPyramidBaseLevelKernel(read_only image3d_t volumeTex, __constant VolumeParameters* volumeParams
+    , int4 levelInfo
+    , int4 atlasDim
+    , __global float* densityPyramid
+    )
+{
+    int3 globalId = (int3)(get_global_id(0), get_global_id(1), get_global_id(2));
+    if (any(globalId >= levelInfo.xyz)) {
+        return;
+    }
+    int4 volumeDim = get_image_dim(volumeTex);
+    int3 startCoord = 2*globalId;
+    int3 endCoord = min(startCoord+2, volumeDim.xyz);
+    float sum = 0.f;
+    for (int z = startCoord.z; z < endCoord.z; ++z) {
+        for (int y = startCoord.y; y < endCoord.y; ++y) {
+            for (int x = startCoord.x; x < endCoord.x; ++x) {
+                sum += getNormalizedVoxelUnorm(volumeTex, volumeParams, (int4)(x, y, z, 0)).x;
+            }
+        }
+    }
+    int3 nVoxels = endCoord-startCoord;
+    densityPyramid[densityPyramidIndex(globalId, levelInfo, atlasDim)] = sum/convert_float(nVoxels.x*nVoxels.y*nVoxels.z);
+}
+
+// Average 2x2x2 voxels of the previous level into the next one
+__kernel void densityPyramidLevelKernel(int4 srcLevelInfo, int4 dstLevelInfo
+    , int4 atlasDim
+    , __global float* densityPyramid
+    )
+{
+    int3 globalId = (int3)(get_global_id(0), get_global_id(1), get_global_id(2));
+    if (any(globalId >= dstLevelInfo.xyz)) {
+        return;
+    }
+    int3 startCoord = 2*globalId;
+    int3 endCoord = min(startCoord+2, srcLevelInfo.xyz);
+    float sum = 0.f;
+    for (int z = startCoord.z; z < endCoord.z; ++z) {
+        for (int y = startCoord.y; y < endCoord.y; ++y) {
+            for (int x = startCoord.x; x < endCoord.x; ++x) {
+                sum += densityPyramid[densityPyramidIndex((int3)(x, y, z), srcLevelInfo, atlasDim)];
+            }
+        }
+    }
+    int3 nVoxels = endCoord-startCoord;
+    densityPyramid[densityPyramidIndex(globalId, dstLevelInfo, atlasDim)] = sum/convert_float(nVoxels.x*nVoxels.y*nVoxels.z);
+}
+
+#endif // DENSITY_PYRAMID_CL
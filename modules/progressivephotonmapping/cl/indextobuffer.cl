@@ -37,4 +37,14 @@ __kernel void indexToBufferKernel(__global unsigned int* indices, int nElements)
         return;
     }
     indices[threadId] = threadId;
+}
+
+// Write offset, offset+1, ... wrapping around at nIndices
+__kernel void ringIndexToBufferKernel(__global unsigned int* indices, int offset, int nIndices, int nElements)
+{
+    int threadId = get_global_id(0);
+    if (threadId >= nElements) {
+        return;
+    }
+    indices[threadId] = (unsigned int)((offset + threadId) % nIndices);
 }
\ No newline at end of file
@@ -0,0 +1,85 @@
+﻿/*********************************************************************************
+ *
+ * Copyright (c) 2016, Daniel Jönsson
+ * All rights reserved.
+ * 
+ * This work is licensed under a Creative Commons Attribution-NonCommercial 4.0 International License.
+ * http://creativecommons.org/licenses/by-nc/4.0/
+ * 
+ * You are free to:
+ * 
+ * Share — copy and redistribute the material in any medium or format
+ * Adapt — remix, transform, and build upon the material
+ * The licensor cannot revoke these freedoms as long as you follow the license terms.
+ * Under the following terms:
+ * 
+ * Attribution — You must give appropriate credit, provide a link to the license, and indicate if changes were made. You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+ * NonCommercial — You may not use the material for commercial purposes.
+ * No additional restrictions — You may not apply legal terms or technological measures that legally restrict others from doing anything the license permits.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include "photon.cl"
+
+bool isValidPhoton(float8 photonData) {
+    // Unused interaction slots are marked with FLT_MAX
+    return all(photonData.xyz != (float3)(FLT_MAX));
+}
+
+// Count valid photons of each path. 
+// Thread nPhotons writes zero so that an exclusive scan of nPhotons + 1 counts 
+// also gives the total number of valid photons.
+__kernel void countPathPhotonsKernel(
+      __global const PHOTON_DATA_TYPE* photonDataArray
+    , int nPhotons // Number of photons per scattering event
+    , int nInteractions // Maximum number of scattering events
+    , __global uint* pathCounts
+    )
+{
+    int photonId = get_global_id(0);
+    if (photonId > nPhotons) {
+        return;
+    }
+    uint count = 0;
+    if (photonId < nPhotons) {
+        for (int interaction = 0; interaction < nInteractions; ++interaction) {
+            if (isValidPhoton(readPhoton(photonDataArray, interaction * nPhotons + photonId))) {
+                ++count;
+            }
+        }
+    }
+    pathCounts[photonId] = count;
+}
+
+// Append valid photons of each path to consecutive elements starting at the scanned path offset
+__kernel void compactPhotonsKernel(
+      __global const PHOTON_DATA_TYPE* photonDataArray
+    , int nPhotons // Number of photons per scattering event
+    , int nInteractions // Maximum number of scattering events
+    , __global const uint* pathOffsets
+    , __global PHOTON_DATA_TYPE* compactedPhotons
+    )
+{
+    int photonId = get_global_id(0);
+    if (photonId >= nPhotons) {
+        return;
+    }
+    uint outIndex = pathOffsets[photonId];
+    for (int interaction = 0; interaction < nInteractions; ++interaction) {
+        float8 photonData = readPhoton(photonDataArray, interaction * nPhotons + photonId);
+        if (isValidPhoton(photonData)) {
+            writePhoton(photonData, compactedPhotons, outIndex++);
+        }
+    }
+}
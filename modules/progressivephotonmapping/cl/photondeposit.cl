@@ -0,0 +1,78 @@
+﻿/*********************************************************************************
+ *
+ * Copyright (c) 2016, Daniel Jönsson
+ * All rights reserved.
+ * 
+ * This work is licensed under a Creative Commons Attribution-NonCommercial 4.0 International License.
+ * http://creativecommons.org/licenses/by-nc/4.0/
+ * 
+ * You are free to:
+ * 
+ * Share — copy and redistribute the material in any medium or format
+ * Adapt — remix, transform, and build upon the material
+ * The licensor cannot revoke these freedoms as long as you follow the license terms.
+ * Under the following terms:
+ * 
+ * Attribution — You must give appropriate credit, provide a link to the license, and indicate if changes were made. You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+ * NonCommercial — You may not use the material for commercial purposes.
+ * No additional restrictions — You may not apply legal terms or technological measures that legally restrict others from doing anything the license permits.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#ifndef PHOTON_DEPOSIT_CL
+#define PHOTON_DEPOSIT_CL
+
+#include "densityestimationkernel.cl"
+
+void atomic_add_float_global(volatile global float *source, const float operand) {
+    union {
+        unsigned int intVal;
+        float floatVal;
+    } newVal;
+    union {
+        unsigned int intVal;
+        float floatVal;
+    } prevVal;
+
+    do {
+        prevVal.floatVal = *source;
+        newVal.floatVal = prevVal.floatVal + operand;
+    } while (atomic_cmpxchg((volatile global unsigned int *)source, prevVal.intVal, newVal.intVal) != prevVal.intVal);
+}
+
+// Add the power of a photon to a float4 irradiance grid, used when splatting while tracing.
+// Voxel centers are at (index + 0.5)/dimensions in texture space. 
+// Same density estimation as splatPhoton in photonstolightvolume.cl.
+void depositPhoton(volatile __global float* volumeOut, int4 volumeDim, float3 pos, float3 power, float photonRadius) {
+    float3 dim = convert_float3(volumeDim.xyz);
+    int3 startCoord = max((int3)(0), convert_int3((pos - photonRadius)*dim - 0.5f));
+    int3 endCoord = min(convert_int3((pos + photonRadius)*dim - 0.5f + 1.f), volumeDim.xyz);
+    for (int z = startCoord.z; z < endCoord.z; ++z) {
+        for (int y = startCoord.y; y < endCoord.y; ++y) {
+            for (int x = startCoord.x; x < endCoord.x; ++x) {
+                int voxelIndex = x + y*volumeDim.x + z*volumeDim.x*volumeDim.y;
+                float3 volTexCoord = (convert_float3((int3)(x, y, z)) + 0.5f) / dim;
+                float weight = densityEstimationKernel(distance(volTexCoord, pos) / photonRadius);
+                if (weight > 0.f) {
+                    float3 filteredIrradiance = power * weight;
+                    atomic_add_float_global(&volumeOut[voxelIndex * 4], filteredIrradiance.x);
+                    atomic_add_float_global(&volumeOut[voxelIndex * 4 + 1], filteredIrradiance.y);
+                    atomic_add_float_global(&volumeOut[voxelIndex * 4 + 2], filteredIrradiance.z);
+                }
+            }
+        }
+    }
+}
+
+#endif // PHOTON_DEPOSIT_CL
@@ -0,0 +1,70 @@
+﻿/*********************************************************************************
+ *
+ * Copyright (c) 2016, Daniel Jönsson
+ * All rights reserved.
+ * 
+ * This work is licensed under a Creative Commons Attribution-NonCommercial 4.0 International License.
+ * http://creativecommons.org/licenses/by-nc/4.0/
+ * 
+ * You are free to:
+ * 
+ * Share — copy and redistribute the material in any medium or format
+ * Adapt — remix, transform, and build upon the material
+ * The licensor cannot revoke these freedoms as long as you follow the license terms.
+ * Under the following terms:
+ * 
+ * Attribution — You must give appropriate credit, provide a link to the license, and indicate if changes were made. You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+ * NonCommercial — You may not use the material for commercial purposes.
+ * No additional restrictions — You may not apply legal terms or technological measures that legally restrict others from doing anything the license permits.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#ifndef PHOTON_INTERACTION_CL
+#define PHOTON_INTERACTION_CL
+
+#include "intersection/rayboxintersection.cl" 
+#include "random.cl"
+#include "shading/shading.cl" 
+#include "light/light.cl" 
+#include "datastructures/lightsample.cl"
+
+//#include "gradients.cl"
+#include "samplers.cl" 
+#include "photon.cl"
+#include "transformations.cl" 
+#include "transmittance.cl"  
+
+//__constant float SAMPLING_BASE_INTERVAL_RCP = 200.0; 
+__constant float RUSSIAN_ROULETTE_P = 0.9f;  
+
+bool nextInteraction(read_only image3d_t volumeTex, __constant VolumeParameters* volumeParams, float volumeSample, BBox volumeBBox, float4 material,
+                 float3 sample, 
+                 float3* direction, float* __restrict t0, float* __restrict t1, random_state* randstate, const ShadingType shadingType) {
+    float2 rnd = (float2)(random_01(randstate), random_01(randstate));     
+    sampleShadingFunction(volumeTex, volumeParams, volumeSample, material, sample, direction, rnd, shadingType);
+    
+    return rayBoxIntersection(volumeBBox, sample, *direction, t0, t1);
+
+}  
+bool nextInteractionPdf(read_only image3d_t volumeTex, __constant VolumeParameters* volumeParams, float volumeSample, BBox volumeBBox, float4 material,
+                 float3 sample, 
+                 float3* direction, float* __restrict t0, float* __restrict t1, float *pdf, random_state* randstate, const ShadingType shadingType) {
+    float2 rnd = (float2)(random_01(randstate), random_01(randstate));     
+    sampleShadingFunctionPdf(volumeTex, volumeParams, volumeSample, material, sample, direction, pdf, rnd, shadingType);
+    
+    return rayBoxIntersection(volumeBBox, sample, *direction, t0, t1);
+
+}
+
+#endif // PHOTON_INTERACTION_CL
@@ -54,8 +54,8 @@
 */
 float uniformGridImportance(float3 x1, float3 x2
     , float3 cellDim 
-    , __global const float* uniformGrid3D
-    , int4 uniformGridDimensions, float* tHit) {
+    , __global const uchar* uniformGrid3D
+    , int4 uniformGridDimensions, int uniformGridElementSize, float uniformGridScale, float* tHit) {
     int3 cellCoord, cellCoordEnd, di;
     float3 dt, deltatx;
     setupUniformGridTraversal(x1, x2, cellDim, uniformGridDimensions.xyz
@@ -79,7 +79,7 @@ float uniformGridImportance(float3 x1, float3 x2
         //    printf("%v3i\n", cellCoord);
         //}
 
-        float val = uniformGrid3D[cellCoord.x + cellCoord.y*uniformGridDimensions.x + cellCoord.z * uniformGridDimensions.x*uniformGridDimensions.y];
+        float val = uniformGridValue(uniformGrid3D, uniformGridCellIndex(cellCoord, uniformGridDimensions), uniformGridElementSize, uniformGridScale);
      
         float dt0 = dt1; 
         continueTraversal = stepToNextCellNextHit(deltatx, di, cellCoordEnd, &dt, &cellCoord, &dt1);
@@ -91,8 +91,10 @@ float uniformGridImportance(float3 x1, float3 x2
   
 __kernel void photonRecomputationDetectorKernel(
     // uniform grid parameters
-      __global const float* uniformGrid3D
+      __global const uchar* uniformGrid3D // float, or quantized uchar/ushort, see uniformGridValue
     , int4 uniformGridDimensions
+    , int uniformGridElementSize
+    , __global const float* uniformGridValueScaleBuffer // See uniformGridValueScale
     , float3 cellSize
     , float16 textureToIndexMat
     , float16 indexToTextureMat
@@ -112,6 +114,7 @@ __kernel void photonRecomputationDetectorKernel(
     }       
     int interaction = 0;
     float recomputationImportance = 0;
+    float uniformGridScale = uniformGridValueScale(uniformGridValueScaleBuffer, uniformGridElementSize);
     LightSample lightSample = readLightSample(lightSamples, threadId);
     float2 intersectionPoint = readIntersectionPoint(intersectionPoints, threadId);
     float tStart = intersectionPoint.x; float tEnd = intersectionPoint.y;
@@ -145,7 +148,7 @@ __kernel void photonRecomputationDetectorKernel(
             float3 x2 = transformPoint(textureToIndexMat, exit.xyz) + 0.5f;
 
             float t0;
-            recomputationImportance += uniformGridImportance(x1, x2, cellSize, uniformGrid3D, uniformGridDimensions, &t0);
+            recomputationImportance += uniformGridImportance(x1, x2, cellSize, uniformGrid3D, uniformGridDimensions, uniformGridElementSize, uniformGridScale, &t0);
             entry = photon.xyz;
         }
     } 
@@ -159,8 +162,10 @@ __kernel void photonRecomputationDetectorKernel(
 // Update a certain percentage of photons with equal importance
 __kernel void photonRecomputationDetectorEqualImportanceKernel(
     // uniform grid parameters
-    __global const float* uniformGrid3D
+    __global const uchar* uniformGrid3D
     , int4 uniformGridDimensions
+    , int uniformGridElementSize
+    , __global const float* uniformGridValueScaleBuffer // See uniformGridValueScale
     , float3 cellSize
     , float16 textureToIndexMat
     , float16 indexToTextureMat
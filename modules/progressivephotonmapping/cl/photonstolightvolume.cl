@@ -3,6 +3,7 @@
 #include "samplers.cl" 
 #include "transformations.cl"
 #include "densityestimationkernel.cl"
+#include "photondeposit.cl"
 #include "photon.cl"
 #include "shading/shading.cl" 
 #include "image3d_write.cl" 
@@ -12,21 +13,12 @@
 #pragma OPENCL_EXTENSION cl_khr_3d_image_writes : enable
 #endif
 
-void atomic_add_float_global(volatile global float *source, const float operand) {
-    union {
-        unsigned int intVal;
-        float floatVal;
-    } newVal;
-    union {
-        unsigned int intVal;
-        float floatVal;
-    } prevVal;
-
-    do {
-        prevVal.floatVal = *source;
-        newVal.floatVal = prevVal.floatVal + operand;
-    } while (atomic_cmpxchg((volatile global unsigned int *)source, prevVal.intVal, newVal.intVal) != prevVal.intVal);
-}
+#ifdef ADAPTIVE_PHOTON_RADIUS
+// Photon counts of a coarse grid over the volume, followed by the total number of photons and the number of occupied cells
+#define ADAPTIVE_RADIUS_KERNEL_ARGS , __global const uint* photonDensityGrid, int4 densityGridDim, float maxRadiusScale
+#else
+#define ADAPTIVE_RADIUS_KERNEL_ARGS
+#endif
 
 void splatPhoton(
 #ifdef VOLUME_OUTPUT_SINGLE_CHANNEL
@@ -78,6 +70,63 @@ void splatPhoton(
     }
 }
 
+#ifdef ADAPTIVE_PHOTON_RADIUS
+int photonDensityGridCell(int4 densityGridDim, float3 pos) {
+    int3 cell = clamp(convert_int3(pos * convert_float3(densityGridDim.xyz)), (int3)(0), densityGridDim.xyz - 1);
+    return cell.x + cell.y*densityGridDim.x + cell.z*densityGridDim.x*densityGridDim.y;
+}
+// Scale of the photon radius from the local photon density relative to the mean density of occupied cells.
+// Sparse regions get a larger support, dense regions a smaller one.
+float adaptiveRadiusScale(__global const uint* photonDensityGrid, int4 densityGridDim, float maxRadiusScale, float3 pos) {
+    float count = (float)max(photonDensityGrid[photonDensityGridCell(densityGridDim, pos)], 1u);
+    float meanCount = (float)photonDensityGrid[densityGridDim.w] / (float)max(photonDensityGrid[densityGridDim.w + 1], 1u);
+    return clamp(cbrt(meanCount / count), 1.f / maxRadiusScale, maxRadiusScale);
+}
+
+void splatPhotonAdaptiveRadius(
+#ifdef VOLUME_OUTPUT_SINGLE_CHANNEL
+    __global float* volumeOut
+#else
+    __global float4* volumeOut
+#endif
+    , __constant VolumeParameters* volumeOutParams
+    , int4 outDim
+    , float8 photonData
+    , float photonRadius
+    , __global const uint* photonDensityGrid, int4 densityGridDim, float maxRadiusScale
+    ) {
+    if (any(photonData.xyz == (float3)(FLT_MAX))) {
+        return;
+    }
+    float radiusScale = adaptiveRadiusScale(photonDensityGrid, densityGridDim, maxRadiusScale, photonData.xyz);
+    // Irradiance is normalized by the volume of the base radius
+    photonData.s345 /= radiusScale*radiusScale*radiusScale;
+    splatPhoton(volumeOut, volumeOutParams, outDim, photonData, photonRadius*radiusScale);
+}
+
+// Count valid photons in each cell of the density grid.
+// The grid must be cleared before, the two elements after the cells count all photons and occupied cells.
+__kernel void photonDensityGridKernel(__global const PHOTON_DATA_TYPE* photonDataArray
+    , int totalPhotons
+    , volatile __global uint* photonDensityGrid
+    , int4 densityGridDim
+    )
+{
+    int photonId = get_global_id(0);
+    if (photonId >= totalPhotons) {
+        return;
+    }
+    float3 pos = readPhoton(photonDataArray, photonId).xyz;
+    if (any(pos == (float3)(FLT_MAX))) {
+        return;
+    }
+    if (atomic_inc(&photonDensityGrid[photonDensityGridCell(densityGridDim, pos)]) == 0) {
+        atomic_inc(&photonDensityGrid[densityGridDim.w + 1]);
+    }
+    atomic_inc(&photonDensityGrid[densityGridDim.w]);
+}
+#endif
+
 __kernel void photonsToLightVolumeKernel(read_only image3d_t volumeIn, __constant VolumeParameters* volumeParams
 #if VOLUME_OUTPUT_HALF_TYPE && VOLUME_OUTPUT_SINGLE_CHANNEL
     , image_3d_write_float16_t volumeOut
@@ -149,6 +198,7 @@ __kernel void splatPhotonsToLightVolumeKernel(read_only image3d_t volumeIn, __co
     , int totalPhotons
     , float photonRadius
     , float relativeIrradianceScale // Scale power to be similar independent of number of photons and photon radius.
+    ADAPTIVE_RADIUS_KERNEL_ARGS
     )
 {
     int photonId = get_global_id(0);
@@ -162,7 +212,11 @@ __kernel void splatPhotonsToLightVolumeKernel(read_only image3d_t volumeIn, __co
 #ifndef PER_PHOTON_SHADING
     photonData.s345 *= isotropicPhaseFunction()*relativeIrradianceScale;
 #endif
+#ifdef ADAPTIVE_PHOTON_RADIUS
+    splatPhotonAdaptiveRadius(volumeOut, volumeOutParams, outDim, photonData, photonRadius, photonDensityGrid, densityGridDim, maxRadiusScale);
+#else
     splatPhoton(volumeOut, volumeOutParams, outDim, photonData, photonRadius);
+#endif
 }
 
 __kernel void splatSelectedPhotonsToLightVolumeKernel(
@@ -182,6 +236,7 @@ __kernel void splatSelectedPhotonsToLightVolumeKernel(
     , float photonRadianceMultiplier // +1 if contribution should be added, -1 otherwise
     , int nPhotons // Number of photons per scattering event
     , int nInteractions // Maximum number of scattering events
+    ADAPTIVE_RADIUS_KERNEL_ARGS
     )
 {
 
@@ -197,7 +252,11 @@ __kernel void splatSelectedPhotonsToLightVolumeKernel(
         photonData.s345 *= isotropicPhaseFunction()*relativeIrradianceScale;
     #endif
         photonData.s345 *= photonRadianceMultiplier;
+    #ifdef ADAPTIVE_PHOTON_RADIUS
+        splatPhotonAdaptiveRadius(volumeOut, volumeOutParams, outDim, photonData, photonRadius, photonDensityGrid, densityGridDim, maxRadiusScale);
+    #else
         splatPhoton(volumeOut, volumeOutParams, outDim, photonData, photonRadius);
+    #endif
     }
 }
 
@@ -214,6 +273,63 @@ __kernel void clearFloatKernel(__global float* memory, int size) {
     }
 }
 
+// Convert the float accumulation buffer into the memory layout of the output light volume.
+// Output is copied to the light volume image afterwards.
+__kernel void packLightVolumeKernel(
+#ifdef VOLUME_OUTPUT_SINGLE_CHANNEL
+      __global const float* accumulatedVolume
+#else
+      __global const float4* accumulatedVolume
+#endif
+    , __global half* volumeOut
+    , int size) {
+    if (get_global_id(0) >= size) {
+        return;
+    }
+    int voxelIndex = get_global_id(0);
+#if defined(VOLUME_OUTPUT_SINGLE_CHANNEL)
+    vstore_half(accumulatedVolume[voxelIndex], voxelIndex, volumeOut);
+#else
+    vstore_half4(accumulatedVolume[voxelIndex], voxelIndex, volumeOut);
+#endif
+}
+
+#ifdef VOLUME_OUTPUT_SINGLE_CHANNEL
+#define ACCUMULATION_TYPE float
+#else
+#define ACCUMULATION_TYPE float4
+#endif
+// Trilinearly resample accumulated photon contributions into a grid of another resolution.
+// Used when the light volume resolution is increased so that incremental updates can continue.
+// Voxel centers are at (index + 0.5)/dimensions in texture space in both grids.
+__kernel void resampleAccumulationKernel(__global const ACCUMULATION_TYPE* accumulatedVolume, int4 srcDim
+    , __global ACCUMULATION_TYPE* resampledVolume, int4 dstDim) {
+    int voxelIndex = get_global_id(0);
+    if (voxelIndex >= dstDim.w) {
+        return;
+    }
+    int3 dstCoord = (int3)(voxelIndex % dstDim.x, (voxelIndex / dstDim.x) % dstDim.y, voxelIndex / (dstDim.x*dstDim.y));
+    float3 srcPos = (convert_float3(dstCoord) + 0.5f) * convert_float3(srcDim.xyz) / convert_float3(dstDim.xyz) - 0.5f;
+    srcPos = clamp(srcPos, (float3)(0.f), convert_float3(srcDim.xyz - 1));
+    int3 c0 = convert_int3(srcPos);
+    int3 c1 = min(c0 + 1, srcDim.xyz - 1);
+    float3 t = srcPos - convert_float3(c0);
+    int sliceSize = srcDim.x*srcDim.y;
+    ACCUMULATION_TYPE v00 = mix(accumulatedVolume[c0.x + c0.y*srcDim.x + c0.z*sliceSize], accumulatedVolume[c1.x + c0.y*srcDim.x + c0.z*sliceSize], t.x);
+    ACCUMULATION_TYPE v10 = mix(accumulatedVolume[c0.x + c1.y*srcDim.x + c0.z*sliceSize], accumulatedVolume[c1.x + c1.y*srcDim.x + c0.z*sliceSize], t.x);
+    ACCUMULATION_TYPE v01 = mix(accumulatedVolume[c0.x + c0.y*srcDim.x + c1.z*sliceSize], accumulatedVolume[c1.x + c0.y*srcDim.x + c1.z*sliceSize], t.x);
+    ACCUMULATION_TYPE v11 = mix(accumulatedVolume[c0.x + c1.y*srcDim.x + c1.z*sliceSize], accumulatedVolume[c1.x + c1.y*srcDim.x + c1.z*sliceSize], t.x);
+    resampledVolume[voxelIndex] = mix(mix(v00, v10, t.y), mix(v01, v11, t.y), t.z);
+}
+
+// Irradiance splatted by the photon tracer is always float4,
+// single channel light volumes keep the first component like splatPhoton.
+__kernel void copyDepositedIrradianceKernel(__global const float4* depositedIrradiance, __global float* accumulatedVolume, int size) {
+    if (get_global_id(0) < size) {
+        accumulatedVolume[get_global_id(0)] = depositedIrradiance[get_global_id(0)].x;
+    }
+}
+
 __kernel void photonDensityNormalizationKernel(__global float4* memory, int size) {
     if (get_global_id(0) < size) {
         float4 photonIrradiance = memory[get_global_id(0)];
@@ -30,42 +30,11 @@
  *
  *********************************************************************************/
 
-#include "intersection/rayboxintersection.cl" 
-#include "random.cl"
-#include "shading/shading.cl" 
-#include "light/light.cl" 
-#include "datastructures/lightsample.cl"
-
-//#include "gradients.cl"
-#include "samplers.cl" 
-#include "photon.cl"
-#include "transformations.cl" 
-#include "transmittance.cl"  
-
-//__constant float SAMPLING_BASE_INTERVAL_RCP = 200.0; 
-__constant float RUSSIAN_ROULETTE_P = 0.9f;  
+#include "photoninteraction.cl"
+#include "photondeposit.cl"
 
 //#define NO_SINGLE_SCATTERING   
     
-bool nextInteraction(read_only image3d_t volumeTex, __constant VolumeParameters* volumeParams, float volumeSample, BBox volumeBBox, float4 material,
-                 float3 sample, 
-                 float3* direction, float* __restrict t0, float* __restrict t1, random_state* randstate, const ShadingType shadingType) {
-    float2 rnd = (float2)(random_01(randstate), random_01(randstate));     
-    sampleShadingFunction(volumeTex, volumeParams, volumeSample, material, sample, direction, rnd, shadingType);
-    
-    return rayBoxIntersection(volumeBBox, sample, *direction, t0, t1);
-
-}  
-bool nextInteractionPdf(read_only image3d_t volumeTex, __constant VolumeParameters* volumeParams, float volumeSample, BBox volumeBBox, float4 material,
-                 float3 sample, 
-                 float3* direction, float* __restrict t0, float* __restrict t1, float *pdf, random_state* randstate, const ShadingType shadingType) {
-    float2 rnd = (float2)(random_01(randstate), random_01(randstate));     
-    sampleShadingFunctionPdf(volumeTex, volumeParams, volumeSample, material, sample, direction, pdf, rnd, shadingType);
-    
-    return rayBoxIntersection(volumeBBox, sample, *direction, t0, t1);
-
-} 
-  
 __kernel void photonTracerKernel(
 #ifdef PHOTON_RECOMPUTATION
     __global const unsigned int* recomputationPhotonIndex,
@@ -73,11 +42,14 @@ __kernel void photonTracerKernel(
 #endif
     read_only image3d_t volumeTex
     , __constant VolumeParameters* volumeParams
+    BRICKED_VOLUME_KERNEL_ARGS
     , __global  const BBox* volumeBBox
     , read_only image2d_t tfData
     , read_only image2d_t tfScattering
     , float4 material
+#ifndef RANDOM_PHILOX
     , __global RANDOM_SEED_TYPE* randomSeeds
+#endif
     //, __global const  float2* lightSamples
     , float stepSize
     , __global PHOTON_DATA_TYPE* photonDataArray
@@ -91,6 +63,18 @@ __kernel void photonTracerKernel(
     , ShadingType shadingType
     , int randomLightSampling
     , int totalPhotons
+#ifdef DENSITY_LOD
+    , read_only image3d_t densityPyramid
+    , __constant int4* densityPyramidLevels
+    , int maxDensityLevel // Coarsest level that can be used, determined by photon radius
+#endif
+#ifdef SPLAT_PHOTONS
+    // Photons are added to a light volume instead of being stored in photonDataArray
+    , __global float* depositedIrradiance // float4 per voxel, see depositPhoton
+    , int4 depositedIrradianceDim
+    , float photonRadius
+    , float irradianceScale // Phase function and relative irradiance scale of splatPhotonsToLightVolumeKernel
+#endif
     )
 {
 //#define DISPLAY_RECOMPUTED_PHOTONS
@@ -120,7 +104,17 @@ __kernel void photonTracerKernel(
     random_state randstate;  
     // Use new random seed for each iteration. 
     //int rndIndex = (threadId+64*(iteration-1))%(get_global_size(0)*get_global_size(1));
+#ifdef RANDOM_PHILOX
+    // Keyed by photon (light source offset included), iteration and batch 
+#ifdef PROGRESSIVE_PHOTON_MAPPING
+    initRandState(&randstate, photonOffset+threadId, (uint2)(iteration, batch));
+#else
+    // Same random numbers each time reduces noise
+    initRandState(&randstate, photonOffset+threadId, (uint2)(0, batch));
+#endif
+#else
     loadRandState(randomSeeds, photonOffset+threadId, &randstate);
+#endif
     //loadRandState(randomSeeds, 0, &randstate);
     //loadRandState(randomSeeds, rndIndex, &randstate);
     uint nInteractions = 0;
@@ -142,11 +136,11 @@ __kernel void photonTracerKernel(
     //{float2 dirAngles = encodeDirection(lightSample.direction); 
     #ifdef NO_SINGLE_SCATTERING
         // Only perform multiple scattering
-    float t = woodcockTracking(volumeTex, volumeParams, tfData, lightSample.origin, lightSample.direction, tStart, tEnd, 1.f, &randstate);  
+    float t = woodcockTracking(VOLUME_SAMPLER_ARGS, tfData, lightSample.origin, lightSample.direction, tStart, tEnd, 1.f, &randstate);  
         if(scatterEvent) {
             lightSample.origin += t*lightSample.direction;
             tStart = 0.f; tEnd = FLT_MAX; 
-            float volumeSample = getVoxel(volumeTex, as_float4(lightSample.origin));
+            float volumeSample = getVolumeDensity(VOLUME_SAMPLER_ARGS, lightSample.origin);
             float pdf;
             scatterEvent = nextInteractionPdf(volumeTex, volumeParams, volumeSample, volumeBBox[0], material, lightSample.origin,  
                 &lightSample.direction, &tStart, &tEnd, &pdf, &randstate, shadingType);
@@ -157,7 +151,13 @@ __kernel void photonTracerKernel(
     #endif
     while(scatterEvent) {  
         // Find next scattering event
-        float t = woodcockTracking(volumeTex, volumeParams, tfData, lightSample.origin, lightSample.direction, tStart, tEnd, 1.f, &randstate);
+#ifdef DENSITY_LOD
+        // Sample coarser density for each scattering event
+        int densityLevel = min(convert_int(nInteractions), maxDensityLevel);
+        float t = woodcockTrackingLod(VOLUME_SAMPLER_ARGS, densityPyramid, densityPyramidLevels, densityLevel, tfData, lightSample.origin, lightSample.direction, tStart, tEnd, 1.f, &randstate);
+#else
+        float t = woodcockTracking(VOLUME_SAMPLER_ARGS, tfData, lightSample.origin, lightSample.direction, tStart, tEnd, 1.f, &randstate);
+#endif
 
         scatterEvent = t <= tEnd;   
         if(scatterEvent) { 
@@ -167,7 +167,12 @@ __kernel void photonTracerKernel(
             float2 dirAngles = encodeDirection(lightSample.direction);
  
             // Determine which kind of interaction we have
-            float volumeSample = getNormalizedVoxel(volumeTex, volumeParams, as_float4(lightSample.origin)).x;
+#ifdef DENSITY_LOD
+            // Must match the density used during tracking
+            float volumeSample = getDensityLod(VOLUME_SAMPLER_ARGS, densityPyramid, densityPyramidLevels, densityLevel, lightSample.origin);
+#else
+            float volumeSample = getVolumeDensity(VOLUME_SAMPLER_ARGS, lightSample.origin);
+#endif
             float4 color = read_imagef(tfData, smpNormClampEdgeLinear, (float2)(volumeSample,0.5f));
 
             float4 scattering = read_imagef(tfScattering, smpNormClampEdgeLinear, (float2)(volumeSample,0.5f)); 
@@ -179,14 +184,22 @@ __kernel void photonTracerKernel(
             ++nInteractions;  
             if (nInteractions < maxInteractions && random_01(&randstate) < scatteringAlbedo) { // Photon is scattered 
                 lightSample.power *= scatteringAlbedo;
+#ifdef SPLAT_PHOTONS
+                depositPhoton(depositedIrradiance, depositedIrradianceDim, lightSample.origin, lightSample.power*irradianceScale, photonRadius);
+#else
                 writePhoton((float8)(lightSample.origin.x, lightSample.origin.y, lightSample.origin.z, lightSample.power.x, lightSample.power.y, lightSample.power.z, dirAngles.x, dirAngles.y), photonDataArray, photonId);
+#endif
                 tStart= 0.f; tEnd = FLT_MAX; 
                 scatterEvent = nextInteraction(volumeTex, volumeParams, volumeSample, volumeBBox[0], material, lightSample.origin,
                                             &lightSample.direction, &tStart, &tEnd, &randstate, shadingType);
                 // Move a bit to avoid getting stuck in the same material
                 tStart+=0.5*stepSize;
             } else {
+#ifdef SPLAT_PHOTONS
+                depositPhoton(depositedIrradiance, depositedIrradianceDim, lightSample.origin, lightSample.power*irradianceScale, photonRadius);
+#else
                 writePhoton((float8)(lightSample.origin.x, lightSample.origin.y, lightSample.origin.z, lightSample.power.x, lightSample.power.y, lightSample.power.z, dirAngles.x, dirAngles.y), photonDataArray, photonId);
+#endif
                 // Used in photonrecompuationdetector.cl
                 lightSample.power = (float3)(FLT_MAX);
                 scatterEvent = false;    
@@ -196,6 +209,7 @@ __kernel void photonTracerKernel(
 
     }
 
+#ifndef SPLAT_PHOTONS
     float2 dirAngles = encodeDirection(lightSample.direction);
     float8 photon = (float8)(FLT_MAX, FLT_MAX, FLT_MAX, lightSample.power.x, FLT_MAX, FLT_MAX, dirAngles.x, dirAngles.y);
     for( uint i = nInteractions; i < maxInteractions; ++i) {
@@ -207,8 +221,9 @@ __kernel void photonTracerKernel(
         #endif
          
     } 
+#endif
     // Ensuring that the same random seed is used reduces noise
-#ifdef PROGRESSIVE_PHOTON_MAPPING
+#if defined(PROGRESSIVE_PHOTON_MAPPING) && !defined(RANDOM_PHILOX)
 
     saveRandState(randomSeeds, photonOffset+threadId, &randstate);
     //saveRandState(randomSeeds, rndIndex, &randstate);
@@ -0,0 +1,327 @@
+﻿/*********************************************************************************
+ *
+ * Copyright (c) 2016, Daniel Jönsson
+ * All rights reserved.
+ * 
+ * This work is licensed under a Creative Commons Attribution-NonCommercial 4.0 International License.
+ * http://creativecommons.org/licenses/by-nc/4.0/
+ * 
+ * You are free to:
+ * 
+ * Share — copy and redistribute the material in any medium or format
+ * Adapt — remix, transform, and build upon the material
+ * The licensor cannot revoke these freedoms as long as you follow the license terms.
+ * Under the following terms:
+ * 
+ * Attribution — You must give appropriate credit, provide a link to the license, and indicate if changes were made. You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+ * NonCommercial — You may not use the material for commercial purposes.
+ * No additional restrictions — You may not apply legal terms or technological measures that legally restrict others from doing anything the license permits.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/*
+ * Wavefront formulation of photonTracerKernel in photontracer.cl.
+ * Each photon path is advanced one stage at a time by separate kernels:
+ *   wavefrontGeneratePathsKernel  Start paths at the light samples
+ *   wavefrontTrackPathsKernel     Find the next interaction using woodcock tracking 
+ *   wavefrontScatterPathsKernel   Store the photon and sample a new direction
+ * Each stage outputs one flag per path telling if it is still active. 
+ * The queue of active paths is compacted by compactPathQueueKernel 
+ * using the scanned flags before the next stage is executed.
+ * Paths are thereby kept together in SIMD groups independently 
+ * of how many times other paths have scattered.
+ */
+
+#include "photoninteraction.cl"
+
+// Must match WavefrontPathState in photontracercl.cpp
+typedef struct {
+    float4 origin;    // xyz: Position, w: tStart
+    float4 direction; // xyz: Direction, w: tEnd
+    float4 power;     // xyz: RGB power
+    uint pathId;      // Photon index relative to photonOffset
+    uint nInteractions;
+    random_state randstate;
+} PathState;
+
+// Fill unused interaction slots of a terminated path and store its random state
+void terminatePath(PathState* path
+#ifndef RANDOM_PHILOX
+    , __global RANDOM_SEED_TYPE* randomSeeds
+#endif
+    , __global PHOTON_DATA_TYPE* photonDataArray
+    , int photonOffset
+    , uint maxInteractions
+    , int totalPhotons
+    ) {
+    float2 dirAngles = encodeDirection(path->direction.xyz);
+    float8 photon = (float8)(FLT_MAX, FLT_MAX, FLT_MAX, path->power.x, FLT_MAX, FLT_MAX, dirAngles.x, dirAngles.y);
+    for (uint i = path->nInteractions; i < maxInteractions; ++i) {
+        writePhoton(photon, photonDataArray, photonOffset + i*totalPhotons + path->pathId);
+    }
+#if defined(PROGRESSIVE_PHOTON_MAPPING) && !defined(RANDOM_PHILOX)
+    saveRandState(randomSeeds, photonOffset + path->pathId, &path->randstate);
+#endif
+}
+
+__kernel void wavefrontGeneratePathsKernel(
+#ifdef PHOTON_RECOMPUTATION
+    __global const unsigned int* recomputationPhotonIndex,
+    int nPhotonsToRecompute,
+#endif
+    read_only image3d_t volumeTex
+    , __constant VolumeParameters* volumeParams
+    BRICKED_VOLUME_KERNEL_ARGS
+    , __global const BBox* volumeBBox
+    , read_only image2d_t tfData
+    , float4 material
+#ifndef RANDOM_PHILOX
+    , __global RANDOM_SEED_TYPE* randomSeeds
+#endif
+    , float stepSize
+    , __global PHOTON_DATA_TYPE* photonDataArray
+    , int iteration
+    , int photonOffset
+    , int batch
+    , __global StoredLightSample const* __restrict lightSamples
+    , __global StoredIntersectionPoint const* __restrict intersectionPoints // tStart, tEnd for each light sample  
+    , int nLightSamples
+    , uint maxInteractions
+    , ShadingType shadingType
+    , int totalPhotons
+    , __global PathState* paths
+    , __global uint* pathQueue
+    , __global uint* activeFlags
+    )
+{
+#ifdef PHOTON_RECOMPUTATION
+    int nPaths = nPhotonsToRecompute;
+#else 
+    int nPaths = nLightSamples;
+#endif
+    int queueId = get_global_id(0);
+    if (queueId >= nPaths) {
+        // Last flag is zero so that the scanned flags also give the number of active paths
+        if (queueId == nPaths) {
+            activeFlags[queueId] = 0;
+        }
+        return;
+    }
+    pathQueue[queueId] = queueId;
+#ifdef PHOTON_RECOMPUTATION
+    int threadId = recomputationPhotonIndex[queueId] - photonOffset;
+    if (threadId < 0 || threadId >= nLightSamples) {
+        activeFlags[queueId] = 0;
+        return;
+    }
+#else 
+    int threadId = queueId;
+#endif
+    PathState path;
+    path.pathId = threadId;
+    path.nInteractions = 0;
+#ifdef RANDOM_PHILOX
+#ifdef PROGRESSIVE_PHOTON_MAPPING
+    initRandState(&path.randstate, photonOffset+threadId, (uint2)(iteration, batch));
+#else
+    initRandState(&path.randstate, photonOffset+threadId, (uint2)(0, batch));
+#endif
+#else
+    loadRandState(randomSeeds, photonOffset+threadId, &path.randstate);
+#endif
+    LightSample lightSample = readLightSample(lightSamples, threadId);
+    lightSample.power /= convert_float(maxInteractions);
+    float2 intersectionPoint = readIntersectionPoint(intersectionPoints, threadId);
+    float tStart = intersectionPoint.x; float tEnd = intersectionPoint.y;
+    bool scatterEvent = tStart < tEnd;
+#ifdef NO_SINGLE_SCATTERING
+    // Only perform multiple scattering
+    float t = woodcockTracking(VOLUME_SAMPLER_ARGS, tfData, lightSample.origin, lightSample.direction, tStart, tEnd, 1.f, &path.randstate);  
+    if (scatterEvent) {
+        lightSample.origin += t*lightSample.direction;
+        tStart = 0.f; tEnd = FLT_MAX; 
+        float volumeSample = getVolumeDensity(VOLUME_SAMPLER_ARGS, lightSample.origin);
+        float pdf;
+        scatterEvent = nextInteractionPdf(volumeTex, volumeParams, volumeSample, volumeBBox[0], material, lightSample.origin,  
+            &lightSample.direction, &tStart, &tEnd, &pdf, &path.randstate, shadingType);
+        lightSample.power /= pdf;
+        // Move a bit to avoid getting stuck in the same material
+        tStart+=0.5f*stepSize;
+    } 
+#endif
+    path.origin = (float4)(lightSample.origin, tStart);
+    path.direction = (float4)(lightSample.direction, tEnd);
+    path.power = (float4)(lightSample.power, 0.f);
+    if (!scatterEvent) {
+        terminatePath(&path
+#ifndef RANDOM_PHILOX
+            , randomSeeds
+#endif
+            , photonDataArray, photonOffset, maxInteractions, totalPhotons);
+    }
+    paths[queueId] = path;
+    activeFlags[queueId] = scatterEvent ? 1 : 0;
+}
+
+__kernel void wavefrontTrackPathsKernel(
+      __global const uint* pathQueue
+    , int nActivePaths
+    , __global PathState* paths
+    , read_only image3d_t volumeTex
+    , __constant VolumeParameters* volumeParams
+    BRICKED_VOLUME_KERNEL_ARGS
+    , read_only image2d_t tfData
+#ifndef RANDOM_PHILOX
+    , __global RANDOM_SEED_TYPE* randomSeeds
+#endif
+    , __global PHOTON_DATA_TYPE* photonDataArray
+    , int photonOffset
+    , uint maxInteractions
+    , int totalPhotons
+#ifdef DENSITY_LOD
+    , read_only image3d_t densityPyramid
+    , __constant int4* densityPyramidLevels
+    , int maxDensityLevel 
+#endif
+    , __global uint* activeFlags
+    )
+{
+    int queueId = get_global_id(0);
+    if (queueId >= nActivePaths) {
+        if (queueId == nActivePaths) {
+            activeFlags[queueId] = 0;
+        }
+        return;
+    }
+    uint pathIndex = pathQueue[queueId];
+    PathState path = paths[pathIndex];
+    float tStart = path.origin.w; float tEnd = path.direction.w;
+#ifdef DENSITY_LOD
+    int densityLevel = min(convert_int(path.nInteractions), maxDensityLevel);
+    float t = woodcockTrackingLod(VOLUME_SAMPLER_ARGS, densityPyramid, densityPyramidLevels, densityLevel, tfData, path.origin.xyz, path.direction.xyz, tStart, tEnd, 1.f, &path.randstate);
+#else
+    float t = woodcockTracking(VOLUME_SAMPLER_ARGS, tfData, path.origin.xyz, path.direction.xyz, tStart, tEnd, 1.f, &path.randstate);
+#endif
+    bool scatterEvent = t <= tEnd;
+    if (scatterEvent) {
+        path.origin.xyz += t*path.direction.xyz;
+    } else {
+        // Left the volume
+        terminatePath(&path
+#ifndef RANDOM_PHILOX
+            , randomSeeds
+#endif
+            , photonDataArray, photonOffset, maxInteractions, totalPhotons);
+    }
+    paths[pathIndex] = path;
+    activeFlags[queueId] = scatterEvent ? 1 : 0;
+}
+
+__kernel void wavefrontScatterPathsKernel(
+      __global const uint* pathQueue
+    , int nActivePaths
+    , __global PathState* paths
+    , read_only image3d_t volumeTex
+    , __constant VolumeParameters* volumeParams
+    BRICKED_VOLUME_KERNEL_ARGS
+    , __global const BBox* volumeBBox
+    , read_only image2d_t tfData
+    , float4 material
+#ifndef RANDOM_PHILOX
+    , __global RANDOM_SEED_TYPE* randomSeeds
+#endif
+    , float stepSize
+    , __global PHOTON_DATA_TYPE* photonDataArray
+    , int photonOffset
+    , uint maxInteractions
+    , ShadingType shadingType
+    , int totalPhotons
+#ifdef DENSITY_LOD
+    , read_only image3d_t densityPyramid
+    , __constant int4* densityPyramidLevels
+    , int maxDensityLevel 
+#endif
+    , __global uint* activeFlags
+    )
+{
+    int queueId = get_global_id(0);
+    if (queueId >= nActivePaths) {
+        if (queueId == nActivePaths) {
+            activeFlags[queueId] = 0;
+        }
+        return;
+    }
+    uint pathIndex = pathQueue[queueId];
+    PathState path = paths[pathIndex];
+    float3 origin = path.origin.xyz;
+    float3 direction = path.direction.xyz;
+    float3 power = path.power.xyz;
+    uint photonId = photonOffset + path.nInteractions*totalPhotons + path.pathId;
+    float2 dirAngles = encodeDirection(direction);
+#ifdef DENSITY_LOD
+    // Must match the density used during tracking
+    int densityLevel = min(convert_int(path.nInteractions), maxDensityLevel);
+    float volumeSample = getDensityLod(VOLUME_SAMPLER_ARGS, densityPyramid, densityPyramidLevels, densityLevel, origin);
+#else
+    float volumeSample = getVolumeDensity(VOLUME_SAMPLER_ARGS, origin);
+#endif
+    float4 color = read_imagef(tfData, smpNormClampEdgeLinear, (float2)(volumeSample,0.5f));
+    float4 scattering = read_imagef(tfScattering, smpNormClampEdgeLinear, (float2)(volumeSample,0.5f)); 
+    float scatteringAlbedo = scattering.w/(scattering.w+color.w);
+    // Monte-Carlo: Divide by the probability that the photon ended up here
+    power /= max(color.w, 0.01f);
+
+    ++path.nInteractions;
+    bool scatterEvent = false;
+    if (path.nInteractions < maxInteractions && random_01(&path.randstate) < scatteringAlbedo) { // Photon is scattered 
+        power *= scatteringAlbedo;
+        writePhoton((float8)(origin.x, origin.y, origin.z, power.x, power.y, power.z, dirAngles.x, dirAngles.y), photonDataArray, photonId);
+        float tStart = 0.f; float tEnd = FLT_MAX; 
+        scatterEvent = nextInteraction(volumeTex, volumeParams, volumeSample, volumeBBox[0], material, origin,
+                                       &direction, &tStart, &tEnd, &path.randstate, shadingType);
+        // Move a bit to avoid getting stuck in the same material
+        path.origin.w = tStart + 0.5f*stepSize;
+        path.direction = (float4)(direction, tEnd);
+    } else {
+        writePhoton((float8)(origin.x, origin.y, origin.z, power.x, power.y, power.z, dirAngles.x, dirAngles.y), photonDataArray, photonId);
+        // Used in photonrecompuationdetector.cl
+        power = (float3)(FLT_MAX);
+    }
+    path.power.xyz = power;
+    if (!scatterEvent) {
+        terminatePath(&path
+#ifndef RANDOM_PHILOX
+            , randomSeeds
+#endif
+            , photonDataArray, photonOffset, maxInteractions, totalPhotons);
+    }
+    paths[pathIndex] = path;
+    activeFlags[queueId] = scatterEvent ? 1 : 0;
+}
+
+// Keep queue entries whose flag is set, scannedFlags is the exclusive prefix sum of activeFlags
+__kernel void compactPathQueueKernel(
+      __global const uint* pathQueue
+    , __global const uint* activeFlags
+    , __global const uint* scannedFlags
+    , int nPaths
+    , __global uint* compactedPathQueue
+    )
+{
+    int queueId = get_global_id(0);
+    if (queueId >= nPaths || activeFlags[queueId] == 0) {
+        return;
+    }
+    compactedPathQueue[scannedFlags[queueId]] = pathQueue[queueId];
+}
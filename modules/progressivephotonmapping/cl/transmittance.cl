@@ -35,12 +35,13 @@
 
 #include "random.cl"
 #include "samplers.cl" 
+#include "uniformgrid/brickedvolume.cl"
 
  
 __constant float SAMPLING_BASE_INTERVAL_RCP = 150.f;
 
 // Compute transmittance through volume
-float transmittance(read_only image3d_t volumeTex, __constant VolumeParameters* volumeParams,
+float transmittance(VOLUME_SAMPLER_ARGS_DECL,
                  read_only image2d_t tfData,
                  const float3 origin, 
                  const float3 direction, const float tStart, const float tEnd, const float stepSize, random_state* randstate) {
@@ -52,7 +53,7 @@ float transmittance(read_only image3d_t volumeTex, __constant VolumeParameters*
 
     while(t <= tEnd) {
         float3 pos = origin+t*direction;
-        float volumeSample = getNormalizedVoxel(volumeTex, volumeParams, as_float4(pos)).x;
+        float volumeSample = getVolumeDensity(VOLUME_SAMPLER_ARGS, pos);
         extinction = read_imagef(tfData, smpNormClampEdgeLinear, (float2)(volumeSample,0.5f)).w;
         opticalThickness += extinction;   
         t += stepSize;
@@ -67,7 +68,7 @@ float transmittance(read_only image3d_t volumeTex, __constant VolumeParameters*
 
 // Finds location where attenuation is equal to random number
 // Stores location in t
-float findAttenuation(read_only image3d_t volumeTex, __constant VolumeParameters* volumeParams,
+float findAttenuation(VOLUME_SAMPLER_ARGS_DECL,
                  read_only image2d_t tfData,
                  const float3 origin, 
                  const float3 direction, const float tStart, const float tEnd, const float stepSize, random_state* randstate) {
@@ -81,7 +82,7 @@ float findAttenuation(read_only image3d_t volumeTex, __constant VolumeParameters
     //for(t < tEnd; accumulatedOpacity < nextInteractionTransittance; t+=stepSize) {
     while(t <= tEnd && accumulatedOpacity < nextInteractionTransittance) {
         float3 pos = origin+t*direction;
-        float volumeSample = getNormalizedVoxel(volumeTex, volumeParams, as_float4(pos)).x;
+        float volumeSample = getVolumeDensity(VOLUME_SAMPLER_ARGS, pos);
         
         opacity = read_imagef(tfData, smpNormClampEdgeLinear, (float2)(volumeSample,0.5f)).w;    
         accumulatedOpacity += opacity;
@@ -123,7 +124,7 @@ float findAttenuation2(read_only image3d_t volumeTex,
 }
 
 // Apply Woodcock tracking to find the sample distance along the ray
-float woodcockTracking(read_only image3d_t volumeTex, __constant VolumeParameters* volumeParams,
+float woodcockTracking(VOLUME_SAMPLER_ARGS_DECL,
                  read_only image2d_t tfData, const float3 origin, 
                  const float3 direction, const float tStart, const float tEnd, float tauMax, random_state* __restrict randstate) {
     
@@ -134,7 +135,7 @@ float woodcockTracking(read_only image3d_t volumeTex, __constant VolumeParameter
     do {
         t += -native_log(random_01(randstate))*invTauMaxSampleBaseInterval;
         float3 pos = origin+t*direction;
-        float volumeSample = getNormalizedVoxel(volumeTex, volumeParams, as_float4(pos)).x;
+        float volumeSample = getVolumeDensity(VOLUME_SAMPLER_ARGS, pos);
         //volumeSample = toDataSpace1d2(1.f/convert_float(get_image_width(tfData)), volumeSample);
         opacity = read_imagef(tfData, smpNormClampEdgeLinear, (float2)(volumeSample,0.5f)).w; 
     } while( random_01(randstate) >= opacity*invTauMax && t <= tEnd);
@@ -142,7 +143,40 @@ float woodcockTracking(read_only image3d_t volumeTex, __constant VolumeParameter
     //return min(t, tEnd);
 
 }
-float woodcockTrackingPhoton(read_only image3d_t volumeTex, __constant VolumeParameters* volumeParams,
+#ifdef DENSITY_LOD
+#include "densitypyramid.cl"
+// Normalized density at pos, level 0 samples the (bricked) volume and level > 0 the density pyramid
+float getDensityLod(VOLUME_SAMPLER_ARGS_DECL,
+                 read_only image3d_t densityPyramid, __constant int4* densityPyramidLevels, int level, const float3 pos) {
+    if (level > 0) {
+        return getDensityPyramidVoxel(densityPyramid, densityPyramidLevels, level, pos);
+    } else {
+        return getVolumeDensity(VOLUME_SAMPLER_ARGS, pos);
+    }
+}
+// Woodcock tracking using density from the given pyramid level.
+// Coarse levels reduce texture bandwidth for multiply scattered photons, 
+// which are blurred by the photon radius anyway.
+float woodcockTrackingLod(VOLUME_SAMPLER_ARGS_DECL,
+                 read_only image3d_t densityPyramid, __constant int4* densityPyramidLevels, int level,
+                 read_only image2d_t tfData, const float3 origin, 
+                 const float3 direction, const float tStart, const float tEnd, float tauMax, random_state* __restrict randstate) {
+    
+    float invTauMaxSampleBaseInterval = 1.f/(tauMax*SAMPLING_BASE_INTERVAL_RCP);
+    float invTauMax = 1.f/(tauMax);
+    float t = tStart;
+    float opacity;
+    do {
+        t += -native_log(random_01(randstate))*invTauMaxSampleBaseInterval;
+        float3 pos = origin+t*direction;
+        float volumeSample = getDensityLod(VOLUME_SAMPLER_ARGS, densityPyramid, densityPyramidLevels, level, pos);
+        opacity = read_imagef(tfData, smpNormClampEdgeLinear, (float2)(volumeSample,0.5f)).w; 
+    } while( random_01(randstate) >= opacity*invTauMax && t <= tEnd);
+    return t;
+}
+#endif // DENSITY_LOD
+
+float woodcockTrackingPhoton(VOLUME_SAMPLER_ARGS_DECL,
                  read_only image2d_t tfData, const float3 origin, 
                  const float3 direction, const float tStart, const float tEnd, float tauMax, random_state* __restrict randstate, float* rnd) {
     
@@ -153,7 +187,7 @@ float woodcockTrackingPhoton(read_only image3d_t volumeTex, __constant VolumePar
     do {
         t += -native_log(random_01(randstate))*invTauMaxSampleBaseInterval;
         float3 pos = origin+t*direction;
-        float volumeSample = getNormalizedVoxel(volumeTex, volumeParams, as_float4(pos)).x;
+        float volumeSample = getVolumeDensity(VOLUME_SAMPLER_ARGS, pos);
         opacity = read_imagef(tfData, smpNormClampEdgeLinear, (float2)(volumeSample,0.5f)).w; 
         *rnd = random_01(randstate);
     } while( *rnd >= (opacity)*invTauMax && t <= tEnd);
@@ -161,7 +195,7 @@ float woodcockTrackingPhoton(read_only image3d_t volumeTex, __constant VolumePar
     return t;
 
 }
-float woodcockTrackingN(read_only image3d_t volumeTex, __constant VolumeParameters* volumeParams, read_only image2d_t tfData, const float3 origin,
+float woodcockTrackingN(VOLUME_SAMPLER_ARGS_DECL, read_only image2d_t tfData, const float3 origin,
                  const float3 direction, const float tStart, const float tEnd, float tauMax, random_state* __restrict randstate, float opacity2) {
     
     float invTauMaxSampleBaseInterval = 1.f/(tauMax*SAMPLING_BASE_INTERVAL_RCP);
@@ -171,7 +205,7 @@ float woodcockTrackingN(read_only image3d_t volumeTex, __constant VolumeParamete
     do {
         t += -native_log(random_01(randstate))*invTauMaxSampleBaseInterval;
         float3 pos = origin+t*direction;
-        float volumeSample = getNormalizedVoxel(volumeTex, volumeParams, as_float4(pos)).x;
+        float volumeSample = getVolumeDensity(VOLUME_SAMPLER_ARGS, pos);
         float tfOpacity = read_imagef(tfData, smpNormClampEdgeLinear, (float2)(volumeSample,0.5f)).w;
         opacity = tfOpacity == 0 ? tfOpacity : opacity2;
     } while( random_01(randstate) >= opacity*invTauMax && t <= tEnd);
@@ -181,7 +215,7 @@ float woodcockTrackingN(read_only image3d_t volumeTex, __constant VolumeParamete
 }
 // Apply Woodcock tracking to find the sample distance along the ray
 // Check for first non-zero location
-float woodcockTrackingCheckNonZero(read_only image3d_t volumeTex, __constant VolumeParameters* volumeParams,
+float woodcockTrackingCheckNonZero(VOLUME_SAMPLER_ARGS_DECL,
                  read_only image2d_t tfData, const float3 origin, 
                  const float3 direction, const float tStart, const float tEnd, float *tFirstNonZero, float tauMax, random_state* randstate) {
     
@@ -193,7 +227,7 @@ float woodcockTrackingCheckNonZero(read_only image3d_t volumeTex, __constant Vol
     do {
         t += -native_log(random_01(randstate))*invTauMaxSampleBaseInterval;
         float3 pos = origin+t*direction;
-        float volumeSample = getNormalizedVoxel(volumeTex, volumeParams, as_float4(pos)).x;
+        float volumeSample = getVolumeDensity(VOLUME_SAMPLER_ARGS, pos);
         opacity = read_imagef(tfData, smpNormClampEdgeLinear, (float2)(volumeSample,0.5f)).w; 
         if (t < *tFirstNonZero && opacity == 0.f) {
             *tFirstNonZero = t;
@@ -211,7 +245,7 @@ float woodcockTrackingCheckNonZero(read_only image3d_t volumeTex, __constant Vol
 
 }
 // Apply Woodcock tracking to find the sample distance along the ray
-float4 woodcockTracking4(read_only image3d_t volumeTex, __constant VolumeParameters* volumeParams,
+float4 woodcockTracking4(VOLUME_SAMPLER_ARGS_DECL,
                  read_only image2d_t tfData, const float3 origin, 
                  const float3 direction, const float tStart, const float tEnd, float tauMax, random_state* randstate) {
     
@@ -228,10 +262,10 @@ float4 woodcockTracking4(read_only image3d_t volumeTex, __constant VolumeParamet
         float3 p3 = origin+t.z*direction;
         float3 p4 = origin+t.w*direction;
         float4 volumeSample;
-        volumeSample.x = getNormalizedVoxel(volumeTex, volumeParams, as_float4(p1)).x;
-        volumeSample.y = getNormalizedVoxel(volumeTex, volumeParams, as_float4(p2)).x;
-        volumeSample.z = getNormalizedVoxel(volumeTex, volumeParams, as_float4(p3)).x;
-        volumeSample.w = getNormalizedVoxel(volumeTex, volumeParams, as_float4(p4)).x;
+        volumeSample.x = getVolumeDensity(VOLUME_SAMPLER_ARGS, p1);
+        volumeSample.y = getVolumeDensity(VOLUME_SAMPLER_ARGS, p2);
+        volumeSample.z = getVolumeDensity(VOLUME_SAMPLER_ARGS, p3);
+        volumeSample.w = getVolumeDensity(VOLUME_SAMPLER_ARGS, p4);
 
         opacity.x = read_imagef(tfData, smpNormClampEdgeLinear, (float2)(volumeSample.x,0.5f)).w; 
         opacity.y = read_imagef(tfData, smpNormClampEdgeLinear, (float2)(volumeSample.y,0.5f)).w; 
@@ -5,5 +5,6 @@ set(dependencies
     InviwoOpenCLModule
     InviwoLightCLModule
     InviwoImportanceSamplingCLModule
+    InviwoUniformGridCLModule
     InviwoRndGenMWC64XModule
 )
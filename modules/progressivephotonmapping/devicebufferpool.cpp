@@ -0,0 +1,187 @@
+/*********************************************************************************
+ *
+ * Copyright (c) 2016, Daniel Jönsson
+ * All rights reserved.
+ * 
+ * This work is licensed under a Creative Commons Attribution-NonCommercial 4.0 International License.
+ * http://creativecommons.org/licenses/by-nc/4.0/
+ * 
+ * You are free to:
+ * 
+ * Share — copy and redistribute the material in any medium or format
+ * Adapt — remix, transform, and build upon the material
+ * The licensor cannot revoke these freedoms as long as you follow the license terms.
+ * Under the following terms:
+ * 
+ * Attribution — You must give appropriate credit, provide a link to the license, and indicate if changes were made. You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+ * NonCommercial — You may not use the material for commercial purposes.
+ * No additional restrictions — You may not apply legal terms or technological measures that legally restrict others from doing anything the license permits.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/progressivephotonmapping/devicebufferpool.h>
+
+namespace inviwo {
+
+const size_t DeviceBufferPool::minBucketSize{ 64 * 1024 };
+
+PooledBuffer::PooledBuffer(std::weak_ptr<DeviceBufferPool> pool, cl::Buffer buffer, size_t size, size_t capacity)
+    : pool_(pool), buffer_(buffer), size_(size), capacity_(capacity) {}
+
+PooledBuffer::PooledBuffer(PooledBuffer&& rhs)
+    : pool_(std::move(rhs.pool_)), buffer_(std::move(rhs.buffer_)), size_(rhs.size_), capacity_(rhs.capacity_), lastUse_(std::move(rhs.lastUse_)) {
+    rhs.buffer_ = cl::Buffer();
+    rhs.lastUse_ = cl::Event();
+    rhs.size_ = 0;
+    rhs.capacity_ = 0;
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& rhs) {
+    if (this != &rhs) {
+        release();
+        pool_ = std::move(rhs.pool_);
+        buffer_ = std::move(rhs.buffer_);
+        size_ = rhs.size_;
+        capacity_ = rhs.capacity_;
+        lastUse_ = std::move(rhs.lastUse_);
+        rhs.buffer_ = cl::Buffer();
+        rhs.lastUse_ = cl::Event();
+        rhs.size_ = 0;
+        rhs.capacity_ = 0;
+    }
+    return *this;
+}
+
+PooledBuffer::~PooledBuffer() {
+    release();
+}
+
+void PooledBuffer::release() {
+    if (capacity_ > 0) {
+        // Buffer is freed if the pool no longer exists
+        if (auto pool = pool_.lock()) {
+            pool->release(buffer_, capacity_, lastUse_);
+        }
+    }
+    buffer_ = cl::Buffer();
+    lastUse_ = cl::Event();
+    size_ = 0;
+    capacity_ = 0;
+}
+
+PooledBuffer DeviceBufferPool::acquire(size_t sizeInBytes) {
+    if (sizeInBytes == 0) {
+        return PooledBuffer();
+    }
+    auto capacity = bucketSize(sizeInBytes);
+    std::unique_lock<std::mutex> lock(mutex_);
+    // Do not hand out buffers from more than one octave above the requested bucket
+    auto it = freeBuffers_.lower_bound(capacity);
+    if (it != freeBuffers_.end() && it->first <= 2 * capacity) {
+        auto buffer = PooledBuffer(shared_from_this(), it->second.buffer, sizeInBytes, it->first);
+        auto lastUse = it->second.lastUse;
+        usedBytes_ += it->first;
+        freeBuffers_.erase(it);
+        highWaterMark_ = std::max(highWaterMark_, usedBytes_);
+        lock.unlock();
+        // The previous owner may still be using the buffer on another queue,
+        // commands on the main queue are not ordered with respect to it
+        if (lastUse()) {
+            lastUse.wait();
+        }
+        return buffer;
+    }
+    cl::Buffer buffer;
+    try {
+        buffer = cl::Buffer(OpenCL::getPtr()->getContext(), CL_MEM_READ_WRITE, capacity);
+    } catch (cl::Error& err) {
+        if (err.err() != CL_MEM_OBJECT_ALLOCATION_FAILURE && err.err() != CL_OUT_OF_RESOURCES &&
+            err.err() != CL_OUT_OF_HOST_MEMORY) {
+            throw;
+        }
+        // Memory pressure, release unused buffers and try again
+        freeBuffers_.clear();
+        allocatedBytes_ = usedBytes_;
+        buffer = cl::Buffer(OpenCL::getPtr()->getContext(), CL_MEM_READ_WRITE, capacity);
+    }
+    allocatedBytes_ += capacity;
+    usedBytes_ += capacity;
+    highWaterMark_ = std::max(highWaterMark_, usedBytes_);
+    trimToHighWaterMark();
+    return PooledBuffer(shared_from_this(), buffer, sizeInBytes, capacity);
+}
+
+void DeviceBufferPool::resize(PooledBuffer& buffer, size_t sizeInBytes) {
+    auto capacity = bucketSize(sizeInBytes);
+    if (buffer.getCapacity() >= capacity && buffer.getCapacity() <= 2 * capacity) {
+        buffer.size_ = sizeInBytes;
+        return;
+    }
+    // Release first so that the memory can be reused
+    buffer.release();
+    buffer = acquire(sizeInBytes);
+}
+
+void DeviceBufferPool::trim() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    freeBuffers_.clear();
+    allocatedBytes_ = usedBytes_;
+}
+
+size_t DeviceBufferPool::getAllocatedBytes() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return allocatedBytes_;
+}
+
+size_t DeviceBufferPool::getUsedBytes() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return usedBytes_;
+}
+
+size_t DeviceBufferPool::getHighWaterMark() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return highWaterMark_;
+}
+
+size_t DeviceBufferPool::bucketSize(size_t sizeInBytes) {
+    if (sizeInBytes <= minBucketSize) {
+        return minBucketSize;
+    }
+    // Four buckets per power of two, i.e. at most 25% unused memory
+    size_t powerOfTwo = minBucketSize;
+    while (powerOfTwo * 2 < sizeInBytes) {
+        powerOfTwo *= 2;
+    }
+    size_t step = powerOfTwo / 4;
+    return ((sizeInBytes + step - 1) / step) * step;
+}
+
+void DeviceBufferPool::release(cl::Buffer buffer, size_t capacity, cl::Event lastUse) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    usedBytes_ -= capacity;
+    freeBuffers_.emplace(capacity, FreeBuffer{ buffer, lastUse });
+    trimToHighWaterMark();
+}
+
+void DeviceBufferPool::trimToHighWaterMark() {
+    // Remove smallest unused buffers first since they are the most likely
+    // to be left over from a previous, smaller, configuration.
+    while (allocatedBytes_ > highWaterMark_ && !freeBuffers_.empty()) {
+        allocatedBytes_ -= freeBuffers_.begin()->first;
+        freeBuffers_.erase(freeBuffers_.begin());
+    }
+}
+
+} // namespace
+
@@ -0,0 +1,142 @@
+/*********************************************************************************
+ *
+ * Copyright (c) 2016, Daniel Jönsson
+ * All rights reserved.
+ * 
+ * This work is licensed under a Creative Commons Attribution-NonCommercial 4.0 International License.
+ * http://creativecommons.org/licenses/by-nc/4.0/
+ * 
+ * You are free to:
+ * 
+ * Share — copy and redistribute the material in any medium or format
+ * Adapt — remix, transform, and build upon the material
+ * The licensor cannot revoke these freedoms as long as you follow the license terms.
+ * Under the following terms:
+ * 
+ * Attribution — You must give appropriate credit, provide a link to the license, and indicate if changes were made. You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+ * NonCommercial — You may not use the material for commercial purposes.
+ * No additional restrictions — You may not apply legal terms or technological measures that legally restrict others from doing anything the license permits.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#ifndef IVW_DEVICEBUFFERPOOL_H
+#define IVW_DEVICEBUFFERPOOL_H
+
+#include <modules/progressivephotonmapping/progressivephotonmappingmoduledefine.h>
+#include <inviwo/core/common/inviwo.h>
+#include <modules/opencl/inviwoopencl.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace inviwo {
+
+class DeviceBufferPool;
+
+/**
+ * \class PooledBuffer
+ *
+ * \brief OpenCL buffer handed out by a DeviceBufferPool. 
+ * The buffer is returned to the pool when the PooledBuffer is released or destroyed.
+ * The underlying buffer may be larger than the requested size.
+ * Commands enqueued on another queue than the main one must be registered using setLastUse,
+ * the pool will wait for them to finish before handing out the buffer again.
+ */
+class IVW_MODULE_PROGRESSIVEPHOTONMAPPING_API PooledBuffer {
+public:
+    PooledBuffer() = default;
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+    PooledBuffer(PooledBuffer&& rhs);
+    PooledBuffer& operator=(PooledBuffer&& rhs);
+    ~PooledBuffer();
+
+    const cl::Buffer& get() const { return buffer_; }
+    // Requested size in bytes
+    size_t getSize() const { return size_; }
+    // Size of underlying buffer in bytes
+    size_t getCapacity() const { return capacity_; }
+    // Event of the last command using the buffer, waited for before the buffer is reused
+    void setLastUse(const cl::Event& event) { lastUse_ = event; }
+    // Return buffer to the pool
+    void release();
+
+private:
+    friend class DeviceBufferPool;
+    PooledBuffer(std::weak_ptr<DeviceBufferPool> pool, cl::Buffer buffer, size_t size, size_t capacity);
+
+    std::weak_ptr<DeviceBufferPool> pool_;
+    cl::Buffer buffer_;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+    cl::Event lastUse_;
+};
+
+/**
+ * \class DeviceBufferPool
+ *
+ * \brief Size-bucketed pool of OpenCL buffers shared by the photon mapping processors.
+ *
+ * Buffers are allocated with sizes rounded up to one of four buckets per power of two
+ * so that changing photon count or light volume size slightly reuses existing memory.
+ * Unused buffers are kept as long as the total allocated memory does not exceed 
+ * the largest amount of memory simultaneously in use (high-water mark). 
+ * All unused buffers are released if an allocation fails.
+ */
+class IVW_MODULE_PROGRESSIVEPHOTONMAPPING_API DeviceBufferPool : public std::enable_shared_from_this<DeviceBufferPool> {
+public:
+    DeviceBufferPool() = default;
+    ~DeviceBufferPool() = default;
+
+    /**
+     * \brief Get a buffer of at least sizeInBytes. Allocates only if no free buffer fits.
+     * @throw cl::Error if allocation fails even after unused buffers have been released.
+     */
+    PooledBuffer acquire(size_t sizeInBytes);
+    /**
+     * \brief Make buffer hold at least sizeInBytes. 
+     * Keeps the current buffer, and its content, if it is within the bucket range of sizeInBytes.
+     */
+    void resize(PooledBuffer& buffer, size_t sizeInBytes);
+    // Release all unused buffers
+    void trim();
+
+    size_t getAllocatedBytes() const;
+    size_t getUsedBytes() const;
+    size_t getHighWaterMark() const;
+
+    // Rounded up size that buffers are allocated with
+    static size_t bucketSize(size_t sizeInBytes);
+    static const size_t minBucketSize; 
+private:
+    friend class PooledBuffer;
+    void release(cl::Buffer buffer, size_t capacity, cl::Event lastUse);
+    void trimToHighWaterMark();
+
+    struct FreeBuffer {
+        cl::Buffer buffer;
+        cl::Event lastUse;
+    };
+    mutable std::mutex mutex_;
+    std::multimap<size_t, FreeBuffer> freeBuffers_; // Capacity and buffer
+    size_t allocatedBytes_ = 0;
+    size_t usedBytes_ = 0;
+    size_t highWaterMark_ = 0;
+};
+
+} // namespace
+
+#endif // IVW_DEVICEBUFFERPOOL_H
+
@@ -0,0 +1,103 @@
+/*********************************************************************************
+ *
+ * Copyright (c) 2016, Daniel Jönsson
+ * All rights reserved.
+ * 
+ * This work is licensed under a Creative Commons Attribution-NonCommercial 4.0 International License.
+ * http://creativecommons.org/licenses/by-nc/4.0/
+ * 
+ * You are free to:
+ * 
+ * Share — copy and redistribute the material in any medium or format
+ * Adapt — remix, transform, and build upon the material
+ * The licensor cannot revoke these freedoms as long as you follow the license terms.
+ * Under the following terms:
+ * 
+ * Attribution — You must give appropriate credit, provide a link to the license, and indicate if changes were made. You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+ * NonCommercial — You may not use the material for commercial purposes.
+ * No additional restrictions — You may not apply legal terms or technological measures that legally restrict others from doing anything the license permits.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/progressivephotonmapping/photoncompactor.h>
+
+namespace inviwo {
+
+PhotonCompactor::PhotonCompactor(std::shared_ptr<DeviceBufferPool> bufferPool, size_t workGroupSize)
+    : KernelOwner(), workGroupSize_(workGroupSize), bufferPool_(bufferPool) {
+    countKernel_ = addKernel("photoncompaction.cl", "countPathPhotonsKernel");
+    compactKernel_ = addKernel("photoncompaction.cl", "compactPhotonsKernel");
+
+    auto problem = clogs::ScanProblem();
+    problem.setType(clogs::TYPE_UINT);
+    scan_ = std::unique_ptr<clogs::Scan>(new clogs::Scan(OpenCL::getPtr()->getContext(), OpenCL::getPtr()->getDevice(), problem));
+}
+
+size_t PhotonCompactor::compact(const PhotonData& photonData, const cl::Buffer& photonsCL, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event) {
+    if (!isValid()) {
+        return 0;
+    }
+    auto nPaths = photonData.getNumberOfPhotons();
+    // One extra element so that the scan also gives the total number of photons
+    auto countsSize = (nPaths + 1) * sizeof(cl_uint);
+    if (pathCounts_.getSize() != countsSize) {
+        bufferPool_->resize(pathCounts_, countsSize);
+        bufferPool_->resize(pathOffsets_, countsSize);
+    }
+    try {
+        const auto& queue = OpenCL::getPtr()->getQueue();
+        std::vector<cl::Event> countEvent(1);
+        std::vector<cl::Event> scanEvent(1);
+        int argIndex = 0;
+        countKernel_->setArg(argIndex++, photonsCL);
+        countKernel_->setArg(argIndex++, static_cast<int>(nPaths));
+        countKernel_->setArg(argIndex++, photonData.getMaxPhotonInteractions());
+        countKernel_->setArg(argIndex++, pathCounts_.get());
+        queue.enqueueNDRangeKernel(*countKernel_, cl::NullRange, getGlobalWorkGroupSize(nPaths + 1, workGroupSize_), workGroupSize_, waitForEvents, &countEvent[0]);
+
+        scan_->enqueue(queue, pathCounts_.get(), pathOffsets_.get(), nPaths + 1, nullptr, &countEvent, &scanEvent[0]);
+
+        cl_uint nCompacted = 0;
+        queue.enqueueReadBuffer(pathOffsets_.get(), true, nPaths * sizeof(cl_uint), sizeof(cl_uint), &nCompacted, &scanEvent);
+        nCompactedPhotons_ = static_cast<size_t>(nCompacted);
+        // Keep at least one photon to avoid zero-sized buffers
+        auto compactedSize = std::max(nCompactedPhotons_, size_t(1)) * 2 * sizeof(vec4);
+        if (compactedPhotons_.getSize() != compactedSize) {
+            bufferPool_->resize(compactedPhotons_, compactedSize);
+        }
+        argIndex = 0;
+        compactKernel_->setArg(argIndex++, photonsCL);
+        compactKernel_->setArg(argIndex++, static_cast<int>(nPaths));
+        compactKernel_->setArg(argIndex++, photonData.getMaxPhotonInteractions());
+        compactKernel_->setArg(argIndex++, pathOffsets_.get());
+        compactKernel_->setArg(argIndex++, compactedPhotons_.get());
+        queue.enqueueNDRangeKernel(*compactKernel_, cl::NullRange, getGlobalWorkGroupSize(nPaths, workGroupSize_), workGroupSize_, nullptr, event);
+    } catch (cl::Error& err) {
+        LogError(getCLErrorString(err));
+        nCompactedPhotons_ = 0;
+    } catch (clogs::InternalError& e) {
+        LogError(e.what());
+        nCompactedPhotons_ = 0;
+    }
+    return nCompactedPhotons_;
+}
+
+void PhotonCompactor::release() {
+    pathCounts_.release();
+    pathOffsets_.release();
+    compactedPhotons_.release();
+    nCompactedPhotons_ = 0;
+}
+
+} // namespace
@@ -0,0 +1,109 @@
+/*********************************************************************************
+ *
+ * Copyright (c) 2016, Daniel Jönsson
+ * All rights reserved.
+ * 
+ * This work is licensed under a Creative Commons Attribution-NonCommercial 4.0 International License.
+ * http://creativecommons.org/licenses/by-nc/4.0/
+ * 
+ * You are free to:
+ * 
+ * Share — copy and redistribute the material in any medium or format
+ * Adapt — remix, transform, and build upon the material
+ * The licensor cannot revoke these freedoms as long as you follow the license terms.
+ * Under the following terms:
+ * 
+ * Attribution — You must give appropriate credit, provide a link to the license, and indicate if changes were made. You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+ * NonCommercial — You may not use the material for commercial purposes.
+ * No additional restrictions — You may not apply legal terms or technological measures that legally restrict others from doing anything the license permits.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#ifndef IVW_PHOTONCOMPACTOR_H
+#define IVW_PHOTONCOMPACTOR_H
+
+#include <modules/progressivephotonmapping/progressivephotonmappingmoduledefine.h>
+#include <inviwo/core/common/inviwo.h>
+
+#include <modules/opencl/inviwoopencl.h>
+#include <modules/opencl/kernelowner.h>
+
+#include <modules/progressivephotonmapping/devicebufferpool.h>
+#include <modules/progressivephotonmapping/photondata.h>
+
+#include <clogs/clogs.h>
+
+namespace inviwo {
+
+/**
+ * \class PhotonCompactor
+ * \brief Appends the valid photons of PhotonData into a dense buffer.
+ *
+ * PhotonData reserves getMaxPhotonInteractions() slots for each photon path 
+ * and marks unused slots with FLT_MAX. The compactor counts the valid photons of each path, 
+ * computes the offset of each path with an exclusive scan on the device and 
+ * scatters the photons of a path to consecutive elements in the compacted buffer.
+ * Photons of path i are found at [pathOffsets[i], pathOffsets[i] + pathCounts[i]).
+ */
+class IVW_MODULE_PROGRESSIVEPHOTONMAPPING_API PhotonCompactor : public KernelOwner {
+public:
+    PhotonCompactor(std::shared_ptr<DeviceBufferPool> bufferPool, size_t workGroupSize = 128);
+    virtual ~PhotonCompactor() = default;
+
+    size_t workGroupSize() const { return workGroupSize_; }
+    void workGroupSize(size_t val) { workGroupSize_ = val; }
+
+    bool isValid() const { return countKernel_ != nullptr && compactKernel_ != nullptr; }
+
+    /**
+     * \brief Compact photons in photonsCL, which must have the layout of photonData.photons_.
+     * Blocks until the number of valid photons has been read back since it determines 
+     * the size of the compacted buffer and the number of threads operating on it.
+     *
+     * @param photonData Number of photon paths and interactions
+     * @param photonsCL Photons with getMaxPhotonInteractions() slots per path
+     * @param waitForEvents Events to wait for before counting photons
+     * @param event Signaled when the compacted buffer has been written
+     * @return Number of photons in the compacted buffer
+     */
+    size_t compact(const PhotonData& photonData, const cl::Buffer& photonsCL, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event = nullptr);
+
+    // Valid photons, in path order, 2 x float4 per photon. 
+    const cl::Buffer& getCompactedPhotons() const { return compactedPhotons_.get(); }
+    size_t getNumberOfCompactedPhotons() const { return nCompactedPhotons_; }
+    // Number of valid photons in each path (uint)
+    const cl::Buffer& getPathCounts() const { return pathCounts_.get(); }
+    // Index of first photon of each path in the compacted buffer (uint). 
+    // Contains one extra element holding the total number of compacted photons.
+    const cl::Buffer& getPathOffsets() const { return pathOffsets_.get(); }
+
+    // Return buffers to the pool
+    void release();
+private:
+    size_t workGroupSize_;
+    size_t nCompactedPhotons_ = 0;
+
+    std::shared_ptr<DeviceBufferPool> bufferPool_;
+    PooledBuffer pathCounts_;
+    PooledBuffer pathOffsets_;
+    PooledBuffer compactedPhotons_;
+    std::unique_ptr<clogs::Scan> scan_;
+
+    cl::Kernel* countKernel_;
+    cl::Kernel* compactKernel_;
+};
+
+} // namespace
+
+#endif // IVW_PHOTONCOMPACTOR_H
@@ -58,6 +58,13 @@ void PhotonData::setSize(size_t numberOfPhotons, int maxPhotonInteractions) {
 
 }
 
+void PhotonData::setDepositedIrradianceDimensions(const size3_t& dim) {
+    depositedIrradianceDimensions_ = dim;
+    if (depositedIrradiance_.getSize() != dim.x * dim.y * dim.z) {
+        depositedIrradiance_.setSize(dim.x * dim.y * dim.z);
+    }
+}
+
 void PhotonData::setRadius(double radiusRelativeToSceneSize, double sceneRadius) {
     sceneRadius_ = sceneRadius;
     worldSpaceRadius_ = radiusRelativeToSceneSize*sceneRadius;
@@ -82,6 +89,16 @@ double PhotonData::sphereVolume(double radius) {
     return std::pow(radius, 3) * (M_PI*4. / 3.);
 }
 
+size3_t PhotonData::lightVolumeDimensions(double radiusRelativeToSceneSize, const size3_t& currentDimensions, double upgradeFactor) {
+    auto radiusDimension = static_cast<size_t>(std::ceil(1.0 / radiusRelativeToSceneSize));
+    auto currentDimension = static_cast<double>(glm::compMax(currentDimensions));
+    if (static_cast<double>(radiusDimension) < currentDimension || static_cast<double>(radiusDimension) >= upgradeFactor * currentDimension) {
+        return size3_t(radiusDimension);
+    } else {
+        return currentDimensions;
+    }
+}
+
 double PhotonData::getRelativeIrradianceScale() const {
     // Scale with lightVolumeSizeScale to get the same look for different light volume sizes.
     double referenceRadiusVolumeScale = sphereVolume(getRadiusRelativeToSceneSize()) / sphereVolume(defaultRadiusRelativeToSceneRadius);
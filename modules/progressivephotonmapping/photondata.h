@@ -135,9 +135,27 @@ public:
     void setIteration(int val) { iteration_ = val; }
     
     static double sphereVolume(double radius);
+    /**
+     * \brief Light volume resolution for photons of the given radius, one voxel per radius along each axis.
+     * The resolution is only increased once the radius has shrunk to 1/upgradeFactor voxels of currentDimensions,
+     * so that it changes in a few steps while the radius decreases during progressive refinement.
+     * Returns the resolution of the radius directly if it is coarser than currentDimensions, e.g. after a reset.
+     * @param upgradeFactor Resolution increase needed before changing, 1 follows the radius exactly
+     */
+    static size3_t lightVolumeDimensions(double radiusRelativeToSceneSize, const size3_t& currentDimensions, double upgradeFactor = 2.0);
     double getRelativeIrradianceScale() const;
     
     Buffer<vec4> photons_;
+    /**
+     * \brief Irradiance splatted by the photon tracer while tracing, float4 per voxel.
+     * Only set when all photons were splatted while tracing, in which case photons_ has not been written.
+     * Voxel centers are at (index + 0.5)/dimensions in texture space, see depositPhoton in photondeposit.cl.
+     */
+    Buffer<vec4> depositedIrradiance_;
+    bool hasDepositedIrradiance() const { return depositedIrradiance_.getSize() > 0; }
+    size3_t getDepositedIrradianceDimensions() const { return depositedIrradianceDimensions_; }
+    // Resizes depositedIrradiance_, size3_t(0) marks photons_ as the up to date representation
+    void setDepositedIrradianceDimensions(const size3_t& dim);
     
     static const float defaultRadiusRelativeToSceneRadius;
     static const float defaultSceneRadius;
@@ -152,6 +170,7 @@ protected:
     double worldSpaceRadius_ = 0.01;
     int iteration_ = 0; ///< Progressive refinement iteration
     InvalidationReason invalidationFlag_ = InvalidationReason::All;
+    size3_t depositedIrradianceDimensions_{ 0 };
     
 };
 inline PhotonData::InvalidationReason operator|(PhotonData::InvalidationReason a, PhotonData::InvalidationReason b)
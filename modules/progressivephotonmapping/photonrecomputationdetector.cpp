@@ -46,7 +46,7 @@ PhotonRecomputationDetector::~PhotonRecomputationDetector()  {
     
 }
 
-void PhotonRecomputationDetector::photonRecomputationImportance(const PhotonData* photonData, int photonOffset, const Volume* origVolume, const ImportanceUniformGrid3D* uniformGridVolume, const LightSamples& lightSamples, Buffer<unsigned int>& recomputationImportance, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event, SyncCLGL* glSync) {
+void PhotonRecomputationDetector::photonRecomputationImportance(const PhotonData* photonData, int photonOffset, const Volume* origVolume, const UniformGrid3DBase* uniformGridVolume, const LightSamples& lightSamples, Buffer<unsigned int>& recomputationImportance, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event, SyncCLGL* glSync) {
     if (kernel_ == NULL) {
         return;
     }
@@ -60,7 +60,7 @@ void PhotonRecomputationDetector::photonRecomputationImportance(const PhotonData
         //IVW_CPU_PROFILING("useGLSharing")
         auto lightSampleCL = lightSamples.getLightSamples()->getRepresentation<BufferCLGL>();
         auto intersectionPointCL = lightSamples.getIntersectionPoints()->getRepresentation<BufferCLGL>();
-        auto uniformGrid3DCL = uniformGridVolume->data.getRepresentation<BufferCLGL>();
+        auto uniformGrid3DCL = uniformGridVolume->getBuffer().getRepresentation<BufferCLGL>();
         auto photonCL = photonData->photons_.getRepresentation<BufferCLGL>();
         auto recomputationImportanceBuf = recomputationImportance.getEditableRepresentation<BufferCL>();
 
@@ -82,7 +82,7 @@ void PhotonRecomputationDetector::photonRecomputationImportance(const PhotonData
     } else {
         auto lightSampleCL = lightSamples.getLightSamples()->getRepresentation<BufferCL>();
         auto intersectionPointCL = lightSamples.getIntersectionPoints()->getRepresentation<BufferCL>();
-        auto uniformGrid3DCL = uniformGridVolume->data.getRepresentation<BufferCL>();
+        auto uniformGrid3DCL = uniformGridVolume->getBuffer().getRepresentation<BufferCL>();
         auto photonCL = photonData->photons_.getRepresentation<BufferCL>();
         auto recomputationImportanceBuf = recomputationImportance.getEditableRepresentation<BufferCL>();
         photonRecomputationImportance(photonData, photonOffset, photonCL, origVolume, uniformGridVolume, uniformGrid3DCL, lightSamples, lightSampleCL, intersectionPointCL,
@@ -90,7 +90,7 @@ void PhotonRecomputationDetector::photonRecomputationImportance(const PhotonData
     }
 }
 
-void PhotonRecomputationDetector::photonRecomputationImportance(const PhotonData* photonData, int photonOffset, const BufferCLBase* photonDataCL, const Volume* origVolume, const ImportanceUniformGrid3D* uniformGridVolume, const BufferCLBase* uniformGridVolumeCL, const LightSamples& lightSamples, const BufferCLBase* lightSamplesCL, const BufferCLBase* intersectionPointsCL, BufferCLBase* recomputationImportance, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event /*= nullptr*/) {
+void PhotonRecomputationDetector::photonRecomputationImportance(const PhotonData* photonData, int photonOffset, const BufferCLBase* photonDataCL, const Volume* origVolume, const UniformGrid3DBase* uniformGridVolume, const BufferCLBase* uniformGridVolumeCL, const LightSamples& lightSamples, const BufferCLBase* lightSamplesCL, const BufferCLBase* intersectionPointsCL, BufferCLBase* recomputationImportance, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event /*= nullptr*/) {
     cl::Kernel* kernel = kernel_;
     if (getEqualImportance()) {
         kernel = equalImportanceKernel_;
@@ -98,7 +98,9 @@ void PhotonRecomputationDetector::photonRecomputationImportance(const PhotonData
     //IVW_CPU_PROFILING("photonRecomputationImportance")
     cl_uint argId = 0;
     kernel->setArg(argId++, *uniformGridVolumeCL);
-    kernel->setArg(argId++, ivec3(uniformGridVolume->getDimensions()));
+    kernel->setArg(argId++, util::uniformGrid3DDimensionsCL(*uniformGridVolume));
+    kernel->setArg(argId++, static_cast<int>(uniformGridVolume->getDataFormat()->getSize()));
+    kernel->setArg(argId++, *uniformGridVolume->getValueScaleBuffer().getRepresentation<BufferCL>());
     kernel->setArg(argId++, vec3(uniformGridVolume->getCellDimension()));
     kernel->setArg(argId++, origVolume->getCoordinateTransformer().getTextureToIndexMatrix());
     kernel->setArg(argId++, origVolume->getCoordinateTransformer().getIndexToTextureMatrix());
@@ -51,6 +51,7 @@ namespace inviwo {
  * \class PhotonRecomputationDetector
  * \brief Detect photons that need to be recomputed using a uniform grid containing recomputation importance values.
  *
+ * The importance grid can be float or quantized to 8 or 16 bits, see util::isScalarUniformGrid3DFormat.
  */
 class IVW_MODULE_PROGRESSIVEPHOTONMAPPING_API PhotonRecomputationDetector : public KernelOwner {
 public:
@@ -65,9 +66,9 @@ public:
     bool isValid() const { return kernel_ != nullptr; }
 
 
-    void photonRecomputationImportance(const PhotonData* photonData, int photonOffset, const Volume* origVolume, const ImportanceUniformGrid3D* uniformGridVolume, const LightSamples& lightSamples, Buffer<unsigned int>& recomputationImportance, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event = nullptr, SyncCLGL* glSync = nullptr);
+    void photonRecomputationImportance(const PhotonData* photonData, int photonOffset, const Volume* origVolume, const UniformGrid3DBase* uniformGridVolume, const LightSamples& lightSamples, Buffer<unsigned int>& recomputationImportance, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event = nullptr, SyncCLGL* glSync = nullptr);
 
-    void photonRecomputationImportance(const PhotonData* photonData, int photonOffset, const BufferCLBase* photonDataCL, const Volume* origVolume, const ImportanceUniformGrid3D* uniformGridVolume, const BufferCLBase* uniformGridVolumeCL, const LightSamples& lightSamples, const BufferCLBase* lightSamplesCL, const BufferCLBase* intersectionPointsCL, BufferCLBase* recomputationImportance, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event = nullptr);
+    void photonRecomputationImportance(const PhotonData* photonData, int photonOffset, const BufferCLBase* photonDataCL, const Volume* origVolume, const UniformGrid3DBase* uniformGridVolume, const BufferCLBase* uniformGridVolumeCL, const LightSamples& lightSamples, const BufferCLBase* lightSamplesCL, const BufferCLBase* intersectionPointsCL, BufferCLBase* recomputationImportance, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event = nullptr);
 
     bool getEqualImportance() const { return equalImportance_; }
     void setEqualImportance(bool val) { equalImportance_ = val; }
@@ -0,0 +1,157 @@
+/*********************************************************************************
+ *
+ * Copyright (c) 2016, Daniel Jönsson
+ * All rights reserved.
+ * 
+ * This work is licensed under a Creative Commons Attribution-NonCommercial 4.0 International License.
+ * http://creativecommons.org/licenses/by-nc/4.0/
+ * 
+ * You are free to:
+ * 
+ * Share — copy and redistribute the material in any medium or format
+ * Adapt — remix, transform, and build upon the material
+ * The licensor cannot revoke these freedoms as long as you follow the license terms.
+ * Under the following terms:
+ * 
+ * Attribution — You must give appropriate credit, provide a link to the license, and indicate if changes were made. You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+ * NonCommercial — You may not use the material for commercial purposes.
+ * No additional restrictions — You may not apply legal terms or technological measures that legally restrict others from doing anything the license permits.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/progressivephotonmapping/photonsplattercpu.h>
+
+#include <thread>
+
+namespace inviwo {
+
+PhotonSplatterCPU::PhotonSplatterCPU(size_t nThreads)
+    : nThreads_(nThreads > 0 ? nThreads : std::max(size_t(std::thread::hardware_concurrency()), size_t(1))) {}
+
+void PhotonSplatterCPU::splat(const vec4* photons, size_t nPhotons, float radianceMultiplier, const Parameters& params, float* volume) const {
+    splatRecords(nPhotons, [&](size_t i, SplatRecord& record) {
+        return makeRecord(&photons[2 * i], radianceMultiplier, params, record);
+    }, params, volume);
+}
+
+void PhotonSplatterCPU::splatSelected(const vec4* photons, const unsigned int* indices, size_t nIndices, size_t photonsPerInteraction, size_t nInteractions, float radianceMultiplier, const Parameters& params, float* volume) const {
+    if (nInteractions == 0) {
+        return;
+    }
+    splatRecords(nIndices * nInteractions, [&](size_t i, SplatRecord& record) {
+        auto photonId = (i % nInteractions) * photonsPerInteraction + indices[i / nInteractions];
+        return makeRecord(&photons[2 * photonId], radianceMultiplier, params, record);
+    }, params, volume);
+}
+
+bool PhotonSplatterCPU::makeRecord(const vec4* photon, float radianceMultiplier, const Parameters& params, SplatRecord& record) const {
+    record.position = vec3(photon[0]);
+    if (glm::any(glm::equal(record.position, vec3(FLT_MAX)))) {
+        return false;
+    }
+    record.power = vec3(photon[0].w, photon[1].x, photon[1].y) * (params.irradianceScale * radianceMultiplier);
+    record.radius = params.radius;
+    if (params.densityGrid) {
+        // Same as adaptiveRadiusScale in photonstolightvolume.cl
+        const auto& gridDim = params.densityGridDim;
+        auto cell = glm::clamp(ivec3(record.position * vec3(gridDim)), ivec3(0), ivec3(gridDim) - 1);
+        auto count = static_cast<float>(std::max(params.densityGrid[cell.x + cell.y * gridDim.x + cell.z * gridDim.x * gridDim.y], 1u));
+        auto meanCount = static_cast<float>(params.densityGrid[gridDim.w]) / static_cast<float>(std::max(params.densityGrid[gridDim.w + 1], 1u));
+        auto radiusScale = glm::clamp(std::cbrt(meanCount / count), 1.f / params.maxRadiusScale, params.maxRadiusScale);
+        record.power /= radiusScale * radiusScale * radiusScale;
+        record.radius *= radiusScale;
+    }
+    return true;
+}
+
+void PhotonSplatterCPU::splatRecords(size_t nRecords, const RecordFunctor& getRecord, const Parameters& params, float* volume) const {
+    const auto dim = ivec3(params.dimensions);
+    const auto nSlabs = std::min(nThreads_, params.dimensions.z);
+    if (nRecords == 0 || nSlabs == 0) {
+        return;
+    }
+    auto slabStart = [&](size_t slab) { return static_cast<int>(slab * params.dimensions.z / nSlabs); };
+    // Voxel range covered by the photon, same as splatPhoton in photonstolightvolume.cl
+    auto footprint = [&](const SplatRecord& record, ivec3& start, ivec3& end) {
+        auto r = vec3(record.radius);
+        start = glm::max(ivec3(0), ivec3(vec3(params.textureToIndex * vec4(record.position - r, 1.f))));
+        end = glm::min(ivec3(vec3(params.textureToIndex * vec4(record.position + r, 1.f)) + 1.f), dim);
+    };
+    // routed[t][s] holds the photons routing thread t found for slab s. 
+    // Each routing thread has its own lists so that routing also runs without synchronization.
+    std::vector<std::vector<std::vector<SplatRecord>>> routed(nSlabs, std::vector<std::vector<SplatRecord>>(nSlabs));
+    parallelFor(nSlabs, [&](size_t thread) {
+        auto& slabs = routed[thread];
+        SplatRecord record;
+        ivec3 start, end;
+        for (auto i = nRecords * thread / nSlabs; i < nRecords * (thread + 1) / nSlabs; ++i) {
+            if (!getRecord(i, record)) {
+                continue;
+            }
+            footprint(record, start, end);
+            for (size_t slab = 0; slab < nSlabs; ++slab) {
+                if (start.z < slabStart(slab + 1) && slabStart(slab) < end.z) {
+                    slabs[slab].push_back(record);
+                }
+            }
+        }
+    });
+    parallelFor(nSlabs, [&](size_t slab) {
+        const auto zBegin = slabStart(slab);
+        const auto zEnd = slabStart(slab + 1);
+        ivec3 start, end;
+        for (const auto& slabs : routed) {
+            for (const auto& record : slabs[slab]) {
+                footprint(record, start, end);
+                for (int z = std::max(start.z, zBegin); z < std::min(end.z, zEnd); ++z) {
+                    for (int y = start.y; y < end.y; ++y) {
+                        for (int x = start.x; x < end.x; ++x) {
+                            auto volTexCoord = vec3(params.indexToTexture * vec4(x, y, z, 1.f));
+                            // Epanechnikov kernel, see densityEstimationKernel
+                            auto distanceToPhoton = glm::distance(volTexCoord, record.position) / record.radius;
+                            if (distanceToPhoton > 1.f) {
+                                continue;
+                            }
+                            auto filteredIrradiance = record.power * (0.75f * (1.f - distanceToPhoton * distanceToPhoton));
+                            auto voxel = &volume[(x + y * dim.x + z * dim.x * dim.y) * params.channels];
+                            if (params.channels == 1) {
+                                voxel[0] += filteredIrradiance.x;
+                            } else {
+                                voxel[0] += filteredIrradiance.x;
+                                voxel[1] += filteredIrradiance.y;
+                                voxel[2] += filteredIrradiance.z;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
+
+void PhotonSplatterCPU::parallelFor(size_t n, const std::function<void(size_t)>& f) {
+    std::vector<std::thread> threads;
+    threads.reserve(n);
+    for (size_t i = 1; i < n; ++i) {
+        threads.emplace_back(f, i);
+    }
+    if (n > 0) {
+        f(0);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+} // namespace
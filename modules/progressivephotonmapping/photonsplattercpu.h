@@ -0,0 +1,110 @@
+/*********************************************************************************
+ *
+ * Copyright (c) 2016, Daniel Jönsson
+ * All rights reserved.
+ * 
+ * This work is licensed under a Creative Commons Attribution-NonCommercial 4.0 International License.
+ * http://creativecommons.org/licenses/by-nc/4.0/
+ * 
+ * You are free to:
+ * 
+ * Share — copy and redistribute the material in any medium or format
+ * Adapt — remix, transform, and build upon the material
+ * The licensor cannot revoke these freedoms as long as you follow the license terms.
+ * Under the following terms:
+ * 
+ * Attribution — You must give appropriate credit, provide a link to the license, and indicate if changes were made. You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+ * NonCommercial — You may not use the material for commercial purposes.
+ * No additional restrictions — You may not apply legal terms or technological measures that legally restrict others from doing anything the license permits.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#ifndef IVW_PHOTONSPLATTERCPU_H
+#define IVW_PHOTONSPLATTERCPU_H
+
+#include <modules/progressivephotonmapping/progressivephotonmappingmoduledefine.h>
+#include <inviwo/core/common/inviwo.h>
+
+#include <functional>
+
+namespace inviwo {
+
+/**
+ * \class PhotonSplatterCPU
+ * \brief Splats photons into a light volume accumulation buffer using host threads.
+ *
+ * Counterpart of splatPhotonsToLightVolumeKernel and splatSelectedPhotonsToLightVolumeKernel 
+ * for OpenCL CPU devices, where the atomic float additions of the kernels turn into 
+ * contended compare-and-swap loops. The volume is divided into z-slabs, one per thread, 
+ * and each photon is routed to the slabs overlapped by its kernel support. 
+ * A thread only writes to the voxels of its own slab so no atomics are needed.
+ * Contributions are accumulated in a different order than on the device, 
+ * results may therefore differ in the last bits.
+ */
+class IVW_MODULE_PROGRESSIVEPHOTONMAPPING_API PhotonSplatterCPU {
+public:
+    struct Parameters {
+        mat4 textureToIndex; // Of the light volume
+        mat4 indexToTexture;
+        size3_t dimensions;
+        size_t channels = 1; // 1 (float) or 4 (float4) per voxel
+        float radius = 0.f; // Texture space
+        float irradianceScale = 1.f; // Applied to photon power, see splatPhotonsToLightVolumeKernel
+        // Photon density grid read from the device, adapts the radius if set. See photonDensityGridKernel.
+        const unsigned int* densityGrid = nullptr;
+        ivec4 densityGridDim{ 0 };
+        float maxRadiusScale = 1.f;
+    };
+    /**
+     * @param nThreads Number of threads and slabs, hardware concurrency if zero.
+     */
+    PhotonSplatterCPU(size_t nThreads = 0);
+    ~PhotonSplatterCPU() = default;
+
+    size_t getNumberOfThreads() const { return nThreads_; }
+
+    /**
+     * \brief Add photon contributions to volume, photons with FLT_MAX position are skipped.
+     *
+     * @param photons Two vec4 per photon, position and power, same layout as PhotonData::photons_
+     * @param nPhotons Number of photons, including unused interaction slots
+     * @param radianceMultiplier +1 if contribution should be added, -1 otherwise
+     * @param volume Accumulation buffer with params.channels floats per voxel
+     */
+    void splat(const vec4* photons, size_t nPhotons, float radianceMultiplier, const Parameters& params, float* volume) const;
+    /**
+     * \brief Add contributions of photons at indices for each interaction,
+     * photon interaction*photonsPerInteraction + indices[i] is splatted.
+     */
+    void splatSelected(const vec4* photons, const unsigned int* indices, size_t nIndices, size_t photonsPerInteraction, size_t nInteractions, float radianceMultiplier, const Parameters& params, float* volume) const;
+
+private:
+    struct SplatRecord {
+        vec3 position;
+        float radius;
+        vec3 power;
+    };
+    // Returns false if the photon does not contribute
+    using RecordFunctor = std::function<bool(size_t, SplatRecord&)>;
+    void splatRecords(size_t nRecords, const RecordFunctor& getRecord, const Parameters& params, float* volume) const;
+    bool makeRecord(const vec4* photon, float radianceMultiplier, const Parameters& params, SplatRecord& record) const;
+    // Run f(i) for i in [0, n[ on separate threads
+    static void parallelFor(size_t n, const std::function<void(size_t)>& f);
+
+    size_t nThreads_;
+};
+
+} // namespace
+
+#endif // IVW_PHOTONSPLATTERCPU_H
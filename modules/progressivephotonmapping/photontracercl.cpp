@@ -42,8 +42,44 @@
 
 #include <modules/rndgenmwc64x/mwc64xseedgenerator.h>
 
+#include <array>
+#include <numeric>
+
 namespace inviwo {
 
+/**
+ * Must match random_state in rndgenmwc64x/cl/random.cl
+ */
+struct MWC64XRandomState {
+    uint32_t x;
+    uint32_t c;
+};
+
+/**
+ * Must match random_state in rndgenmwc64x/cl/randomphilox.cl
+ */
+struct alignas(16) PhiloxRandomState {
+    uvec4 ctr;
+    uvec2 key;
+    alignas(16) uvec4 values;
+    uint32_t index;
+};
+
+/**
+ * Must match PathState in photontracerwavefront.cl
+ */
+template <typename RandomState>
+struct alignas(16) WavefrontPathState {
+    vec4 origin;
+    vec4 direction;
+    vec4 power;
+    uint32_t pathId;
+    uint32_t nInteractions;
+    RandomState randstate;
+};
+static_assert(sizeof(WavefrontPathState<MWC64XRandomState>) == 64, "WavefrontPathState does not match PathState in photontracerwavefront.cl");
+static_assert(sizeof(WavefrontPathState<PhiloxRandomState>) == 128, "WavefrontPathState does not match PathState in photontracerwavefront.cl");
+
 uvec2 getSamplesPerLight(uvec2 nSamples, int nLightSources) {
     uvec2 samplesPerLight;
     // samplesPerLight.y = nPhotons.y / nLightSources;
@@ -62,13 +98,15 @@ uvec2 getSamplesPerLight(uvec2 nSamples, int nLightSources) {
 PhotonTracerCL::PhotonTracerCL(size2_t workGroupSize /*= size2_t(8, 8)*/, bool useGLSharing /*= false*/)
 : KernelOwner(), workGroupSize_(workGroupSize), useGLSharing_(useGLSharing) {
     compileKernels();
+    densityPyramidBaseLevelKernel_ = addKernel("densitypyramid.cl", "densityPyramidBaseLevelKernel");
+    densityPyramidLevelKernel_ = addKernel("densitypyramid.cl", "densityPyramidLevelKernel");
 }
 
 void PhotonTracerCL::tracePhotons(const Volume* volume, const TransferFunction& transferFunction, const BufferCL* axisAlignedBoundingBoxCL, const AdvancedMaterialProperty& material, const Camera* camera, float stepSize, const LightSamples* lightSamples, const Buffer<unsigned int>* photonsToRecomputeIndices, int nInvalidPhotons, int photonOffset, int batch, int maxInteractions, PhotonData* photonOutData, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event /*= nullptr*/) {
     if (!photonTracerKernel_) {
         return;
     }
-    if (randomState_.getSize() != photonOutData->getNumberOfPhotons()) {
+    if (!counterBasedRandom_ && randomState_.getSize() != photonOutData->getNumberOfPhotons()) {
         setRandomSeedSize(photonOutData->getNumberOfPhotons());
     }
     auto volumeDim = volume->getDimensions();
@@ -131,9 +169,84 @@ void PhotonTracerCL::tracePhotons(const Volume* volume, const TransferFunction&
     
 }
 
+void PhotonTracerCL::tracePhotons(const Volume* volume, const TransferFunction& transferFunction, const BufferCL* axisAlignedBoundingBoxCL, const AdvancedMaterialProperty& material, const Camera* camera, float stepSize, const std::vector<const LightSamples*>& lightSamples, const Buffer<unsigned int>* photonsToRecomputeIndices, int nInvalidPhotons, int batch, int maxInteractions, PhotonData* photonOutData, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event /*= nullptr*/) {
+    if (lightSamples.empty()) {
+        return;
+    }
+    auto packedLightSamples = packLightSamples(lightSamples);
+    tracePhotons(volume, transferFunction, axisAlignedBoundingBoxCL, material, camera, stepSize, packedLightSamples, photonsToRecomputeIndices, nInvalidPhotons, 0, batch
+                 , maxInteractions, photonOutData, waitForEvents, event);
+}
+
+const LightSamples* PhotonTracerCL::packLightSamples(const std::vector<const LightSamples*>& lightSamples) {
+    if (lightSamples.size() == 1) {
+        return lightSamples.front();
+    }
+    size_t nSamples = std::accumulate(lightSamples.begin(), lightSamples.end(), size_t(0), 
+                                      [](size_t val, const LightSamples* samples) { return val + samples->getSize(); });
+    if (packedLightSamples_.getSize() != nSamples) {
+        packedLightSamples_.setSize(nSamples);
+    }
+    if (nSamples == 0) {
+        return &packedLightSamples_;
+    }
+    try {
+        std::unique_ptr<SyncCLGL> glSync = nullptr;
+        BufferCLBase* packedSamplesCL = nullptr;
+        BufferCLBase* packedIntersectionPointsCL = nullptr;
+        std::vector<std::pair<const BufferCLBase*, const BufferCLBase*>> samplesCL;
+        if (useGLSharing_) {
+            glSync = std::make_unique<SyncCLGL>();
+            auto packedSamplesCLGL = packedLightSamples_.getLightSamples()->getEditableRepresentation<BufferCLGL>();
+            auto packedIntersectionPointsCLGL = packedLightSamples_.getIntersectionPoints()->getEditableRepresentation<BufferCLGL>();
+            glSync->addToAquireGLObjectList(packedSamplesCLGL);
+            glSync->addToAquireGLObjectList(packedIntersectionPointsCLGL);
+            packedSamplesCL = packedSamplesCLGL;
+            packedIntersectionPointsCL = packedIntersectionPointsCLGL;
+            for (auto samples : lightSamples) {
+                auto lightSamplesCLGL = samples->getLightSamples()->getRepresentation<BufferCLGL>();
+                auto intersectionPointsCLGL = samples->getIntersectionPoints()->getRepresentation<BufferCLGL>();
+                glSync->addToAquireGLObjectList(lightSamplesCLGL);
+                glSync->addToAquireGLObjectList(intersectionPointsCLGL);
+                samplesCL.emplace_back(lightSamplesCLGL, intersectionPointsCLGL);
+            }
+            glSync->aquireAllObjects();
+        } else {
+            packedSamplesCL = packedLightSamples_.getLightSamples()->getEditableRepresentation<BufferCL>();
+            packedIntersectionPointsCL = packedLightSamples_.getIntersectionPoints()->getEditableRepresentation<BufferCL>();
+            for (auto samples : lightSamples) {
+                samplesCL.emplace_back(samples->getLightSamples()->getRepresentation<BufferCL>(), samples->getIntersectionPoints()->getRepresentation<BufferCL>());
+            }
+        }
+        size_t samplesOffset = 0;
+        size_t intersectionPointsOffset = 0;
+        for (size_t i = 0; i < lightSamples.size(); ++i) {
+            auto samplesSize = lightSamples[i]->getLightSamples()->getSizeInBytes();
+            auto intersectionPointsSize = lightSamples[i]->getIntersectionPoints()->getSizeInBytes();
+            if (samplesSize > 0) {
+                OpenCL::getPtr()->getQueue().enqueueCopyBuffer(samplesCL[i].first->get(), packedSamplesCL->getEditable(), 0, samplesOffset, samplesSize);
+                OpenCL::getPtr()->getQueue().enqueueCopyBuffer(samplesCL[i].second->get(), packedIntersectionPointsCL->getEditable(), 0, intersectionPointsOffset, intersectionPointsSize);
+            }
+            samplesOffset += samplesSize;
+            intersectionPointsOffset += intersectionPointsSize;
+        }
+    } catch (cl::Error& err) {
+        LogError(getCLErrorString(err));
+    }
+    return &packedLightSamples_;
+}
 
 void PhotonTracerCL::tracePhotons(PhotonData* photonData, const VolumeCLBase* volumeCL, const Buffer<glm::u8>& volumeStruct, const BufferCL* axisAlignedBoundingBoxCL, const LayerCLBase* transferFunctionCL, const AdvancedMaterialProperty& material, float stepSize, const BufferCLBase* lightSamplesCL, const BufferCLBase* intersectionPointsCL, size_t nLightSamples, const BufferCLBase* photonsToRecomputeIndicesCL, int nInvalidPhotons, BufferCLBase* photonsCL, int photonOffset, int batch, int maxInteractions, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event /*= nullptr*/) {
-    
+    // Partial updates replace photons in photons_, which must then be up to date
+    bool splatPhotons = fusedSplatting_ && fusedPhotonTracerKernel_ && !wavefront_ && !photonsToRecomputeIndicesCL;
+    if (!splatPhotons) {
+        photonData->setDepositedIrradianceDimensions(size3_t(0));
+    }
+    if (wavefront_) {
+        tracePhotonsWavefront(photonData, volumeCL, volumeStruct, axisAlignedBoundingBoxCL, transferFunctionCL, material, stepSize, lightSamplesCL, intersectionPointsCL, nLightSamples
+                              , photonsToRecomputeIndicesCL, nInvalidPhotons, photonsCL, photonOffset, batch, maxInteractions, waitForEvents, event);
+        return;
+    }
     cl::Kernel* kernel;
     
     cl_uint tracerArg = 0;
@@ -141,16 +254,21 @@ void PhotonTracerCL::tracePhotons(PhotonData* photonData, const VolumeCLBase* vo
         kernel = recomputePhotonTracerKernel_;
         kernel->setArg(tracerArg++, *photonsToRecomputeIndicesCL);
         kernel->setArg(tracerArg++, nInvalidPhotons);
+    } else if (splatPhotons) {
+        kernel = fusedPhotonTracerKernel_;
     } else {
         kernel = photonTracerKernel_;
     }
     kernel->setArg(tracerArg++, *volumeCL);
     kernel->setArg(tracerArg++, volumeStruct);
+    setBrickedVolumeArgs(kernel, tracerArg);
     kernel->setArg(tracerArg++, *axisAlignedBoundingBoxCL);
     kernel->setArg(tracerArg++, *transferFunctionCL);
     kernel->setArg(tracerArg++, *transferFunctionCL); // TODO: Replace with scattering or remove
     kernel->setArg(tracerArg++, material.getCombinedMaterialParameters());
-    kernel->setArg(tracerArg++, *(randomState_.getEditableRepresentation<BufferCL>()));
+    if (!counterBasedRandom_) {
+        kernel->setArg(tracerArg++, *(randomState_.getEditableRepresentation<BufferCL>()));
+    }
     kernel->setArg(tracerArg++, stepSize);
     kernel->setArg(tracerArg++, *photonsCL);
     kernel->setArg(tracerArg++, photonData->iteration());
@@ -164,6 +282,29 @@ void PhotonTracerCL::tracePhotons(PhotonData* photonData, const VolumeCLBase* vo
     //kernel->setArg(tracerArg++, 1); // Random light sampling
     kernel->setArg(tracerArg++, photonData->iteration() > 1 ? 1 : 0); // Random light sampling
     kernel->setArg(tracerArg++, static_cast<int>(photonData->getNumberOfPhotons()));
+    if (densityLevelOfDetail_) {
+        buildDensityPyramid(volumeCL, volumeStruct);
+        kernel->setArg(tracerArg++, *densityPyramid_);
+        kernel->setArg(tracerArg++, *densityPyramidLevels_.getRepresentation<BufferCL>());
+        kernel->setArg(tracerArg++, getMaxDensityLevel(photonData));
+    }
+    std::vector<cl::Event> clearDepositEvent;
+    if (splatPhotons) {
+        // Resolution follows the shrinking photon radius in steps, see PhotonToLightVolumeProcessorCL
+        auto dim = PhotonData::lightVolumeDimensions(photonData->getRadiusRelativeToSceneSize(), photonData->getDepositedIrradianceDimensions(), depositResolutionUpgradeFactor_);
+        photonData->setDepositedIrradianceDimensions(dim);
+        auto depositedIrradianceCL = photonData->depositedIrradiance_.getEditableRepresentation<BufferCL>();
+        clearDepositEvent.resize(1);
+        OpenCL::getPtr()->getQueue().enqueueFillBuffer<float>(depositedIrradianceCL->getEditable(), 0.f, 0, photonData->depositedIrradiance_.getSizeInBytes(), waitForEvents, &clearDepositEvent[0]);
+        waitForEvents = &clearDepositEvent;
+        double nPhotons = static_cast<double>(photonData->getNumberOfPhotons());
+        double photonVolume = PhotonData::sphereVolume(photonData->getRadiusRelativeToSceneSize());
+        kernel->setArg(tracerArg++, *depositedIrradianceCL);
+        kernel->setArg(tracerArg++, ivec4(ivec3(dim), 0));
+        kernel->setArg(tracerArg++, static_cast<float>(photonData->getRadiusRelativeToSceneSize()));
+        // isotropicPhaseFunction() times relativeIrradianceScale of the splatting kernels
+        kernel->setArg(tracerArg++, static_cast<float>(0.25 * glm::one_over_pi<double>() * PhotonData::scaleToMakeLightPowerOfOneVisibleForDirectionalLightSource / (photonVolume*nPhotons)));
+    }
     auto globalWorkSize = getGlobalWorkGroupSize(nLightSamples, workGroupSize_.x*workGroupSize_.y);
     if (photonsToRecomputeIndicesCL) {
         globalWorkSize = getGlobalWorkGroupSize(nInvalidPhotons, workGroupSize_.x*workGroupSize_.y);
@@ -173,6 +314,248 @@ void PhotonTracerCL::tracePhotons(PhotonData* photonData, const VolumeCLBase* vo
                                                       workGroupSize_.x*workGroupSize_.y, waitForEvents, event);
 }
 
+void PhotonTracerCL::tracePhotonsWavefront(PhotonData* photonData, const VolumeCLBase* volumeCL, const Buffer<glm::u8>& volumeStruct, const BufferCL* axisAlignedBoundingBoxCL, const LayerCLBase* transferFunctionCL, const AdvancedMaterialProperty& material, float stepSize, const BufferCLBase* lightSamplesCL, const BufferCLBase* intersectionPointsCL, size_t nLightSamples, const BufferCLBase* photonsToRecomputeIndicesCL, int nPhotonsToRecompute, BufferCLBase* photonsCL, int photonOffset, int batch, int maxInteractions, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event /*= nullptr*/) {
+    cl::Kernel* generateKernel = photonsToRecomputeIndicesCL ? wavefrontRecomputeGenerateKernel_ : wavefrontGenerateKernel_;
+    if (!generateKernel || !wavefrontTrackKernel_ || !wavefrontScatterKernel_ || !compactPathQueueKernel_) {
+        return;
+    }
+    int nPaths = photonsToRecomputeIndicesCL ? nPhotonsToRecompute : static_cast<int>(nLightSamples);
+    if (nPaths <= 0) {
+        return;
+    }
+    try {
+        if (wavefrontCapacity_ < static_cast<size_t>(nPaths)) {
+            const auto& context = OpenCL::getPtr()->getContext();
+            // One extra flag so that the scan gives the number of active paths
+            size_t queueSizeInBytes = (nPaths + 1) * sizeof(cl_uint);
+            size_t pathStateSize = counterBasedRandom_ ? sizeof(WavefrontPathState<PhiloxRandomState>) : sizeof(WavefrontPathState<MWC64XRandomState>);
+            wavefrontPaths_ = cl::Buffer(context, CL_MEM_READ_WRITE, nPaths * pathStateSize);
+            for (auto& pathQueue : wavefrontPathQueues_) {
+                pathQueue = cl::Buffer(context, CL_MEM_READ_WRITE, queueSizeInBytes);
+            }
+            wavefrontActiveFlags_ = cl::Buffer(context, CL_MEM_READ_WRITE, queueSizeInBytes);
+            wavefrontScannedFlags_ = cl::Buffer(context, CL_MEM_READ_WRITE, queueSizeInBytes);
+            wavefrontCapacity_ = nPaths;
+        }
+        if (!wavefrontScan_) {
+            auto problem = clogs::ScanProblem();
+            problem.setType(clogs::TYPE_UINT);
+            wavefrontScan_ = std::unique_ptr<clogs::Scan>(new clogs::Scan(OpenCL::getPtr()->getContext(), OpenCL::getPtr()->getDevice(), problem));
+        }
+        BufferCL* randomStateCL = counterBasedRandom_ ? nullptr : randomState_.getEditableRepresentation<BufferCL>();
+        if (densityLevelOfDetail_) {
+            buildDensityPyramid(volumeCL, volumeStruct);
+        }
+        auto totalPhotons = static_cast<int>(photonData->getNumberOfPhotons());
+        
+        cl_uint arg = 0;
+        if (photonsToRecomputeIndicesCL) {
+            generateKernel->setArg(arg++, *photonsToRecomputeIndicesCL);
+            generateKernel->setArg(arg++, nPhotonsToRecompute);
+        }
+        generateKernel->setArg(arg++, *volumeCL);
+        generateKernel->setArg(arg++, volumeStruct);
+        setBrickedVolumeArgs(generateKernel, arg);
+        generateKernel->setArg(arg++, *axisAlignedBoundingBoxCL);
+        generateKernel->setArg(arg++, *transferFunctionCL);
+        generateKernel->setArg(arg++, material.getCombinedMaterialParameters());
+        if (randomStateCL) {
+            generateKernel->setArg(arg++, *randomStateCL);
+        }
+        generateKernel->setArg(arg++, stepSize);
+        generateKernel->setArg(arg++, *photonsCL);
+        generateKernel->setArg(arg++, photonData->iteration());
+        generateKernel->setArg(arg++, photonOffset);
+        generateKernel->setArg(arg++, batch);
+        generateKernel->setArg(arg++, *lightSamplesCL);
+        generateKernel->setArg(arg++, *intersectionPointsCL);
+        generateKernel->setArg(arg++, static_cast<int>(nLightSamples));
+        generateKernel->setArg(arg++, maxInteractions);
+        generateKernel->setArg(arg++, material.getPhaseFunctionEnum());
+        generateKernel->setArg(arg++, totalPhotons);
+        generateKernel->setArg(arg++, wavefrontPaths_);
+        generateKernel->setArg(arg++, wavefrontPathQueues_[0]);
+        generateKernel->setArg(arg++, wavefrontActiveFlags_);
+
+        // Queue and number of active paths (argument 0 and 1) are set for each stage
+        arg = 2;
+        wavefrontTrackKernel_->setArg(arg++, wavefrontPaths_);
+        wavefrontTrackKernel_->setArg(arg++, *volumeCL);
+        wavefrontTrackKernel_->setArg(arg++, volumeStruct);
+        setBrickedVolumeArgs(wavefrontTrackKernel_, arg);
+        wavefrontTrackKernel_->setArg(arg++, *transferFunctionCL);
+        if (randomStateCL) {
+            wavefrontTrackKernel_->setArg(arg++, *randomStateCL);
+        }
+        wavefrontTrackKernel_->setArg(arg++, *photonsCL);
+        wavefrontTrackKernel_->setArg(arg++, photonOffset);
+        wavefrontTrackKernel_->setArg(arg++, maxInteractions);
+        wavefrontTrackKernel_->setArg(arg++, totalPhotons);
+        if (densityLevelOfDetail_) {
+            wavefrontTrackKernel_->setArg(arg++, *densityPyramid_);
+            wavefrontTrackKernel_->setArg(arg++, *densityPyramidLevels_.getRepresentation<BufferCL>());
+            wavefrontTrackKernel_->setArg(arg++, getMaxDensityLevel(photonData));
+        }
+        wavefrontTrackKernel_->setArg(arg++, wavefrontActiveFlags_);
+
+        arg = 2;
+        wavefrontScatterKernel_->setArg(arg++, wavefrontPaths_);
+        wavefrontScatterKernel_->setArg(arg++, *volumeCL);
+        wavefrontScatterKernel_->setArg(arg++, volumeStruct);
+        setBrickedVolumeArgs(wavefrontScatterKernel_, arg);
+        wavefrontScatterKernel_->setArg(arg++, *axisAlignedBoundingBoxCL);
+        wavefrontScatterKernel_->setArg(arg++, *transferFunctionCL);
+        wavefrontScatterKernel_->setArg(arg++, material.getCombinedMaterialParameters());
+        if (randomStateCL) {
+            wavefrontScatterKernel_->setArg(arg++, *randomStateCL);
+        }
+        wavefrontScatterKernel_->setArg(arg++, stepSize);
+        wavefrontScatterKernel_->setArg(arg++, *photonsCL);
+        wavefrontScatterKernel_->setArg(arg++, photonOffset);
+        wavefrontScatterKernel_->setArg(arg++, maxInteractions);
+        wavefrontScatterKernel_->setArg(arg++, material.getPhaseFunctionEnum());
+        wavefrontScatterKernel_->setArg(arg++, totalPhotons);
+        if (densityLevelOfDetail_) {
+            wavefrontScatterKernel_->setArg(arg++, *densityPyramid_);
+            wavefrontScatterKernel_->setArg(arg++, *densityPyramidLevels_.getRepresentation<BufferCL>());
+            wavefrontScatterKernel_->setArg(arg++, getMaxDensityLevel(photonData));
+        }
+        wavefrontScatterKernel_->setArg(arg++, wavefrontActiveFlags_);
+
+        const auto& queue = OpenCL::getPtr()->getQueue();
+        auto localWorkSize = workGroupSize_.x*workGroupSize_.y;
+        // Stages also write the flag after the last path
+        auto stageWorkSize = [localWorkSize](int nActivePaths) { return getGlobalWorkGroupSize(nActivePaths + 1, localWorkSize); };
+        cl::Event stageEvent;
+        queue.enqueueNDRangeKernel(*generateKernel, cl::NullRange, stageWorkSize(nPaths), localWorkSize, waitForEvents, &stageEvent);
+        int pathQueue = 0;
+        int nActivePaths = compactPathQueue(pathQueue, nPaths);
+        pathQueue = 1 - pathQueue;
+        // Each path is tracked and scattered at most maxInteractions times
+        std::array<cl::Kernel*, 2> stages{ wavefrontTrackKernel_, wavefrontScatterKernel_ };
+        for (size_t stage = 0; nActivePaths > 0; stage = (stage + 1) % stages.size()) {
+            stages[stage]->setArg(0, wavefrontPathQueues_[pathQueue]);
+            stages[stage]->setArg(1, nActivePaths);
+            queue.enqueueNDRangeKernel(*stages[stage], cl::NullRange, stageWorkSize(nActivePaths), localWorkSize, nullptr, &stageEvent);
+            nActivePaths = compactPathQueue(pathQueue, nActivePaths);
+            pathQueue = 1 - pathQueue;
+        }
+        // All photons have been written when the last stage has finished
+        if (event) {
+            *event = stageEvent;
+        }
+    } catch (cl::Error& err) {
+        LogError(getCLErrorString(err));
+    } catch (clogs::InternalError& e) {
+        LogError(e.what());
+    }
+}
+
+void PhotonTracerCL::setBrickedVolumeArgs(cl::Kernel* kernel, cl_uint& argIndex) const {
+    if (brickedVolume_) {
+        kernel->setArg(argIndex++, brickedVolume_->getBrickCache());
+        kernel->setArg(argIndex++, *brickedVolume_->getPageTable());
+        kernel->setArg(argIndex++, *brickedVolume_->getParameters());
+    }
+}
+
+int PhotonTracerCL::compactPathQueue(int pathQueue, int nPaths) {
+    const auto& queue = OpenCL::getPtr()->getQueue();
+    wavefrontScan_->enqueue(queue, wavefrontActiveFlags_, wavefrontScannedFlags_, nPaths + 1);
+    cl_uint nActivePaths = 0;
+    queue.enqueueReadBuffer(wavefrontScannedFlags_, true, nPaths * sizeof(cl_uint), sizeof(cl_uint), &nActivePaths);
+    if (nActivePaths > 0) {
+        int arg = 0;
+        compactPathQueueKernel_->setArg(arg++, wavefrontPathQueues_[pathQueue]);
+        compactPathQueueKernel_->setArg(arg++, wavefrontActiveFlags_);
+        compactPathQueueKernel_->setArg(arg++, wavefrontScannedFlags_);
+        compactPathQueueKernel_->setArg(arg++, nPaths);
+        compactPathQueueKernel_->setArg(arg++, wavefrontPathQueues_[1 - pathQueue]);
+        auto localWorkSize = workGroupSize_.x*workGroupSize_.y;
+        queue.enqueueNDRangeKernel(*compactPathQueueKernel_, cl::NullRange, getGlobalWorkGroupSize(nPaths, localWorkSize), localWorkSize);
+    }
+    return static_cast<int>(nActivePaths);
+}
+
+void PhotonTracerCL::buildDensityPyramid(const VolumeCLBase* volumeCL, const Buffer<glm::u8>& volumeStruct) {
+    const cl::Image3D& volumeImage = volumeCL->get();
+    size3_t volumeDim(volumeImage.getImageInfo<CL_IMAGE_WIDTH>(), volumeImage.getImageInfo<CL_IMAGE_HEIGHT>(), volumeImage.getImageInfo<CL_IMAGE_DEPTH>());
+    if (densityPyramid_ && densityPyramidVolumeDim_ == volumeDim) {
+        return;
+    }
+    // Level 0 is the volume itself, halve dimensions until all of them are one
+    std::vector<ivec4> levels(1, ivec4(volumeDim, 0));
+    int atlasWidth = 0;
+    while (glm::any(glm::greaterThan(ivec3(levels.back()), ivec3(1)))) {
+        ivec3 levelDim = glm::max((ivec3(levels.back()) + 1) / 2, ivec3(1));
+        levels.emplace_back(levelDim, atlasWidth);
+        atlasWidth += levelDim.x;
+    }
+    if (levels.size() < 2) {
+        // Single voxel volume, keep a one-voxel level so that the kernel arguments are valid
+        levels.emplace_back(1, 1, 1, 0);
+        atlasWidth = 1;
+    }
+    ivec4 atlasDim(atlasWidth, levels[1].y, levels[1].z, 0);
+    densityPyramidLevels_.setSize(levels.size());
+    auto levelsData = static_cast<ivec4*>(densityPyramidLevels_.getEditableRAMRepresentation()->getData());
+    std::copy(levels.begin(), levels.end(), levelsData);
+    try {
+        size_t atlasSizeInBytes = atlasDim.x*atlasDim.y*atlasDim.z*sizeof(float);
+        cl::Buffer atlasBuffer(OpenCL::getPtr()->getContext(), CL_MEM_READ_WRITE, atlasSizeInBytes);
+        size3_t localWorkGroupSize(4, 4, 4);
+        auto globalWorkGroupSize = [&localWorkGroupSize](const ivec4& levelDim) {
+            return cl::NDRange(getGlobalWorkGroupSize(levelDim.x, localWorkGroupSize.x),
+                               getGlobalWorkGroupSize(levelDim.y, localWorkGroupSize.y),
+                               getGlobalWorkGroupSize(levelDim.z, localWorkGroupSize.z));
+        };
+        int argIndex = 0;
+        densityPyramidBaseLevelKernel_->setArg(argIndex++, *volumeCL);
+        densityPyramidBaseLevelKernel_->setArg(argIndex++, volumeStruct);
+        densityPyramidBaseLevelKernel_->setArg(argIndex++, levels[1]);
+        densityPyramidBaseLevelKernel_->setArg(argIndex++, atlasDim);
+        densityPyramidBaseLevelKernel_->setArg(argIndex++, atlasBuffer);
+        OpenCL::getPtr()->getQueue().enqueueNDRangeKernel(*densityPyramidBaseLevelKernel_, cl::NullRange, globalWorkGroupSize(levels[1]), localWorkGroupSize);
+        densityPyramidLevelKernel_->setArg(2, atlasDim);
+        densityPyramidLevelKernel_->setArg(3, atlasBuffer);
+        for (size_t level = 2; level < levels.size(); ++level) {
+            densityPyramidLevelKernel_->setArg(0, levels[level - 1]);
+            densityPyramidLevelKernel_->setArg(1, levels[level]);
+            OpenCL::getPtr()->getQueue().enqueueNDRangeKernel(*densityPyramidLevelKernel_, cl::NullRange, globalWorkGroupSize(levels[level]), localWorkGroupSize);
+        }
+        densityPyramid_ = std::make_unique<cl::Image3D>(OpenCL::getPtr()->getContext(), CL_MEM_READ_ONLY, cl::ImageFormat(CL_R, CL_FLOAT), atlasDim.x, atlasDim.y, atlasDim.z);
+        cl::size_t<3> origin;
+        cl::size_t<3> region;
+        region[0] = atlasDim.x; region[1] = atlasDim.y; region[2] = atlasDim.z;
+        OpenCL::getPtr()->getQueue().enqueueCopyBufferToImage(atlasBuffer, *densityPyramid_, 0, origin, region);
+        densityPyramidVolumeDim_ = volumeDim;
+    } catch (cl::Error& err) {
+        densityPyramid_.reset();
+        LogError(getCLErrorString(err));
+    }
+}
+
+int PhotonTracerCL::getMaxDensityLevel(const PhotonData* photonData) const {
+    // The radius relative to scene size is given in texture space, 
+    // see ProgressivePhotonTracerCL::process
+    double radiusInVoxels = photonData->getRadiusRelativeToSceneSize() / glm::length(dvec3(1.0) / dvec3(densityPyramidVolumeDim_));
+    if (radiusInVoxels < 2.0) {
+        return 0;
+    }
+    int maxLevel = static_cast<int>(densityPyramidLevels_.getSize()) - 1;
+    return std::min(static_cast<int>(std::floor(std::log2(radiusInVoxels))), maxLevel);
+}
+
+void PhotonTracerCL::setDensityLevelOfDetail(bool enable) {
+    if (enable != densityLevelOfDetail_) {
+        densityLevelOfDetail_ = enable;
+        if (!enable) {
+            densityPyramid_.reset();
+        }
+        compileKernels();
+    }
+}
+
 void PhotonTracerCL::setRandomSeedSize(size_t nPhotons) {
     if (nPhotons > 0) {
         randomState_.setSize(nPhotons);
@@ -181,6 +564,49 @@ void PhotonTracerCL::setRandomSeedSize(size_t nPhotons) {
     }
 }
 
+void PhotonTracerCL::setFusedSplatting(bool enable) {
+    if (enable != fusedSplatting_) {
+        fusedSplatting_ = enable;
+        compileKernels();
+    }
+}
+
+void PhotonTracerCL::setCounterBasedRandom(bool enable) {
+    if (enable != counterBasedRandom_) {
+        counterBasedRandom_ = enable;
+        // Size of the wavefront path state depends on the random generator
+        wavefrontCapacity_ = 0;
+        if (enable) {
+            // State is not needed anymore
+            randomState_.setSize(0);
+        }
+        compileKernels();
+    }
+}
+
+void PhotonTracerCL::setWavefront(bool enable) {
+    if (enable != wavefront_) {
+        wavefront_ = enable;
+        if (!enable) {
+            wavefrontCapacity_ = 0;
+            wavefrontPaths_ = cl::Buffer();
+            wavefrontPathQueues_[0] = cl::Buffer();
+            wavefrontPathQueues_[1] = cl::Buffer();
+            wavefrontActiveFlags_ = cl::Buffer();
+            wavefrontScannedFlags_ = cl::Buffer();
+        }
+        compileKernels();
+    }
+}
+
+void PhotonTracerCL::setBrickedVolume(const BrickedVolumeCL* brickedVolume) {
+    bool recompile = (brickedVolume != nullptr) != (brickedVolume_ != nullptr);
+    brickedVolume_ = brickedVolume;
+    if (recompile) {
+        compileKernels();
+    }
+}
+
 void PhotonTracerCL::setNoSingleScattering(bool onlyMultipleScattering) {
     onlyMultipleScattering_ = onlyMultipleScattering;
     compileKernels();
@@ -198,15 +624,46 @@ void PhotonTracerCL::setProgressive(bool val) {
 void PhotonTracerCL::compileKernels() {
     removeKernel(photonTracerKernel_);
     removeKernel(recomputePhotonTracerKernel_);
+    removeKernel(fusedPhotonTracerKernel_);
+    fusedPhotonTracerKernel_ = nullptr;
+    removeKernel(wavefrontGenerateKernel_);
+    removeKernel(wavefrontRecomputeGenerateKernel_);
+    removeKernel(wavefrontTrackKernel_);
+    removeKernel(wavefrontScatterKernel_);
+    removeKernel(compactPathQueueKernel_);
+    wavefrontGenerateKernel_ = nullptr;
+    wavefrontRecomputeGenerateKernel_ = nullptr;
+    wavefrontTrackKernel_ = nullptr;
+    wavefrontScatterKernel_ = nullptr;
+    compactPathQueueKernel_ = nullptr;
     std::string defines = "";
     if (onlyMultipleScattering_) {
-        defines = " -D NO_SINGLE_SCATTERING";
+        defines += " -D NO_SINGLE_SCATTERING";
     }
     if (isProgressive()) {
-        defines = " -D PROGRESSIVE_PHOTON_MAPPING";
+        defines += " -D PROGRESSIVE_PHOTON_MAPPING";
+    }
+    if (densityLevelOfDetail_) {
+        defines += " -D DENSITY_LOD";
+    }
+    if (counterBasedRandom_) {
+        defines += " -D RANDOM_PHILOX";
+    }
+    if (brickedVolume_) {
+        defines += " -D BRICKED_VOLUME";
     }
     photonTracerKernel_ = addKernel("photontracer.cl", "photonTracerKernel", "", defines);
     recomputePhotonTracerKernel_ = addKernel("photontracer.cl", "photonTracerKernel", "", defines + " -D PHOTON_RECOMPUTATION");
+    if (fusedSplatting_) {
+        fusedPhotonTracerKernel_ = addKernel("photontracer.cl", "photonTracerKernel", "", defines + " -D SPLAT_PHOTONS");
+    }
+    if (wavefront_) {
+        wavefrontGenerateKernel_ = addKernel("photontracerwavefront.cl", "wavefrontGeneratePathsKernel", "", defines);
+        wavefrontRecomputeGenerateKernel_ = addKernel("photontracerwavefront.cl", "wavefrontGeneratePathsKernel", "", defines + " -D PHOTON_RECOMPUTATION");
+        wavefrontTrackKernel_ = addKernel("photontracerwavefront.cl", "wavefrontTrackPathsKernel", "", defines);
+        wavefrontScatterKernel_ = addKernel("photontracerwavefront.cl", "wavefrontScatterPathsKernel", "", defines);
+        compactPathQueueKernel_ = addKernel("photontracerwavefront.cl", "compactPathQueueKernel", "", defines);
+    }
 }
 
 } // namespace
@@ -47,6 +47,9 @@
 #include <modules/opencl/light/packedlightsource.h>
 #include <modules/opencl/volume/volumeclbase.h>
 #include <modules/progressivephotonmapping/photondata.h>
+#include <modules/uniformgridcl/brickedvolumecl.h>
+
+#include <clogs/clogs.h>
 
 
 namespace inviwo {
@@ -74,6 +77,13 @@ public:
 
     void tracePhotons(const Volume* volume, const TransferFunction& transferFunction, const BufferCL* axisAlignedBoundingBoxCL, const AdvancedMaterialProperty& material, const Camera* camera, float stepSize, const LightSamples* lightSamples, const Buffer<unsigned int>* photonsToRecomputeIndices, int nInvalidPhotons, int photonOffset, int batch, int maxInteractions, PhotonData* photonOutData, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event = nullptr);
 
+    /**
+     * \brief Trace photons of all light sources in a single dispatch.
+     * Photons of light source i start at the sum of the sizes of light sources 0 to i-1.
+     * @see packLightSamples
+     */
+    void tracePhotons(const Volume* volume, const TransferFunction& transferFunction, const BufferCL* axisAlignedBoundingBoxCL, const AdvancedMaterialProperty& material, const Camera* camera, float stepSize, const std::vector<const LightSamples*>& lightSamples, const Buffer<unsigned int>* photonsToRecomputeIndices, int nInvalidPhotons, int batch, int maxInteractions, PhotonData* photonOutData, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event = nullptr);
+
     void tracePhotons(PhotonData* photonData, const VolumeCLBase* volumeCL, const Buffer<glm::u8>& volumeStruct, const BufferCL* axisAlignedBoundingBoxCL, const LayerCLBase* transferFunctionCL, const AdvancedMaterialProperty& material, float stepSize, const BufferCLBase* lightSamplesCL, const BufferCLBase* intersectionPointsCL, size_t nLightSamples, const BufferCLBase* photonsToRecomputeIndicesCL, int nPhotonsToRecompute, BufferCLBase* photonsCL, int photonOffset, int batch, int maxInteractions, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event = nullptr);
 
     size2_t workGroupSize() const { return workGroupSize_; }
@@ -83,24 +93,115 @@ public:
 
     void setNoSingleScattering(bool onlyMultipleScattering);
 
+    /**
+     * \brief Copy light samples and intersection points of all light sources into one contiguous buffer on the device.
+     * @return lightSamples[0] if there is only one light source, otherwise the packed light samples owned by this object.
+     */
+    const LightSamples* packLightSamples(const std::vector<const LightSamples*>& lightSamples);
+
     
 
     bool isValid() const { return photonTracerKernel_ != nullptr; }
     bool isProgressive() const { return progressive_; }
     void setProgressive(bool val);
+
+    /**
+     * \brief Sample a density mip pyramid of the volume instead of the volume itself for scattered photons. 
+     * Scattering event n uses pyramid level min(n, log2(photon radius in voxels)).
+     * The pyramid is built on demand and must be invalidated when the volume data changes.
+     */
+    void setDensityLevelOfDetail(bool enable);
+    bool useDensityLevelOfDetail() const { return densityLevelOfDetail_; }
+    void invalidateDensityPyramid() { densityPyramid_.reset(); }
+
+    /**
+     * \brief Use stateless counter-based random numbers (Philox) keyed by photon, iteration and batch
+     * instead of MWC64X. Removes the per-photon random state buffer and its loads and stores.
+     */
+    void setCounterBasedRandom(bool enable);
+    bool useCounterBasedRandom() const { return counterBasedRandom_; }
+
+    /**
+     * \brief Trace photons in stages (generate, track, scatter) instead of one path per work-item until termination.
+     * Active paths are compacted between stages so that work-items of a SIMD group all perform work,
+     * independently of how many times other paths scatter. 
+     * Blocks after each stage to read back the number of active paths.
+     * See photontracerwavefront.cl
+     */
+    void setWavefront(bool enable);
+    bool useWavefront() const { return wavefront_; }
+
+    /**
+     * \brief Sample density from a paged volume, for volumes that do not fit on the device.
+     * The volume passed to tracePhotons must then be the overview of brickedVolume, 
+     * which is used for gradients and where bricks are not resident.
+     * Recompiles kernels when switching between bricked and regular volumes, nullptr disables.
+     */
+    void setBrickedVolume(const BrickedVolumeCL* brickedVolume);
+    const BrickedVolumeCL* getBrickedVolume() const { return brickedVolume_; }
+
+    /**
+     * \brief Splat photons into PhotonData::depositedIrradiance_ while tracing instead of storing them in PhotonData::photons_.
+     * Saves writing and reading back the photon buffer when all photons are traced each iteration.
+     * Only applies when tracing all photons without wavefront tracing, photons_ is written otherwise.
+     */
+    void setFusedSplatting(bool enable);
+    bool useFusedSplatting() const { return fusedSplatting_; }
+    /**
+     * \brief Steps in which the resolution of the deposited irradiance follows the shrinking photon radius, 
+     * see PhotonData::lightVolumeDimensions.
+     */
+    void setDepositResolutionUpgradeFactor(double factor) { depositResolutionUpgradeFactor_ = factor; }
+    double getDepositResolutionUpgradeFactor() const { return depositResolutionUpgradeFactor_; }
 private:
+    // Brick cache, page table and parameters following the volume parameters, see BRICKED_VOLUME_KERNEL_ARGS
+    void setBrickedVolumeArgs(cl::Kernel* kernel, cl_uint& argIndex) const;
+    void tracePhotonsWavefront(PhotonData* photonData, const VolumeCLBase* volumeCL, const Buffer<glm::u8>& volumeStruct, const BufferCL* axisAlignedBoundingBoxCL, const LayerCLBase* transferFunctionCL, const AdvancedMaterialProperty& material, float stepSize, const BufferCLBase* lightSamplesCL, const BufferCLBase* intersectionPointsCL, size_t nLightSamples, const BufferCLBase* photonsToRecomputeIndicesCL, int nPhotonsToRecompute, BufferCLBase* photonsCL, int photonOffset, int batch, int maxInteractions, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event = nullptr);
+    // Compact pathQueue into the other queue using activeFlags, returns number of active paths
+    int compactPathQueue(int pathQueue, int nPaths);
     
     void setRandomSeedSize(size_t nPhotons);
     void compileKernels();
+    // Average 2x2x2 voxels into each level, levels are stored next to each other along x in densityPyramid_
+    void buildDensityPyramid(const VolumeCLBase* volumeCL, const Buffer<glm::u8>& volumeStruct);
+    // Coarsest pyramid level with voxels smaller than the photon radius
+    int getMaxDensityLevel(const PhotonData* photonData) const;
     size2_t workGroupSize_;
     bool useGLSharing_;
     bool progressive_ = true; // should use new random values each time called
     bool onlyMultipleScattering_ = false;
-
-    Buffer<glm::uvec2> randomState_;
-
-    cl::Kernel* photonTracerKernel_;
-    cl::Kernel* recomputePhotonTracerKernel_;
+    bool densityLevelOfDetail_ = false;
+    bool counterBasedRandom_ = false;
+    bool wavefront_ = false;
+    bool fusedSplatting_ = false;
+    double depositResolutionUpgradeFactor_ = 2.0;
+    const BrickedVolumeCL* brickedVolume_ = nullptr;
+
+    Buffer<glm::uvec2> randomState_; // Not used if counterBasedRandom_
+    LightSamples packedLightSamples_; // Light samples of all light sources, see packLightSamples
+
+    std::unique_ptr<cl::Image3D> densityPyramid_; // nullptr if not built
+    Buffer<glm::ivec4> densityPyramidLevels_; // Dimensions and x-offset into densityPyramid_ for each level
+    size3_t densityPyramidVolumeDim_;
+
+    cl::Kernel* photonTracerKernel_ = nullptr;
+    cl::Kernel* recomputePhotonTracerKernel_ = nullptr;
+    cl::Kernel* fusedPhotonTracerKernel_ = nullptr; // Splats photons while tracing, see setFusedSplatting
+    cl::Kernel* densityPyramidBaseLevelKernel_ = nullptr;
+    cl::Kernel* densityPyramidLevelKernel_ = nullptr;
+
+    // Wavefront tracing, see setWavefront
+    std::unique_ptr<clogs::Scan> wavefrontScan_;
+    size_t wavefrontCapacity_ = 0; // Number of paths that buffers below can hold
+    cl::Buffer wavefrontPaths_;
+    cl::Buffer wavefrontPathQueues_[2];
+    cl::Buffer wavefrontActiveFlags_; // One flag per queue entry plus one
+    cl::Buffer wavefrontScannedFlags_;
+    cl::Kernel* wavefrontGenerateKernel_ = nullptr;
+    cl::Kernel* wavefrontRecomputeGenerateKernel_ = nullptr;
+    cl::Kernel* wavefrontTrackKernel_ = nullptr;
+    cl::Kernel* wavefrontScatterKernel_ = nullptr;
+    cl::Kernel* compactPathQueueKernel_ = nullptr;
 };
 
 } // namespace
@@ -31,6 +31,8 @@
  *********************************************************************************/
 
 #include "photontolightvolumeprocessorcl.h"
+#include <modules/progressivephotonmapping/progressivephotonmappingmodule.h>
+#include <inviwo/core/common/inviwoapplication.h>
 #include <modules/opencl/syncclgl.h>
 #include <modules/opencl/buffer/buffercl.h>
 #include <modules/opencl/buffer/bufferclgl.h>
@@ -61,31 +63,43 @@ PhotonToLightVolumeProcessorCL::PhotonToLightVolumeProcessorCL()
 , outport_("lightvolume")
 , incrementalRecomputationThreshold_("incrementalRecomputationThreshold", "Max % invalid photons to use add-remove", 50.f, 0.f, 100.f, 10.f)
 , volumeSizeOption_("volumeSizeOption", "Light Volume Size")
+, resolutionUpgradeFactor_("resolutionUpgradeFactor", "Resolution upgrade factor", 2.f, 1.f, 4.f)
 , volumeDataTypeOption_("volumeDataType", "Output data type")
 , information_("Information", "Light volume information")
 //, camera_("camera", "Camera", vec3(0.0f, 0.0f, -2.0f), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f), nullptr, InvalidationLevel::Valid)
 , alignChangedPhotons_("alignChangedPhotons", "Mem-align changed photons", false)
+, compactPhotons_("compactPhotons", "Compact photons", false)
+, adaptiveRadius_("adaptiveRadius", "Adaptive photon radius", false)
+, maxRadiusScale_("maxRadiusScale", "Max adaptive radius scale", 4.f, 1.f, 16.f)
+, hostSplatting_("hostSplatting", "Splat on host threads (CPU device)", true)
 , workGroupSize_("wgsize", "Work group size", 128, 1, 2048)
 , useGLSharing_("glsharing", "Use OpenGL sharing", true)
 , kernelOwner_(this)
 , kernel_(nullptr)
 , splatSelectedPhotonsKernel_(nullptr)
 , clearFloatsKernel_(nullptr)
+, packLightVolumeKernel_(nullptr)
+, photonDensityGridKernel_(nullptr)
+, copyDepositedIrradianceKernel_(nullptr)
+, resampleAccumulationKernel_(nullptr)
 , lightVolume_(std::make_shared<Volume>(size3_t(1), DataFloat32::get()))
+, bufferPool_(InviwoApplication::getPtr()->getModuleByType<ProgressivePhotonMappingModule>()->getDeviceBufferPool())
+, photonCompactor_(bufferPool_)
 {
     addPort(volumeInport_);
     addPort(photons_);
     recomputedPhotonIndicesPort_.setOptional(true);
     recomputedPhotonIndicesPort_.onDisconnect([this]() {
-        prevPhotons_.setSize(0);
+        prevPhotons_.release();
         changedAlignedPhotons_.setSize(0);
     });
     addPort(recomputedPhotonIndicesPort_);
     addPort(outport_);
     
     outport_.onDisconnect([this]() {
-        prevPhotons_.setSize(0);
+        prevPhotons_.release();
         changedAlignedPhotons_.setSize(0);
+        photonCompactor_.release();
     });
     
     volumeInport_.onChange([this]() { volumeSizeOptionChanged(); });
@@ -99,16 +113,19 @@ PhotonToLightVolumeProcessorCL::PhotonToLightVolumeProcessorCL()
     //volumeSizeOption_.addOption("0", "Custom", 0);
     volumeSizeOption_.setSelectedIndex(0);
     volumeSizeOption_.setCurrentStateAsDefault();
-    volumeSizeOption_.onChange([this]() { volumeSizeOptionChanged(); });
+    volumeSizeOption_.onChange([this]() { 
+        resolutionUpgradeFactor_.setVisible(volumeSizeOption_.get() == 0);
+        volumeSizeOptionChanged(); 
+    });
     
-    //volumeDataTypeOption_.addOption("float16", "float16");
+    volumeDataTypeOption_.addOption("float16", "float16");
     volumeDataTypeOption_.addOption("float32", "float32");
-    //volumeDataTypeOption_.addOption("4xfloat16", "4 x float16");
+    volumeDataTypeOption_.addOption("4xfloat16", "4 x float16");
     volumeDataTypeOption_.addOption("4xfloat32", "4 x float32");
-    volumeDataTypeOption_.setSelectedIndex(0);
+    volumeDataTypeOption_.setSelectedIndex(1);
     volumeDataTypeOption_.setCurrentStateAsDefault();
     volumeDataTypeOption_.onChange([this]() {
-        
+        auto prevLightVolume = lightVolume_;
         if (volumeDataTypeOption_.getSelectedValue() == "float16") {
             lightVolume_ = std::make_shared<Volume>(lightVolume_->getDimensions(), DataFloat16::get());
         } else if (volumeDataTypeOption_.getSelectedValue() == "float32") {
@@ -118,13 +135,41 @@ PhotonToLightVolumeProcessorCL::PhotonToLightVolumeProcessorCL()
         } else {
             lightVolume_ = std::make_shared<Volume>(lightVolume_->getDimensions(), DataVec4Float32::get());
         }
+        lightVolume_->setModelMatrix(prevLightVolume->getModelMatrix());
+        lightVolume_->setWorldMatrix(prevLightVolume->getWorldMatrix());
         information_.updateForNewVolume(*lightVolume_, util::OverwriteState::No);
+        outport_.setData(lightVolume_);
+        // Accumulated photons in tmpVolume_ may have different number of channels
+        tmpVolume_.release();
+        packedVolume_.release();
+        prevPhotons_.release();
         buildKernel();
     });
     addProperty(volumeSizeOption_);
+    addProperty(resolutionUpgradeFactor_);
     addProperty(volumeDataTypeOption_);
     addProperty(information_);
     addProperty(alignChangedPhotons_);
+    compactPhotons_.onChange([this]() {
+        if (!compactPhotons_) {
+            photonCompactor_.release();
+        }
+    });
+    addProperty(compactPhotons_);
+    adaptiveRadius_.onChange([this]() {
+        maxRadiusScale_.setVisible(adaptiveRadius_);
+        if (!adaptiveRadius_) {
+            photonDensityGrid_.release();
+        }
+        // Contributions of previous photons were splatted with a different radius
+        prevPhotons_.release();
+        buildKernel();
+    });
+    addProperty(adaptiveRadius_);
+    maxRadiusScale_.setVisible(false);
+    maxRadiusScale_.onChange([this]() { prevPhotons_.release(); });
+    addProperty(maxRadiusScale_);
+    addProperty(hostSplatting_);
     addProperty(workGroupSize_);
     addProperty(useGLSharing_);
     
@@ -141,35 +186,46 @@ void PhotonToLightVolumeProcessorCL::process() {
     }
     auto photonData = photons_.getData();
     const Volume* volume = volumeInport_.getData().get();
-    if (volumeSizeOption_.get() == 0) {
-        // Determine size on photon radius
-        auto invPhotonRadius = 1.0 / photonData->getRadiusRelativeToSceneSize();
+    // The photon tracer determines the resolution when splatting while tracing
+    resolutionUpgradeFactor_.setReadOnly(photonData->hasDepositedIrradiance());
+    auto maxRecomputationPhotons = static_cast<int>(photonData->getNumberOfPhotons() * (incrementalRecomputationThreshold_ / incrementalRecomputationThreshold_.getMaxValue()));
+    bool resampledAccumulation = false;
+    if (volumeSizeOption_.get() == 0 || photonData->hasDepositedIrradiance()) {
+        // Determine size on photon radius, the photon tracer uses the same size when splatting while tracing.
+        // Resolution is increased in steps as the radius shrinks during progressive refinement.
         // Set dimensions depending on photon radius
         // Add one to each dimension to get rid of clamp functions in the photonTracerKernel
         //int maxDim = std::max(volumeDims.x, std::max(volumeDims.y, volumeDims.z));
         //photonMapSizeProp_.set(2+tgt::ivec3(static_cast<int>(static_cast<float>(maxDim)/radiusInVoxels)));
         
         //ivec3 hashTableDimensions(2 + ivec3(static_cast<int>(invPhotonRadius)));
-        auto lightVolumeDimensions(size3_t(static_cast<size_t>(std::ceil(invPhotonRadius))));
-        if (glm::any(glm::notEqual(lightVolume_->getDimensions(), lightVolumeDimensions))) {
+        const auto prevDim = lightVolume_->getDimensions();
+        auto lightVolumeDimensions(photonData->hasDepositedIrradiance() ? photonData->getDepositedIrradianceDimensions() : 
+                                   PhotonData::lightVolumeDimensions(photonData->getRadiusRelativeToSceneSize(), prevDim, resolutionUpgradeFactor_.get()));
+        if (glm::any(glm::notEqual(prevDim, lightVolumeDimensions))) {
             lightVolume_->setDimensions(lightVolumeDimensions);
             lightVolume_->setModelMatrix(volume->getModelMatrix());
             lightVolume_->setWorldMatrix(volume->getWorldMatrix());
             information_.updateForNewVolume(*lightVolume_, util::OverwriteState::No);
-            // Recompute all photons
-            prevPhotons_.setSize(0);
             changedAlignedPhotons_.setSize(0);
+            // The accumulation is cleared when all photons are recomputed so only resample it if it will be updated incrementally
+            bool incrementalUpdate = recomputedPhotonIndicesPort_.isReady() && prevPhotons_.getSize() > 0 && prevPhotons_.getSize() == photonData->photons_.getSizeInBytes()
+                && recomputedPhotonIndicesPort_.getData()->nRecomputedPhotons >= 0 && recomputedPhotonIndicesPort_.getData()->nRecomputedPhotons < maxRecomputationPhotons;
+            if (glm::all(glm::greaterThan(lightVolumeDimensions, prevDim)) && incrementalUpdate && !photonData->hasDepositedIrradiance()) {
+                // Continue incremental updates on the finer grid instead of recomputing all photons
+                resampledAccumulation = resampleAccumulation(prevDim, lightVolumeDimensions, static_cast<size_t>(workGroupSize_.get()));
+            } else {
+                // Recompute all photons
+                prevPhotons_.release();
+            }
         }
     }
     
     const size3_t outDim{ lightVolume_->getDimensions() };
-    size_t outDimFlattened = outDim.x * outDim.y * outDim.z;
-    if (tmpVolume_.getSize() != outDimFlattened*lightVolume_->getDataFormat()->getSize()) {
-        
-        tmpVolume_.setSize(outDimFlattened*lightVolume_->getDataFormat()->getSize());
+    if (tmpVolume_.getSize() != getAccumulationVolumeSizeInBytes(outDim)) {
+        bufferPool_->resize(tmpVolume_, getAccumulationVolumeSizeInBytes(outDim));
     }
     size_t localWorkGroupSize(workGroupSize_.get());
-    auto maxRecomputationPhotons = static_cast<int>(photonData->getNumberOfPhotons() * (incrementalRecomputationThreshold_ / incrementalRecomputationThreshold_.getMaxValue()));
     if (copyPrevPhotonsEvent_.size() > 0) {
         //IVW_CPU_PROFILING("Wait for copy prev photons (CPU)")
         // Wait for previous photons to be copied
@@ -180,6 +236,25 @@ void PhotonToLightVolumeProcessorCL::process() {
         copyPrevPhotonsEvent_.clear();
     }
 
+    if (photonData->hasDepositedIrradiance()) {
+        // Photons were splatted while tracing and are not stored, 
+        // previous photons can therefore not be used for incremental updates
+        prevPhotons_.release();
+        std::unique_ptr<SyncCLGL> glSync = nullptr;
+        VolumeCLBase* volumeOutCL = nullptr;
+        if (useGLSharing_.get()) {
+            glSync = std::make_unique<SyncCLGL>();
+            auto volumeOutCLGL = lightVolume_->getEditableRepresentation<VolumeCLGL>();
+            glSync->addToAquireGLObjectList(volumeOutCLGL);
+            glSync->aquireAllObjects();
+            volumeOutCL = volumeOutCLGL;
+        } else {
+            volumeOutCL = lightVolume_->getEditableRepresentation<VolumeCL>();
+        }
+        depositedIrradianceToLightVolume(*photonData, volumeOutCL, outDim, localWorkGroupSize);
+        return;
+    }
+
     std::vector<cl::Event> splatPhotonEvents;
     std::unique_ptr<SyncCLGL> glSync = nullptr;
     const BufferCLBase* photonsCL = nullptr;
@@ -193,11 +268,11 @@ void PhotonToLightVolumeProcessorCL::process() {
         photonsCL = photonData->photons_.getRepresentation<BufferCL>();
     }
 
-    if (recomputedPhotonIndicesPort_.isReady() && prevPhotons_.getSize() == photonData->photons_.getSize() && recomputedPhotonIndicesPort_.getData()->nRecomputedPhotons > 0 && recomputedPhotonIndicesPort_.getData()->nRecomputedPhotons < maxRecomputationPhotons) {
+    if (recomputedPhotonIndicesPort_.isReady() && prevPhotons_.getSize() == photonData->photons_.getSizeInBytes() && recomputedPhotonIndicesPort_.getData()->nRecomputedPhotons > 0 && recomputedPhotonIndicesPort_.getData()->nRecomputedPhotons < maxRecomputationPhotons) {
         auto recomputedPhotonIndices = recomputedPhotonIndicesPort_.getData();
         size_t globalWorkGroupSize(getGlobalWorkGroupSize(recomputedPhotonIndicesPort_.getData()->nRecomputedPhotons, localWorkGroupSize));
         auto volumeOutCL = lightVolume_->getEditableRepresentation<VolumeCLGL>();
-        auto prevPhotonsCL = prevPhotons_.getRepresentation<BufferCL>();
+        const auto& prevPhotonsCL = prevPhotons_.get();
         auto indicesCL = recomputedPhotonIndices->indicesToRecomputedPhotons.getRepresentation<BufferCLGL>();
         
         glSync->addToAquireGLObjectList(volumeOutCL);
@@ -220,7 +295,7 @@ void PhotonToLightVolumeProcessorCL::process() {
             cl::Event copySplatPhotonEvent;
             std::vector<cl::Event>* waitForEvents = nullptr;
             int argIndex = 0;
-            copyIndexPhotonsKernel_->setArg(argIndex++, *prevPhotonsCL);
+            copyIndexPhotonsKernel_->setArg(argIndex++, prevPhotonsCL);
             copyIndexPhotonsKernel_->setArg(argIndex++, *indicesCL);
             copyIndexPhotonsKernel_->setArg(argIndex++, static_cast<int>(recomputedPhotonIndices->nRecomputedPhotons));
             copyIndexPhotonsKernel_->setArg(argIndex++, -1.f);
@@ -240,7 +315,7 @@ void PhotonToLightVolumeProcessorCL::process() {
             
             
             size_t splatGlobalWorkGroupSize(getGlobalWorkGroupSize(2 * recomputedPhotonIndicesPort_.getData()->nRecomputedPhotons, localWorkGroupSize));
-            executeVolumeOperation(volume, volumeCL, volumeOutCL, alignedChangedPhotonsCL, lightVolume_.get(), outDim,
+            executeVolumeOperation(volume, volumeCL, volumeOutCL, alignedChangedPhotonsCL->get(), 2 * recomputedPhotonIndices->nRecomputedPhotons, lightVolume_.get(), outDim,
                                    splatGlobalWorkGroupSize, localWorkGroupSize, &copyAlingedPhotonEvents, &splatAlingedPhotonEvents, &copySplatPhotonEvent);
             
             splatPhotonEvents.emplace_back(copySplatPhotonEvent);
@@ -269,15 +344,12 @@ void PhotonToLightVolumeProcessorCL::process() {
                                  globalWorkGroupSize,
                                  localWorkGroupSize, nullptr, &removePhotonsEvents[0]);
             // Add new contribution
-            photonsToLightVolume(volumeOutCL, photonsCL, indicesCL, *photonData, *recomputedPhotonIndices, 1.f, lightVolume_.get(), outDim,
+            photonsToLightVolume(volumeOutCL, photonsCL->get(), indicesCL, *photonData, *recomputedPhotonIndices, 1.f, lightVolume_.get(), outDim,
                                  globalWorkGroupSize,
                                  localWorkGroupSize, &removePhotonsEvents, &addPhotonsEvents[0]);
             
             
-            auto tmpVolumeCL = tmpVolume_.getRepresentation<BufferCL>();
-            OpenCL::getPtr()->getQueue().enqueueCopyBufferToImage(
-                                                                  tmpVolumeCL->get(), volumeOutCL->getEditable(), 0, size3_t(0), size3_t(outDim),
-                                                                  &addPhotonsEvents, &copyEvent);
+            copyToLightVolume(volumeOutCL, outDim, localWorkGroupSize, &addPhotonsEvents, &copyEvent);
             splatPhotonEvents.emplace_back(copyEvent);
 #ifdef IVW_DETAILED_PROFILING
             try {
@@ -296,32 +368,38 @@ void PhotonToLightVolumeProcessorCL::process() {
             }
 #endif
         }
-    } else if (prevPhotons_.getSize() != photonData->photons_.getSize() || (recomputedPhotonIndicesPort_.getData()->nRecomputedPhotons < 0) || recomputedPhotonIndicesPort_.getData()->nRecomputedPhotons >= maxRecomputationPhotons) {
+    } else if (prevPhotons_.getSize() != photonData->photons_.getSizeInBytes() || (recomputedPhotonIndicesPort_.getData()->nRecomputedPhotons < 0) || recomputedPhotonIndicesPort_.getData()->nRecomputedPhotons >= maxRecomputationPhotons) {
         std::vector <cl::Event> clearEvent(1);
         std::vector<cl::Event> splatEvent(1);
         cl::Event copyEvent;
-
-        size_t globalWorkGroupSize(getGlobalWorkGroupSize(photonData->getNumberOfPhotons()*photonData->getMaxPhotonInteractions(), localWorkGroupSize));
+        // All interaction slots are splatted unless compacted
+        size_t nPhotons = photonData->getNumberOfPhotons()*photonData->getMaxPhotonInteractions();
         
-        BufferCL* tmpVolumeCL = tmpVolume_.getEditableRepresentation<BufferCL>();
-        OpenCL::getPtr()->getQueue().enqueueFillBuffer<float>(tmpVolumeCL->getEditable(), 0.f, 0, tmpVolume_.getSizeInBytes(), nullptr, &clearEvent.back());
+        OpenCL::getPtr()->getQueue().enqueueFillBuffer<float>(tmpVolume_.get(), 0.f, 0, tmpVolume_.getSize(), nullptr, &clearEvent.back());
         if (useGLSharing_.get()) {
             const VolumeCLGL* volumeCL = volume->getRepresentation<VolumeCLGL>();
             VolumeCLGL* volumeOutCL = lightVolume_->getEditableRepresentation<VolumeCLGL>();
             glSync->addToAquireGLObjectList(volumeCL);
             glSync->addToAquireGLObjectList(volumeOutCL);
             glSync->aquireAllObjects();
-                
-            executeVolumeOperation(volume, volumeCL, volumeOutCL, photonsCL, lightVolume_.get(), outDim,
-                                    globalWorkGroupSize,
+            const auto& splatPhotonsCL = photonsToSplat(*photonData, photonsCL->get(), nPhotons, clearEvent);
+            if (adaptiveRadius_) {
+                computePhotonDensityGrid(splatPhotonsCL, nPhotons, static_cast<float>(photonData->getRadiusRelativeToSceneSize()), localWorkGroupSize, clearEvent);
+            }
+            executeVolumeOperation(volume, volumeCL, volumeOutCL, splatPhotonsCL, nPhotons, lightVolume_.get(), outDim,
+                                    getGlobalWorkGroupSize(std::max(nPhotons, size_t(1)), localWorkGroupSize),
                                     localWorkGroupSize, &clearEvent, &splatEvent, &copyEvent);
             
         } else {
             const VolumeCL* volumeCL = volume->getRepresentation<VolumeCL>();
             VolumeCL* volumeOutCL = lightVolume_->getEditableRepresentation<VolumeCL>();
             const BufferCL* photonsCL = photonData->photons_.getRepresentation<BufferCL>();
-            executeVolumeOperation(volume, volumeCL, volumeOutCL, photonsCL, lightVolume_.get(), outDim,
-                                   globalWorkGroupSize,
+            const auto& splatPhotonsCL = photonsToSplat(*photonData, photonsCL->get(), nPhotons, clearEvent);
+            if (adaptiveRadius_) {
+                computePhotonDensityGrid(splatPhotonsCL, nPhotons, static_cast<float>(photonData->getRadiusRelativeToSceneSize()), localWorkGroupSize, clearEvent);
+            }
+            executeVolumeOperation(volume, volumeCL, volumeOutCL, splatPhotonsCL, nPhotons, lightVolume_.get(), outDim,
+                                   getGlobalWorkGroupSize(std::max(nPhotons, size_t(1)), localWorkGroupSize),
                                    localWorkGroupSize, &clearEvent, &splatEvent, &copyEvent);
         }
         splatPhotonEvents.emplace_back(copyEvent);
@@ -336,31 +414,48 @@ void PhotonToLightVolumeProcessorCL::process() {
             LogError(getCLErrorString(err));
         }
 #endif
+    } else if (resampledAccumulation) {
+        // No photons changed but the light volume has been reallocated, fill it with the resampled accumulation
+        cl::Event copyEvent;
+        VolumeCLBase* volumeOutCL = nullptr;
+        if (useGLSharing_.get()) {
+            auto volumeOutCLGL = lightVolume_->getEditableRepresentation<VolumeCLGL>();
+            glSync->addToAquireGLObjectList(volumeOutCLGL);
+            glSync->aquireAllObjects();
+            volumeOutCL = volumeOutCLGL;
+        } else {
+            volumeOutCL = lightVolume_->getEditableRepresentation<VolumeCL>();
+        }
+        copyToLightVolume(volumeOutCL, outDim, localWorkGroupSize, nullptr, &copyEvent);
+        splatPhotonEvents.emplace_back(copyEvent);
     }
     
     
     
     if (recomputedPhotonIndicesPort_.isReady() && recomputedPhotonIndicesPort_.getData()->nRecomputedPhotons != 0) {
         copyPrevPhotonsEvent_.emplace_back(cl::Event());
-        if (prevPhotons_.getSize() != photonData->photons_.getSize()) {
-            prevPhotons_.setSize(photonData->photons_.getSize());
+        if (prevPhotons_.getSize() != photonData->photons_.getSizeInBytes()) {
+            bufferPool_->resize(prevPhotons_, photonData->photons_.getSizeInBytes());
         }
         
-        auto prevPhotonsCL = prevPhotons_.getEditableRepresentation<BufferCL>();
         OpenCL::getPtr()->getAsyncQueue().enqueueCopyBuffer(
-                                                                photonsCL->get(), prevPhotonsCL->getEditable(), 0, size_t(0), photonData->photons_.getSizeInBytes(), &splatPhotonEvents, &copyPrevPhotonsEvent_.back());
+                                                                photonsCL->get(), prevPhotons_.get(), 0, size_t(0), photonData->photons_.getSizeInBytes(), &splatPhotonEvents, &copyPrevPhotonsEvent_.back());
+        // Make the pool wait for the copy if prevPhotons_ is released before the next evaluation
+        prevPhotons_.setLastUse(copyPrevPhotonsEvent_.back());
     }
     
 }
 
 void PhotonToLightVolumeProcessorCL::executeVolumeOperation(const Volume* volume,
                                                             const VolumeCLBase* volumeCL,
-                                                            VolumeCLBase* volumeOutCL, const BufferCLBase* photonsCL, const Volume* volumeOut, const size3_t& outDim,
+                                                            VolumeCLBase* volumeOutCL, const cl::Buffer& photonsCL, size_t nPhotons, const Volume* volumeOut, const size3_t& outDim,
                                                             const size_t& globalWorkGroupSize,
                                                             const size_t& localWorkgroupSize, std::vector<cl::Event>* waitForEvents, std::vector<cl::Event>* splatEvent, cl::Event* copyEvent) {
-    
-    BufferCL* tmpVolumeCL = tmpVolume_.getEditableRepresentation<BufferCL>();
-    
+    if (useHostSplatting()) {
+        splatOnHost(photonsCL, nPhotons, nullptr, 0, *photons_.getData(), 1.f, volumeOut, outDim, waitForEvents, &(*splatEvent)[0]);
+        copyToLightVolume(volumeOutCL, outDim, localWorkgroupSize, splatEvent, copyEvent);
+        return;
+    }
     try {
         
         int argIndex = 0;
@@ -368,7 +463,7 @@ void PhotonToLightVolumeProcessorCL::executeVolumeOperation(const Volume* volume
         kernel_->setArg(argIndex++,
                         *(volumeCL->getVolumeStruct(volume)
                           .getRepresentation<BufferCL>()));  // Scaling for 12-bit data
-        kernel_->setArg(argIndex++, *tmpVolumeCL);
+        kernel_->setArg(argIndex++, tmpVolume_.get());
         
         kernel_->setArg(argIndex++,
                         *(volumeOutCL->getVolumeStruct(volumeOut)
@@ -376,8 +471,8 @@ void PhotonToLightVolumeProcessorCL::executeVolumeOperation(const Volume* volume
         
         kernel_->setArg(argIndex++, ivec4(outDim, 0));
         // Photon params
-        kernel_->setArg(argIndex++, *photonsCL);
-        kernel_->setArg(argIndex++, static_cast<int>(photons_.getData()->getNumberOfPhotons()));
+        kernel_->setArg(argIndex++, photonsCL);
+        kernel_->setArg(argIndex++, static_cast<int>(nPhotons));
         kernel_->setArg(argIndex++, static_cast<float>(photons_.getData()->getRadiusRelativeToSceneSize()));
         const PhotonData* inputPhotons = photons_.getData().get();
         // Use photon scale to get equivalent appearance when normalizing light volume
@@ -388,6 +483,7 @@ void PhotonToLightVolumeProcessorCL::executeVolumeOperation(const Volume* volume
         double nPhotons = static_cast<double>(inputPhotons->getNumberOfPhotons());
         double photonVolume = PhotonData::sphereVolume(inputPhotons->getRadiusRelativeToSceneSize());
         kernel_->setArg(argIndex++, static_cast<float>(PhotonData::scaleToMakeLightPowerOfOneVisibleForDirectionalLightSource / (photonVolume*nPhotons)));
+        setAdaptiveRadiusArgs(kernel_, argIndex);
         
         OpenCL::getPtr()->getQueue().enqueueNDRangeKernel(
                                                           *kernel_, cl::NullRange, globalWorkGroupSize, localWorkgroupSize, waitForEvents, &(*splatEvent)[0]);
@@ -401,20 +497,177 @@ void PhotonToLightVolumeProcessorCL::executeVolumeOperation(const Volume* volume
         
         //std::vector<cl::Event> waitForNormalization(1, events[2]);
         
-        OpenCL::getPtr()->getQueue().enqueueCopyBufferToImage(
-                                                              tmpVolumeCL->get(), volumeOutCL->getEditable(), 0, size3_t(0), size3_t(outDim),
-                                                              &(*splatEvent), copyEvent);
     } catch (cl::Error& err) {
         LogError(getCLErrorString(err));
     }
-    
-    
+    copyToLightVolume(volumeOutCL, outDim, localWorkgroupSize, splatEvent, copyEvent);
+}
+
+const cl::Buffer& PhotonToLightVolumeProcessorCL::photonsToSplat(const PhotonData& photons, const cl::Buffer& photonsCL, size_t& nPhotons, std::vector<cl::Event>& waitForEvents) {
+    if (!compactPhotons_ || !photonCompactor_.isValid()) {
+        return photonsCL;
+    }
+    // Most interaction slots are unused when photons scatter few times,
+    // splat the valid ones only instead of rejecting the rest in the kernel.
+    photonCompactor_.workGroupSize(workGroupSize_.get());
+    cl::Event compactEvent;
+    auto nCompactedPhotons = photonCompactor_.compact(photons, photonsCL, &waitForEvents, &compactEvent);
+    if (compactEvent() == nullptr) {
+        // Compaction failed, error has been logged
+        return photonsCL;
+    }
+    nPhotons = nCompactedPhotons;
+    waitForEvents.emplace_back(compactEvent);
+    return photonCompactor_.getCompactedPhotons();
+}
+
+void PhotonToLightVolumeProcessorCL::depositedIrradianceToLightVolume(const PhotonData& photons, VolumeCLBase* volumeOutCL, const size3_t& outDim, const size_t& localWorkgroupSize) {
+    std::vector<cl::Event> depositEvent(1);
+    cl::Event copyEvent;
+    try {
+        auto depositedIrradianceCL = photons.depositedIrradiance_.getRepresentation<BufferCL>();
+        if (copyDepositedIrradianceKernel_) {
+            auto outDimFlattened = outDim.x * outDim.y * outDim.z;
+            copyDepositedIrradianceKernel_->setArg(0, *depositedIrradianceCL);
+            copyDepositedIrradianceKernel_->setArg(1, tmpVolume_.get());
+            copyDepositedIrradianceKernel_->setArg(2, static_cast<int>(outDimFlattened));
+            OpenCL::getPtr()->getQueue().enqueueNDRangeKernel(
+                                                              *copyDepositedIrradianceKernel_, cl::NullRange, getGlobalWorkGroupSize(outDimFlattened, localWorkgroupSize), localWorkgroupSize, nullptr, &depositEvent[0]);
+        } else {
+            // Accumulation buffer is float4 as well
+            OpenCL::getPtr()->getQueue().enqueueCopyBuffer(depositedIrradianceCL->get(), tmpVolume_.get(), 0, 0, tmpVolume_.getSize(), nullptr, &depositEvent[0]);
+        }
+    } catch (cl::Error& err) {
+        LogError(getCLErrorString(err));
+        return;
+    }
+    copyToLightVolume(volumeOutCL, outDim, localWorkgroupSize, &depositEvent, &copyEvent);
+}
+
+void PhotonToLightVolumeProcessorCL::copyToLightVolume(VolumeCLBase* volumeOutCL, const size3_t& outDim, const size_t& localWorkgroupSize, std::vector<cl::Event>* waitForEvents, cl::Event* copyEvent) {
+    try {
+        if (packLightVolumeKernel_ == nullptr) {
+            OpenCL::getPtr()->getQueue().enqueueCopyBufferToImage(
+                                                                  tmpVolume_.get(), volumeOutCL->getEditable(), 0, size3_t(0), size3_t(outDim),
+                                                                  waitForEvents, copyEvent);
+        } else {
+            size_t outDimFlattened = outDim.x * outDim.y * outDim.z;
+            if (packedVolume_.getSize() != outDimFlattened*lightVolume_->getDataFormat()->getSize()) {
+                bufferPool_->resize(packedVolume_, outDimFlattened*lightVolume_->getDataFormat()->getSize());
+            }
+            std::vector<cl::Event> packEvent(1);
+            packLightVolumeKernel_->setArg(0, tmpVolume_.get());
+            packLightVolumeKernel_->setArg(1, packedVolume_.get());
+            packLightVolumeKernel_->setArg(2, static_cast<int>(outDimFlattened));
+            OpenCL::getPtr()->getQueue().enqueueNDRangeKernel(
+                                                              *packLightVolumeKernel_, cl::NullRange, getGlobalWorkGroupSize(outDimFlattened, localWorkgroupSize), localWorkgroupSize, waitForEvents, &packEvent[0]);
+            OpenCL::getPtr()->getQueue().enqueueCopyBufferToImage(
+                                                                  packedVolume_.get(), volumeOutCL->getEditable(), 0, size3_t(0), size3_t(outDim),
+                                                                  &packEvent, copyEvent);
+        }
+    } catch (cl::Error& err) {
+        LogError(getCLErrorString(err));
+    }
+}
+
+void PhotonToLightVolumeProcessorCL::computePhotonDensityGrid(const cl::Buffer& photonsCL, size_t nPhotons, float photonRadius, const size_t& localWorkgroupSize, std::vector<cl::Event>& waitForEvents) {
+    if (photonDensityGridKernel_ == nullptr) {
+        return;
+    }
+    // Coarse enough to contain several photons per cell, photon positions are in texture space
+    auto cellsPerDim = glm::clamp(static_cast<int>(std::ceil(0.5f / photonRadius)), 1, 128);
+    densityGridDim_ = ivec4(ivec3(cellsPerDim), cellsPerDim * cellsPerDim * cellsPerDim);
+    // Cell counts followed by total number of photons and number of occupied cells
+    auto gridSizeInBytes = (densityGridDim_.w + 2) * sizeof(cl_uint);
+    if (photonDensityGrid_.getSize() != gridSizeInBytes) {
+        bufferPool_->resize(photonDensityGrid_, gridSizeInBytes);
+    }
+    try {
+        std::vector<cl::Event> clearEvent(1);
+        cl::Event densityEvent;
+        OpenCL::getPtr()->getQueue().enqueueFillBuffer<cl_uint>(photonDensityGrid_.get(), 0u, 0, gridSizeInBytes, &waitForEvents, &clearEvent[0]);
+        int argIndex = 0;
+        photonDensityGridKernel_->setArg(argIndex++, photonsCL);
+        photonDensityGridKernel_->setArg(argIndex++, static_cast<int>(nPhotons));
+        photonDensityGridKernel_->setArg(argIndex++, photonDensityGrid_.get());
+        photonDensityGridKernel_->setArg(argIndex++, densityGridDim_);
+        OpenCL::getPtr()->getQueue().enqueueNDRangeKernel(
+                                                          *photonDensityGridKernel_, cl::NullRange, getGlobalWorkGroupSize(std::max(nPhotons, size_t(1)), localWorkgroupSize), localWorkgroupSize, &clearEvent, &densityEvent);
+        waitForEvents.emplace_back(densityEvent);
+    } catch (cl::Error& err) {
+        LogError(getCLErrorString(err));
+    }
+}
+
+void PhotonToLightVolumeProcessorCL::setAdaptiveRadiusArgs(cl::Kernel* kernel, int argIndex) {
+    if (!adaptiveRadius_) {
+        return;
+    }
+    kernel->setArg(argIndex++, photonDensityGrid_.get());
+    kernel->setArg(argIndex++, densityGridDim_);
+    kernel->setArg(argIndex++, maxRadiusScale_.get());
+}
+
+bool PhotonToLightVolumeProcessorCL::useHostSplatting() const {
+    return hostSplatting_ && OpenCL::getPtr()->getDevice().getInfo<CL_DEVICE_TYPE>() == CL_DEVICE_TYPE_CPU;
+}
+
+void PhotonToLightVolumeProcessorCL::splatOnHost(const cl::Buffer& photonsCL, size_t nPhotons, const BufferCLBase* photonIndices, size_t nIndices, const PhotonData& photons, float radianceMultiplier, const Volume* volumeOut, const size3_t& outDim, std::vector<cl::Event>* waitForEvents, cl::Event* event) {
+    PhotonSplatterCPU::Parameters params;
+    params.textureToIndex = volumeOut->getCoordinateTransformer().getTextureToIndexMatrix();
+    params.indexToTexture = volumeOut->getCoordinateTransformer().getIndexToTextureMatrix();
+    params.dimensions = outDim;
+    params.channels = tmpVolume_.getSize() / (outDim.x * outDim.y * outDim.z * sizeof(float));
+    params.radius = static_cast<float>(photons.getRadiusRelativeToSceneSize());
+    double nPhotonPaths = static_cast<double>(photons.getNumberOfPhotons());
+    double photonVolume = PhotonData::sphereVolume(photons.getRadiusRelativeToSceneSize());
+    // isotropicPhaseFunction() times relativeIrradianceScale of the splatting kernels
+    params.irradianceScale = static_cast<float>(0.25 * glm::one_over_pi<double>() * PhotonData::scaleToMakeLightPowerOfOneVisibleForDirectionalLightSource / (photonVolume*nPhotonPaths));
+    params.maxRadiusScale = maxRadiusScale_.get();
+    params.densityGridDim = densityGridDim_;
+    try {
+        const auto& queue = OpenCL::getPtr()->getQueue();
+        if (nPhotons == 0 || (photonIndices && nIndices == 0)) {
+            // Nothing to splat, e.g. no compacted photons hit the volume. 
+            // Mapping zero bytes is invalid, only signal that the (cleared) accumulation is ready.
+            queue.enqueueMarkerWithWaitList(waitForEvents, event);
+            return;
+        }
+        auto photonsPtr = static_cast<const vec4*>(queue.enqueueMapBuffer(photonsCL, CL_TRUE, CL_MAP_READ, 0, 2 * nPhotons * sizeof(vec4), waitForEvents));
+        auto volumePtr = static_cast<float*>(queue.enqueueMapBuffer(tmpVolume_.get(), CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, tmpVolume_.getSize(), waitForEvents));
+        void* densityGridPtr = nullptr;
+        if (adaptiveRadius_ && photonDensityGrid_.getSize() > 0) {
+            densityGridPtr = queue.enqueueMapBuffer(photonDensityGrid_.get(), CL_TRUE, CL_MAP_READ, 0, photonDensityGrid_.getSize(), waitForEvents);
+            params.densityGrid = static_cast<const unsigned int*>(densityGridPtr);
+        }
+        if (photonIndices) {
+            auto indicesPtr = queue.enqueueMapBuffer(photonIndices->get(), CL_TRUE, CL_MAP_READ, 0, nIndices * sizeof(unsigned int), waitForEvents);
+            hostSplatter_.splatSelected(photonsPtr, static_cast<const unsigned int*>(indicesPtr), nIndices, photons.getNumberOfPhotons(), photons.getMaxPhotonInteractions(), radianceMultiplier, params, volumePtr);
+            queue.enqueueUnmapMemObject(photonIndices->get(), indicesPtr);
+        } else {
+            hostSplatter_.splat(photonsPtr, nPhotons, radianceMultiplier, params, volumePtr);
+        }
+        if (densityGridPtr) {
+            queue.enqueueUnmapMemObject(photonDensityGrid_.get(), densityGridPtr);
+        }
+        queue.enqueueUnmapMemObject(photonsCL, const_cast<vec4*>(photonsPtr));
+        queue.enqueueUnmapMemObject(tmpVolume_.get(), volumePtr, nullptr, event);
+    } catch (cl::Error& err) {
+        LogError(getCLErrorString(err));
+    }
 }
 
-void PhotonToLightVolumeProcessorCL::clearBuffer(BufferCL* tmpVolumeCL, size_t outDimFlattened, const size_t& localWorkgroupSize, std::vector<cl::Event>* waitForEvents, cl::Event * events) {
+size_t PhotonToLightVolumeProcessorCL::getAccumulationVolumeSizeInBytes(const size3_t& outDim) const {
+    // Half formats are accumulated in full precision
+    const auto& type = volumeDataTypeOption_.getSelectedValue();
+    size_t components = (type == "float16" || type == "float32") ? 1 : 4;
+    return outDim.x * outDim.y * outDim.z * components * sizeof(float);
+}
+
+void PhotonToLightVolumeProcessorCL::clearBuffer(const cl::Buffer& tmpVolumeCL, size_t outDimFlattened, const size_t& localWorkgroupSize, std::vector<cl::Event>* waitForEvents, cl::Event * events) {
     try {
         
-        clearFloatsKernel_->setArg(0, *tmpVolumeCL);
+        clearFloatsKernel_->setArg(0, tmpVolumeCL);
         //LogInfo("N components" << lightVolume_->getDataFormat()->getComponents());
         clearFloatsKernel_->setArg(1, static_cast<int>(outDimFlattened));
         OpenCL::getPtr()->getQueue().enqueueNDRangeKernel(
@@ -425,20 +678,21 @@ void PhotonToLightVolumeProcessorCL::clearBuffer(BufferCL* tmpVolumeCL, size_t o
     }
 }
 
-void PhotonToLightVolumeProcessorCL::photonsToLightVolume(VolumeCLBase* volumeOutCL, const BufferCLBase* photonsCL, const BufferCLBase* photonIndices, const PhotonData& photons, const RecomputedPhotonIndices& recomputedPhotons, float radianceMultiplier, const Volume* volumeOut, const size3_t& outDim,
+void PhotonToLightVolumeProcessorCL::photonsToLightVolume(VolumeCLBase* volumeOutCL, const cl::Buffer& photonsCL, const BufferCLBase* photonIndices, const PhotonData& photons, const RecomputedPhotonIndices& recomputedPhotons, float radianceMultiplier, const Volume* volumeOut, const size3_t& outDim,
                                                           const size_t& globalWorkGroupSize,
                                                           const size_t& localWorkgroupSize, std::vector<cl::Event>* waitForEvents, cl::Event* event) {
     
-    size_t outDimFlattened = outDim.x * outDim.y * outDim.z;
-    
-    if (tmpVolume_.getSize() != outDimFlattened*volumeOut->getDataFormat()->getSize()) {
-        tmpVolume_.setSize(outDimFlattened*volumeOut->getDataFormat()->getSize());
+    if (tmpVolume_.getSize() != getAccumulationVolumeSizeInBytes(outDim)) {
+        bufferPool_->resize(tmpVolume_, getAccumulationVolumeSizeInBytes(outDim));
+    }
+    if (useHostSplatting()) {
+        splatOnHost(photonsCL, photons.getNumberOfPhotons() * photons.getMaxPhotonInteractions(), photonIndices, recomputedPhotons.nRecomputedPhotons, photons, radianceMultiplier, volumeOut, outDim, waitForEvents, event);
+        return;
     }
-    BufferCL* tmpVolumeCL = tmpVolume_.getEditableRepresentation<BufferCL>();
     try {
         
         int argIndex = 0;
-        splatSelectedPhotonsKernel_->setArg(argIndex++, *tmpVolumeCL);
+        splatSelectedPhotonsKernel_->setArg(argIndex++, tmpVolume_.get());
         
         splatSelectedPhotonsKernel_->setArg(argIndex++,
                                             *(volumeOutCL->getVolumeStruct(volumeOut)
@@ -446,7 +700,7 @@ void PhotonToLightVolumeProcessorCL::photonsToLightVolume(VolumeCLBase* volumeOu
         
         splatSelectedPhotonsKernel_->setArg(argIndex++, ivec4(outDim, 0));
         // Photon params
-        splatSelectedPhotonsKernel_->setArg(argIndex++, *photonsCL);
+        splatSelectedPhotonsKernel_->setArg(argIndex++, photonsCL);
         splatSelectedPhotonsKernel_->setArg(argIndex++, *photonIndices);
         splatSelectedPhotonsKernel_->setArg(argIndex++, static_cast<int>(recomputedPhotons.nRecomputedPhotons));
         splatSelectedPhotonsKernel_->setArg(argIndex++, static_cast<float>(photons.getRadiusRelativeToSceneSize()));
@@ -461,9 +715,14 @@ void PhotonToLightVolumeProcessorCL::photonsToLightVolume(VolumeCLBase* volumeOu
         splatSelectedPhotonsKernel_->setArg(argIndex++, radianceMultiplier);
         splatSelectedPhotonsKernel_->setArg(argIndex++, static_cast<int>(photons.getNumberOfPhotons()));
         splatSelectedPhotonsKernel_->setArg(argIndex++, static_cast<int>(photons.getMaxPhotonInteractions()));
+        setAdaptiveRadiusArgs(splatSelectedPhotonsKernel_, argIndex);
         
         OpenCL::getPtr()->getAsyncQueue().enqueueNDRangeKernel(
                                                                *splatSelectedPhotonsKernel_, cl::NullRange, globalWorkGroupSize, localWorkgroupSize, waitForEvents, event);
+        if (event) {
+            // tmpVolume_ may be returned to the pool while the kernel is running
+            tmpVolume_.setLastUse(*event);
+        }
         
         
     } catch (cl::Error& err) {
@@ -471,6 +730,33 @@ void PhotonToLightVolumeProcessorCL::photonsToLightVolume(VolumeCLBase* volumeOu
     }
 }
 
+bool PhotonToLightVolumeProcessorCL::resampleAccumulation(const size3_t& prevDim, const size3_t& outDim, const size_t& localWorkgroupSize) {
+    if (resampleAccumulationKernel_ == nullptr || tmpVolume_.getSize() != getAccumulationVolumeSizeInBytes(prevDim)) {
+        prevPhotons_.release();
+        return false;
+    }
+    try {
+        auto resampledVolume = bufferPool_->acquire(getAccumulationVolumeSizeInBytes(outDim));
+        auto outDimFlattened = outDim.x * outDim.y * outDim.z;
+        int argIndex = 0;
+        resampleAccumulationKernel_->setArg(argIndex++, tmpVolume_.get());
+        resampleAccumulationKernel_->setArg(argIndex++, ivec4(prevDim, prevDim.x * prevDim.y * prevDim.z));
+        resampleAccumulationKernel_->setArg(argIndex++, resampledVolume.get());
+        resampleAccumulationKernel_->setArg(argIndex++, ivec4(outDim, outDimFlattened));
+        cl::Event resampleEvent;
+        OpenCL::getPtr()->getQueue().enqueueNDRangeKernel(
+                                                          *resampleAccumulationKernel_, cl::NullRange, getGlobalWorkGroupSize(outDimFlattened, localWorkgroupSize), localWorkgroupSize, nullptr, &resampleEvent);
+        // The coarse buffer is returned to the pool and may be handed out on another queue
+        resampleEvent.wait();
+        tmpVolume_ = std::move(resampledVolume);
+        return true;
+    } catch (cl::Error& err) {
+        LogError(getCLErrorString(err));
+        prevPhotons_.release();
+        return false;
+    }
+}
+
 void PhotonToLightVolumeProcessorCL::volumeSizeOptionChanged() {
     if (volumeInport_.hasData() && volumeSizeOption_.get() != 0) {
         auto inputVolume = volumeInport_.getData();
@@ -481,7 +767,7 @@ void PhotonToLightVolumeProcessorCL::volumeSizeOptionChanged() {
             lightVolume_->setWorldMatrix(inputVolume->getWorldMatrix());
             information_.updateForNewVolume(*lightVolume_, util::OverwriteState::No);
             // Recompute all photons
-            prevPhotons_.setSize(0);
+            prevPhotons_.release();
         }
     }
     
@@ -493,11 +779,16 @@ void PhotonToLightVolumeProcessorCL::buildKernel() {
     if (volumeDataTypeOption_.getSelectedValue() == "float16" || volumeDataTypeOption_.getSelectedValue() == "4xfloat16") {
         defines << " -D VOLUME_OUTPUT_HALF_TYPE ";
     }
+    if (adaptiveRadius_) {
+        defines << " -D ADAPTIVE_PHOTON_RADIUS ";
+    }
     if (volumeDataTypeOption_.getSelectedValue() == "float16" || volumeDataTypeOption_.getSelectedValue() == "float32") {
         defines << " -D VOLUME_OUTPUT_SINGLE_CHANNEL ";
         clearFloatsKernel_ = kernelOwner_.addKernel("photonstolightvolume.cl", "clearFloatKernel", "", defines.str());
+        copyDepositedIrradianceKernel_ = kernelOwner_.addKernel("photonstolightvolume.cl", "copyDepositedIrradianceKernel", "", defines.str());
     } else {
         clearFloatsKernel_ = kernelOwner_.addKernel("photonstolightvolume.cl", "clearFloat4Kernel", "", defines.str());
+        copyDepositedIrradianceKernel_ = nullptr;
     }
     //kernel_ = kernelOwner_.addKernel("photonstolightvolume.cl", "photonsToLightVolumeKernel", "", defines.str());
     kernel_ = kernelOwner_.addKernel("photonstolightvolume.cl", "splatPhotonsToLightVolumeKernel", "", defines.str());
@@ -505,6 +796,18 @@ void PhotonToLightVolumeProcessorCL::buildKernel() {
     
     photonDensityNormalizationKernel_ = kernelOwner_.addKernel("photonstolightvolume.cl", "photonDensityNormalizationKernel", "", defines.str());
     copyIndexPhotonsKernel_ = kernelOwner_.addKernel("photonstolightvolume.cl", "copyIndexPhotonsKernel", "", defines.str());
+    if (volumeDataTypeOption_.getSelectedValue() == "float32" || volumeDataTypeOption_.getSelectedValue() == "4xfloat32") {
+        // Accumulation buffer can be copied directly
+        packLightVolumeKernel_ = nullptr;
+    } else {
+        packLightVolumeKernel_ = kernelOwner_.addKernel("photonstolightvolume.cl", "packLightVolumeKernel", "", defines.str());
+    }
+    resampleAccumulationKernel_ = kernelOwner_.addKernel("photonstolightvolume.cl", "resampleAccumulationKernel", "", defines.str());
+    if (adaptiveRadius_) {
+        photonDensityGridKernel_ = kernelOwner_.addKernel("photonstolightvolume.cl", "photonDensityGridKernel", "", defines.str());
+    } else {
+        photonDensityGridKernel_ = nullptr;
+    }
     
 }
 
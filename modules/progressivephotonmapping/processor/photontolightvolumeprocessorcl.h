@@ -50,7 +50,10 @@
 #include <modules/opencl/kernelowner.h>
 #include <modules/opencl/volume/volumeclbase.h>
 
+#include <modules/progressivephotonmapping/devicebufferpool.h>
+#include <modules/progressivephotonmapping/photoncompactor.h>
 #include <modules/progressivephotonmapping/photondata.h>
+#include <modules/progressivephotonmapping/photonsplattercpu.h>
 
 namespace inviwo {
 
@@ -85,11 +88,51 @@ public:
     
     virtual void process();
 protected:
-    void executeVolumeOperation(const Volume* volume, const VolumeCLBase* volumeCL, VolumeCLBase* volumeOutCL, const BufferCLBase* photonsCL, const Volume* volumeOut, const size3_t& outDim, const size_t& globalWorkGroupSize, const size_t& localWorkgroupSize, std::vector<cl::Event>* waitForEvents, std::vector<cl::Event>* splatEvent, cl::Event* copyEvent);
+    void executeVolumeOperation(const Volume* volume, const VolumeCLBase* volumeCL, VolumeCLBase* volumeOutCL, const cl::Buffer& photonsCL, size_t nPhotons, const Volume* volumeOut, const size3_t& outDim, const size_t& globalWorkGroupSize, const size_t& localWorkgroupSize, std::vector<cl::Event>* waitForEvents, std::vector<cl::Event>* splatEvent, cl::Event* copyEvent);
     
-    void clearBuffer(BufferCL* tmpVolumeCL, size_t outDimFlattened, const size_t& localWorkgroupSize, std::vector<cl::Event>* waitForEvents, cl::Event * events);
+    /**
+     * Photons to splat when computing the whole light volume.
+     * Compacts photonsCL if compactPhotons_ is set, in which case the compaction event is added to waitForEvents.
+     * @param nPhotons Number of photons to splat, including unused interaction slots if not compacted.
+     */
+    const cl::Buffer& photonsToSplat(const PhotonData& photons, const cl::Buffer& photonsCL, size_t& nPhotons, std::vector<cl::Event>& waitForEvents);
+    /**
+     * Count photons in a coarse grid over the volume, used to adapt the radius of each photon to the local photon density.
+     * Grid cells are twice the photon radius. The event of the computation is added to waitForEvents.
+     */
+    void computePhotonDensityGrid(const cl::Buffer& photonsCL, size_t nPhotons, float photonRadius, const size_t& localWorkgroupSize, std::vector<cl::Event>& waitForEvents);
+    void setAdaptiveRadiusArgs(cl::Kernel* kernel, int argIndex);
+    // True if photons should be splatted by PhotonSplatterCPU, only done for OpenCL CPU devices
+    bool useHostSplatting() const;
+    /**
+     * Splat photons into tmpVolume_ on host threads instead of using the splatting kernels.
+     * Device buffers are mapped, which does not copy any data on CPU devices.
+     * @param nPhotons Number of photons in photonsCL
+     * @param photonIndices Splat the selected photons of each interaction if not null, see splatSelectedPhotonsToLightVolumeKernel
+     * @param event Signaled when tmpVolume_ has been unmapped
+     */
+    void splatOnHost(const cl::Buffer& photonsCL, size_t nPhotons, const BufferCLBase* photonIndices, size_t nIndices, const PhotonData& photons, float radianceMultiplier, const Volume* volumeOut, const size3_t& outDim, std::vector<cl::Event>* waitForEvents, cl::Event* event);
+    /**
+     * Copy irradiance splatted by the photon tracer, see PhotonData::depositedIrradiance_, to the light volume.
+     * Used instead of splatting photons, which have not been stored in that case.
+     */
+    void depositedIrradianceToLightVolume(const PhotonData& photons, VolumeCLBase* volumeOutCL, const size3_t& outDim, const size_t& localWorkgroupSize);
+    /**
+     * Copy accumulated photon contributions in tmpVolume_ to the light volume. 
+     * Formats other than float32 are first converted by packLightVolumeKernel_.
+     */
+    void copyToLightVolume(VolumeCLBase* volumeOutCL, const size3_t& outDim, const size_t& localWorkgroupSize, std::vector<cl::Event>* waitForEvents, cl::Event* copyEvent);
+    // Size of accumulation buffer, always float/float4 independent of output format
+    size_t getAccumulationVolumeSizeInBytes(const size3_t& outDim) const;
+    void clearBuffer(const cl::Buffer& tmpVolumeCL, size_t outDimFlattened, const size_t& localWorkgroupSize, std::vector<cl::Event>* waitForEvents, cl::Event * events);
     
-    void photonsToLightVolume(VolumeCLBase* volumeOutCL, const BufferCLBase* photonsCL, const BufferCLBase* photonIndices, const PhotonData& photons, const RecomputedPhotonIndices& recomputedPhotons, float radianceMultiplier, const Volume* volumeOut, const size3_t& outDim, const size_t& globalWorkGroupSize, const size_t& localWorkgroupSize, std::vector<cl::Event>* waitForEvents, cl::Event* event);
+    void photonsToLightVolume(VolumeCLBase* volumeOutCL, const cl::Buffer& photonsCL, const BufferCLBase* photonIndices, const PhotonData& photons, const RecomputedPhotonIndices& recomputedPhotons, float radianceMultiplier, const Volume* volumeOut, const size3_t& outDim, const size_t& globalWorkGroupSize, const size_t& localWorkgroupSize, std::vector<cl::Event>* waitForEvents, cl::Event* event);
+    /**
+     * Resample tmpVolume_ from prevDim to the current light volume dimensions, 
+     * keeping accumulated photon contributions for incremental updates.
+     * @return false if resampling failed, in which case all photons must be recomputed.
+     */
+    bool resampleAccumulation(const size3_t& prevDim, const size3_t& outDim, const size_t& localWorkgroupSize);
     void volumeSizeOptionChanged();
     void buildKernel();
     private:
@@ -101,10 +144,15 @@ protected:
     
     //CameraProperty camera_;
     OptionPropertyInt volumeSizeOption_;
+    FloatProperty resolutionUpgradeFactor_; // Light volume resolution follows the photon radius in steps of this factor
     OptionPropertyString volumeDataTypeOption_;
     FloatProperty incrementalRecomputationThreshold_; // Threshold to decide if photons should be removed-added.
     VolumeInformationProperty information_;
     BoolProperty alignChangedPhotons_;
+    BoolProperty compactPhotons_; // Splat only valid photons when computing the whole light volume. Off by default since it reads back the photon count and needs scratch buffers
+    BoolProperty adaptiveRadius_; // Photon radius from local photon density, scaled by the progressive radius
+    FloatProperty maxRadiusScale_; // Adaptive radius is within [radius/scale, radius*scale]
+    BoolProperty hostSplatting_; // Splat with host threads instead of atomics when running on a CPU device
     IntProperty workGroupSize_;
     BoolProperty useGLSharing_;
     
@@ -114,11 +162,21 @@ protected:
     cl::Kernel* clearFloatsKernel_;
     cl::Kernel* photonDensityNormalizationKernel_;
     cl::Kernel* copyIndexPhotonsKernel_;
+    cl::Kernel* packLightVolumeKernel_; // nullptr if output format is float32
+    cl::Kernel* photonDensityGridKernel_; // nullptr unless adaptiveRadius_ is set
+    cl::Kernel* copyDepositedIrradianceKernel_; // nullptr unless output is single channel
+    cl::Kernel* resampleAccumulationKernel_;
     std::vector<cl::Event> copyPrevPhotonsEvent_; // Can be done in parallel, wait for completion if
     std::shared_ptr<Volume> lightVolume_;
-    Buffer<vec4> prevPhotons_; // Copy of photons from last computation only used when recomputedPhotonIndicesPort_ is connected
+    std::shared_ptr<DeviceBufferPool> bufferPool_;
+    PooledBuffer prevPhotons_; // Copy of photons from last computation only used when recomputedPhotonIndicesPort_ is connected
     Buffer<vec4> changedAlignedPhotons_; // Aligned copy of photons changed from previous and current distribution. Only used when recomputedPhotonIndicesPort_ is connected
-    Buffer<unsigned char> tmpVolume_;   // Enables atomic operations to be used
+    PooledBuffer tmpVolume_;   // Enables atomic operations to be used
+    PooledBuffer packedVolume_;   // tmpVolume_ converted to half format
+    PooledBuffer photonDensityGrid_; // Photons per cell, built when the whole light volume is computed and reused by incremental updates
+    ivec4 densityGridDim_{ 0 }; // xyz cells, w total number of cells
+    PhotonCompactor photonCompactor_;
+    PhotonSplatterCPU hostSplatter_;
 };
 
 } // namespace
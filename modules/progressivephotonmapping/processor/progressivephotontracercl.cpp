@@ -31,6 +31,8 @@
  *********************************************************************************/
 
 #include <modules/progressivephotonmapping/processor/progressivephotontracercl.h>
+#include <modules/progressivephotonmapping/progressivephotonmappingmodule.h>
+#include <inviwo/core/common/inviwoapplication.h>
 
 #include <modules/opencl/buffer/bufferclgl.h>
 #include <modules/opencl/inviwoopencl.h>
@@ -40,6 +42,7 @@
 #include <modules/opencl/volume/volumeclgl.h>
 #include <modules/opencl/volume/volumecl.h>
 #include <inviwo/core/datastructures/volume/volumeram.h>
+#include <inviwo/core/datastructures/image/layerram.h>
 #include <modules/opencl/kernelmanager.h>
 
 #include <modules/lightcl/lightsourcescl.h>
@@ -71,8 +74,10 @@ const ProcessorInfo ProgressivePhotonTracerCL::getProcessorInfo() const {
 
 ProgressivePhotonTracerCL::ProgressivePhotonTracerCL()
 : Processor(), KernelObserver(), KernelOwner()
+, bufferPool_(InviwoApplication::getPtr()->getModuleByType<ProgressivePhotonMappingModule>()->getDeviceBufferPool())
 , volumePort_("volume")
 , recomputationImportanceGrid_("recomputationImportance")
+, minMaxGrid_("minMaxGrid")
 , lightSamples_("LightSamples")
 , outport_("photons")
 , recomputedIndicesPort_("recomputedIndices")
@@ -82,9 +87,20 @@ ProgressivePhotonTracerCL::ProgressivePhotonTracerCL()
 , camera_("camera", "Camera", vec3(0.0f, 0.0f, -2.0f), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f), nullptr, InvalidationLevel::Valid)
 , maxIncrementalPhotonsToUpdate_("maxIncrementalPhotonsToUpdate", "Max photons per update (%)", 100.f, 0.f, 100.f)
 , equalIncrementalImportance_("equalImportance", "Equal importance", false)
+, incrementalLightUpdate_("incrementalLightUpdate", "Incremental light update", true)
+, maxIncrementalLightAngle_("maxIncrementalLightAngle", "Max incremental light change (degrees)", 10.f, 0.f, 90.f)
+, lightPhotonsPerUpdate_("lightPhotonsPerUpdate", "Light photons per update (%)", 10.f, 0.1f, 100.f)
 , spatialSorting_("spatialSorting", "Spatial sorting", true)
 , maxScatteringEvents_("maxScatteringEvents", "Max scattering events", 1, 1, 16)
 , noSingleScattering_("noSingleScattering", "No single scattering", false)
+, densityLevelOfDetail_("densityLevelOfDetail", "Density level of detail", false)
+, counterBasedRandom_("counterBasedRandom", "Counter-based random numbers", false)
+, wavefrontTracing_("wavefrontTracing", "Wavefront tracing", false)
+, fusedSplatting_("fusedSplatting", "Splat photons while tracing", false)
+, fusedResolutionUpgradeFactor_("fusedResolutionUpgradeFactor", "Resolution upgrade factor", 2.f, 1.f, 4.f)
+, outOfCoreVolume_("outOfCoreVolume", "Out-of-core volume", false)
+, brickCacheSize_("brickCacheSize", "Brick cache size (MB)", 512, 16, 16384)
+, bricksPerUpdate_("bricksPerUpdate", "Bricks per update", 256, 1, 65536)
 // Material properties
 , transferFunction_("transferFunction", "Transfer function", TransferFunction())
 , advancedMaterial_("material", "Material")
@@ -104,23 +120,18 @@ ProgressivePhotonTracerCL::ProgressivePhotonTracerCL()
 , recomputedPhotonIndices_(std::make_shared< RecomputedPhotonIndices >())
 {
     addPort(volumePort_);
-    volumePort_.onChange([this]() {
-        invalidateProgressiveRendering(PhotonData::InvalidationReason::Volume); }
-                         );
     addPort(recomputationImportanceGrid_);
     recomputationImportanceGrid_.setOptional(true);
     recomputationImportanceGrid_.onConnect([this]() {
         invalidateProgressiveRendering(PhotonData::InvalidationReason::All); }
                                            );
     
+    addPort(minMaxGrid_);
+    minMaxGrid_.setOptional(true);
+    minMaxGrid_.onChange([this]() { brickPrioritiesInvalid_ = true; });
+    
     addPort(lightSamples_);
-    lightSamples_.onChange([this]() {
-        for (auto lightSourceSample = lightSamples_.begin(), end = lightSamples_.end(); lightSourceSample != end; ++lightSourceSample) {
-            if (lightSourceSample->isReset()) {
-                invalidateProgressiveRendering(PhotonData::InvalidationReason::Light);
-            }
-        }
-    });
+    lightSamples_.onChange([this]() { lightSamplesChanged(); });
     
     addPort(outport_);
     addPort(recomputedIndicesPort_);
@@ -129,6 +140,8 @@ ProgressivePhotonTracerCL::ProgressivePhotonTracerCL()
     
     
     volumePort_.onChange([this] () {
+        photonTracer_.invalidateDensityPyramid();
+        brickPrioritiesInvalid_ = true;
         invalidateProgressiveRendering(PhotonData::InvalidationReason::Volume);
     }
                          );
@@ -141,11 +154,37 @@ ProgressivePhotonTracerCL::ProgressivePhotonTracerCL()
     addProperty(maxScatteringEvents_);
     addProperty(noSingleScattering_);
     noSingleScattering_.onChange([this] { noSingleScatteringChanged(); });
+    addProperty(densityLevelOfDetail_);
+    densityLevelOfDetail_.onChange([this] { 
+        photonTracer_.setDensityLevelOfDetail(densityLevelOfDetail_.get()); 
+        // Photons traced with the other density model must not be mixed with new ones
+        invalidateProgressiveRendering(PhotonData::InvalidationReason::All);
+    });
+    addProperty(counterBasedRandom_);
+    counterBasedRandom_.onChange([this] { photonTracer_.setCounterBasedRandom(counterBasedRandom_.get()); });
+    addProperty(wavefrontTracing_);
+    wavefrontTracing_.onChange([this] { photonTracer_.setWavefront(wavefrontTracing_.get()); });
+    addProperty(fusedSplatting_);
+    fusedSplatting_.onChange([this]() { 
+        fusedResolutionUpgradeFactor_.setVisible(fusedSplatting_);
+        invalidateProgressiveRendering(PhotonData::InvalidationReason::All); 
+    });
+    addProperty(fusedResolutionUpgradeFactor_);
+    fusedResolutionUpgradeFactor_.setVisible(false);
+    fusedResolutionUpgradeFactor_.onChange([this]() { 
+        photonTracer_.setDepositResolutionUpgradeFactor(fusedResolutionUpgradeFactor_.get());
+    });
+    addProperty(outOfCoreVolume_);
+    outOfCoreVolume_.onChange([this]() { kernelArgChanged(); });
+    addProperty(brickCacheSize_);
+    addProperty(bricksPerUpdate_);
     addProperty(alphaProp_);
     //transferFunction_.setGroupID(advancedMaterial_.getGroupId());
     addProperty(advancedMaterial_);
     addProperty(transferFunction_);
-    transferFunction_.onChange([this]{ invalidateProgressiveRendering(PhotonData::InvalidationReason::TransferFunction); });
+    transferFunction_.onChange([this]{
+        brickPrioritiesInvalid_ = true;
+        invalidateProgressiveRendering(PhotonData::InvalidationReason::TransferFunction); });
     advancedMaterial_.phaseFunctionProp.onChange([this]() { phaseFunctionChanged(); });
     // Need to override these to invalidate progressive rendering
     advancedMaterial_.indexOfRefractionProp.onChange([this]() { kernelArgChanged(); });
@@ -168,6 +207,14 @@ ProgressivePhotonTracerCL::ProgressivePhotonTracerCL()
     addProperty(maxIncrementalPhotonsToUpdate_);
     addProperty(equalIncrementalImportance_);
     equalIncrementalImportance_.onChange([this]() { photonRecomputationDetector_.setEqualImportance(equalIncrementalImportance_.get()); });
+    addProperty(incrementalLightUpdate_);
+    addProperty(maxIncrementalLightAngle_);
+    addProperty(lightPhotonsPerUpdate_);
+    incrementalLightUpdate_.onChange([this]() {
+        if (!incrementalLightUpdate_.get() && remainingLightPhotonsToUpdate_ > 0) {
+            invalidateProgressiveRendering(PhotonData::InvalidationReason::Light);
+        }
+    });
     addProperty(spatialSorting_);
     addProperty(invalidateRendering_);
     addProperty(enableProgressiveRefinement_);
@@ -196,6 +243,7 @@ ProgressivePhotonTracerCL::ProgressivePhotonTracerCL()
     progressiveRefinementChanged();
     
     indexToBuffer_ = addKernel("indextobuffer.cl", "indexToBufferKernel");
+    ringIndexToBuffer_ = addKernel("indextobuffer.cl", "ringIndexToBufferKernel");
     thresholdKernel_ = addKernel("threshold.cl", "thresholdKernel");
     lightSampleHashKernel_ = addKernel("hashlightsample.cl", "hashLightSampleKernel");
     
@@ -229,7 +277,20 @@ void ProgressivePhotonTracerCL::process() {
         invalidateProgressiveRendering(PhotonData::InvalidationReason::All);
         
     }
+    // Splatting while tracing leaves photons_ unwritten, which incremental updates and recomputation rely on.
+    // Trace all photons again when switching back so that photons_ is up to date.
+    bool fusedSplatting = fusedSplatting_ && !enableProgressivePhotonRecomputation_ && !incrementalLightUpdate_ && !recomputationImportanceGrid_.isReady();
+    if (!fusedSplatting && photonData_->hasDepositedIrradiance()) {
+        invalidationFlag_ |= PhotonData::InvalidationReason::All;
+    }
+    photonTracer_.setFusedSplatting(fusedSplatting);
     const Volume* volume = volumePort_.getData().get();
+    if (outOfCoreVolume_ || !BrickedVolumeCL::fitsOnDevice(*volume)) {
+        volume = updateBrickedVolume();
+    } else if (brickedVolume_) {
+        photonTracer_.setBrickedVolume(nullptr);
+        brickedVolume_.reset();
+    }
     auto volumeDim = volume->getDimensions();
     float sceneRadius = getSceneRadius();
     // Texture space spacing
@@ -250,7 +311,8 @@ void ProgressivePhotonTracerCL::process() {
             photonData_->resetIteration();
         }
     if (photonData_->iteration() == 0) {
-        vec4 radiusInTextureSpace = volume->getCoordinateTransformer().getIndexToTextureMatrix()*vec4(vec3(radius_.get()), 0.f);
+        // Radius is given in voxels of the input volume, not the overview of out-of-core volumes
+        vec4 radiusInTextureSpace = volumePort_.getData()->getCoordinateTransformer().getIndexToTextureMatrix()*vec4(vec3(radius_.get()), 0.f);
         float radius = glm::length(vec3(radiusInTextureSpace));
         //radius = photonRadiusScaling+0.001f*(radius_.get()-1.f);
         photonData_->setRadius(radius, sceneRadius); // % of scene size
@@ -262,7 +324,21 @@ void ProgressivePhotonTracerCL::process() {
     std::vector< std::vector<cl::Event> > clEvents;
     // Number of photons to compute this iteration
     auto nPhotonsToCompute = photonData_->getNumberOfPhotons();
-    if (!(static_cast<int>(invalidationFlag_) & static_cast<int>(PhotonData::InvalidationReason::Light)) && recomputationImportanceGrid_.isReady() && photonRecomputationDetector_.isValid()) {
+    // Light changed slightly, replace photons traced from the previous light source over several updates.
+    // Transfer function and volume changes take precedence.
+    bool incrementalLightUpdate = remainingLightPhotonsToUpdate_ > 0 && remainingPhotonsToUpdate_ <= 0 &&
+        !(static_cast<int>(invalidationFlag_) &
+          (static_cast<int>(PhotonData::InvalidationReason::Light) |
+           static_cast<int>(PhotonData::InvalidationReason::TransferFunction) |
+           static_cast<int>(PhotonData::InvalidationReason::Volume)));
+    if (incrementalLightUpdate) {
+        nPhotonsToCompute = traceLightUpdatePhotons(volume, stepSize, batch, maxInteractions, clEvents);
+        if (remainingLightPhotonsToUpdate_ > 0) {
+            progressiveTimer_.start(Timer::Milliseconds(100));
+        } else if (!enableProgressiveRefinement_) {
+            progressiveTimer_.stop();
+        }
+    } else if (!(static_cast<int>(invalidationFlag_) & static_cast<int>(PhotonData::InvalidationReason::Light)) && recomputationImportanceGrid_.isReady() && photonRecomputationDetector_.isValid()) {
         //IVW_CPU_PROFILING("recomputation")
         // Compute update priority and only update changed photons
         
@@ -282,9 +358,10 @@ void ProgressivePhotonTracerCL::process() {
         if ((static_cast<int>(invalidationFlag_) & (static_cast<int>(PhotonData::InvalidationReason::TransferFunction) | static_cast<int>(PhotonData::InvalidationReason::Volume)))) {
             int offset = 0;
             //IVW_CPU_PROFILING("recomputation")
-            auto recomputationImportanceGrid = dynamic_cast<const ImportanceUniformGrid3D*>(recomputationImportanceGrid_.getData().get());
-            if (!recomputationImportanceGrid) {
-                LogError("UniformGrid3DInport require ImportanceUniformGrid3D as input");
+            // Float or quantized importance, see ImportanceUniformGrid3DUInt8
+            auto recomputationImportanceGrid = recomputationImportanceGrid_.getData().get();
+            if (!util::isScalarUniformGrid3DFormat(recomputationImportanceGrid->getDataFormat())) {
+                LogError("UniformGrid3DInport require ImportanceUniformGrid3D (float32, uint16 or uint8) as input");
                 return;
             }
             
@@ -476,55 +553,41 @@ void ProgressivePhotonTracerCL::process() {
             //IVW_OPENCL_PROFILING(tracingProfilingEvent, "Tracing")
             //
             
-            int offset = 0;
-            
+            // Trace photons of all light sources in one dispatch
+            std::vector<const LightSamples*> lightSamples;
             for (auto lightSourceSample = lightSamples_.begin(), end = lightSamples_.end(); lightSourceSample != end; ++lightSourceSample) {
-                
-                clEvents.emplace_back(std::vector<cl::Event>(1));
-                // Only wait first iteration
-                std::vector<cl::Event>* waitForRecomputationDetection = nullptr;
-                if (clEvents.size() > 1) {
-                    waitForRecomputationDetection = &clEvents[clEvents.size() - 2];
-                }
-                
-                // Texture space spacing
-                const mat4 volumeTextureToWorld = volume->getCoordinateTransformer().getTextureToWorldMatrix();
-                
-                auto volumeCL = volume->getRepresentation<VolumeCLGL>();
-                auto lightSamplesCL = lightSourceSample->getLightSamples()->getRepresentation<BufferCLGL>();
-                auto intersectionPointsCL = lightSourceSample->getIntersectionPoints()->getRepresentation<BufferCLGL>();
-                auto photonCL = photonData_->photons_.getEditableRepresentation<BufferCLGL>();
-                
-                auto transferFunctionCL = transferFunction_.get().getData()->getRepresentation<LayerCLGL>();
-                //const ElementBufferCLGL* photonsToRecomputeIndicesCL = recomputedPhotonIndices_->indicesToRecomputedPhotons.getRepresentation<ElementBufferCLGL>();;
-                
-                // Acquire shared representations before using them in OpenGL
-                // The SyncCLGL object will take care of synchronization between OpenGL and OpenCL
-                //{IVW_CPU_PROFILING("Aquire")
-                glSync.addToAquireGLObjectList(volumeCL);
-                glSync.addToAquireGLObjectList(lightSamplesCL);
-                glSync.addToAquireGLObjectList(intersectionPointsCL);
-                glSync.addToAquireGLObjectList(photonCL);
-                glSync.addToAquireGLObjectList(transferFunctionCL);
-                glSync.addToAquireGLObjectList(indicesToRecomputedPhotonsCL);
-                glSync.aquireAllObjects();
-                //}
-                //{IVW_CPU_PROFILING("Tracing (CPU measurement)")
-                photonTracer_.tracePhotons(photonData_.get(), volumeCL, volumeCL->getVolumeStruct(volume), &axisAlignedBoundingBoxCL_
-                                           , transferFunctionCL, advancedMaterial_, stepSize, lightSamplesCL, intersectionPointsCL, lightSourceSample->getSize(), indicesToRecomputedPhotonsCL, recomputedPhotonIndices_->nRecomputedPhotons
-                                           , photonCL, offset, batch, maxInteractions
-                                           , waitForRecomputationDetection, &clEvents.back()[0]);
-                //}
-                
-                
-                glSync.releaseAllGLObjects(&clEvents.back());
-                
-                
-                //photonTracer_.tracePhotons(volume, transferFunction_.get(), &axisAlignedBoundingBoxCL_,
-                //    advancedMaterial_, &camera_.get(), stepSize, (*lightSourceSample).get(), &recomputedPhotonIndices_->indicesToRecomputedPhotons, recomputedPhotonIndices_->nRecomputedPhotons, offset, batch
-                //    , maxInteractions, photonData_.get(), waitForRecomputationDetection, &clEvents.back()[0]);
-                offset += static_cast<int>(lightSourceSample->getSize());
+                lightSamples.push_back((*lightSourceSample).get());
             }
+            auto packedLightSamples = photonTracer_.packLightSamples(lightSamples);
+            
+            clEvents.emplace_back(std::vector<cl::Event>(1));
+            std::vector<cl::Event>* waitForRecomputationDetection = nullptr;
+            if (clEvents.size() > 1) {
+                waitForRecomputationDetection = &clEvents[clEvents.size() - 2];
+            }
+            
+            auto volumeCL = volume->getRepresentation<VolumeCLGL>();
+            auto lightSamplesCL = packedLightSamples->getLightSamples()->getRepresentation<BufferCLGL>();
+            auto intersectionPointsCL = packedLightSamples->getIntersectionPoints()->getRepresentation<BufferCLGL>();
+            auto photonCL = photonData_->photons_.getEditableRepresentation<BufferCLGL>();
+            
+            auto transferFunctionCL = transferFunction_.get().getData()->getRepresentation<LayerCLGL>();
+            
+            // Acquire shared representations before using them in OpenGL
+            // The SyncCLGL object will take care of synchronization between OpenGL and OpenCL
+            glSync.addToAquireGLObjectList(volumeCL);
+            glSync.addToAquireGLObjectList(lightSamplesCL);
+            glSync.addToAquireGLObjectList(intersectionPointsCL);
+            glSync.addToAquireGLObjectList(photonCL);
+            glSync.addToAquireGLObjectList(transferFunctionCL);
+            glSync.addToAquireGLObjectList(indicesToRecomputedPhotonsCL);
+            glSync.aquireAllObjects();
+            photonTracer_.tracePhotons(photonData_.get(), volumeCL, volumeCL->getVolumeStruct(volume), &axisAlignedBoundingBoxCL_
+                                       , transferFunctionCL, advancedMaterial_, stepSize, lightSamplesCL, intersectionPointsCL, packedLightSamples->getSize(), indicesToRecomputedPhotonsCL, recomputedPhotonIndices_->nRecomputedPhotons
+                                       , photonCL, 0, batch, maxInteractions
+                                       , waitForRecomputationDetection, &clEvents.back()[0]);
+            
+            glSync.releaseAllGLObjects(&clEvents.back());
             //clEvents.emplace_back(std::vector<cl::Event>(1));
             resetPhotonImportance(remainingPhotonsOffset_, nPhotonsToCompute);
             
@@ -533,24 +596,29 @@ void ProgressivePhotonTracerCL::process() {
         
         remainingPhotonsOffset_ += nPhotonsToCompute;
         remainingPhotonsToUpdate_ -= static_cast<int>(nPhotonsToCompute);
-        if (remainingPhotonsToUpdate_ > 0 && enableProgressivePhotonRecomputation_) {
+        if ((remainingPhotonsToUpdate_ > 0 || remainingLightPhotonsToUpdate_ > 0) && enableProgressivePhotonRecomputation_) {
             enableProgressiveRefinement_.set(true);
         } else {
             enableProgressiveRefinement_.set(false);
         }
     } else {
-        auto offset = 0;
+        // Trace photons of all light sources in one dispatch
+        std::vector<const LightSamples*> lightSamples;
+        tracedLightDirections_.clear();
         for (auto lightSourceSample = lightSamples_.begin(), end = lightSamples_.end(); lightSourceSample != end; ++lightSourceSample) {
-            clEvents.emplace_back(std::vector<cl::Event>(1));
-            photonTracer_.tracePhotons(volume, transferFunction_.get(), &axisAlignedBoundingBoxCL_,
-                                       advancedMaterial_, &camera_.get(), stepSize, (*lightSourceSample).get(), nullptr, 0, offset, batch
-                                       , maxInteractions, photonData_.get(), nullptr, &clEvents.back()[0]);
-            offset += static_cast<int>(lightSourceSample->getSize());
+            lightSamples.push_back((*lightSourceSample).get());
+            tracedLightDirections_.push_back(lightSourceSample->getLightDirection());
         }
+        clEvents.emplace_back(std::vector<cl::Event>(1));
+        photonTracer_.tracePhotons(volume, transferFunction_.get(), &axisAlignedBoundingBoxCL_,
+                                   advancedMaterial_, &camera_.get(), stepSize, lightSamples, nullptr, 0, batch
+                                   , maxInteractions, photonData_.get(), nullptr, &clEvents.back()[0]);
         recomputedPhotonIndices_->nRecomputedPhotons = -1;
         // Will be withdrawn to zero at end of function
         remainingPhotonsToUpdate_ = 0;
         remainingPhotonsOffset_ = 0;
+        // All photons are up to date with the light sources
+        remainingLightPhotonsToUpdate_ = 0;
         
         if (photonRecomputationImportance_.getSize() > 0) {
             //IVW_CPU_PROFILING("FillBuffer")
@@ -604,6 +672,141 @@ void ProgressivePhotonTracerCL::process() {
     outport_.setData(photonData_);
 }
 
+const Volume* ProgressivePhotonTracerCL::updateBrickedVolume() {
+    if (!brickedVolume_) {
+        brickedVolume_ = std::make_unique<BrickedVolumeCL>(static_cast<size_t>(brickCacheSize_.get()));
+    }
+    brickedVolume_->setBrickCacheSizeInMB(static_cast<size_t>(brickCacheSize_.get()));
+    brickedVolume_->setVolume(volumePort_.getData());
+    if (brickPrioritiesInvalid_ && minMaxGrid_.isReady()) {
+        auto minMaxGrid = dynamic_cast<const MinMaxUniformGrid3D*>(minMaxGrid_.getData().get());
+        if (minMaxGrid) {
+            auto tfRAM = transferFunction_.get().getData()->getRepresentation<LayerRAM>();
+            auto tfSize = tfRAM->getDimensions().x;
+            // Bricks are empty if the transfer function is transparent in their whole value range
+            brickedVolume_->setPriorities(*minMaxGrid, [tfRAM, tfSize](float minValue, float maxValue) {
+                auto first = static_cast<size_t>(minValue * static_cast<float>(tfSize - 1));
+                auto last = std::min(static_cast<size_t>(std::ceil(maxValue * static_cast<float>(tfSize - 1))), tfSize - 1);
+                double maxOpacity = 0.0;
+                for (auto i = first; i <= last; ++i) {
+                    maxOpacity = std::max(maxOpacity, tfRAM->getAsNormalizedDVec4(size2_t(i, 0)).a);
+                }
+                return static_cast<float>(maxOpacity);
+            });
+        } else {
+            LogError("UniformGrid3DInport require MinMaxUniformGrid3D as input");
+        }
+    }
+    brickPrioritiesInvalid_ = false;
+    photonTracer_.setBrickedVolume(brickedVolume_.get());
+    
+    bool wasComplete = brickedVolume_->isComplete();
+    if (brickedVolume_->update(static_cast<size_t>(bricksPerUpdate_.get())) > 0) {
+        streamedBricks_ = true;
+    }
+    if (streamedBricks_ && brickedVolume_->isComplete()) {
+        // Photons were partly traced through the overview where bricks are now resident.
+        // Restarting on every update would prevent progressive refinement from converging while streaming.
+        streamedBricks_ = false;
+        invalidateProgressiveRendering(PhotonData::InvalidationReason::All);
+    }
+    if (!brickedVolume_->isComplete()) {
+        // Continue streaming bricks
+        progressiveTimer_.start(Timer::Milliseconds(100));
+    } else if (!wasComplete && !enableProgressiveRefinement_ && remainingLightPhotonsToUpdate_ <= 0) {
+        progressiveTimer_.stop();
+    }
+    return brickedVolume_->getOverview();
+}
+
+size_t ProgressivePhotonTracerCL::traceLightUpdatePhotons(const Volume* volume, float stepSize, int batch, int maxInteractions, std::vector< std::vector<cl::Event> >& clEvents) {
+    auto nPhotons = photonData_->getNumberOfPhotons();
+    if (nPhotons == 0 || ringIndexToBuffer_ == nullptr) {
+        remainingLightPhotonsToUpdate_ = 0;
+        return 0;
+    }
+    auto maxPhotonsToUpdate = std::max(size_t(1), static_cast<size_t>((lightPhotonsPerUpdate_.get() / 100.f)*nPhotons));
+    auto nPhotonsToCompute = std::min(static_cast<size_t>(remainingLightPhotonsToUpdate_), maxPhotonsToUpdate);
+    auto& indices = recomputedPhotonIndices_->indicesToRecomputedPhotons;
+    if (indices.getSize() != nPhotons) {
+        indices.setSize(nPhotons);
+    }
+    try {
+        // Photons replaced the longest time ago are traced first
+        SyncCLGL glSync;
+        auto indicesCL = indices.getEditableRepresentation<BufferCLGL>();
+        glSync.addToAquireGLObjectList(indicesCL);
+        glSync.aquireAllObjects();
+        size_t workGroupSize = 128;
+        ringIndexToBuffer_->setArg(0, *indicesCL);
+        ringIndexToBuffer_->setArg(1, static_cast<int>(lightUpdateOffset_));
+        ringIndexToBuffer_->setArg(2, static_cast<int>(nPhotons));
+        ringIndexToBuffer_->setArg(3, static_cast<int>(nPhotonsToCompute));
+        clEvents.emplace_back(std::vector<cl::Event>(1));
+        OpenCL::getPtr()->getQueue().enqueueNDRangeKernel(*ringIndexToBuffer_, cl::NullRange, getGlobalWorkGroupSize(nPhotonsToCompute, workGroupSize),
+                                                          workGroupSize, nullptr, &clEvents.back()[0]);
+        glSync.releaseAllGLObjects(&clEvents.back());
+    } catch (cl::Error& err) {
+        LogError(getCLErrorString(err));
+        remainingLightPhotonsToUpdate_ = 0;
+        return 0;
+    }
+    std::vector<const LightSamples*> lightSamples;
+    for (auto lightSourceSample = lightSamples_.begin(), end = lightSamples_.end(); lightSourceSample != end; ++lightSourceSample) {
+        lightSamples.push_back((*lightSourceSample).get());
+    }
+    std::vector<cl::Event> waitForIndices = clEvents.back();
+    clEvents.emplace_back(std::vector<cl::Event>(1));
+    photonTracer_.tracePhotons(volume, transferFunction_.get(), &axisAlignedBoundingBoxCL_,
+                               advancedMaterial_, &camera_.get(), stepSize, lightSamples, &indices, static_cast<int>(nPhotonsToCompute), batch
+                               , maxInteractions, photonData_.get(), &waitForIndices, &clEvents.back()[0]);
+    // Let the light volume remove the previous contribution of the traced photons
+    recomputedPhotonIndices_->nRecomputedPhotons = static_cast<int>(nPhotonsToCompute);
+    lightUpdateOffset_ = (lightUpdateOffset_ + nPhotonsToCompute) % nPhotons;
+    remainingLightPhotonsToUpdate_ -= static_cast<int>(nPhotonsToCompute);
+    if (remainingLightPhotonsToUpdate_ <= 0) {
+        // All photons have been replaced
+        tracedLightDirections_ = pendingLightDirections_;
+    }
+    return nPhotonsToCompute;
+}
+
+void ProgressivePhotonTracerCL::lightSamplesChanged() {
+    std::vector<vec3> lightDirections;
+    bool lightChanged = false;
+    for (auto lightSourceSample = lightSamples_.begin(), end = lightSamples_.end(); lightSourceSample != end; ++lightSourceSample) {
+        lightDirections.push_back(lightSourceSample->getLightDirection());
+        lightChanged |= lightSourceSample->isReset();
+    }
+    if (!lightChanged) {
+        return;
+    }
+    auto isSmallChange = [this](const vec3& a, const vec3& b) {
+        // Unknown direction, e.g. point light
+        if (glm::length(a) <= 0.f || glm::length(b) <= 0.f) {
+            return false;
+        }
+        auto cosAngle = glm::clamp(glm::dot(glm::normalize(a), glm::normalize(b)), -1.f, 1.f);
+        return glm::degrees(std::acos(cosAngle)) <= maxIncrementalLightAngle_.get();
+    };
+    // Compare against the direction that the oldest photons were traced with, 
+    // not the previous change, so that many small changes cannot accumulate beyond maxIncrementalLightAngle_
+    bool incremental = incrementalLightUpdate_.get() && lightDirections.size() == tracedLightDirections_.size() &&
+        !(static_cast<int>(invalidationFlag_) & static_cast<int>(PhotonData::InvalidationReason::Light));
+    for (size_t i = 0; incremental && i < lightDirections.size(); ++i) {
+        incremental = isSmallChange(lightDirections[i], tracedLightDirections_[i]);
+    }
+    if (incremental) {
+        // All photons originate from the previous light source,
+        // keep them valid until they have been replaced
+        remainingLightPhotonsToUpdate_ = static_cast<int>(photonData_->getNumberOfPhotons());
+        pendingLightDirections_ = lightDirections;
+    } else {
+        // tracedLightDirections_ is updated when all photons are traced
+        invalidateProgressiveRendering(PhotonData::InvalidationReason::Light);
+    }
+}
+
 void ProgressivePhotonTracerCL::resetPhotonImportance(size_t offset, size_t nPhotons, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event* event) {
     auto photonImportanceCL = photonRecomputationImportance_.getEditableRepresentation<BufferCL>();
     // Reset importance for the photons that were computed
@@ -688,11 +891,12 @@ void ProgressivePhotonTracerCL::onClipChange() {
 
 void ProgressivePhotonTracerCL::sortIndicesByImportance(const BufferBase* keys, BufferCLBase* keysCL, const BufferBase* data, const BufferCLBase* dataCL, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event) {
     try {
-        if (sortKeysTempBufferSize_ < keys->getSize()*keys->getDataFormat()->getSize() || sortDataTempBufferSize_ < data->getSize()*data->getDataFormat()->getSize()) {
-            recomputationImportanceSorter_->setTemporaryBuffers(cl::Buffer(OpenCL::getPtr()->getContext(), CL_MEM_READ_WRITE, keys->getSize()*keys->getDataFormat()->getSize(), NULL),
-                                                                cl::Buffer(OpenCL::getPtr()->getContext(), CL_MEM_READ_WRITE, data->getSize()*data->getDataFormat()->getSize(), NULL));
-            sortKeysTempBufferSize_ = keys->getSize()*keys->getDataFormat()->getSize();
-            sortDataTempBufferSize_ = data->getSize()*data->getDataFormat()->getSize();
+        auto keysSizeInBytes = keys->getSize()*keys->getDataFormat()->getSize();
+        auto dataSizeInBytes = data->getSize()*data->getDataFormat()->getSize();
+        if (sortKeysTempBuffer_.getCapacity() < keysSizeInBytes || sortDataTempBuffer_.getCapacity() < dataSizeInBytes) {
+            bufferPool_->resize(sortKeysTempBuffer_, keysSizeInBytes);
+            bufferPool_->resize(sortDataTempBuffer_, dataSizeInBytes);
+            recomputationImportanceSorter_->setTemporaryBuffers(sortKeysTempBuffer_.get(), sortDataTempBuffer_.get());
         }
         
         recomputationImportanceSorter_->enqueue(OpenCL::getPtr()->getQueue(), keysCL->get(), dataCL->get(), static_cast<unsigned int>(keys->getSize()), 0, waitForEvents, event);
@@ -707,11 +911,12 @@ void ProgressivePhotonTracerCL::sortIndicesByImportance(const BufferBase* keys,
 
 void ProgressivePhotonTracerCL::sortIndices(const BufferBase* keys, BufferCLBase* keysCL, const BufferBase* values, BufferCLBase* valuesCL, size_t nElements, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event) {
     try {
-        if (sortIndicesTempBufferSize_ < keys->getSize()*keys->getDataFormat()->getSize()) {
-            recomputationIndexSorter_->setTemporaryBuffers(
-                                                           cl::Buffer(OpenCL::getPtr()->getContext(), CL_MEM_READ_WRITE, keys->getSize()*keys->getDataFormat()->getSize(), NULL),
-                                                           cl::Buffer(OpenCL::getPtr()->getContext(), CL_MEM_READ_WRITE, values->getSize()*values->getDataFormat()->getSize(), NULL));
-            sortIndicesTempBufferSize_ = keys->getSize()*keys->getDataFormat()->getSize();
+        auto keysSizeInBytes = keys->getSize()*keys->getDataFormat()->getSize();
+        auto valuesSizeInBytes = values->getSize()*values->getDataFormat()->getSize();
+        if (sortIndicesKeysTempBuffer_.getCapacity() < keysSizeInBytes || sortIndicesValuesTempBuffer_.getCapacity() < valuesSizeInBytes) {
+            bufferPool_->resize(sortIndicesKeysTempBuffer_, keysSizeInBytes);
+            bufferPool_->resize(sortIndicesValuesTempBuffer_, valuesSizeInBytes);
+            recomputationIndexSorter_->setTemporaryBuffers(sortIndicesKeysTempBuffer_.get(), sortIndicesValuesTempBuffer_.get());
         }
         
         recomputationIndexSorter_->enqueue(OpenCL::getPtr()->getQueue(), keysCL->get(), valuesCL->get(), static_cast<unsigned int>(nElements), 0, waitForEvents, event);
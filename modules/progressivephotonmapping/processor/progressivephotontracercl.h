@@ -61,11 +61,14 @@
 
 #include <modules/lightcl/lightsample.h>
 
+#include <modules/progressivephotonmapping/devicebufferpool.h>
 #include <modules/progressivephotonmapping/photondata.h>
 #include <modules/progressivephotonmapping/photontracercl.h>
 #include <modules/progressivephotonmapping/photonrecomputationdetector.h>
 
 #include <modules/importancesamplingcl/importanceuniformgrid3d.h>
+#include <modules/uniformgridcl/brickedvolumecl.h>
+#include <modules/uniformgridcl/minmaxuniformgrid3d.h>
 
 #include <clogs/clogs.h>
 
@@ -77,6 +80,7 @@ namespace inviwo {
  * ### Inports
  *   * __volume__                   Volume data.
  *   * __recomputationImportance__  Optional importance grid.
+ *   * __minMaxGrid__               Optional min-max grid of the volume, prioritizes bricks of out-of-core volumes.
  *   * __LightSamples__             Light source samples.
  * ### Outports
  *   * __photons__ Traced photons.
@@ -125,6 +129,20 @@ protected:
     
     void progressiveRefinementChanged();
     void noSingleScatteringChanged();
+    /**
+     * \brief Upload the next bricks of an out-of-core volume, see BrickedVolumeCL.
+     * Photons are traced again when new bricks became resident.
+     * @return Overview volume to pass to the photon tracer.
+     */
+    const Volume* updateBrickedVolume();
+    /**
+     * \brief Decide if photons should be traced again all at once or
+     * incrementally when a light source changed.
+     * Small changes of the light direction are handled incrementally, see incrementalLightUpdate_.
+     */
+    void lightSamplesChanged();
+    // Trace the lightPhotonsPerUpdate_ least recently traced photons, returns number of traced photons
+    size_t traceLightUpdatePhotons(const Volume* volume, float stepSize, int batch, int maxInteractions, std::vector< std::vector<cl::Event> >& clEvents);
     
     void sortIndicesByImportance(const BufferBase* keys, BufferCLBase* keysCL, const BufferBase* data, const BufferCLBase* dataCL, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event = nullptr);
     void sortIndices(const BufferBase* keys, BufferCLBase* keysCL, const BufferBase* values, BufferCLBase* valuesCL, size_t nElements, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event = nullptr);
@@ -132,14 +150,17 @@ protected:
     void resetPhotonImportance(size_t offset, size_t nPhotons, const VECTOR_CLASS<cl::Event> *waitForEvents = nullptr, cl::Event* event = nullptr);
     // Sorting algorithm
     std::unique_ptr<clogs::Radixsort> recomputationImportanceSorter_;
-    size_t sortKeysTempBufferSize_ = 0;
-    size_t sortDataTempBufferSize_ = 0;
+    std::shared_ptr<DeviceBufferPool> bufferPool_;
+    PooledBuffer sortKeysTempBuffer_;
+    PooledBuffer sortDataTempBuffer_;
     std::unique_ptr<clogs::Radixsort> recomputationIndexSorter_;
-    size_t sortIndicesTempBufferSize_ = 0;
+    PooledBuffer sortIndicesKeysTempBuffer_;
+    PooledBuffer sortIndicesValuesTempBuffer_;
     std::unique_ptr<clogs::Reduce> reduce_;
     private:
     VolumeInport volumePort_;
     UniformGrid3DInport recomputationImportanceGrid_;
+    UniformGrid3DInport minMaxGrid_;
     MultiDataInport<LightSamples> lightSamples_;
     
     DataOutport<PhotonData> outport_;
@@ -152,6 +173,14 @@ protected:
     
     IntProperty maxScatteringEvents_;
     BoolProperty noSingleScattering_;
+    BoolProperty densityLevelOfDetail_; // Trace scattered photons through a density mip pyramid
+    BoolProperty counterBasedRandom_; // Stateless random numbers, no random state per photon
+    BoolProperty wavefrontTracing_; // Trace photons in stages with compacted queues of active paths
+    BoolProperty fusedSplatting_; // Splat photons into a light volume while tracing when all photons are traced each iteration
+    FloatProperty fusedResolutionUpgradeFactor_; // Light volume resolution follows the photon radius in steps of this factor when splatting while tracing
+    BoolProperty outOfCoreVolume_; // Page the volume through a brick cache, always used if the volume does not fit on the device
+    IntProperty brickCacheSize_; // MB
+    IntProperty bricksPerUpdate_;
     // Material properties
     TransferFunctionProperty transferFunction_;
     AdvancedMaterialProperty advancedMaterial_;
@@ -165,6 +194,14 @@ protected:
     BoolProperty equalIncrementalImportance_; // All photons to update receive equal importance.
     size_t remainingPhotonsOffset_ = 0;
     int remainingPhotonsToUpdate_ = -1;
+    // Only recompute a part of the photons each update when light direction changes less than maxIncrementalLightAngle_
+    BoolProperty incrementalLightUpdate_;
+    FloatProperty maxIncrementalLightAngle_; // Degrees
+    FloatProperty lightPhotonsPerUpdate_; // Percentage of photons to trace each update when light changed
+    std::vector<vec3> tracedLightDirections_; // Light direction of each light source inport that all current photons have been traced with
+    std::vector<vec3> pendingLightDirections_; // Light directions that photons are incrementally traced with
+    size_t lightUpdateOffset_ = 0; // Photons are traced in ring order starting at the least recently traced one
+    int remainingLightPhotonsToUpdate_ = 0;
     BoolProperty spatialSorting_;
     // Enables step by step invalidation and
     // other processors to react on an invalidation
@@ -183,6 +220,9 @@ protected:
     BufferCL axisAlignedBoundingBoxCL_;
     
     PhotonTracerCL photonTracer_;
+    std::unique_ptr<BrickedVolumeCL> brickedVolume_; // nullptr if the volume is not paged
+    bool brickPrioritiesInvalid_ = true;
+    bool streamedBricks_ = false; // Bricks have been uploaded since photons were last invalidated by streaming
     
     PhotonRecomputationDetector photonRecomputationDetector_;
     Buffer<unsigned int> photonRecomputationImportance_; // Must be unsigned integer type for sorting to work (radix sort)
@@ -190,6 +230,7 @@ protected:
     std::shared_ptr<RecomputedPhotonIndices> recomputedPhotonIndices_; // Spatially sorted indices
     Buffer<unsigned int> thresholdPhotonRecomputation_;
     cl::Kernel* indexToBuffer_;
+    cl::Kernel* ringIndexToBuffer_;
     cl::Kernel* thresholdKernel_;
     cl::Kernel* lightSampleHashKernel_;
     
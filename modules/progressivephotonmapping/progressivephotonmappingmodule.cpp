@@ -40,7 +40,8 @@
 
 namespace inviwo {
 
-ProgressivePhotonMappingModule::ProgressivePhotonMappingModule(InviwoApplication* app) : InviwoModule(app, "ProgressivePhotonMapping") {
+ProgressivePhotonMappingModule::ProgressivePhotonMappingModule(InviwoApplication* app) : InviwoModule(app, "ProgressivePhotonMapping")
+, deviceBufferPool_(std::make_shared<DeviceBufferPool>()) {
     // Processors
     registerProcessor<PhotonToLightVolumeProcessorCL>();
     registerProcessor<ProgressivePhotonTracerCL>();
@@ -50,4 +51,9 @@ ProgressivePhotonMappingModule::ProgressivePhotonMappingModule(InviwoApplication
     registerPort<DataOutport<PhotonData>>();
 }
 
+ProgressivePhotonMappingModule::~ProgressivePhotonMappingModule() {
+    // Free unused memory while the OpenCL context still exists
+    deviceBufferPool_->trim();
+}
+
 } // namespace
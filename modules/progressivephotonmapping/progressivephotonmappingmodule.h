@@ -35,12 +35,18 @@
 
 #include <inviwo/core/common/inviwomodule.h>
 #include <modules/progressivephotonmapping/progressivephotonmappingmoduledefine.h>
+#include <modules/progressivephotonmapping/devicebufferpool.h>
 namespace inviwo {
 
 class IVW_MODULE_PROGRESSIVEPHOTONMAPPING_API ProgressivePhotonMappingModule : public InviwoModule {
 
 public:
     ProgressivePhotonMappingModule(InviwoApplication* app);
+    virtual ~ProgressivePhotonMappingModule();
+    // Scratch memory shared by the processors in this module
+    std::shared_ptr<DeviceBufferPool> getDeviceBufferPool() const { return deviceBufferPool_; }
+private:
+    std::shared_ptr<DeviceBufferPool> deviceBufferPool_;
 
 };
 
@@ -38,6 +38,11 @@
 */
 #define RANDOM_SEED_TYPE uint
 
+#ifdef RANDOM_PHILOX
+// Stateless alternative, no seed buffer is required
+#include "randomphilox.cl"
+#else
+
 #include "skip_mwc.cl"
 
 //! Represents the state of a particular generator
@@ -94,6 +99,6 @@ float random_01(random_state *r)
     return MWC64X_NextUint(r) / 4294967295.0f;
 }
 
-
+#endif // RANDOM_PHILOX
 
 #endif // RANDOM_CL
\ No newline at end of file
@@ -0,0 +1,93 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2013-2015 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ *********************************************************************************/
+
+#ifndef RANDOM_PHILOX_CL
+#define RANDOM_PHILOX_CL
+
+/*
+ * Philox4x32-10 counter-based random number generator.
+ * J. K. Salmon et al., Parallel random numbers: as easy as 1, 2, 3, SC 2011.
+ *
+ * Random numbers are a function of a counter and a key, so nothing needs
+ * to be stored between kernel invocations. Provides the same functions as the 
+ * MWC64X generator in random.cl, define RANDOM_PHILOX to use it.
+ */
+
+typedef struct { 
+    uint4 ctr;    // (stream, block, 0, 0)
+    uint2 key;
+    uint4 values; // Output of the last block
+    uint index;   // Next value to use in values, 4 means that a new block must be generated
+} random_state;
+
+uint4 philox4x32Round(uint4 ctr, uint2 key) {
+    uint hi0 = mul_hi(0xD2511F53u, ctr.x);
+    uint lo0 = 0xD2511F53u*ctr.x;
+    uint hi1 = mul_hi(0xCD9E8D57u, ctr.z);
+    uint lo1 = 0xCD9E8D57u*ctr.z;
+    return (uint4)(hi1 ^ ctr.y ^ key.x, lo1, hi0 ^ ctr.w ^ key.y, lo0);
+}
+
+uint4 philox4x32_10(uint4 ctr, uint2 key) {
+    ctr = philox4x32Round(ctr, key);
+    for (int i = 1; i < 10; ++i) {
+        key += (uint2)(0x9E3779B9u, 0xBB67AE85u);
+        ctr = philox4x32Round(ctr, key);
+    }
+    return ctr;
+}
+
+/*
+ * Start a new sequence of random numbers. 
+ * Sequences with different stream or key are independent.
+ */
+void initRandState(random_state *s, uint stream, uint2 key) {
+    s->ctr = (uint4)(stream, 0u, 0u, 0u);
+    s->key = key;
+    s->index = 4;
+}
+
+//! Return a 32-bit integer in the range [0..2^32)
+uint Philox_NextUint(random_state *s) {
+    if (s->index >= 4) {
+        s->values = philox4x32_10(s->ctr, s->key);
+        ++s->ctr.y;
+        s->index = 0;
+    }
+    uint res = s->index == 0 ? s->values.x : (s->index == 1 ? s->values.y : (s->index == 2 ? s->values.z : s->values.w));
+    ++s->index;
+    return res;
+}
+
+float random_01(random_state *r)
+{
+    return Philox_NextUint(r) / 4294967295.0f;
+}
+
+#endif // RANDOM_PHILOX_CL
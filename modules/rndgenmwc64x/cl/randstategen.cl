@@ -46,6 +46,27 @@ __kernel void MWC64X_GenerateRandomState(__global uint* seeds, int size) {
     seeds[2*get_global_id(0)+1] = randState.c;
 }
 
+// SplitMix64 finalizer, maps a counter to a well distributed 64-bit value
+ulong splitMix64(ulong z) {
+    z += 0x9E3779B97F4A7C15UL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9UL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBUL;
+    return z ^ (z >> 31);
+}
+
+// Same as MWC64X_GenerateRandomState but the start offset of each stream
+// is computed from the base seed and the work item id instead of being read from seeds.
+__kernel void MWC64X_GenerateRandomStateFromSeed(__global uint* seeds, ulong baseSeed, int size) {
+    if (get_global_id(0) >= size) {
+        return;
+    }
+    random_state randState;
+    ulong offset = splitMix64(splitMix64(baseSeed) + (ulong)get_global_id(0)) >> 32;
+    MWC64X_SeedStreams(&randState, offset, 1099511627776UL);
+    seeds[2*get_global_id(0)] = randState.x;
+    seeds[2*get_global_id(0)+1] = randState.c;
+}
+
 // Seeds are shared among threads and each thread can take maxSamplesPerStream random numbers 
 // from the state
 // To use it you need to choose the maximum possible samples you will take from a single stream
@@ -35,13 +35,12 @@
 #include <modules/opencl/kernelmanager.h>
 #include <modules/opencl/syncclgl.h>
 #include <modules/rndgenmwc64x/mwc64xseedgenerator.h>
-#include <stdlib.h>
 
 namespace inviwo {
 
 MWC64XSeedGenerator::MWC64XSeedGenerator(): kernel_(NULL) { 
     cl::Program* program = KernelManager::getPtr()->buildProgram("randstategen.cl");
-    kernel_ = KernelManager::getPtr()->getKernel(program, "MWC64X_GenerateRandomState", NULL);
+    kernel_ = KernelManager::getPtr()->getKernel(program, "MWC64X_GenerateRandomStateFromSeed", NULL);
 }
 
 MWC64XSeedGenerator::~MWC64XSeedGenerator() {
@@ -53,33 +52,30 @@ void MWC64XSeedGenerator::generateRandomSeeds(Buffer<uvec2>* buffer, unsigned in
         return;
     }
 
-    srand(seed);
-    // MWC64X random number generator
-    BufferRAM* bufferRAM = buffer->getEditableRepresentation<BufferRAM>();
-    uvec2* randomNumbers = static_cast<uvec2*>(bufferRAM->getData());
-    int nRandomSeeds = static_cast<int>(bufferRAM->getSize());
-
-    for (int i = 0; i < nRandomSeeds; ++i) {
-        randomNumbers[i].x = static_cast<cl_uint>(rand());
-    }
-    // Data will be transferred to OpenCL device before new representation is returned.
+    int nRandomSeeds = static_cast<int>(buffer->getSize());
+    // All content is generated on the device
     if (useGLSharing) {
         SyncCLGL glSync;
         BufferCLGL* randomSeedBufferCL = buffer->getEditableRepresentation<BufferCLGL>();
         glSync.addToAquireGLObjectList(randomSeedBufferCL);
         glSync.aquireAllObjects();
-        generateSeeds(randomSeedBufferCL, nRandomSeeds, localWorkGroupSize);
+        generateSeeds(randomSeedBufferCL, nRandomSeeds, seed, localWorkGroupSize);
     } else {
+        if (!buffer->hasRepresentations()) {
+            // Avoid allocating and uploading a host representation that will be overwritten
+            buffer->addRepresentation(std::make_shared<BufferCL>(buffer->getSize(), buffer->getDataFormat(), buffer->getBufferUsage()));
+        }
         BufferCLBase* randomSeedBufferCL = buffer->getEditableRepresentation<BufferCL>();
-        generateSeeds(randomSeedBufferCL, nRandomSeeds, localWorkGroupSize);
+        generateSeeds(randomSeedBufferCL, nRandomSeeds, seed, localWorkGroupSize);
     }
 }
 
-void MWC64XSeedGenerator::generateSeeds(BufferCLBase* randomSeedBufferCL, int nRandomSeeds, size_t localWorkGroupSize) {
+void MWC64XSeedGenerator::generateSeeds(BufferCLBase* randomSeedBufferCL, int nRandomSeeds, glm::u64 seed, size_t localWorkGroupSize) {
     try
     {
         kernel_->setArg(0, *randomSeedBufferCL);
-        kernel_->setArg(1, nRandomSeeds);
+        kernel_->setArg(1, static_cast<cl_ulong>(seed));
+        kernel_->setArg(2, nRandomSeeds);
         size_t globalWorkSizeX = getGlobalWorkGroupSize(nRandomSeeds, localWorkGroupSize);
         OpenCL::getPtr()->getQueue().enqueueNDRangeKernel(*kernel_, 0, globalWorkSizeX, localWorkGroupSize);
     }
@@ -39,6 +39,8 @@ namespace inviwo {
 
 // Generating seed numbers for MWC64X can be very time consuming.
 // This class performs the generation on the GPU to speed up the process.
+// The seed of each stream is derived on the device from the base seed and
+// the stream index, so no data is transferred from the host.
 class IVW_MODULE_RNDGENMWC64X_API MWC64XSeedGenerator {
 
 public:
@@ -60,7 +62,7 @@ public:
     void generateRandomSeeds(Buffer<uvec2>* buffer, unsigned int seed, bool useGLSharing = true, size_t localWorkGroupSize = 256);
 
 protected:
-    void generateSeeds( BufferCLBase* randomSeedBufferCL, int nRandomSeeds, size_t localWorkGroupSize );
+    void generateSeeds( BufferCLBase* randomSeedBufferCL, int nRandomSeeds, glm::u64 seed, size_t localWorkGroupSize );
 
     cl::Kernel* kernel_;
 };
@@ -0,0 +1,282 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2016 Daniel Jönsson
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include "brickedvolumecl.h"
+#include <inviwo/core/datastructures/volume/volumeram.h>
+#include <inviwo/core/datastructures/volume/volumeramprecision.h>
+#include <modules/opencl/buffer/buffercl.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace inviwo {
+
+BrickedVolumeCL::BrickedVolumeCL(size_t brickCacheSizeInMB, int brickSize, size_t maxOverviewDim)
+    : brickCacheSizeInMB_(brickCacheSizeInMB), brickSize_(std::max(brickSize, 1)), maxOverviewDim_(std::max<size_t>(maxOverviewDim, 1)), parameters_(4) {}
+
+bool BrickedVolumeCL::fitsOnDevice(const Volume& volume) {
+    const auto& device = OpenCL::getPtr()->getDevice();
+    const size3_t dim{ volume.getDimensions() };
+    const size3_t maxDim(device.getInfo<CL_DEVICE_IMAGE3D_MAX_WIDTH>(), device.getInfo<CL_DEVICE_IMAGE3D_MAX_HEIGHT>(), device.getInfo<CL_DEVICE_IMAGE3D_MAX_DEPTH>());
+    size_t sizeInBytes = dim.x * dim.y * dim.z * volume.getDataFormat()->getSize();
+    return glm::all(glm::lessThanEqual(dim, maxDim)) && sizeInBytes <= device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>();
+}
+
+void BrickedVolumeCL::setVolume(std::shared_ptr<const Volume> volume) {
+    if (volume == volume_) {
+        return;
+    }
+    volume_ = volume;
+    if (!volume_) {
+        overview_.reset();
+        brickCache_ = cl::Image3D();
+        return;
+    }
+    const size3_t dim{ volume_->getDimensions() };
+    brickGridDim_ = (dim + size3_t(brickSize_ - 1)) / size3_t(brickSize_);
+    priorities_.assign(brickGridDim_.x * brickGridDim_.y * brickGridDim_.z, 1.f);
+    pageTable_.setSize(priorities_.size());
+    try {
+        createOverview();
+        createBrickCache();
+    } catch (cl::Error& err) {
+        LogError(getCLErrorString(err));
+    }
+}
+
+void BrickedVolumeCL::setPriorities(const MinMaxUniformGrid3D& minMaxGrid, const std::function<float(float, float)>& importance) {
+    if (!volume_) {
+        return;
+    }
+    const size3_t dim{ volume_->getDimensions() };
+    const size3_t gridDim{ minMaxGrid.getDimensions() };
+    const size3_t cellDim{ minMaxGrid.getCellDimension() };
+    if (glm::any(glm::equal(gridDim, size3_t(0)))) {
+        return;
+    }
+    auto cells = static_cast<const DataVec2UInt16::type*>(minMaxGrid.getData());
+    for (size_t z = 0; z < brickGridDim_.z; ++z) {
+        for (size_t y = 0; y < brickGridDim_.y; ++y) {
+            for (size_t x = 0; x < brickGridDim_.x; ++x) {
+                size3_t brickCoord(x, y, z);
+                // Include the border voxels since they are also sampled
+                auto voxelStart = glm::max(ivec3(brickCoord) * brickSize_ - 1, ivec3(0));
+                auto voxelEnd = glm::min(ivec3(brickCoord + size3_t(1)) * brickSize_, ivec3(dim) - 1);
+                auto cellStart = glm::min(size3_t(voxelStart) / cellDim, gridDim - size3_t(1));
+                auto cellEnd = glm::min(size3_t(voxelEnd) / cellDim, gridDim - size3_t(1));
+                float minValue = 1.f;
+                float maxValue = 0.f;
+                for (auto cz = cellStart.z; cz <= cellEnd.z; ++cz) {
+                    for (auto cy = cellStart.y; cy <= cellEnd.y; ++cy) {
+                        for (auto cx = cellStart.x; cx <= cellEnd.x; ++cx) {
+                            const auto& cell = cells[util::uniformGrid3DIndex(size3_t(cx, cy, cz), gridDim, minMaxGrid.getLayout())];
+                            minValue = std::min(minValue, static_cast<float>(cell.x) / 65535.f);
+                            maxValue = std::max(maxValue, static_cast<float>(cell.y) / 65535.f);
+                        }
+                    }
+                }
+                priorities_[brickIndex(brickCoord)] = importance(minValue, maxValue);
+            }
+        }
+    }
+    complete_ = false;
+}
+
+size_t BrickedVolumeCL::update(size_t maxBricks) {
+    if (!volume_ || brickCache_() == nullptr) {
+        return 0;
+    }
+    auto pageTable = static_cast<const int*>(pageTable_.getRAMRepresentation()->getData());
+    std::vector<size_t> candidates;
+    for (size_t brick = 0; brick < priorities_.size(); ++brick) {
+        if (pageTable[brick] < 0 && priorities_[brick] > 0.f) {
+            candidates.push_back(brick);
+        }
+    }
+    auto nCandidates = std::min(maxBricks, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + nCandidates, candidates.end(),
+                      [this](size_t a, size_t b) { return priorities_[a] > priorities_[b]; });
+    // Use free slots first, then the slots of the resident bricks with lowest priority
+    std::vector<int> freeSlots;
+    std::vector<int> evictableSlots;
+    for (int slot = 0; slot < static_cast<int>(slotBricks_.size()); ++slot) {
+        if (slotBricks_[slot] < 0) {
+            freeSlots.push_back(slot);
+        } else {
+            evictableSlots.push_back(slot);
+        }
+    }
+    std::sort(evictableSlots.begin(), evictableSlots.end(),
+              [this](int a, int b) { return priorities_[slotBricks_[a]] < priorities_[slotBricks_[b]]; });
+    auto freeSlot = freeSlots.begin();
+    auto evictableSlot = evictableSlots.begin();
+    size_t uploaded = 0;
+    bool cacheFull = false;
+    int* editablePageTable = nullptr;
+    try {
+        for (; uploaded < nCandidates; ++uploaded) {
+            auto brick = candidates[uploaded];
+            int slot = -1;
+            if (freeSlot != freeSlots.end()) {
+                slot = *freeSlot++;
+            } else if (evictableSlot != evictableSlots.end() && priorities_[slotBricks_[*evictableSlot]] < priorities_[brick]) {
+                slot = *evictableSlot++;
+            } else {
+                cacheFull = true;
+                break;
+            }
+            if (!editablePageTable) {
+                // Only upload the page table if it changed
+                editablePageTable = static_cast<int*>(pageTable_.getEditableRAMRepresentation()->getData());
+            }
+            if (slotBricks_[slot] >= 0) {
+                editablePageTable[slotBricks_[slot]] = -1;
+            }
+            uploadBrick(brick, slot);
+            editablePageTable[brick] = slot;
+            slotBricks_[slot] = static_cast<int>(brick);
+        }
+    } catch (cl::Error& err) {
+        LogError(getCLErrorString(err));
+    }
+    complete_ = cacheFull || uploaded == candidates.size();
+    return uploaded;
+}
+
+const BufferCLBase* BrickedVolumeCL::getPageTable() const {
+    return pageTable_.getRepresentation<BufferCL>();
+}
+
+const BufferCLBase* BrickedVolumeCL::getParameters() const {
+    return parameters_.getRepresentation<BufferCL>();
+}
+
+void BrickedVolumeCL::setBrickCacheSizeInMB(size_t val) {
+    if (val == brickCacheSizeInMB_) {
+        return;
+    }
+    brickCacheSizeInMB_ = val;
+    if (volume_) {
+        try {
+            createBrickCache();
+        } catch (cl::Error& err) {
+            LogError(getCLErrorString(err));
+        }
+    }
+}
+
+void BrickedVolumeCL::createOverview() {
+    const size3_t dim{ volume_->getDimensions() };
+    // Same reduction factor along all axes to keep the voxel aspect ratio
+    size_t factor = std::max<size_t>((std::max(dim.x, std::max(dim.y, dim.z)) + maxOverviewDim_ - 1) / maxOverviewDim_, 1);
+    const size3_t overviewDim{ glm::max((dim + size3_t(factor - 1)) / size3_t(factor), size3_t(1)) };
+    auto overviewRAM = std::make_shared<VolumeRAMPrecision<unsigned short>>(overviewDim);
+    auto data = overviewRAM->getDataTyped();
+    auto volumeRAM = volume_->getRepresentation<VolumeRAM>();
+    const dvec2 dataRange = volume_->dataMap_.dataRange;
+    const double invRange = 1.0 / std::max(dataRange.y - dataRange.x, std::numeric_limits<double>::epsilon());
+    // Point sample the center of each factor^3 region
+    for (size_t z = 0; z < overviewDim.z; ++z) {
+        for (size_t y = 0; y < overviewDim.y; ++y) {
+            for (size_t x = 0; x < overviewDim.x; ++x) {
+                size3_t pos = glm::min(size3_t(x, y, z) * factor + size3_t(factor / 2), dim - size3_t(1));
+                double value = glm::clamp((volumeRAM->getAsDouble(pos) - dataRange.x) * invRange, 0.0, 1.0);
+                data[x + overviewDim.x * (y + overviewDim.y * z)] = static_cast<unsigned short>(value * 65535.0 + 0.5);
+            }
+        }
+    }
+    overview_ = std::make_shared<Volume>(overviewRAM);
+    // Same transformation to cover the same space
+    overview_->setModelMatrix(volume_->getModelMatrix());
+    overview_->setWorldMatrix(volume_->getWorldMatrix());
+    overview_->dataMap_.dataRange = dvec2(0.0, 65535.0);
+    overview_->dataMap_.valueRange = volume_->dataMap_.valueRange;
+}
+
+void BrickedVolumeCL::createBrickCache() {
+    const auto& device = OpenCL::getPtr()->getDevice();
+    const size_t paddedBrickSize = brickSize_ + 2;
+    const size_t brickSizeInBytes = paddedBrickSize * paddedBrickSize * paddedBrickSize * sizeof(unsigned short);
+    // No need for more slots than bricks
+    size_t nSlots = std::min(std::max<size_t>(brickCacheSizeInMB_ * 1024 * 1024 / brickSizeInBytes, 1), priorities_.size());
+    const size3_t maxSlotDim(device.getInfo<CL_DEVICE_IMAGE3D_MAX_WIDTH>() / paddedBrickSize,
+                             device.getInfo<CL_DEVICE_IMAGE3D_MAX_HEIGHT>() / paddedBrickSize,
+                             device.getInfo<CL_DEVICE_IMAGE3D_MAX_DEPTH>() / paddedBrickSize);
+    size_t slotsPerAxis = static_cast<size_t>(std::ceil(std::cbrt(static_cast<double>(nSlots))));
+    cacheSlotDim_.x = std::max<size_t>(std::min(slotsPerAxis, maxSlotDim.x), 1);
+    cacheSlotDim_.y = std::max<size_t>(std::min((nSlots + cacheSlotDim_.x - 1) / cacheSlotDim_.x, std::min(slotsPerAxis, maxSlotDim.y)), 1);
+    cacheSlotDim_.z = std::max<size_t>(std::min(nSlots / (cacheSlotDim_.x * cacheSlotDim_.y), maxSlotDim.z), 1);
+
+    // Release the previous cache before allocating the new one
+    brickCache_ = cl::Image3D();
+    brickCache_ = cl::Image3D(OpenCL::getPtr()->getContext(), CL_MEM_READ_ONLY, cl::ImageFormat(CL_R, CL_UNORM_INT16),
+                              cacheSlotDim_.x * paddedBrickSize, cacheSlotDim_.y * paddedBrickSize, cacheSlotDim_.z * paddedBrickSize);
+    slotBricks_.assign(cacheSlotDim_.x * cacheSlotDim_.y * cacheSlotDim_.z, -1);
+    auto pageTable = static_cast<int*>(pageTable_.getEditableRAMRepresentation()->getData());
+    std::fill(pageTable, pageTable + pageTable_.getSize(), -1);
+    complete_ = false;
+
+    auto parameters = static_cast<ivec4*>(parameters_.getEditableRAMRepresentation()->getData());
+    parameters[0] = ivec4(volume_->getDimensions(), 0);
+    parameters[1] = ivec4(brickGridDim_, 0);
+    parameters[2] = ivec4(cacheSlotDim_, 0);
+    parameters[3] = ivec4(brickSize_, static_cast<int>(paddedBrickSize), 0, 0);
+}
+
+void BrickedVolumeCL::uploadBrick(size_t brick, int slot) {
+    const ivec3 dim{ volume_->getDimensions() };
+    const size_t paddedBrickSize = brickSize_ + 2;
+    const size3_t brickCoord(brick % brickGridDim_.x, (brick / brickGridDim_.x) % brickGridDim_.y, brick / (brickGridDim_.x * brickGridDim_.y));
+    const size3_t slotCoord(slot % cacheSlotDim_.x, (slot / cacheSlotDim_.x) % cacheSlotDim_.y, slot / (cacheSlotDim_.x * cacheSlotDim_.y));
+    // Border voxels outside of the volume are clamped to the edge
+    const ivec3 origin = ivec3(brickCoord) * brickSize_ - 1;
+    auto volumeRAM = volume_->getRepresentation<VolumeRAM>();
+    const dvec2 dataRange = volume_->dataMap_.dataRange;
+    const double invRange = 1.0 / std::max(dataRange.y - dataRange.x, std::numeric_limits<double>::epsilon());
+    stagingBrick_.resize(paddedBrickSize * paddedBrickSize * paddedBrickSize);
+    auto dst = stagingBrick_.begin();
+    for (size_t z = 0; z < paddedBrickSize; ++z) {
+        for (size_t y = 0; y < paddedBrickSize; ++y) {
+            for (size_t x = 0; x < paddedBrickSize; ++x) {
+                size3_t pos(glm::clamp(origin + ivec3(x, y, z), ivec3(0), dim - 1));
+                double value = glm::clamp((volumeRAM->getAsDouble(pos) - dataRange.x) * invRange, 0.0, 1.0);
+                *dst++ = static_cast<unsigned short>(value * 65535.0 + 0.5);
+            }
+        }
+    }
+    cl::size_t<3> cacheOrigin;
+    cacheOrigin[0] = slotCoord.x * paddedBrickSize; cacheOrigin[1] = slotCoord.y * paddedBrickSize; cacheOrigin[2] = slotCoord.z * paddedBrickSize;
+    cl::size_t<3> region;
+    region[0] = paddedBrickSize; region[1] = paddedBrickSize; region[2] = paddedBrickSize;
+    // Blocking since the staging memory is reused for the next brick
+    OpenCL::getPtr()->getQueue().enqueueWriteImage(brickCache_, CL_TRUE, cacheOrigin, region, 0, 0, stagingBrick_.data());
+}
+
+} // namespace
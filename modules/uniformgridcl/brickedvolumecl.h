@@ -0,0 +1,139 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2016 Daniel Jönsson
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#ifndef IVW_BRICKEDVOLUMECL_H
+#define IVW_BRICKEDVOLUMECL_H
+
+#include <modules/uniformgridcl/uniformgridclmoduledefine.h>
+#include <inviwo/core/common/inviwo.h>
+#include <inviwo/core/datastructures/buffer/buffer.h>
+#include <inviwo/core/datastructures/volume/volume.h>
+#include <modules/uniformgridcl/minmaxuniformgrid3d.h>
+
+#include <modules/opencl/inviwoopencl.h>
+#include <modules/opencl/buffer/bufferclbase.h>
+
+#include <functional>
+
+namespace inviwo {
+
+/**
+ * Must match BrickedVolumeParameters in uniformgrid/brickedvolume.cl
+ */
+struct BrickedVolumeParameters {
+    ivec4 volumeDim;    // Dimensions of the full resolution volume
+    ivec4 brickGridDim; // Number of bricks along each axis
+    ivec4 cacheSlotDim; // Number of brick slots along each axis of the brick cache
+    ivec4 brickSize;    // x: voxels along each brick axis, y: including the border on both sides
+};
+
+/**
+ * \class BrickedVolumeCL
+ * \brief Paged representation of a volume that is too large to be stored on the device.
+ *
+ * The volume is divided into bricks of brickSize^3 voxels, each stored with a one voxel border 
+ * so that trilinear interpolation never crosses into another brick.
+ * Resident bricks are kept in slots of a device-side brick cache (3D image), 
+ * a page table maps each brick to its slot or -1 if not resident.
+ * Kernels sample it using getVolumeDensity in uniformgrid/brickedvolume.cl (compiled with BRICKED_VOLUME), 
+ * which falls back to a low resolution overview volume for bricks that are not resident.
+ *
+ * Bricks are uploaded on demand in priority order, see setPriorities and update.
+ * The data of the source volume is read from its VolumeRAM representation, 
+ * which hence must be accessible on the host (e.g. memory mapped).
+ */
+class IVW_MODULE_UNIFORMGRIDCL_API BrickedVolumeCL {
+public:
+    BrickedVolumeCL(size_t brickCacheSizeInMB = 512, int brickSize = 32, size_t maxOverviewDim = 256);
+    virtual ~BrickedVolumeCL() = default;
+
+    /**
+     * \brief Check if the volume can be stored as a single image on the device.
+     */
+    static bool fitsOnDevice(const Volume& volume);
+
+    /**
+     * \brief Set volume to page, evicts all bricks and creates the overview volume if the volume changed.
+     */
+    void setVolume(std::shared_ptr<const Volume> volume);
+    const Volume* getVolume() const { return volume_.get(); }
+    /**
+     * \brief Prioritize bricks using the maximum and minimum values of the overlapping cells in a min-max grid.
+     * Bricks with zero importance are empty and will not be uploaded.
+     * All bricks have equal priority if this function is not called.
+     * @param minMaxGrid Min-max grid of the volume, values are normalized in the volume data range.
+     * @param importance Importance of a brick given its normalized min and max value, e.g. maximum opacity of the transfer function in the range.
+     */
+    void setPriorities(const MinMaxUniformGrid3D& minMaxGrid, const std::function<float(float, float)>& importance);
+    /**
+     * \brief Upload at most maxBricks non-resident bricks in order of decreasing priority.
+     * Bricks with lower priority are evicted when the cache is full.
+     * @return Number of uploaded bricks.
+     */
+    size_t update(size_t maxBricks);
+    // True when the last update could not upload any more bricks, 
+    // i.e. all non-empty bricks are resident or the cache is full of bricks with higher priority.
+    bool isComplete() const { return complete_; }
+
+    // Low resolution version of the volume, used where bricks are not resident. Normalized UInt16 data.
+    const Volume* getOverview() const { return overview_.get(); }
+    const cl::Image3D& getBrickCache() const { return brickCache_; }
+    const BufferCLBase* getPageTable() const;
+    const BufferCLBase* getParameters() const;
+
+    size_t getBrickCacheSizeInMB() const { return brickCacheSizeInMB_; }
+    // Evicts all bricks
+    void setBrickCacheSizeInMB(size_t val);
+private:
+    void createOverview();
+    void createBrickCache();
+    void uploadBrick(size_t brick, int slot);
+    size_t brickIndex(const size3_t& brickCoord) const { return brickCoord.x + brickGridDim_.x*(brickCoord.y + brickGridDim_.y*brickCoord.z); }
+
+    size_t brickCacheSizeInMB_;
+    int brickSize_;
+    size_t maxOverviewDim_;
+
+    std::shared_ptr<const Volume> volume_;
+    std::shared_ptr<Volume> overview_;
+    size3_t brickGridDim_;
+    size3_t cacheSlotDim_;
+
+    cl::Image3D brickCache_; // Normalized values, CL_R CL_UNORM_INT16
+    Buffer<int> pageTable_; // Slot of each brick, -1 if not resident
+    std::vector<int> slotBricks_; // Brick in each slot, -1 if free
+    std::vector<float> priorities_; // Priority of each brick, 0 if empty
+    Buffer<glm::ivec4> parameters_; // BrickedVolumeParameters
+    std::vector<unsigned short> stagingBrick_;
+    bool complete_ = false;
+};
+
+} // namespace
+
+#endif // IVW_BRICKEDVOLUMECL_H
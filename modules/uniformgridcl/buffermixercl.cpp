@@ -45,6 +45,10 @@ BufferMixerCL::~BufferMixerCL()  {
 }
 
 void BufferMixerCL::mix(const BufferBase& x, const BufferBase& y, float a, BufferBase& out, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event) {
+    mix(x, 1.f, y, 1.f, a, out, waitForEvents, event);
+}
+
+void BufferMixerCL::mix(const BufferBase& x, float xScale, const BufferBase& y, float yScale, float a, BufferBase& out, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event) {
     
     if (format_ == nullptr || format_ != x.getDataFormat()) {
         format_ = x.getDataFormat();
@@ -59,24 +63,60 @@ void BufferMixerCL::mix(const BufferBase& x, const BufferBase& y, float a, Buffe
         glSync.addToAquireGLObjectList(yCL);
         glSync.addToAquireGLObjectList(outCL);
         glSync.aquireAllObjects();
-        mix(xCL, yCL, a, outCL, out.getSize(), waitForEvents, event);
+        mix(xCL->get(), xScale, yCL->get(), yScale, a, outCL->getEditable(), out.getSize(), waitForEvents, event);
     } else {
         auto xCL = x.getRepresentation<BufferCL>();
         auto yCL = y.getRepresentation<BufferCL>();
         auto outCL = out.getEditableRepresentation<BufferCL>();
-        mix(xCL, yCL, a, outCL, out.getSize(), waitForEvents, event);
+        mix(xCL->get(), xScale, yCL->get(), yScale, a, outCL->getEditable(), out.getSize(), waitForEvents, event);
     }
     
     
 }
 
+void BufferMixerCL::mix(const cl::Buffer& xCL, const cl::Buffer& yCL, float a, BufferBase& out, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event) {
+    mix(xCL, 1.f, yCL, 1.f, a, out, waitForEvents, event);
+}
+
+void BufferMixerCL::mix(const cl::Buffer& xCL, float xScale, const cl::Buffer& yCL, float yScale, float a, BufferBase& out, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event) {
+    
+    if (format_ == nullptr || format_ != out.getDataFormat()) {
+        format_ = out.getDataFormat();
+        compileKernel();
+    }
+    if (useGLSharing_) {
+        SyncCLGL glSync;
+        auto outCL = out.getEditableRepresentation<BufferCLGL>();
+        glSync.addToAquireGLObjectList(outCL);
+        glSync.aquireAllObjects();
+        mix(xCL, xScale, yCL, yScale, a, outCL->getEditable(), out.getSize(), waitForEvents, event);
+    } else {
+        auto outCL = out.getEditableRepresentation<BufferCL>();
+        mix(xCL, xScale, yCL, yScale, a, outCL->getEditable(), out.getSize(), waitForEvents, event);
+    }
+}
+
+void BufferMixerCL::mix(const cl::Buffer& xCL, const cl::Buffer& yCL, float a, const DataFormatBase* format, cl::Buffer& outCL, size_t nElements, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event) {
+    if (format_ == nullptr || format_ != format) {
+        format_ = format;
+        compileKernel();
+    }
+    mix(xCL, 1.f, yCL, 1.f, a, outCL, nElements, waitForEvents, event);
+}
+
 void BufferMixerCL::mix(const BufferCLBase* xCL, const BufferCLBase* yCL, float a, BufferCLBase* outCL, size_t nElements, const VECTOR_CLASS<cl::Event> * waitForEvents, cl::Event * event) {
+    mix(xCL->get(), 1.f, yCL->get(), 1.f, a, outCL->getEditable(), nElements, waitForEvents, event);
+}
+
+void BufferMixerCL::mix(const cl::Buffer& xCL, float xScale, const cl::Buffer& yCL, float yScale, float a, cl::Buffer& outCL, size_t nElements, const VECTOR_CLASS<cl::Event> * waitForEvents, cl::Event * event) {
     int argIndex = 0;
-    kernel_->setArg(argIndex++, *xCL);
-    kernel_->setArg(argIndex++, *yCL);
+    kernel_->setArg(argIndex++, xCL);
+    kernel_->setArg(argIndex++, yCL);
     kernel_->setArg(argIndex++, a);
+    kernel_->setArg(argIndex++, xScale);
+    kernel_->setArg(argIndex++, yScale);
     kernel_->setArg(argIndex++, static_cast<unsigned int>(nElements));
-    kernel_->setArg(argIndex++, *outCL);
+    kernel_->setArg(argIndex++, outCL);
     
     
     size_t globalWorkSizeX = getGlobalWorkGroupSize(nElements, workGroupSize_);
@@ -99,7 +139,7 @@ std::string dataFormatToOpenCLType(const DataFormatBase* dataFormat) {
         result = "double";
         break;
         case DataFormatId::Int8:
-        result = "uchar";
+        result = "char";
         break;
         case DataFormatId::Int16:
         result = "short";
@@ -233,9 +273,15 @@ void BufferMixerCL::compileKernel() {
     
     std::stringstream header;
     header << " #define MIX_T " << dataFormatToOpenCLType(format_) << '\n';
-    if (format_->getComponents() > 1 && format_->getNumericType() != NumericType::Float) {
-        header << " #define CONVERT_T_TO_FLOAT convert_float" << format_->getComponents() << " \n";
-        header << " #define CONVERT_FLOAT_TO_T convert_" << dataFormatToOpenCLType(format_) << "\n";
+    if (format_->getNumericType() != NumericType::Float) {
+        // mix is only defined for floating point types. Integer types, including scalar
+        // uint8/uint16 volumes and quantized grids, are mixed as float and rounded back with saturation
+        header << " #define CONVERT_T_TO_FLOAT convert_float";
+        if (format_->getComponents() > 1) {
+            header << format_->getComponents();
+        }
+        header << " \n";
+        header << " #define CONVERT_FLOAT_TO_T convert_" << dataFormatToOpenCLType(format_) << "_sat_rte\n";
     } else if (format_->getNumericType() == NumericType::Float){
         //header << " #define CONVERT_T  \n";
         //header << " #define CONVERT_FLOAT_TO_T   \n";
@@ -243,6 +289,8 @@ void BufferMixerCL::compileKernel() {
     
     kernel_ = addKernel("buffermixer.cl", "mixKernel", header.str());
     if (!kernel_) {
+        // Try again on the next call instead of using the missing kernel
+        format_ = nullptr;
         std::string msg("Could not compile kernel in buffermix.cl with header " + header.str());
         throw std::runtime_error(msg);
     }
@@ -44,6 +44,11 @@ namespace inviwo {
  * \class BufferMixerCL
  * \brief mix two buffers
  * 
+ * Buffers are mixed element-wise, so the data of UniformGrid3D can be mixed
+ * independent of its UniformGrid3DLayout as long as all grids use the same layout.
+ * Integer formats are mixed as float and rounded back. Quantized grids with different 
+ * value scales are mixed by passing their scales relative to the value scale of out.
+ * The mix functions throw std::runtime_error if the kernel cannot be compiled for the format.
  */
 class IVW_MODULE_UNIFORMGRIDCL_API BufferMixerCL : public KernelOwner {
 public:
@@ -51,8 +56,24 @@ public:
     virtual ~BufferMixerCL();
 
     void mix(const BufferBase& x, const BufferBase& y, float a, BufferBase& out, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event = nullptr);
+    /**
+     * \brief out = mix(x*xScale, y*yScale, a), used for grids quantized with different
+     * value scales, see UniformGrid3DBase::getValueScale.
+     */
+    void mix(const BufferBase& x, float xScale, const BufferBase& y, float yScale, float a, BufferBase& out, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event = nullptr);
 
     void mix(const BufferCLBase* xCL, const BufferCLBase* yCL, float a, BufferCLBase* outCL, size_t nElements, const VECTOR_CLASS<cl::Event> * waitForEvents, cl::Event * event);
+    /**
+     * \brief Mix buffers already resident on the device, for example prefetched by UniformGrid3DPrefetcherCL.
+     * x and y must have the same data format and size as out.
+     */
+    void mix(const cl::Buffer& xCL, const cl::Buffer& yCL, float a, BufferBase& out, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event = nullptr);
+    void mix(const cl::Buffer& xCL, float xScale, const cl::Buffer& yCL, float yScale, float a, BufferBase& out, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event = nullptr);
+    /**
+     * \brief Mix raw device data with elements of the given format, for example voxels of a volume.
+     * The result is written to outCL, which must hold at least nElements.
+     */
+    void mix(const cl::Buffer& xCL, const cl::Buffer& yCL, float a, const DataFormatBase* format, cl::Buffer& outCL, size_t nElements, const VECTOR_CLASS<cl::Event> *waitForEvents, cl::Event *event = nullptr);
 
     void compileKernel();
 
@@ -61,6 +82,8 @@ public:
     bool useGLSharing() const { return useGLSharing_; }
     void useGLSharing(bool val) { useGLSharing_ = val; }
 protected:
+    void mix(const cl::Buffer& xCL, float xScale, const cl::Buffer& yCL, float yScale, float a, cl::Buffer& outCL, size_t nElements, const VECTOR_CLASS<cl::Event> * waitForEvents, cl::Event * event);
+
     const DataFormatBase* format_;
     cl::Kernel* kernel_;
     size_t workGroupSize_;
@@ -34,16 +34,17 @@
 # define MIX_T int 
 #endif
 
-__kernel void mixKernel(__global const MIX_T *x, __global const MIX_T *y, float a, uint len, __global MIX_T *out)
+// out = mix(x*xScale, y*yScale, a), scales are 1 unless mixing quantized grids with different value scales
+__kernel void mixKernel(__global const MIX_T *x, __global const MIX_T *y, float a, float xScale, float yScale, uint len, __global MIX_T *out)
 {
     uint index = get_global_id(0);
     if (index >= len) {
         return;
     }
 #ifdef CONVERT_T_TO_FLOAT
-    out[index] = CONVERT_FLOAT_TO_T(mix(CONVERT_T_TO_FLOAT(x[index]), CONVERT_T_TO_FLOAT(y[index]), a));
+    out[index] = CONVERT_FLOAT_TO_T(mix(xScale*CONVERT_T_TO_FLOAT(x[index]), yScale*CONVERT_T_TO_FLOAT(y[index]), a));
 #else
-    out[index] = mix(x[index], y[index], a);
+    out[index] = mix(xScale*x[index], yScale*y[index], a);
 #endif
 }
 
@@ -0,0 +1,87 @@
+﻿/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2016 Daniel Jönsson
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#ifndef BRICKED_VOLUME_CL
+#define BRICKED_VOLUME_CL
+
+#include "samplers.cl" 
+
+// Must match BrickedVolumeParameters in brickedvolumecl.h
+typedef struct BrickedVolumeParameters {
+    int4 volumeDim;    // Dimensions of the full resolution volume
+    int4 brickGridDim; // Number of bricks along each axis
+    int4 cacheSlotDim; // Number of brick slots along each axis of the brick cache
+    int4 brickSize;    // x: voxels along each brick axis, y: including the border on both sides
+} BrickedVolumeParameters;
+
+__constant sampler_t brickCacheSampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_LINEAR;
+
+// Normalized data value at texture coordinate pos.
+// Resident bricks are sampled from the brick cache using the page table,
+// the others from the low resolution overview volume.
+float getBrickedVolumeVoxel(read_only image3d_t overview, __constant VolumeParameters* overviewParams
+    , read_only image3d_t brickCache, __global const int* brickPageTable, __constant BrickedVolumeParameters* params
+    , const float3 pos) {
+    // Voxel centers at integer coordinates
+    float3 voxel = pos*convert_float3(params->volumeDim.xyz) - 0.5f;
+    int3 brick = clamp(convert_int3(floor(voxel / convert_float(params->brickSize.x))), (int3)(0), params->brickGridDim.xyz - 1);
+    int slot = brickPageTable[brick.x + params->brickGridDim.x*(brick.y + params->brickGridDim.y*brick.z)];
+    if (slot < 0) {
+        return getNormalizedVoxel(overview, overviewParams, as_float4(pos)).x;
+    }
+    int3 slotCoord = (int3)(slot % params->cacheSlotDim.x, (slot / params->cacheSlotDim.x) % params->cacheSlotDim.y, slot / (params->cacheSlotDim.x*params->cacheSlotDim.y));
+    // Stay within the border of the brick so that neighboring slots are never interpolated
+    float3 local = clamp(voxel - convert_float3(brick*params->brickSize.x), -0.5f, convert_float(params->brickSize.x));
+    // Skip border voxel and move to texel center
+    float3 cacheCoord = convert_float3(slotCoord*params->brickSize.y) + local + 1.5f;
+    return read_imagef(brickCache, brickCacheSampler, (float4)(cacheCoord, 0.f)).x;
+}
+
+// Functions sampling the density take VOLUME_SAMPLER_ARGS_DECL and are called with VOLUME_SAMPLER_ARGS, 
+// kernels add BRICKED_VOLUME_KERNEL_ARGS after their volume parameters.
+// volumeTex is the overview volume when BRICKED_VOLUME is defined.
+#ifdef BRICKED_VOLUME
+#define VOLUME_SAMPLER_ARGS_DECL read_only image3d_t volumeTex, __constant VolumeParameters* volumeParams, read_only image3d_t brickCache, __global const int* brickPageTable, __constant BrickedVolumeParameters* brickedVolumeParams
+#define VOLUME_SAMPLER_ARGS volumeTex, volumeParams, brickCache, brickPageTable, brickedVolumeParams
+#define BRICKED_VOLUME_KERNEL_ARGS , read_only image3d_t brickCache, __global const int* brickPageTable, __constant BrickedVolumeParameters* brickedVolumeParams
+#else
+#define VOLUME_SAMPLER_ARGS_DECL read_only image3d_t volumeTex, __constant VolumeParameters* volumeParams
+#define VOLUME_SAMPLER_ARGS volumeTex, volumeParams
+#define BRICKED_VOLUME_KERNEL_ARGS
+#endif
+
+float getVolumeDensity(VOLUME_SAMPLER_ARGS_DECL, const float3 pos) {
+#ifdef BRICKED_VOLUME
+    return getBrickedVolumeVoxel(volumeTex, volumeParams, brickCache, brickPageTable, brickedVolumeParams, pos);
+#else
+    return getNormalizedVoxel(volumeTex, volumeParams, as_float4(pos)).x;
+#endif
+}
+
+#endif // BRICKED_VOLUME_CL
@@ -35,6 +35,82 @@
 
 #define OPTIMIZE_STEP_FOR_SIMD
 
+// See UniformGrid3DLayout
+#define UNIFORM_GRID_LAYOUT_LINEAR 0
+#define UNIFORM_GRID_LAYOUT_MORTON 1
+
+/*
+ * Index of the element storing cellCoord in the grid data.
+ * The Morton layout stores tiles of 4x4x4 cells in linear order 
+ * and the cells within each tile in Morton (Z-) order.
+ * @param gridDim xyz number of cells, w layout (UNIFORM_GRID_LAYOUT_X)
+ */
+inline int uniformGridCellIndex(int3 cellCoord, int4 gridDim) {
+    if (gridDim.w == UNIFORM_GRID_LAYOUT_MORTON) {
+        int3 tiles = (gridDim.xyz + 3) >> 2;
+        int3 tile = cellCoord >> 2;
+        int3 local = cellCoord & 3;
+        int tileIndex = tile.x + tiles.x*(tile.y + tiles.y*tile.z);
+        return (tileIndex << 6) | (local.x & 1) | ((local.y & 1) << 1) | ((local.z & 1) << 2)
+            | ((local.x & 2) << 2) | ((local.y & 2) << 3) | ((local.z & 2) << 4);
+    }
+    return cellCoord.x + gridDim.x*(cellCoord.y + gridDim.y*cellCoord.z);
+}
+
+/*
+ * Cell coordinate stored at index, inverse of uniformGridCellIndex.
+ * Padding elements of the Morton layout map to coordinates outside of the grid.
+ */
+inline int3 uniformGridCellCoordinate(int index, int4 gridDim) {
+    if (gridDim.w == UNIFORM_GRID_LAYOUT_MORTON) {
+        int3 tiles = (gridDim.xyz + 3) >> 2;
+        int tileIndex = index >> 6;
+        int m = index & 63;
+        int3 tile = (int3)(tileIndex % tiles.x, (tileIndex / tiles.x) % tiles.y, tileIndex / (tiles.x*tiles.y));
+        int3 local = (int3)((m & 1) | ((m >> 2) & 2), ((m >> 1) & 1) | ((m >> 3) & 2), ((m >> 2) & 1) | ((m >> 4) & 2));
+        return (tile << 2) + local;
+    }
+    return (int3)(index % gridDim.x, (index / gridDim.x) % gridDim.y, index / (gridDim.x*gridDim.y));
+}
+
+// Number of elements in the grid data, including padding
+inline int uniformGridStorageSize(int4 gridDim) {
+    if (gridDim.w == UNIFORM_GRID_LAYOUT_MORTON) {
+        int3 tiles = (gridDim.xyz + 3) >> 2;
+        return (tiles.x*tiles.y*tiles.z) << 6;
+    }
+    return gridDim.x*gridDim.y*gridDim.z;
+}
+
+/*
+ * Scale converting stored values of a scalar grid to actual values, see util::uniformGrid3DValueScaleCL.
+ * @param valueScale UniformGrid3DBase::getValueScaleBuffer, not positive if all stored values are zero
+ * @param elementSize Size in bytes of each element: 4 (float), 2 (ushort) or 1 (uchar)
+ */
+inline float uniformGridValueScale(__global const float* valueScale, int elementSize) {
+    float scale = valueScale[0] > 0.f ? valueScale[0] : 1.f;
+    if (elementSize == 1) {
+        return scale / 255.f;
+    } else if (elementSize == 2) {
+        return scale / 65535.f;
+    }
+    return scale;
+}
+
+/*
+ * Actual value of a scalar grid element stored as float, or quantized to unsigned 8-bit or 16-bit integers.
+ * @param elementSize Size in bytes of each element: 4 (float), 2 (ushort) or 1 (uchar)
+ * @param scale Converts stored values to actual values, see uniformGridValueScale
+ */
+inline float uniformGridValue(__global const uchar* data, int index, int elementSize, float scale) {
+    if (elementSize == 1) {
+        return scale*convert_float(data[index]);
+    } else if (elementSize == 2) {
+        return scale*convert_float(((__global const ushort*)data)[index]);
+    }
+    return scale*((__global const float*)data)[index];
+}
+
 void setupUniformGridTraversal(float3 x1, float3 x2, float3 cellDim, int3 maxCells
                                , int3* cellCoord, int3* cellCoordEnd, int3* di, float3* dt, float3* deltatx) {
     // x in [0 dim]
@@ -0,0 +1,79 @@
+﻿/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2016 Daniel Jönsson
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#ifndef UNIFORMGRID_QUANTIZATION_CL
+#define UNIFORMGRID_QUANTIZATION_CL
+
+#ifndef QUANTIZED_T
+# define QUANTIZED_T uchar
+# define CONVERT_TO_QUANTIZED convert_uchar_sat_rte
+#endif
+
+/*
+ * Largest value of data, written as the bits of a non-negative float so that
+ * atomic_max on unsigned integers gives the same order as on floats.
+ * maxValue must be initialized to zero. Reduces within each work group before the atomic.
+ */
+__kernel void uniformGridMaxValueKernel(__global const float* data, int nElements
+    , __local float* groupMax, volatile __global uint* maxValue) {
+    int index = get_global_id(0);
+    int localId = get_local_id(0);
+    int localSize = get_local_size(0);
+    groupMax[localId] = index < nElements ? fmax(data[index], 0.f) : 0.f;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    // Works for any work group size
+    for (int stride = 1; stride < localSize; stride <<= 1) {
+        if ((localId % (2*stride)) == 0 && localId + stride < localSize) {
+            groupMax[localId] = fmax(groupMax[localId], groupMax[localId + stride]);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    if (localId == 0) {
+        atomic_max(maxValue, as_uint(groupMax[0]));
+    }
+}
+
+/*
+ * Normalize data by the value computed by uniformGridMaxValueKernel and 
+ * store it in [0 maxStored] (255 for uchar, 65535 for ushort).
+ * Positive values are stored as at least one so that they remain distinguishable from zero.
+ */
+__kernel void uniformGridQuantizeKernel(__global const float* data, int nElements
+    , __global const uint* maxValue, float maxStored, __global QUANTIZED_T* out) {
+    int index = get_global_id(0);
+    if (index >= nElements) {
+        return;
+    }
+    float maxData = as_float(maxValue[0]);
+    float toStored = maxData > 0.f ? maxStored / maxData : 0.f;
+    float value = data[index];
+    out[index] = value > 0.f ? max(CONVERT_TO_QUANTIZED(value*toStored), (QUANTIZED_T)1) : (QUANTIZED_T)0;
+}
+
+#endif // UNIFORMGRID_QUANTIZATION_CL
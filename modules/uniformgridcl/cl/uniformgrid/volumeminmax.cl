@@ -28,11 +28,27 @@
  *********************************************************************************/
 
 #include "samplers.cl" 
-#include "image3d_write.cl" 
+#include "uniformgrid/uniformgrid.cl" 
+
+// Minimum and maximum normalized value of the voxels in [startCoord endCoord)
+float2 volumeRegionMinMax(read_only image3d_t volumeIn, __constant VolumeParameters* volumeParams
+    , int4 startCoord, int4 endCoord) {
+    float2 minMaxVal = (float2)(FLT_MAX, 0);
+    for (int z = startCoord.z; z < endCoord.z; ++z) {
+        for (int y = startCoord.y; y < endCoord.y; ++y) {
+            for (int x = startCoord.x; x < endCoord.x; ++x) {
+                float value = getNormalizedVoxelUnorm(volumeIn, volumeParams, (int4)(x, y, z, 0)).x;
+                minMaxVal.x = min(minMaxVal.x, value);
+                minMaxVal.y = max(minMaxVal.y, value);
+            }
+        }
+    }
+    return minMaxVal;
+}
 
 __kernel void volumeMinMaxKernel(read_only image3d_t volumeIn, __constant VolumeParameters* volumeParams
-    , image_3d_write_vec2_uint16_t volumeOut
-    , int4 outDim
+    , __global ushort2* volumeOut
+    , int4 outDim // xyz number of cells, w layout, see uniformGridCellIndex
     , int4 region
     )
 {
@@ -40,22 +56,103 @@ __kernel void volumeMinMaxKernel(read_only image3d_t volumeIn, __constant Volume
     int3 globalId = (int3)(get_global_id(0), get_global_id(1), get_global_id(2));  
 
     
+    if (any(globalId>=outDim.xyz)) {
+        return;
+    }
+    int4 startCoord = (int4)(globalId*region.xyz, 0);
+    int4 endCoord = min(startCoord+region, get_image_dim(volumeIn));
+    float2 minMaxVal = volumeRegionMinMax(volumeIn, volumeParams, startCoord, endCoord);
+
+    volumeOut[uniformGridCellIndex(globalId, outDim)] = convert_ushort2_sat_rte(minMaxVal*65535.f);
+
+}
+
+// Several volumes of equal size are stacked along z in volumeIn. 
+// Output of each volume is stored after each other.
+__kernel void volumeMinMaxBatchKernel(read_only image3d_t volumeIn, __constant VolumeParameters* volumeParams
+    , __global ushort2* volumeOut
+    , int4 outDim // Output dimensions of one volume, w layout
+    , int4 region
+    , int4 volumeDim // Dimensions of one volume
+    , int nVolumes
+    )
+{
+    int3 globalId = (int3)(get_global_id(0), get_global_id(1), get_global_id(2));  
+
+    if (any(globalId.xy>=outDim.xy) || globalId.z >= outDim.z*nVolumes) {
+        return;
+    }
+    int volumeIndex = globalId.z / outDim.z;
+    int3 cellId = (int3)(globalId.xy, globalId.z - volumeIndex*outDim.z);
+    int4 startCoord = (int4)(cellId*region.xyz, 0);
+    int4 endCoord = min(startCoord+region, volumeDim);
+    // Do not cross into the next volume
+    int4 zOffset = (int4)(0, 0, volumeIndex*volumeDim.z, 0);
+    float2 minMaxVal = volumeRegionMinMax(volumeIn, volumeParams, startCoord + zOffset, endCoord + zOffset);
+
+    volumeOut[volumeIndex*uniformGridStorageSize(outDim) + uniformGridCellIndex(cellId, outDim)] = convert_ushort2_sat_rte(minMaxVal*65535.f);
+
+}
+
+// Recompute the cells in cellIndices only, used when updating the grid of the 
+// previous timestep. The other cells of volumeOut keep their values.
+__kernel void volumeMinMaxCellsKernel(read_only image3d_t volumeIn, __constant VolumeParameters* volumeParams
+    , __global ushort2* volumeOut
+    , int4 outDim // xyz number of cells, w layout, see uniformGridCellIndex
+    , int4 region
+    , __global const int* cellIndices // x + outDim.x*(y + outDim.y*z), independent of layout
+    , int nCells
+    )
+{
+    int id = get_global_id(0);
+    if (id >= nCells) {
+        return;
+    }
+    int cellIndex = cellIndices[id];
+    int3 cellId = (int3)(cellIndex % outDim.x, (cellIndex / outDim.x) % outDim.y, cellIndex / (outDim.x*outDim.y));
+    int4 startCoord = (int4)(cellId*region.xyz, 0);
+    int4 endCoord = min(startCoord+region, get_image_dim(volumeIn));
+    float2 minMaxVal = volumeRegionMinMax(volumeIn, volumeParams, startCoord, endCoord);
+
+    volumeOut[uniformGridCellIndex(cellId, outDim)] = convert_ushort2_sat_rte(minMaxVal*65535.f);
+}
+
+// Min-max of volumeIn and mean absolute difference to nextVolumeIn in each cell, 
+// reading the voxels of both volumes once. Volumes must have equal dimensions.
+// Differences are of normalized values and encoded as in DynamicVolumeDifferenceAnalysis, 
+// i.e. unchanged cells are at -differenceOffset.
+__kernel void volumeMinMaxDifferenceKernel(read_only image3d_t volumeIn, __constant VolumeParameters* volumeParams
+    , read_only image3d_t nextVolumeIn, __constant VolumeParameters* nextVolumeParams
+    , __global ushort2* minMaxOut
+    , __global float* differenceOut
+    , int4 outDim // xyz number of cells, w layout, see uniformGridCellIndex
+    , int4 region
+    , float differenceScale // (defaultRange.y - defaultRange.x)/(dataRange.y - dataRange.x), see DynamicVolumeDifferenceAnalysis
+    , float differenceOffset // dataRange.x/(dataRange.y - dataRange.x)
+    )
+{
+    int3 globalId = (int3)(get_global_id(0), get_global_id(1), get_global_id(2));  
     if (any(globalId>=outDim.xyz)) {
         return;
     }
     float2 minMaxVal = (float2)(FLT_MAX, 0);
+    float absDiffSum = 0.f;
     int4 startCoord = (int4)(globalId*region.xyz, 0);
     int4 endCoord = min(startCoord+region, get_image_dim(volumeIn));
     for (int z = startCoord.z; z < endCoord.z; ++z) {
         for (int y = startCoord.y; y < endCoord.y; ++y) {
             for (int x = startCoord.x; x < endCoord.x; ++x) {
-                float value = getNormalizedVoxelUnorm(volumeIn, volumeParams, (int4)(x, y, z, 0)).x;
+                int4 voxel = (int4)(x, y, z, 0);
+                float value = getNormalizedVoxelUnorm(volumeIn, volumeParams, voxel).x;
+                float nextValue = getNormalizedVoxelUnorm(nextVolumeIn, nextVolumeParams, voxel).x;
                 minMaxVal.x = min(minMaxVal.x, value);
                 minMaxVal.y = max(minMaxVal.y, value);
+                absDiffSum += fabs(nextValue - value);
             }
         }
     }
-
-    writeImageVec2UInt16f(volumeOut, as_int4(globalId), outDim, minMaxVal);
-
-}
\ No newline at end of file
+    int index = uniformGridCellIndex(globalId, outDim);
+    minMaxOut[index] = convert_ushort2_sat_rte(minMaxVal*65535.f);
+    // Mean over the whole region, also at the border of the volume
+    differenceOut[index] = differenceScale * absDiffSum / convert_float(region.x*region.y*region.z) - differenceOffset;
+}
@@ -0,0 +1,208 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2016 Daniel Jnsson
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include "gridcompression.h"
+#include <inviwo/core/util/exception.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace inviwo {
+
+namespace util {
+
+namespace {
+
+constexpr size_t minMatchLength = 4;
+constexpr size_t maxMatchOffset = 65535;
+constexpr int hashBits = 16;
+
+uint32_t readUInt32(const unsigned char* p) {
+    uint32_t val;
+    std::memcpy(&val, p, sizeof(val));
+    return val;
+}
+
+size_t hashSequence(uint32_t sequence) {
+    return static_cast<size_t>((sequence * 2654435761u) >> (32 - hashBits));
+}
+
+// Lengths >= 15 are stored as 15 in the token followed by bytes of 255 and a terminating byte < 255
+void writeLength(std::vector<unsigned char>& out, size_t length) {
+    while (length >= 255) {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back(static_cast<unsigned char>(length));
+}
+
+void writeSequence(std::vector<unsigned char>& out, const unsigned char* literals, size_t nLiterals,
+                   size_t matchOffset, size_t matchLength) {
+    auto literalToken = std::min<size_t>(nLiterals, 15);
+    auto matchToken = matchLength > 0 ? std::min<size_t>(matchLength - minMatchLength, 15) : 0;
+    out.push_back(static_cast<unsigned char>((literalToken << 4) | matchToken));
+    if (literalToken == 15) {
+        writeLength(out, nLiterals - 15);
+    }
+    out.insert(out.end(), literals, literals + nLiterals);
+    if (matchLength > 0) {
+        out.push_back(static_cast<unsigned char>(matchOffset & 0xFF));
+        out.push_back(static_cast<unsigned char>(matchOffset >> 8));
+        if (matchToken == 15) {
+            writeLength(out, matchLength - minMatchLength - 15);
+        }
+    }
+}
+
+size_t readLength(const unsigned char*& src, const unsigned char* srcEnd) {
+    size_t length = 0;
+    unsigned char val;
+    do {
+        if (src >= srcEnd) {
+            throw Exception(IVW_CONTEXT_CUSTOM("decompressGridChunk"), "Corrupt grid chunk: unexpected end of data");
+        }
+        val = *src++;
+        length += val;
+    } while (val == 255);
+    return length;
+}
+
+void shuffleBytes(const unsigned char* src, unsigned char* dst, size_t sizeInBytes, size_t elementSize) {
+    size_t nElements = sizeInBytes / elementSize;
+    for (size_t b = 0; b < elementSize; ++b) {
+        for (size_t i = 0; i < nElements; ++i) {
+            dst[b * nElements + i] = src[i * elementSize + b];
+        }
+    }
+    // Remaining bytes not forming a complete element
+    std::copy(src + nElements * elementSize, src + sizeInBytes, dst + nElements * elementSize);
+}
+
+void unshuffleBytes(const unsigned char* src, unsigned char* dst, size_t sizeInBytes, size_t elementSize) {
+    size_t nElements = sizeInBytes / elementSize;
+    for (size_t b = 0; b < elementSize; ++b) {
+        for (size_t i = 0; i < nElements; ++i) {
+            dst[i * elementSize + b] = src[b * nElements + i];
+        }
+    }
+    std::copy(src + nElements * elementSize, src + sizeInBytes, dst + nElements * elementSize);
+}
+
+} // namespace
+
+std::vector<char> compressGridChunk(const void* data, size_t sizeInBytes, size_t elementSize) {
+    std::vector<unsigned char> shuffled(sizeInBytes);
+    shuffleBytes(static_cast<const unsigned char*>(data), shuffled.data(), sizeInBytes, std::max<size_t>(elementSize, 1));
+
+    std::vector<unsigned char> out;
+    out.reserve(sizeInBytes / 2 + 16);
+    // Position + 1 of last occurrence of each hashed 4-byte sequence, 0 means none
+    std::vector<size_t> hashTable(size_t(1) << hashBits, 0);
+
+    const unsigned char* begin = shuffled.data();
+    size_t pos = 0;
+    size_t literalStart = 0;
+    while (pos + minMatchLength <= sizeInBytes) {
+        auto sequence = readUInt32(begin + pos);
+        auto& entry = hashTable[hashSequence(sequence)];
+        size_t candidate = entry;
+        entry = pos + 1;
+        if (candidate > 0 && pos - (candidate - 1) <= maxMatchOffset &&
+            readUInt32(begin + candidate - 1) == sequence) {
+            size_t matchStart = candidate - 1;
+            size_t matchLength = minMatchLength;
+            while (pos + matchLength < sizeInBytes &&
+                   begin[matchStart + matchLength] == begin[pos + matchLength]) {
+                ++matchLength;
+            }
+            writeSequence(out, begin + literalStart, pos - literalStart, pos - matchStart, matchLength);
+            pos += matchLength;
+            literalStart = pos;
+        } else {
+            ++pos;
+        }
+    }
+    // Trailing literals
+    if (literalStart < sizeInBytes) {
+        writeSequence(out, begin + literalStart, sizeInBytes - literalStart, 0, 0);
+    }
+    return std::vector<char>(out.begin(), out.end());
+}
+
+void decompressGridChunk(const char* srcData, size_t srcSizeInBytes, void* dstData, size_t dstSizeInBytes, size_t elementSize) {
+    std::vector<unsigned char> shuffled(dstSizeInBytes);
+    auto src = reinterpret_cast<const unsigned char*>(srcData);
+    auto srcEnd = src + srcSizeInBytes;
+    size_t pos = 0;
+    while (src < srcEnd) {
+        auto token = *src++;
+        size_t nLiterals = token >> 4;
+        if (nLiterals == 15) {
+            nLiterals += readLength(src, srcEnd);
+        }
+        if (nLiterals > static_cast<size_t>(srcEnd - src) || pos + nLiterals > dstSizeInBytes) {
+            throw Exception(IVW_CONTEXT_CUSTOM("decompressGridChunk"), "Corrupt grid chunk: literals out of bounds");
+        }
+        std::copy(src, src + nLiterals, shuffled.data() + pos);
+        src += nLiterals;
+        pos += nLiterals;
+        if (src == srcEnd) {
+            // Last sequence only contain literals
+            break;
+        }
+        if (srcEnd - src < 2) {
+            throw Exception(IVW_CONTEXT_CUSTOM("decompressGridChunk"), "Corrupt grid chunk: unexpected end of data");
+        }
+        size_t matchOffset = static_cast<size_t>(src[0]) | (static_cast<size_t>(src[1]) << 8);
+        src += 2;
+        size_t matchLength = (token & 0x0F) + minMatchLength;
+        if ((token & 0x0F) == 15) {
+            matchLength += readLength(src, srcEnd);
+        }
+        if (matchOffset == 0 || matchOffset > pos || pos + matchLength > dstSizeInBytes) {
+            throw Exception(IVW_CONTEXT_CUSTOM("decompressGridChunk"), "Corrupt grid chunk: match out of bounds");
+        }
+        // Byte by byte since source and destination may overlap
+        auto match = shuffled.data() + pos - matchOffset;
+        auto dst = shuffled.data() + pos;
+        for (size_t i = 0; i < matchLength; ++i) {
+            dst[i] = match[i];
+        }
+        pos += matchLength;
+    }
+    if (pos != dstSizeInBytes) {
+        throw Exception(IVW_CONTEXT_CUSTOM("decompressGridChunk"), "Corrupt grid chunk: size mismatch");
+    }
+    unshuffleBytes(shuffled.data(), static_cast<unsigned char*>(dstData), dstSizeInBytes, std::max<size_t>(elementSize, 1));
+}
+
+} // namespace util
+
+} // namespace
+
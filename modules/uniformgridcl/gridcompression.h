@@ -0,0 +1,75 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2016 Daniel Jnsson
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#ifndef IVW_GRIDCOMPRESSION_H
+#define IVW_GRIDCOMPRESSION_H
+
+#include <modules/uniformgridcl/uniformgridclmoduledefine.h>
+#include <inviwo/core/common/inviwo.h>
+
+#include <vector>
+
+namespace inviwo {
+
+namespace util {
+
+/**
+ * \brief Compress one chunk (timestep) of grid data.
+ *
+ * Bytes are first shuffled so that byte b of all elements are stored consecutively,
+ * which makes the slowly varying high order bytes of min-max and importance grids
+ * highly redundant. The shuffled bytes are then compressed using a byte oriented
+ * LZ77 scheme (LZ4 style sequences of literals and matches), favoring decompression speed
+ * over compression ratio.
+ *
+ * @param data Grid data to compress
+ * @param sizeInBytes Size of data
+ * @param elementSize Size of one grid element in bytes, used for shuffling
+ * @return Compressed data, may be larger than the input if the data is not compressible.
+ */
+IVW_MODULE_UNIFORMGRIDCL_API std::vector<char> compressGridChunk(const void* data, size_t sizeInBytes, size_t elementSize);
+
+/**
+ * \brief Decompress a chunk created by compressGridChunk.
+ *
+ * @param src Compressed data
+ * @param srcSizeInBytes Size of compressed data
+ * @param dst Output, must be able to hold dstSizeInBytes
+ * @param dstSizeInBytes Size of uncompressed data
+ * @param elementSize Size of one grid element in bytes, same as used during compression
+ * @throws Exception if the compressed data is corrupt
+ */
+IVW_MODULE_UNIFORMGRIDCL_API void decompressGridChunk(const char* src, size_t srcSizeInBytes, void* dst, size_t dstSizeInBytes, size_t elementSize);
+
+} // namespace util
+
+} // namespace
+
+#endif // IVW_GRIDCOMPRESSION_H
+
@@ -48,12 +48,26 @@ DynamicVolumeDifferenceAnalysis::DynamicVolumeDifferenceAnalysis()
     : Processor()
     , inport_("data")
     , outport_("DynamicDataInfo")
-    , volumeRegionSize_("region", "Region size", 8, 1, 100) {
+    , volumeRegionSize_("region", "Region size", 8, 1, 100)
+    , layout_("layout", "Grid layout")
+    , precision_("precision", "Precision") {
     
     addPort(inport_);
     addPort(outport_);
 
     addProperty(volumeRegionSize_);
+    layout_.addOption("linear", "Linear", static_cast<int>(UniformGrid3DLayout::Linear));
+    layout_.addOption("morton", "Morton (4x4x4 tiles)", static_cast<int>(UniformGrid3DLayout::Morton));
+    layout_.setSelectedIndex(0);
+    layout_.setCurrentStateAsDefault();
+    addProperty(layout_);
+    // Quantized grids only keep differences above zero, see util::quantizeUniformGrid3D
+    precision_.addOption("float32", "32-bit float", 32);
+    precision_.addOption("uint16", "16-bit normalized", 16);
+    precision_.addOption("uint8", "8-bit normalized", 8);
+    precision_.setSelectedIndex(0);
+    precision_.setCurrentStateAsDefault();
+    addProperty(precision_);
 
 }
     
@@ -66,41 +80,50 @@ void DynamicVolumeDifferenceAnalysis::process() {
         auto curVolume = (*data)[timeStep];
         auto nextVolume = (*data)[nextTimeStep];
 
-    
-        const VolumeRAM* curRAMVolume = curVolume->getRepresentation<VolumeRAM>();
-        auto nextRAMVolume = nextVolume->getRepresentation<VolumeRAM>();
-        auto dim = curVolume->getDimensions();
-        auto region = size3_t(volumeRegionSize_.get());
-        const size3_t outDim{ glm::ceil(vec3(dim) / static_cast<float>(volumeRegionSize_.get())) };
+        auto out = util::volumeDifferenceGrid(*curVolume, *nextVolume, static_cast<size_t>(volumeRegionSize_.get()), static_cast<UniformGrid3DLayout>(layout_.get()));
+        if (precision_.get() < 32) {
+            output->emplace_back(util::quantizeUniformGrid3D(*out, precision_.get() == 8 ? DataUInt8::get() : DataUInt16::get()));
+        } else {
+            output->emplace_back(out);
+        }
+    }
 
-        std::shared_ptr<DynamicVolumeInfoUniformGrid3D> out = std::make_shared<DynamicVolumeInfoUniformGrid3D>(region);
-        // Use same transformation to make sure that they are render at the same location
-        out->setModelMatrix(curVolume->getModelMatrix());
-        out->setWorldMatrix(curVolume->getWorldMatrix());
-        out->setDimensions(outDim);
-        auto outRAM = out->data.getEditableRepresentation<BufferRAM>();
+    outport_.setData(output);
+}
 
-        dvec2 dataRange = curVolume->dataMap_.dataRange;
-        DataMapper defaultRange(curVolume->getDataFormat());
+std::shared_ptr<DynamicVolumeInfoUniformGrid3D> util::volumeDifferenceGrid(const Volume& curVolume, const Volume& nextVolume, size_t regionSize, UniformGrid3DLayout layout) {
+    const VolumeRAM* curRAMVolume = curVolume.getRepresentation<VolumeRAM>();
+    auto nextRAMVolume = nextVolume.getRepresentation<VolumeRAM>();
+    auto dim = curVolume.getDimensions();
+    auto region = size3_t(regionSize);
+    const size3_t outDim{ glm::ceil(vec3(dim) / static_cast<float>(regionSize)) };
 
-        double invRange = 1.0 / (dataRange.y - dataRange.x);
-        double defaultToDataRange = (defaultRange.dataRange.y - defaultRange.dataRange.x) * invRange;
-        double defaultToDataOffset = (dataRange.x - defaultRange.dataRange.x) /
-            (defaultRange.dataRange.y - defaultRange.dataRange.x);
-    
-        for (int z = 0; z < outDim.z; ++z) {
-            for (int y = 0; y < outDim.y; ++y) {
-                for (int x = 0; x < outDim.x; ++x) {
-                    auto offset = size3_t(x, y, z)*region;
-                    VolumeRAMDifferenceAnalysisDispatcher disp;
-                    curVolume->getDataFormat()->dispatch(disp, curRAMVolume, nextRAMVolume, dataRange, defaultToDataOffset, defaultToDataRange, offset, region, outRAM, VolumeRAM::posToIndex(size3_t(x, y, z), outDim));
-                }
+    std::shared_ptr<DynamicVolumeInfoUniformGrid3D> out = std::make_shared<DynamicVolumeInfoUniformGrid3D>(region);
+    // Use same transformation to make sure that they are render at the same location
+    out->setModelMatrix(curVolume.getModelMatrix());
+    out->setWorldMatrix(curVolume.getWorldMatrix());
+    out->setLayout(layout);
+    out->setDimensions(outDim);
+    auto outRAM = out->data.getEditableRepresentation<BufferRAM>();
+
+    dvec2 dataRange = curVolume.dataMap_.dataRange;
+    DataMapper defaultRange(curVolume.getDataFormat());
+
+    double invRange = 1.0 / (dataRange.y - dataRange.x);
+    double defaultToDataRange = (defaultRange.dataRange.y - defaultRange.dataRange.x) * invRange;
+    double defaultToDataOffset = (dataRange.x - defaultRange.dataRange.x) /
+        (defaultRange.dataRange.y - defaultRange.dataRange.x);
+
+    for (int z = 0; z < outDim.z; ++z) {
+        for (int y = 0; y < outDim.y; ++y) {
+            for (int x = 0; x < outDim.x; ++x) {
+                auto offset = size3_t(x, y, z)*region;
+                VolumeRAMDifferenceAnalysisDispatcher disp;
+                curVolume.getDataFormat()->dispatch(disp, curRAMVolume, nextRAMVolume, dataRange, defaultToDataOffset, defaultToDataRange, offset, region, outRAM, util::uniformGrid3DIndex(size3_t(x, y, z), outDim, out->getLayout()));
             }
         }
-        output->emplace_back(out);
     }
-
-    outport_.setData(output);
+    return out;
 }
 
 } // namespace
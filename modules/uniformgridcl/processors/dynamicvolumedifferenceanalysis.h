@@ -33,6 +33,7 @@
 #include <modules/uniformgridcl/uniformgridclmoduledefine.h>
 #include <inviwo/core/common/inviwo.h>
 #include <inviwo/core/processors/processor.h>
+#include <inviwo/core/properties/optionproperty.h>
 #include <inviwo/core/datastructures/buffer/bufferram.h>
 #include <inviwo/core/datastructures/buffer/bufferramprecision.h>
 #include <inviwo/core/datastructures/volume/volumeramprecision.h>
@@ -80,6 +81,8 @@ private:
     VolumeSequenceInport inport_;
     UniformGrid3DVectorOutport outport_;
     IntProperty volumeRegionSize_;
+    OptionPropertyInt layout_; // UniformGrid3DLayout of the output grids, must match the min-max grids it is used with
+    OptionPropertyInt precision_; // Bits per output value, 8 and 16 bits are quantized with a per-grid value scale
     
 
 };
@@ -150,6 +153,15 @@ void VolumeRAMDifferenceAnalysisDispatcher::dispatch(const VolumeRepresentation*
     //outVolume->set(outIndex, util::glm_convert<float, P>((absDiffMax / static_cast<double>(region.x*region.y*region.z) - dataRange.x) / (dataRange.y - dataRange.x)));
 }
 
+namespace util {
+/**
+ * \brief Mean absolute difference between curVolume and nextVolume for each region of regionSize^3 voxels.
+ * Reference for the difference grids computed by VolumeMinMaxCLProcessor.
+ */
+IVW_MODULE_UNIFORMGRIDCL_API std::shared_ptr<DynamicVolumeInfoUniformGrid3D> volumeDifferenceGrid(
+    const Volume& curVolume, const Volume& nextVolume, size_t regionSize, UniformGrid3DLayout layout);
+}
+
 
 } // namespace
 
@@ -52,10 +52,12 @@ UniformGrid3DPlayerProcessor::UniformGrid3DPlayerProcessor()
 , timePerElement_("timePerElement", "Time Per element (s)", 1.f, 0.01f, 10.f, 0.01f)
 , playSequence_("playSequence", "Play Sequence", false)
 , frameRate_("frameRate", "Frame rate", 10, 1, 60, 1, InvalidationLevel::Valid)
+, prefetch_("prefetch", "Prefetch timesteps", true)
 , sequenceTimer_(Timer::Milliseconds(1000 / frameRate_.get()), [this](){ onSequenceTimerEvent(); }) {
     
     addPort(inport_);
     inport_.onChange([this]() {
+        prefetcher_.clear();
         onTimeStepChange();
         
     });
@@ -82,6 +84,8 @@ UniformGrid3DPlayerProcessor::UniformGrid3DPlayerProcessor()
             sequenceTimer_.stop();
         }
     });
+    addProperty(prefetch_);
+    prefetch_.onChange([this]() { prefetcher_.clear(); });
 }
 
 void UniformGrid3DPlayerProcessor::process() {
@@ -95,8 +99,13 @@ void UniformGrid3DPlayerProcessor::process() {
         std::swap(outData_, outDataPingPong_);
         auto input0 = elements->at(timeStep);
         auto input1 = elements->at(nextTimeStep);
+        if (input0->getLayout() != input1->getLayout() || input0->getDataFormat() != input1->getDataFormat()) {
+            LogError("Grids to interpolate between must have the same layout and format");
+            return;
+        }
         if (!outData_ || outData_->getDimensions() != input0->getDimensions()
-            || outData_->getDataFormat() != input0->getDataFormat()) {
+            || outData_->getDataFormat() != input0->getDataFormat()
+            || outData_->getLayout() != input0->getLayout()) {
             outData_ = std::shared_ptr<UniformGrid3DBase>(input0->clone());
             //outData_ = input0->getDataFormat()->dispatch(util::UniformGrid3DDispatcher(), input0->getDimensions(), input0->getCellDimension(), BufferUsage::Static);
             outData_->setModelMatrix(input0->getModelMatrix());
@@ -106,7 +115,36 @@ void UniformGrid3DPlayerProcessor::process() {
             //outData_->dataMap_ = input0->dataMap_;
             
         }
-        input0->getDataFormat()->dispatch(bufferMixer_, input0.get(), input1.get(), t, outData_);
+        // Grids quantized with different value scales are mixed into the larger scale
+        outData_->setValueScale(std::max(input0->getValueScale(), input1->getValueScale()));
+        if (prefetch_) {
+            try {
+                std::vector<cl::Event> uploadEvents;
+                const auto& input0CL = prefetcher_.get(*elements, timeStep, uploadEvents);
+                const auto& input1CL = prefetcher_.get(*elements, nextTimeStep, uploadEvents);
+                input0->getDataFormat()->dispatch(bufferMixer_, input0CL, input0.get(), input1CL, input1.get(), t, outData_, &uploadEvents);
+                
+                // Predict timesteps needed during the next frames from playback direction and speed
+                // The timer only plays forward, but wraps around at the end
+                int direction = playSequence_ || time_.get() >= prevTime_ ? 1 : -1;
+                float timestepsPerFrame = playSequence_ ? 1.f / (static_cast<float>(frameRate_.get()) * timePerElement_.get()) : 1.f;
+                auto nTimesteps = static_cast<size_t>(std::ceil(2.f * timestepsPerFrame));
+                prefetcher_.prefetch(*elements, direction > 0 ? nextTimeStep : timeStep, direction, nTimesteps);
+            } catch (cl::Error& err) {
+                LogError(getCLErrorString(err));
+            } catch (std::runtime_error& err) {
+                LogError(err.what());
+            }
+        } else {
+            try {
+                input0->getDataFormat()->dispatch(bufferMixer_, input0.get(), input1.get(), t, outData_);
+            } catch (cl::Error& err) {
+                LogError(getCLErrorString(err));
+            } catch (std::runtime_error& err) {
+                LogError(err.what());
+            }
+        }
+        prevTime_ = time_.get();
         //bufferMixer_.mix(*input0->dataget(), *input1, t, *outData_, nullptr);
         outport_.setData(outData_);
     } else {
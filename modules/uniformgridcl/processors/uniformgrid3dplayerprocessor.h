@@ -39,6 +39,7 @@
 
 #include <modules/uniformgridcl/uniformgrid3d.h>
 #include <modules/uniformgridcl/buffermixercl.h>
+#include <modules/uniformgridcl/uniformgrid3dprefetchercl.h>
 
 namespace inviwo {
 namespace util {
@@ -47,9 +48,19 @@ namespace util {
         template <class T>
         void dispatch(const UniformGrid3DBase* x, const UniformGrid3DBase* y, float t, std::shared_ptr<UniformGrid3DBase> out) {
             typedef typename T::type F;
-            bufferMixer_.mix(static_cast<const UniformGrid3D<F>*>(x)->data, static_cast<const UniformGrid3D<F>*>(y)->data, t
+            bufferMixer_.mix(static_cast<const UniformGrid3D<F>*>(x)->data, relativeValueScale(*x, *out), static_cast<const UniformGrid3D<F>*>(y)->data, relativeValueScale(*y, *out), t
                 , static_cast<UniformGrid3D<F>*>(out.get())->data, nullptr);
         }
+        // Mix data already resident on the device
+        template <class T>
+        void dispatch(const cl::Buffer& x, const UniformGrid3DBase* xGrid, const cl::Buffer& y, const UniformGrid3DBase* yGrid, float t, std::shared_ptr<UniformGrid3DBase> out, const std::vector<cl::Event>* waitForEvents) {
+            typedef typename T::type F;
+            bufferMixer_.mix(x, relativeValueScale(*xGrid, *out), y, relativeValueScale(*yGrid, *out), t, static_cast<UniformGrid3D<F>*>(out.get())->data, waitForEvents);
+        }
+        // Value scale of a quantized input relative to the value scale of the output
+        static float relativeValueScale(const UniformGrid3DBase& in, const UniformGrid3DBase& out) {
+            return in.getValueScale() / out.getValueScale();
+        }
         BufferMixerCL bufferMixer_;
     };
 }
@@ -98,10 +109,13 @@ private:
     FloatProperty timePerElement_;
     IntProperty frameRate_;
     BoolProperty playSequence_;
+    BoolProperty prefetch_; // Upload upcoming timesteps ahead of time
 
     Timer sequenceTimer_;
 
     util::UniformGrid3DMixDispatcher bufferMixer_;
+    UniformGrid3DPrefetcherCL prefetcher_;
+    float prevTime_ = 0.f; // Used to determine playback direction
 };
 
 
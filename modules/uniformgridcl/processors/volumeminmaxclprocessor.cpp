@@ -38,8 +38,20 @@
 #include <modules/opencl/volume/volumeclgl.h>
 
 #include <modules/opencl/inviwoopencl.h>
+#include <modules/uniformgridcl/brickedvolumecl.h>
+#include <modules/uniformgridcl/processors/dynamicvolumedifferenceanalysis.h>
+
+#include <array>
 
 namespace inviwo {
+
+namespace {
+// Volumes with the same size, format and data range are normalized equally
+bool compatibleVolumes(const Volume* a, const Volume* b) {
+    return a->getDimensions() == b->getDimensions() && a->getDataFormat() == b->getDataFormat() &&
+        a->dataMap_.dataRange == b->dataMap_.dataRange && a->dataMap_.valueRange == b->dataMap_.valueRange;
+}
+}  // namespace
     
 // The Class Identifier has to be globally unique. Use a reverse DNS naming scheme
 const ProcessorInfo VolumeMinMaxCLProcessor::processorInfo_{
@@ -60,59 +72,80 @@ VolumeMinMaxCLProcessor::VolumeMinMaxCLProcessor()
 , outport_("output")
 , vectorInport_("VolumeSequenceInput")
 , vectorOutport_("UniformGrid3DVectorOut")
+, differenceInport_("volumeDifference")
+, differenceOutport_("volumeDifferenceOut")
 , volumeRegionSize_("region", "Region size", 8, 1, 100)
+, layout_("layout", "Grid layout")
 , workGroupSize_("wgsize", "Work group size", ivec3(4), ivec3(0), ivec3(256))
 , useGLSharing_("glsharing", "Use OpenGL sharing", true)
+, maxBatchSize_("maxBatchSize", "Max sequence batch size (MB)", 64, 1, 1024)
+, incrementalSequence_("incrementalSequence", "Incremental sequence update", true)
+, changeThreshold_("changeThreshold", "Change threshold", 0.f, 0.f, 0.1f, 1e-4f)
+, differencePrecision_("differencePrecision", "Difference precision")
 //, volumeOut_(new MinMaxUniformGrid3D(size3_t(volumeRegionSize_.get())))
-, kernel_(nullptr) {
+, kernel_(nullptr)
+, batchKernel_(nullptr)
+, cellsKernel_(nullptr)
+, differenceKernel_(nullptr) {
     addPort(inport_);
     addPort(outport_);
     
     addPort(vectorInport_);
     addPort(vectorOutport_);
+    addPort(differenceInport_);
+    addPort(differenceOutport_);
     
     inport_.setOptional(true);
     vectorInport_.setOptional(true);
+    differenceInport_.setOptional(true);
     
     addProperty(volumeRegionSize_);
+    // Morton layout improves cache hit rates of grid traversals
+    layout_.addOption("linear", "Linear", static_cast<int>(UniformGrid3DLayout::Linear));
+    layout_.addOption("morton", "Morton (4x4x4 tiles)", static_cast<int>(UniformGrid3DLayout::Morton));
+    layout_.setSelectedIndex(0);
+    layout_.setCurrentStateAsDefault();
+    addProperty(layout_);
     addProperty(workGroupSize_);
     addProperty(useGLSharing_);
+    addProperty(maxBatchSize_);
+    addProperty(incrementalSequence_);
+    addProperty(changeThreshold_);
+    differencePrecision_.addOption("float32", "32-bit float", 32);
+    differencePrecision_.addOption("uint16", "16-bit normalized", 16);
+    differencePrecision_.addOption("uint8", "8-bit normalized", 8);
+    differencePrecision_.setSelectedIndex(0);
+    differencePrecision_.setCurrentStateAsDefault();
+    addProperty(differencePrecision_);
     std::stringstream defines;
     
     //volumeRegionSize_.onChange([this]() {volumeOut_->setCellDimension(size3_t(volumeRegionSize_.get())); });
     
     kernel_ = addKernel("uniformgrid/volumeminmax.cl", "volumeMinMaxKernel");
+    batchKernel_ = addKernel("uniformgrid/volumeminmax.cl", "volumeMinMaxBatchKernel");
+    cellsKernel_ = addKernel("uniformgrid/volumeminmax.cl", "volumeMinMaxCellsKernel");
+    differenceKernel_ = addKernel("uniformgrid/volumeminmax.cl", "volumeMinMaxDifferenceKernel");
     
 }
 
 void VolumeMinMaxCLProcessor::process() {
-    if (kernel_ == nullptr) {
+    if (kernel_ == nullptr || batchKernel_ == nullptr || cellsKernel_ == nullptr || differenceKernel_ == nullptr) {
         return;
     }
     
     if (vectorInport_.isReady()) {
         outport_.setData(nullptr);
         auto volumes = vectorInport_.getData().get();
-        std::shared_ptr<UniformGrid3DVector> output = std::make_shared<UniformGrid3DVector>();
-        auto memSize = OpenCL::getPtr()->getDevice().getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>();
-        
-        for (auto elem : *volumes)
-        {
-            auto result = compute(elem.get());
-            if (result) {
-                // Remove GPU representations
-                auto dim = elem->getDimensions();
-                if (dim.x*dim.y*dim.z* elem->getDataFormat()->getSize()*output->size() > memSize / 3) {
-                    elem->removeOtherRepresentations(elem->getRepresentation<VolumeRAM>());
-                    auto ramRep = result->data.getRAMRepresentation();
-                    result->data.removeOtherRepresentations(ramRep);
-                }
-                
-                output->emplace_back(std::shared_ptr<UniformGrid3DBase>(result.release()));
-            }
-            
+        if (differenceOutport_.isConnected()) {
+            auto differences = std::make_shared<UniformGrid3DVector>();
+            vectorOutport_.setData(computeSequenceWithDifference(*volumes, *differences));
+            differenceOutport_.setData(differences);
+        } else {
+            auto output = incrementalSequence_ && differenceInport_.isReady()
+                              ? computeSequenceIncremental(*volumes, *differenceInport_.getData())
+                              : computeSequence(*volumes);
+            vectorOutport_.setData(output);
         }
-        vectorOutport_.setData(output);
     }
     if (inport_.isReady()) {
         auto result = compute(inport_.getData().get());
@@ -135,7 +168,7 @@ void VolumeMinMaxCLProcessor::executeVolumeOperation(const Volume* volume,
                         *(volumeCL->getVolumeStruct(volume)
                           .getRepresentation<BufferCL>()));  // Scaling for 12-bit data
         kernel_->setArg(argIndex++, *volumeOutCL);
-        kernel_->setArg(argIndex++, ivec4(outDim, 0));
+        kernel_->setArg(argIndex++, ivec4(outDim, layout_.get()));
         kernel_->setArg(argIndex++, ivec4(volumeRegionSize_.get()));
         
         OpenCL::getPtr()->getQueue().enqueueNDRangeKernel(
@@ -147,6 +180,9 @@ void VolumeMinMaxCLProcessor::executeVolumeOperation(const Volume* volume,
 }
 
 std::unique_ptr<MinMaxUniformGrid3D> VolumeMinMaxCLProcessor::compute(const Volume* volume) {
+    if (!BrickedVolumeCL::fitsOnDevice(*volume)) {
+        return computeInSlabs(volume);
+    }
     const size3_t dim{ volume->getDimensions() };
     const size3_t outDim{ glm::ceil(vec3(dim) / static_cast<float>(volumeRegionSize_.get())) };
     // const DataFormatBase* volFormat = inport_.getData()->getDataFormat(); // Not used
@@ -155,6 +191,7 @@ std::unique_ptr<MinMaxUniformGrid3D> VolumeMinMaxCLProcessor::compute(const Volu
         // Use same transformation to make sure that they are render at the same location
         volumeOut_->setModelMatrix(volume->getModelMatrix());
         volumeOut_->setWorldMatrix(volume->getWorldMatrix());
+        volumeOut_->setLayout(static_cast<UniformGrid3DLayout>(layout_.get()));
         volumeOut_->setDimensions(outDim);
     }
     
@@ -183,6 +220,423 @@ std::unique_ptr<MinMaxUniformGrid3D> VolumeMinMaxCLProcessor::compute(const Volu
     return volumeOut_;
 }
 
+std::unique_ptr<MinMaxUniformGrid3D> VolumeMinMaxCLProcessor::computeInSlabs(const Volume* volume) {
+    const size3_t dim{ volume->getDimensions() };
+    const size_t region = static_cast<size_t>(volumeRegionSize_.get());
+    const size3_t outDim{ glm::ceil(vec3(dim) / static_cast<float>(region)) };
+    auto layout = static_cast<UniformGrid3DLayout>(layout_.get());
+    
+    const auto& device = OpenCL::getPtr()->getDevice();
+    const size_t sliceSizeInBytes = dim.x * dim.y * volume->getDataFormat()->getSize();
+    size_t maxSlabSizeInBytes = std::min(static_cast<size_t>(maxBatchSize_.get()) * 1024 * 1024, static_cast<size_t>(device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>()));
+    size_t maxSlabDepth = std::min(maxSlabSizeInBytes / sliceSizeInBytes, static_cast<size_t>(device.getInfo<CL_DEVICE_IMAGE3D_MAX_DEPTH>()));
+    // Cells must not be split between slabs, nor tiles of the Morton layout
+    if (maxSlabDepth < region) {
+        LogError("A slab of " << region << " slices does not fit on the device, decrease the region size or increase the max batch size");
+        return nullptr;
+    }
+    if (layout == UniformGrid3DLayout::Morton && maxSlabDepth / region < util::uniformGrid3DTileSize) {
+        LogWarn("A slab cannot hold a tile of the Morton layout, using the linear layout");
+        layout = UniformGrid3DLayout::Linear;
+    }
+    const size_t layerAlignment = layout == UniformGrid3DLayout::Morton ? util::uniformGrid3DTileSize : 1;
+    size_t cellLayersPerSlab = ((maxSlabDepth / region) / layerAlignment) * layerAlignment;
+    
+    std::unique_ptr<MinMaxUniformGrid3D> volumeOut(new MinMaxUniformGrid3D(size3_t(region)));
+    volumeOut->setModelMatrix(volume->getModelMatrix());
+    volumeOut->setWorldMatrix(volume->getWorldMatrix());
+    volumeOut->setLayout(layout);
+    volumeOut->setDimensions(outDim);
+    
+    auto volumeRAM = volume->getRepresentation<VolumeRAM>();
+    auto outData = static_cast<char*>(volumeOut->getData());
+    size3_t localWorkGroupSize(workGroupSize_.get());
+    std::unique_ptr<VolumeCL> slabCL;
+    cl::Buffer outCL;
+    try {
+        for (size_t cellZ = 0; cellZ < outDim.z; cellZ += cellLayersPerSlab) {
+            size_t nCellLayers = std::min(cellLayersPerSlab, outDim.z - cellZ);
+            size_t zStart = cellZ * region;
+            size3_t slabDim(dim.x, dim.y, std::min(nCellLayers * region, dim.z - zStart));
+            if (!slabCL || slabCL->getDimensions() != slabDim) {
+                slabCL = std::make_unique<VolumeCL>(slabDim, volume->getDataFormat());
+            }
+            size_t outBytes = util::uniformGrid3DStorageSize(size3_t(outDim.x, outDim.y, nCellLayers), layout) * DataVec2UInt16::size;
+            if (outCL() == nullptr || outCL.getInfo<CL_MEM_SIZE>() < outBytes) {
+                outCL = cl::Buffer(OpenCL::getPtr()->getContext(), CL_MEM_WRITE_ONLY, outBytes);
+            }
+            cl::size_t<3> origin;
+            cl::size_t<3> slabRegion;
+            slabRegion[0] = slabDim.x; slabRegion[1] = slabDim.y; slabRegion[2] = slabDim.z;
+            OpenCL::getPtr()->getQueue().enqueueWriteImage(slabCL->getEditable(), CL_FALSE, origin, slabRegion, 0, 0,
+                const_cast<char*>(static_cast<const char*>(volumeRAM->getData()) + zStart * sliceSizeInBytes));
+            
+            ivec4 slabOutDim(outDim.x, outDim.y, nCellLayers, static_cast<int>(layout));
+            size3_t globalWorkGroupSize(getGlobalWorkGroupSize(outDim.x, localWorkGroupSize.x),
+                                        getGlobalWorkGroupSize(outDim.y, localWorkGroupSize.y),
+                                        getGlobalWorkGroupSize(nCellLayers, localWorkGroupSize.z));
+            int argIndex = 0;
+            kernel_->setArg(argIndex++, *slabCL);
+            // Data range of the whole volume
+            kernel_->setArg(argIndex++, *(slabCL->getVolumeStruct(volume).getRepresentation<BufferCL>()));
+            kernel_->setArg(argIndex++, outCL);
+            kernel_->setArg(argIndex++, slabOutDim);
+            kernel_->setArg(argIndex++, ivec4(volumeRegionSize_.get()));
+            OpenCL::getPtr()->getQueue().enqueueNDRangeKernel(*kernel_, cl::NullRange, globalWorkGroupSize, localWorkGroupSize);
+            // Blocking, the slab is overwritten in the next iteration
+            // Slabs start at whole tiles, so the preceding layers are stored before the slab also in the Morton layout
+            size_t outOffset = util::uniformGrid3DStorageSize(size3_t(outDim.x, outDim.y, cellZ), layout) * DataVec2UInt16::size;
+            OpenCL::getPtr()->getQueue().enqueueReadBuffer(outCL, CL_TRUE, 0, outBytes, outData + outOffset);
+        }
+    } catch (cl::Error& err) {
+        LogError(getCLErrorString(err));
+        return nullptr;
+    }
+    return volumeOut;
+}
+
+std::shared_ptr<UniformGrid3DVector> VolumeMinMaxCLProcessor::computeSequence(const VolumeSequence& volumes) {
+    auto output = std::make_shared<UniformGrid3DVector>();
+    if (volumes.empty()) {
+        return output;
+    }
+    const auto layout = static_cast<UniformGrid3DLayout>(layout_.get());
+    struct Batch {
+        std::vector<size_t> volumeIndices;
+        std::unique_ptr<VolumeCL> volumeCL; // Volumes stacked along z
+        cl::Buffer outCL;
+        cl::Event computeEvent;
+    };
+    // Volumes can be stacked if they have the same size, format and data range
+    size_t maxBatchBytes = static_cast<size_t>(maxBatchSize_.get()) * 1024 * 1024;
+    size_t maxImageDepth = OpenCL::getPtr()->getDevice().getInfo<CL_DEVICE_IMAGE3D_MAX_DEPTH>();
+    
+    std::vector<cl::Event> readEvents;
+    // Double buffering: upload to one batch while the other is being processed
+    std::array<Batch, 2> batches;
+    size_t batchCount = 0;
+    size_t volumeIndex = 0;
+    try {
+        while (volumeIndex < volumes.size()) {
+            auto first = volumes[volumeIndex].get();
+            const size3_t dim{ first->getDimensions() };
+            const size3_t outDim{ glm::ceil(vec3(dim) / static_cast<float>(volumeRegionSize_.get())) };
+            auto volumeBytes = dim.x * dim.y * dim.z * first->getDataFormat()->getSize();
+            auto outBytes = util::uniformGrid3DStorageSize(outDim, layout) * DataVec2UInt16::size;
+            
+            auto& batch = batches[batchCount % 2];
+            // The previous computation using this batch must be done before overwriting it
+            std::vector<cl::Event> prevComputation;
+            if (batchCount >= 2) {
+                prevComputation.push_back(batch.computeEvent);
+            }
+            batch.volumeIndices.clear();
+            do {
+                batch.volumeIndices.push_back(volumeIndex++);
+            } while (volumeIndex < volumes.size() && compatibleVolumes(first, volumes[volumeIndex].get()) &&
+                     (batch.volumeIndices.size() + 1) * volumeBytes <= maxBatchBytes &&
+                     (batch.volumeIndices.size() + 1) * dim.z <= maxImageDepth);
+            auto nVolumes = batch.volumeIndices.size();
+            
+            size3_t batchDim(dim.x, dim.y, dim.z * nVolumes);
+            if (!batch.volumeCL || batch.volumeCL->getDimensions() != batchDim || batch.volumeCL->getDataFormat() != first->getDataFormat()) {
+                if (!prevComputation.empty()) {
+                    prevComputation.front().wait();
+                }
+                batch.volumeCL = std::make_unique<VolumeCL>(batchDim, first->getDataFormat());
+            }
+            if (batch.outCL() == nullptr || batch.outCL.getInfo<CL_MEM_SIZE>() < outBytes * nVolumes) {
+                if (!prevComputation.empty()) {
+                    prevComputation.front().wait();
+                }
+                batch.outCL = cl::Buffer(OpenCL::getPtr()->getContext(), CL_MEM_WRITE_ONLY, outBytes * nVolumes);
+            }
+            // Upload on the asynchronous queue
+            std::vector<cl::Event> uploadEvents(nVolumes);
+            for (size_t i = 0; i < nVolumes; ++i) {
+                auto volumeRAM = volumes[batch.volumeIndices[i]]->getRepresentation<VolumeRAM>();
+                cl::size_t<3> origin;
+                origin[2] = i * dim.z;
+                cl::size_t<3> region;
+                region[0] = dim.x; region[1] = dim.y; region[2] = dim.z;
+                OpenCL::getPtr()->getAsyncQueue().enqueueWriteImage(batch.volumeCL->getEditable(), CL_FALSE, origin, region, 0, 0,
+                    const_cast<void*>(volumeRAM->getData()), prevComputation.empty() ? nullptr : &prevComputation, &uploadEvents[i]);
+            }
+            OpenCL::getPtr()->getAsyncQueue().flush();
+            
+            size3_t localWorkGroupSize(workGroupSize_.get());
+            size3_t globalWorkGroupSize(getGlobalWorkGroupSize(outDim.x, localWorkGroupSize.x),
+                                        getGlobalWorkGroupSize(outDim.y, localWorkGroupSize.y),
+                                        getGlobalWorkGroupSize(outDim.z * nVolumes, localWorkGroupSize.z));
+            int argIndex = 0;
+            batchKernel_->setArg(argIndex++, *batch.volumeCL);
+            batchKernel_->setArg(argIndex++, *(batch.volumeCL->getVolumeStruct(first).getRepresentation<BufferCL>()));
+            batchKernel_->setArg(argIndex++, batch.outCL);
+            batchKernel_->setArg(argIndex++, ivec4(outDim, static_cast<int>(layout)));
+            batchKernel_->setArg(argIndex++, ivec4(volumeRegionSize_.get()));
+            batchKernel_->setArg(argIndex++, ivec4(dim, 0));
+            batchKernel_->setArg(argIndex++, static_cast<int>(nVolumes));
+            OpenCL::getPtr()->getQueue().enqueueNDRangeKernel(*batchKernel_, cl::NullRange, globalWorkGroupSize, localWorkGroupSize, &uploadEvents, &batch.computeEvent);
+            
+            // Read results directly into the output grids
+            std::vector<cl::Event> computeEvents(1, batch.computeEvent);
+            for (size_t i = 0; i < nVolumes; ++i) {
+                auto volume = volumes[batch.volumeIndices[i]].get();
+                auto result = std::make_shared<MinMaxUniformGrid3D>(size3_t(volumeRegionSize_.get()));
+                result->setModelMatrix(volume->getModelMatrix());
+                result->setWorldMatrix(volume->getWorldMatrix());
+                result->setLayout(layout);
+                result->setDimensions(outDim);
+                readEvents.emplace_back();
+                OpenCL::getPtr()->getQueue().enqueueReadBuffer(batch.outCL, CL_FALSE, i * outBytes, outBytes,
+                    result->getData(), &computeEvents, &readEvents.back());
+                output->push_back(result);
+            }
+            OpenCL::getPtr()->getQueue().flush();
+            ++batchCount;
+        }
+        cl::WaitForEvents(readEvents);
+    } catch (cl::Error& err) {
+        LogError(getCLErrorString(err));
+        output->clear();
+    }
+    return output;
+}
+
+std::shared_ptr<UniformGrid3DVector> VolumeMinMaxCLProcessor::computeSequenceIncremental(const VolumeSequence& volumes, const UniformGrid3DVector& differences) {
+    if (differences.size() != volumes.size()) {
+        LogWarn("Expected one difference grid per timestep (" << volumes.size() << "), got " << differences.size() << ". Computing all cells.");
+        return computeSequence(volumes);
+    }
+    auto output = std::make_shared<UniformGrid3DVector>();
+    const auto layout = static_cast<UniformGrid3DLayout>(layout_.get());
+    const size_t region = static_cast<size_t>(volumeRegionSize_.get());
+    const size3_t localWorkGroupSize(workGroupSize_.get());
+    const size_t localWorkGroupSize1D = localWorkGroupSize.x * localWorkGroupSize.y * localWorkGroupSize.z;
+    
+    std::unique_ptr<VolumeCL> volumeCL;
+    cl::Buffer gridCL; // Grid of the previous timestep, updated in place
+    cl::Buffer cellsCL;
+    std::vector<int> changedCells;
+    const Volume* prevVolume = nullptr;
+    std::vector<cl::Event> readEvents;
+    auto& queue = OpenCL::getPtr()->getQueue();
+    size_t nComputedCells = 0;
+    size_t nCells = 0;
+    try {
+        for (size_t t = 0; t < volumes.size(); ++t) {
+            auto volume = volumes[t].get();
+            const size3_t dim{ volume->getDimensions() };
+            const size3_t outDim{ glm::ceil(vec3(dim) / static_cast<float>(region)) };
+            const size_t outBytes = util::uniformGrid3DStorageSize(outDim, layout) * DataVec2UInt16::size;
+            const ivec4 outDimCL(outDim, static_cast<int>(layout));
+            nCells += outDim.x * outDim.y * outDim.z;
+            
+            if (!volumeCL || volumeCL->getDimensions() != dim || volumeCL->getDataFormat() != volume->getDataFormat()) {
+                volumeCL = std::make_unique<VolumeCL>(dim, volume->getDataFormat());
+            }
+            auto volumeRAM = volume->getRepresentation<VolumeRAM>();
+            cl::size_t<3> origin;
+            cl::size_t<3> imageRegion;
+            imageRegion[0] = dim.x; imageRegion[1] = dim.y; imageRegion[2] = dim.z;
+            // In-order queue, the previous timestep has been processed when the upload starts
+            queue.enqueueWriteImage(volumeCL->getEditable(), CL_FALSE, origin, imageRegion, 0, 0,
+                                    const_cast<void*>(volumeRAM->getData()));
+            
+            // Grid t-1 holds the difference between timestep t-1 and t
+            auto difference = t > 0 && util::isScalarUniformGrid3DFormat(differences[t - 1]->getDataFormat()) ? differences[t - 1].get() : nullptr;
+            bool incremental = prevVolume && compatibleVolumes(prevVolume, volume) && difference &&
+                               difference->getDimensions() == outDim && difference->getCellDimension() == size3_t(region);
+            if (!incremental) {
+                if (gridCL() == nullptr || gridCL.getInfo<CL_MEM_SIZE>() < outBytes) {
+                    gridCL = cl::Buffer(OpenCL::getPtr()->getContext(), CL_MEM_READ_WRITE, outBytes);
+                }
+                size3_t globalWorkGroupSize(getGlobalWorkGroupSize(outDim.x, localWorkGroupSize.x),
+                                            getGlobalWorkGroupSize(outDim.y, localWorkGroupSize.y),
+                                            getGlobalWorkGroupSize(outDim.z, localWorkGroupSize.z));
+                int argIndex = 0;
+                kernel_->setArg(argIndex++, *volumeCL);
+                kernel_->setArg(argIndex++, *(volumeCL->getVolumeStruct(volume).getRepresentation<BufferCL>()));
+                kernel_->setArg(argIndex++, gridCL);
+                kernel_->setArg(argIndex++, outDimCL);
+                kernel_->setArg(argIndex++, ivec4(volumeRegionSize_.get()));
+                queue.enqueueNDRangeKernel(*kernel_, cl::NullRange, globalWorkGroupSize, localWorkGroupSize);
+                nComputedCells += outDim.x * outDim.y * outDim.z;
+            } else {
+                changedCells.clear();
+                // Float or quantized differences
+                const auto diff = util::uniformGrid3DValues(*difference);
+                // DynamicVolumeDifferenceAnalysis maps the mean absolute difference d to (d - range.x)/(range.y - range.x),
+                // so unchanged cells are at -range.x/(range.y - range.x)
+                const dvec2 dataRange = prevVolume->dataMap_.dataRange;
+                const auto threshold = static_cast<DynamicVolumeInfoDataType>(-dataRange.x / (dataRange.y - dataRange.x) + changeThreshold_.get());
+                for (size_t z = 0; z < outDim.z; ++z) {
+                    for (size_t y = 0; y < outDim.y; ++y) {
+                        for (size_t x = 0; x < outDim.x; ++x) {
+                            if (diff[util::uniformGrid3DIndex(size3_t(x, y, z), outDim, difference->getLayout())] > threshold) {
+                                changedCells.push_back(static_cast<int>(x + outDim.x * (y + outDim.y * z)));
+                            }
+                        }
+                    }
+                }
+                if (!changedCells.empty()) {
+                    auto cellBytes = changedCells.size() * sizeof(int);
+                    if (cellsCL() == nullptr || cellsCL.getInfo<CL_MEM_SIZE>() < cellBytes) {
+                        cellsCL = cl::Buffer(OpenCL::getPtr()->getContext(), CL_MEM_READ_ONLY, cellBytes);
+                    }
+                    // Blocking, changedCells is reused for the next timestep
+                    queue.enqueueWriteBuffer(cellsCL, CL_TRUE, 0, cellBytes, changedCells.data());
+                    int argIndex = 0;
+                    cellsKernel_->setArg(argIndex++, *volumeCL);
+                    cellsKernel_->setArg(argIndex++, *(volumeCL->getVolumeStruct(volume).getRepresentation<BufferCL>()));
+                    cellsKernel_->setArg(argIndex++, gridCL);
+                    cellsKernel_->setArg(argIndex++, outDimCL);
+                    cellsKernel_->setArg(argIndex++, ivec4(volumeRegionSize_.get()));
+                    cellsKernel_->setArg(argIndex++, cellsCL);
+                    cellsKernel_->setArg(argIndex++, static_cast<int>(changedCells.size()));
+                    queue.enqueueNDRangeKernel(*cellsKernel_, cl::NullRange, getGlobalWorkGroupSize(changedCells.size(), localWorkGroupSize1D), localWorkGroupSize1D);
+                    nComputedCells += changedCells.size();
+                }
+            }
+            auto result = std::make_shared<MinMaxUniformGrid3D>(size3_t(region));
+            result->setModelMatrix(volume->getModelMatrix());
+            result->setWorldMatrix(volume->getWorldMatrix());
+            result->setLayout(layout);
+            result->setDimensions(outDim);
+            readEvents.emplace_back();
+            queue.enqueueReadBuffer(gridCL, CL_FALSE, 0, outBytes, result->getData(), nullptr, &readEvents.back());
+            output->push_back(result);
+            prevVolume = volume;
+        }
+        cl::WaitForEvents(readEvents);
+    } catch (cl::Error& err) {
+        LogError(getCLErrorString(err));
+        output->clear();
+        return output;
+    }
+#ifdef IVW_DETAILED_PROFILING
+    LogInfo("Recomputed " << nComputedCells << " of " << nCells << " min-max cells");
+#endif
+    return output;
+}
+
+std::shared_ptr<UniformGrid3DVector> VolumeMinMaxCLProcessor::computeSequenceWithDifference(const VolumeSequence& volumes, UniformGrid3DVector& differences) {
+    auto output = std::make_shared<UniformGrid3DVector>();
+    differences.clear();
+    if (volumes.empty()) {
+        return output;
+    }
+    const Volume* first = volumes.front().get();
+    for (const auto& volume : volumes) {
+        if (volume->getDimensions() != first->getDimensions() || volume->getDataFormat() != first->getDataFormat()) {
+            LogError("Volumes of a sequence must have the same dimensions and format to compute differences");
+            return output;
+        }
+    }
+    const auto layout = static_cast<UniformGrid3DLayout>(layout_.get());
+    const size_t region = static_cast<size_t>(volumeRegionSize_.get());
+    const size3_t dim{ first->getDimensions() };
+    const size3_t outDim{ glm::ceil(vec3(dim) / static_cast<float>(region)) };
+    const size_t nOutElements = util::uniformGrid3DStorageSize(outDim, layout);
+    const size3_t localWorkGroupSize(workGroupSize_.get());
+    const size3_t globalWorkGroupSize(getGlobalWorkGroupSize(outDim.x, localWorkGroupSize.x),
+                                      getGlobalWorkGroupSize(outDim.y, localWorkGroupSize.y),
+                                      getGlobalWorkGroupSize(outDim.z, localWorkGroupSize.z));
+    auto& queue = OpenCL::getPtr()->getQueue();
+    auto upload = [&](const Volume* volume, std::unique_ptr<VolumeCL>& volumeCL) {
+        if (!volumeCL) {
+            volumeCL = std::make_unique<VolumeCL>(dim, volume->getDataFormat());
+        }
+        cl::size_t<3> origin;
+        cl::size_t<3> imageRegion;
+        imageRegion[0] = dim.x; imageRegion[1] = dim.y; imageRegion[2] = dim.z;
+        queue.enqueueWriteImage(volumeCL->getEditable(), CL_FALSE, origin, imageRegion, 0, 0,
+                                const_cast<void*>(volume->getRepresentation<VolumeRAM>()->getData()));
+    };
+    // The first timestep is needed again by the last one,
+    // the others alternate between two slots while being the current or next timestep
+    std::unique_ptr<VolumeCL> firstCL;
+    std::array<std::unique_ptr<VolumeCL>, 2> slots;
+    cl::Buffer minMaxCL;
+    cl::Buffer differenceCL;
+    std::vector<cl::Event> readEvents;
+    try {
+        minMaxCL = cl::Buffer(OpenCL::getPtr()->getContext(), CL_MEM_WRITE_ONLY, nOutElements * DataVec2UInt16::size);
+        differenceCL = cl::Buffer(OpenCL::getPtr()->getContext(), CL_MEM_WRITE_ONLY, nOutElements * sizeof(DynamicVolumeInfoDataType));
+        upload(first, firstCL);
+        const VolumeCL* currentCL = firstCL.get();
+        for (size_t t = 0; t < volumes.size(); ++t) {
+            auto volume = volumes[t].get();
+            auto nextIndex = (t + 1) % volumes.size();
+            auto nextVolume = volumes[nextIndex].get();
+            const VolumeCL* nextCL = firstCL.get();
+            if (nextIndex != 0) {
+                // In-order queue, the slot is no longer used by the computation of timestep t-1
+                upload(nextVolume, slots[t % 2]);
+                nextCL = slots[t % 2].get();
+            }
+            const dvec2 dataRange = volume->dataMap_.dataRange;
+            const dvec2 defaultRange = DataMapper(volume->getDataFormat()).dataRange;
+            int argIndex = 0;
+            differenceKernel_->setArg(argIndex++, *currentCL);
+            differenceKernel_->setArg(argIndex++, *(currentCL->getVolumeStruct(volume).getRepresentation<BufferCL>()));
+            differenceKernel_->setArg(argIndex++, *nextCL);
+            differenceKernel_->setArg(argIndex++, *(nextCL->getVolumeStruct(nextVolume).getRepresentation<BufferCL>()));
+            differenceKernel_->setArg(argIndex++, minMaxCL);
+            differenceKernel_->setArg(argIndex++, differenceCL);
+            differenceKernel_->setArg(argIndex++, ivec4(outDim, static_cast<int>(layout)));
+            differenceKernel_->setArg(argIndex++, ivec4(volumeRegionSize_.get()));
+            // Same encoding as DynamicVolumeDifferenceAnalysis, which scales differences from the default to the data range
+            differenceKernel_->setArg(argIndex++, static_cast<float>((defaultRange.y - defaultRange.x) / (dataRange.y - dataRange.x)));
+            differenceKernel_->setArg(argIndex++, static_cast<float>(dataRange.x / (dataRange.y - dataRange.x)));
+            queue.enqueueNDRangeKernel(*differenceKernel_, cl::NullRange, globalWorkGroupSize, localWorkGroupSize);
+            
+            auto minMax = std::make_shared<MinMaxUniformGrid3D>(size3_t(region));
+            auto difference = std::make_shared<DynamicVolumeInfoUniformGrid3D>(size3_t(region));
+            for (auto grid : { static_cast<UniformGrid3DBase*>(minMax.get()), static_cast<UniformGrid3DBase*>(difference.get()) }) {
+                grid->setModelMatrix(volume->getModelMatrix());
+                grid->setWorldMatrix(volume->getWorldMatrix());
+                grid->setLayout(layout);
+                grid->setDimensions(outDim);
+            }
+            // Results are read before the next computation overwrites them (in-order queue)
+            readEvents.emplace_back();
+            queue.enqueueReadBuffer(minMaxCL, CL_FALSE, 0, minMax->getSizeInBytes(), minMax->getData(), nullptr, &readEvents.back());
+            readEvents.emplace_back();
+            queue.enqueueReadBuffer(differenceCL, CL_FALSE, 0, difference->getSizeInBytes(), difference->getData(), nullptr, &readEvents.back());
+            queue.flush();
+            output->push_back(minMax);
+            differences.push_back(difference);
+            currentCL = nextCL;
+        }
+        cl::WaitForEvents(readEvents);
+#ifdef IVW_DETAILED_PROFILING
+        // Compare against the host implementation, catches encoding mismatches for volumes with a custom data range
+        for (size_t t = 0; t < volumes.size(); ++t) {
+            auto reference = util::volumeDifferenceGrid(*volumes[t], *volumes[(t + 1) % volumes.size()], region, layout);
+            auto expected = static_cast<const DynamicVolumeInfoDataType*>(static_cast<const UniformGrid3DBase*>(reference.get())->getData());
+            auto computed = static_cast<const DynamicVolumeInfoDataType*>(static_cast<const UniformGrid3DBase*>(differences[t].get())->getData());
+            float maxError = 0.f;
+            for (size_t i = 0; i < reference->data.getSize(); ++i) {
+                maxError = std::max(maxError, std::abs(expected[i] - computed[i]));
+            }
+            LogInfo("Difference grid " << t << " max error compared to host: " << maxError);
+        }
+#endif
+        if (differencePrecision_.get() < 32) {
+            const DataFormatBase* format = differencePrecision_.get() == 8 ? DataUInt8::get() : DataUInt16::get();
+            for (auto& difference : differences) {
+                difference = util::quantizeUniformGrid3D(*difference, format);
+            }
+        }
+    } catch (cl::Error& err) {
+        LogError(getCLErrorString(err));
+        output->clear();
+        differences.clear();
+    }
+    return output;
+}
+
 } // namespace
 
 
@@ -36,6 +36,7 @@
 #include <inviwo/core/datastructures/buffer/buffer.h>
 #include <inviwo/core/ports/volumeport.h>
 #include <inviwo/core/properties/boolproperty.h>
+#include <inviwo/core/properties/optionproperty.h>
 #include <inviwo/core/properties/ordinalproperty.h>
 #include <inviwo/core/processors/processor.h>
 
@@ -80,6 +81,46 @@ public:
     virtual void process() override;
     
     std::unique_ptr<MinMaxUniformGrid3D> compute(const Volume* volume);
+    /**
+     * \brief Compute min-max grids for a sequence while streaming volumes to the device.
+     *
+     * Volumes of equal size, format and data range are stacked into batches 
+     * (at most maxBatchSize_ MB) processed in a single dispatch. 
+     * Two batches are kept on the device: while one is reduced on the main queue 
+     * the next is uploaded on the asynchronous queue. Results are read back directly,
+     * so the device working set is bounded independent of sequence length.
+     */
+    std::shared_ptr<UniformGrid3DVector> computeSequence(const VolumeSequence& volumes);
+    /**
+     * \brief Compute min-max grids for a sequence by updating the grid of the previous timestep.
+     *
+     * Only cells whose mean absolute difference to the previous timestep exceeds changeThreshold_
+     * are recomputed. The differences are read from the grids of DynamicVolumeDifferenceAnalysis,
+     * where grid t holds the difference between timestep t and t+1. Timesteps without a matching
+     * difference grid, or of another size, format or data range than the previous one, are computed fully.
+     * @param differences One DynamicVolumeInfoUniformGrid3D per timestep with the same cell dimension as the output.
+     *                    Quantized grids cannot represent differences below zero, which occur if the data range
+     *                    does not start at zero. Such cells are conservatively recomputed.
+     */
+    std::shared_ptr<UniformGrid3DVector> computeSequenceIncremental(const VolumeSequence& volumes, const UniformGrid3DVector& differences);
+    /**
+     * \brief Compute min-max grids and the difference grids of DynamicVolumeDifferenceAnalysis in one pass.
+     *
+     * Each timestep is uploaded once and read together with the next timestep (the last with the first),
+     * which stays resident until the difference to it has been computed.
+     * All volumes must have the same dimensions and format.
+     * @param differences Filled with one DynamicVolumeInfoUniformGrid3D per timestep, 
+     *                    holding the mean absolute difference to the next timestep.
+     */
+    std::shared_ptr<UniformGrid3DVector> computeSequenceWithDifference(const VolumeSequence& volumes, UniformGrid3DVector& differences);
+    /**
+     * \brief Compute min-max grid of a volume that does not fit on the device.
+     *
+     * The volume is uploaded in slabs of whole cell layers along z (at most maxBatchSize_ MB)
+     * from its RAM representation, and the result of each slab is read back into the grid.
+     * Used by compute if BrickedVolumeCL::fitsOnDevice returns false.
+     */
+    std::unique_ptr<MinMaxUniformGrid3D> computeInSlabs(const Volume* volume);
     
     void executeVolumeOperation(const Volume* volume, const VolumeCLBase* volumeCL, BufferCLBase* volumeOutCL, const size3_t& outDim, const size3_t& globalWorkGroupSize, const size3_t& localWorkgroupSize);
     private:
@@ -89,13 +130,23 @@ public:
     // Vector in/out
     VolumeSequenceInport vectorInport_;
     UniformGrid3DVectorOutport vectorOutport_;
+    UniformGrid3DVectorInport differenceInport_; // Change mask for incremental sequence updates
+    UniformGrid3DVectorOutport differenceOutport_; // Computed together with the min-max grids if connected
     
     IntProperty volumeRegionSize_;
+    OptionPropertyInt layout_; // UniformGrid3DLayout of the output grids
     IntVec3Property workGroupSize_;
     BoolProperty useGLSharing_;
+    IntProperty maxBatchSize_; // In MB, used for sequences
+    BoolProperty incrementalSequence_; // Only recompute changed cells if differenceInport_ is connected
+    FloatProperty changeThreshold_; // Cells with mean absolute difference up to the threshold, relative to the data range, are reused
+    OptionPropertyInt differencePrecision_; // Bits per value of differenceOutport_, 8 and 16 bits are quantized on the host
     
     
     cl::Kernel* kernel_;
+    cl::Kernel* batchKernel_;
+    cl::Kernel* cellsKernel_;
+    cl::Kernel* differenceKernel_;
 };
 
 } // namespace
@@ -60,6 +60,7 @@ VolumeSequencePlayer::VolumeSequencePlayer()
 , volumesPerSecond_("volumesPerSecond", "Frame rate", 10, 1, 60, 1, InvalidationLevel::Valid)
 , sequenceTimer_(Timer::Milliseconds(1000 / volumesPerSecond_.get()), [this](){ onSequenceTimerEvent(); })
 , playSequence_("playSequence", "Play Sequence", false)
+, prefetch_("prefetch", "Prefetch timesteps", true)
 {
     addPort(inport_);
     inport_.onChange([this]() {
@@ -89,6 +90,7 @@ VolumeSequencePlayer::VolumeSequencePlayer()
             sequenceTimer_.stop();
         }
     });
+    addProperty(prefetch_);
 }
 
 void VolumeSequencePlayer::process() {
@@ -137,6 +139,13 @@ void VolumeSequencePlayer::process() {
         fbo_.deactivate();
         
         outport_.setData(outVolume_);
+        
+        if (prefetch_ && volumes->size() > 2) {
+            // Upload the volume following the two in use now, 
+            // instead of stalling when it is needed by the next frame.
+            auto prefetchTimeStep = (nextTimeStep + 1) % volumes->size();
+            volumes->at(prefetchTimeStep)->getRepresentation<VolumeGL>();
+        }
     } else {
         outport_.setData(volumes->at(timeStep));
     }
@@ -94,6 +94,7 @@ private:
     FloatProperty timePerVolume_;
     IntProperty volumesPerSecond_;
     BoolProperty playSequence_;
+    BoolProperty prefetch_; // Upload the upcoming volume to the GPU after mixing
     
     Timer sequenceTimer_;
 };
@@ -0,0 +1,216 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2016 Daniel Jönsson
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ *********************************************************************************/
+
+
+#include "volumesequenceplayercl.h"
+
+#include <modules/opencl/syncclgl.h>
+#include <modules/opencl/volume/volumecl.h>
+#include <modules/opencl/volume/volumeclgl.h>
+#include <modules/opengl/volume/volumegl.h>
+
+
+namespace inviwo {
+
+// The Class Identifier has to be globally unique. Use a reverse DNS naming scheme
+const ProcessorInfo VolumeSequencePlayerCL::processorInfo_{
+    "org.inviwo.VolumeSequencePlayerCL",    // Class identifier
+    "Volume Sequence Player CL",            // Display name
+    "Volume",                               // Category
+    CodeState::Experimental,                // Code state
+    Tags::CL,                               // Tags
+};
+const ProcessorInfo VolumeSequencePlayerCL::getProcessorInfo() const {
+    return processorInfo_;
+}
+
+VolumeSequencePlayerCL::VolumeSequencePlayerCL()
+: Processor()
+, inport_("volumeSequence")
+, outport_("InterpolatedVolume")
+, time_("time", "Time", 0.f, 0.f, 0.f)
+, index_("selectedSequenceIndex", "Sequence index", 1, 1, 1)
+, timePerVolume_("timePerVolume", "Time Per Volume (s)", 1.f, 0.01f, 10.f, 0.01f)
+, volumesPerSecond_("volumesPerSecond", "Frame rate", 10, 1, 60, 1, InvalidationLevel::Valid)
+, playSequence_("playSequence", "Play Sequence", false)
+, prefetch_("prefetch", "Prefetch timesteps", true)
+, workGroupSize_("wgsize", "Work group size", 128, 1, 2048)
+, useGLSharing_("glsharing", "Use OpenGL sharing", false)
+, sequenceTimer_(Timer::Milliseconds(1000 / volumesPerSecond_.get()), [this](){ onSequenceTimerEvent(); })
+, bufferMixer_(128, false)
+{
+    addPort(inport_);
+    inport_.onChange([this]() {
+        prefetcher_.clear();
+        onTimeStepChange();
+    });
+    addPort(outport_);
+    addProperty(time_);
+    time_.onChange([this](){ updateVolumeIndex(); });
+    addProperty(index_);
+    index_.setReadOnly(true);
+    addProperty(timePerVolume_);
+    timePerVolume_.onChange([this]() {
+        onTimeStepChange();
+    });
+    
+    addProperty(volumesPerSecond_);
+    volumesPerSecond_.onChange([this]() { sequenceTimer_.setInterval(Timer::Milliseconds(1000 / volumesPerSecond_.get())); });
+    addProperty(playSequence_);
+    playSequence_.onChange([this]() {
+        time_.setReadOnly(playSequence_);
+        
+        if (playSequence_) {
+            sequenceTimer_.setInterval(Timer::Milliseconds(1000 / volumesPerSecond_.get()));
+            sequenceTimer_.start();
+        } else {
+            sequenceTimer_.stop();
+        }
+    });
+    addProperty(prefetch_);
+    addProperty(workGroupSize_);
+    addProperty(useGLSharing_);
+    // Output volumes are created with the representation matching the sharing mode
+    useGLSharing_.onChange([this]() {
+        outVolume_.reset();
+        outVolumePingPong_.reset();
+    });
+}
+
+void VolumeSequencePlayerCL::process() {
+    auto volumes = inport_.getData();
+    float integerTime;
+    // Time between two volumes
+    float t = std::modf(time_ / timePerVolume_, &integerTime);
+    auto timeStep = static_cast<size_t>(index_ - 1);
+    auto nextTimeStep = (timeStep + 1) % volumes->size();
+    if (volumes->size() > 1) {
+        // Do not overwrite the volume that may still be in use by the previous network evaluation
+        std::swap(outVolume_, outVolumePingPong_);
+        auto inputVol0 = volumes->at(timeStep);
+        auto dim = inputVol0->getDimensions();
+        auto format = inputVol0->getDataFormat();
+        if (!outVolume_ || outVolume_->getDimensions() != dim
+            || outVolume_->getDataFormat() != format) {
+            if (useGLSharing_) {
+                outVolume_ = std::make_shared<Volume>(std::make_shared<VolumeGL>(dim, format));
+            } else {
+                outVolume_ = std::make_shared<Volume>(std::make_shared<VolumeCL>(dim, format));
+            }
+            outVolume_->setModelMatrix(inputVol0->getModelMatrix());
+            outVolume_->setWorldMatrix(inputVol0->getWorldMatrix());
+            // pass meta data on
+            outVolume_->copyMetaDataFrom(*inputVol0);
+            outVolume_->dataMap_ = inputVol0->dataMap_;
+        }
+        try {
+            std::vector<cl::Event> uploadEvents;
+            const auto& vol0CL = prefetcher_.get(*volumes, timeStep, uploadEvents);
+            const auto& vol1CL = prefetcher_.get(*volumes, nextTimeStep, uploadEvents);
+            
+            auto nVoxels = glm::compMul(dim);
+            auto sizeInBytes = nVoxels * format->getSize();
+            if (mixedVoxelsSizeInBytes_ != sizeInBytes) {
+                mixedVoxels_ = cl::Buffer(OpenCL::getPtr()->getContext(), CL_MEM_READ_WRITE, sizeInBytes);
+                mixedVoxelsSizeInBytes_ = sizeInBytes;
+            }
+            std::vector<cl::Event> mixEvent(1);
+            bufferMixer_.workGroupSize(static_cast<size_t>(workGroupSize_.get()));
+            bufferMixer_.mix(vol0CL, vol1CL, t, format, mixedVoxels_, nVoxels, &uploadEvents, &mixEvent[0]);
+            // 3D image writes are not supported by all devices, copy the mixed voxels instead
+            if (useGLSharing_) {
+                SyncCLGL glSync;
+                auto outVolumeCL = outVolume_->getEditableRepresentation<VolumeCLGL>();
+                glSync.addToAquireGLObjectList(outVolumeCL);
+                glSync.aquireAllObjects();
+                OpenCL::getPtr()->getQueue().enqueueCopyBufferToImage(mixedVoxels_, outVolumeCL->getEditable(), 0, size3_t(0), dim, &mixEvent);
+            } else {
+                auto outVolumeCL = outVolume_->getEditableRepresentation<VolumeCL>();
+                OpenCL::getPtr()->getQueue().enqueueCopyBufferToImage(mixedVoxels_, outVolumeCL->getEditable(), 0, size3_t(0), dim, &mixEvent);
+            }
+            
+            if (prefetch_ && volumes->size() > 2) {
+                // Predict timesteps needed during the next frames from playback direction and speed
+                // The timer only plays forward, but wraps around at the end
+                int direction = playSequence_ || time_.get() >= prevTime_ ? 1 : -1;
+                float timestepsPerFrame = playSequence_ ? 1.f / (static_cast<float>(volumesPerSecond_.get()) * timePerVolume_.get()) : 1.f;
+                auto nTimesteps = static_cast<size_t>(std::ceil(2.f * timestepsPerFrame));
+                prefetcher_.prefetch(*volumes, direction > 0 ? nextTimeStep : timeStep, direction, nTimesteps);
+            }
+        } catch (cl::Error& err) {
+            LogError(getCLErrorString(err));
+        } catch (std::runtime_error& err) {
+            // BufferMixerCL could not compile its kernel for the volume format
+            LogError(err.what());
+        }
+        prevTime_ = time_.get();
+        outport_.setData(outVolume_);
+    } else {
+        outport_.setData(volumes->at(timeStep));
+    }
+}
+
+void VolumeSequencePlayerCL::onSequenceTimerEvent() {
+    auto time = time_.get();
+    time = time + static_cast<float>(1000 / volumesPerSecond_.get())/1000.f;
+    // Wrap around time
+    if (time > time_.getMaxValue()) {
+        time -= time_.getMaxValue();
+    }
+    time_.set(time);
+    updateVolumeIndex();
+}
+
+void VolumeSequencePlayerCL::updateVolumeIndex() {
+    float integerTime;
+    // Time between two volumes
+    std::modf(time_ / timePerVolume_, &integerTime);
+    auto timeStep = static_cast<size_t>(integerTime) % index_.getMaxValue();
+    if (timeStep != static_cast<size_t>(index_ - 1)) {
+        index_.set(static_cast<int>(timeStep + 1));
+    }
+}
+
+void VolumeSequencePlayerCL::onTimeStepChange() {
+    if (inport_.hasData()) {
+        auto volumes = inport_.getData();
+        time_.setMaxValue(time_.getMinValue() + static_cast<float>(volumes->size() - 1) * timePerVolume_);
+        if (time_ > time_.getMaxValue()) {
+            time_.set(time_.getMinValue());
+        }
+        index_.setMaxValue(static_cast<int>(volumes->size()));
+        if (index_ > index_.getMaxValue()) {
+            index_.set(index_.getMinValue());
+        }
+    }
+}
+
+
+} // namespace
+
@@ -0,0 +1,116 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2016 Daniel Jönsson
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ *********************************************************************************/
+
+
+#ifndef IVW_VOLUMESEQUENCEPLAYERCL_H
+#define IVW_VOLUMESEQUENCEPLAYERCL_H
+
+#include <modules/uniformgridcl/uniformgridclmoduledefine.h>
+#include <inviwo/core/common/inviwo.h>
+#include <inviwo/core/processors/processor.h>
+#include <inviwo/core/properties/boolproperty.h>
+#include <inviwo/core/properties/ordinalproperty.h>
+#include <inviwo/core/ports/volumeport.h>
+
+#include <inviwo/core/util/timer.h>
+
+#include <modules/opencl/inviwoopencl.h>
+#include <modules/uniformgridcl/buffermixercl.h>
+#include <modules/uniformgridcl/uniformgrid3dprefetchercl.h>
+
+namespace inviwo {
+
+/** \docpage{org.inviwo.VolumeSequencePlayerCL, Volume Sequence Player CL}
+ * ![](org.inviwo.VolumeSequencePlayerCL.png?classIdentifier=org.inviwo.VolumeSequencePlayerCL)
+ * Linearly interpolates between two consecutive volumes of a sequence using OpenCL.
+ * The interpolated volume is written directly into an OpenCL image, so OpenCL processors
+ * such as the photon tracer can use it without OpenGL sharing.
+ *
+ * ### Inports
+ *   * __volumeSequence__ Volumes of equal dimensions and data format.
+ *
+ * ### Outports
+ *   * __InterpolatedVolume__ Volume at the current time, with an OpenCL representation.
+ *
+ * ### Properties
+ *   * __Time__ Current time of the sequence.
+ *   * __Prefetch timesteps__ Upload upcoming timesteps ahead of time.
+ *   * __Use OpenGL sharing__ Write the result to a shared OpenCL/OpenGL volume instead of an OpenCL image.
+ */
+
+
+/**
+ * \class VolumeSequencePlayerCL
+ * \brief Linearly interpolates between two volumes to create the output at time t.
+ * OpenCL counterpart of VolumeSequencePlayer. Timesteps are kept on the device by
+ * UniformGrid3DPrefetcherCL, mixed by BufferMixerCL and copied into the output image.
+ */
+class IVW_MODULE_UNIFORMGRIDCL_API VolumeSequencePlayerCL : public Processor {
+public:
+    VolumeSequencePlayerCL();
+    virtual ~VolumeSequencePlayerCL() = default;
+    
+    virtual void process() override;
+    
+    virtual const ProcessorInfo getProcessorInfo() const override;
+    static const ProcessorInfo processorInfo_;
+    
+private:
+    void onSequenceTimerEvent();
+    void updateVolumeIndex();
+    void onTimeStepChange();
+    
+    VolumeSequenceInport inport_;
+    VolumeOutport outport_;
+    
+    std::shared_ptr<Volume> outVolume_;
+    std::shared_ptr<Volume> outVolumePingPong_;
+    
+    FloatProperty time_;
+    IntProperty index_;
+    FloatProperty timePerVolume_;
+    IntProperty volumesPerSecond_;
+    BoolProperty playSequence_;
+    BoolProperty prefetch_; // Upload upcoming timesteps ahead of time
+    IntProperty workGroupSize_;
+    BoolProperty useGLSharing_;
+    
+    Timer sequenceTimer_;
+    
+    BufferMixerCL bufferMixer_;
+    UniformGrid3DPrefetcherCL prefetcher_;
+    cl::Buffer mixedVoxels_; // Mixed data before it is copied into the output image
+    size_t mixedVoxelsSizeInBytes_ = 0;
+    float prevTime_ = 0.f; // Used to determine playback direction
+};
+
+} // namespace
+
+#endif // IVW_VOLUMESEQUENCEPLAYERCL_H
+
@@ -29,12 +29,17 @@
 
 
 #include <modules/uniformgridcl/uniformgrid3d.h>
+#include <inviwo/core/util/exception.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 namespace inviwo {
 
 
-UniformGrid3DBase::UniformGrid3DBase(size3_t cellDimension /*= size3_t(1)*/) : StructuredGridEntity<3>(), cellDimension_(cellDimension) {
-    
+UniformGrid3DBase::UniformGrid3DBase(size3_t cellDimension /*= size3_t(1)*/) : StructuredGridEntity<3>(), cellDimension_(cellDimension), valueScale_(1) {
+    setValueScale(1.f);
 }
 
 UniformGrid3DBase::UniformGrid3DBase(const UniformGrid3DBase&) = default;
@@ -43,6 +48,107 @@ UniformGrid3DBase::~UniformGrid3DBase() = default;
 
 UniformGrid3DBase& UniformGrid3DBase::operator=(const UniformGrid3DBase& that) = default;
 
+float UniformGrid3DBase::getValueScale() const {
+    const float scale = static_cast<const float*>(valueScale_.getRAMRepresentation()->getData())[0];
+    return scale > 0.f ? scale : 1.f;
+}
+
+void UniformGrid3DBase::setValueScale(float val) {
+    static_cast<float*>(valueScale_.getEditableRAMRepresentation()->getData())[0] = val;
+}
+
+namespace {
+
+template <typename T>
+void storedToValues(const UniformGrid3DBase& grid, float scale, std::vector<float>& values) {
+    const auto src = static_cast<const T*>(grid.getData());
+    values.resize(grid.getBuffer().getSize());
+    std::transform(src, src + values.size(), values.begin(), [scale](T v) { return scale * static_cast<float>(v); });
+}
+
+template <typename T>
+std::shared_ptr<UniformGrid3DBase> valuesToQuantized(const std::vector<float>& values, const UniformGrid3DBase& grid, float maxValue) {
+    auto out = std::make_shared<UniformGrid3D<T>>(grid.getDimensions(), grid.getCellDimension(), BufferUsage::Static, grid.getLayout());
+    const float maxStored = static_cast<float>(std::numeric_limits<T>::max());
+    const float toStored = maxValue > 0.f ? maxStored / maxValue : 0.f;
+    auto dst = static_cast<T*>(out->getData());
+    std::transform(values.begin(), values.end(), dst, [toStored, maxStored](float v) {
+        // Stored zero means unchanged/unimportant, small positive values must not round down to it
+        return v > 0.f ? static_cast<T>(std::max(1.f, std::round(glm::min(v * toStored, maxStored)))) : T(0);
+    });
+    out->setValueScale(maxValue > 0.f ? maxValue : 1.f);
+    return out;
+}
+
+}  // namespace
+
+bool util::isScalarUniformGrid3DFormat(const DataFormatBase* format) {
+    switch (format->getId()) {
+        case DataFormatId::Float32:
+        case DataFormatId::UInt8:
+        case DataFormatId::UInt16:
+            return true;
+        default:
+            return false;
+    }
+}
+
+float util::uniformGrid3DValueScaleCL(const UniformGrid3DBase& grid) {
+    switch (grid.getDataFormat()->getId()) {
+        case DataFormatId::UInt8:
+            return grid.getValueScale() / 255.f;
+        case DataFormatId::UInt16:
+            return grid.getValueScale() / 65535.f;
+        default:
+            return grid.getValueScale();
+    }
+}
+
+std::vector<float> util::uniformGrid3DValues(const UniformGrid3DBase& grid) {
+    std::vector<float> values;
+    const auto scale = uniformGrid3DValueScaleCL(grid);
+    switch (grid.getDataFormat()->getId()) {
+        case DataFormatId::Float32:
+            storedToValues<float>(grid, scale, values);
+            break;
+        case DataFormatId::UInt8:
+            storedToValues<unsigned char>(grid, scale, values);
+            break;
+        case DataFormatId::UInt16:
+            storedToValues<unsigned short>(grid, scale, values);
+            break;
+        default:
+            throw Exception("Grid values require a scalar float32, uint8 or uint16 grid, got " + std::string(grid.getDataFormat()->getString()),
+                            IVW_CONTEXT_CUSTOM("util::uniformGrid3DValues"));
+    }
+    return values;
+}
+
+std::shared_ptr<UniformGrid3DBase> util::quantizeUniformGrid3D(const UniformGrid3DBase& grid, const DataFormatBase* format) {
+    const auto values = uniformGrid3DValues(grid);
+    std::shared_ptr<UniformGrid3DBase> out;
+    switch (format->getId()) {
+        case DataFormatId::Float32: {
+            auto floatGrid = std::make_shared<UniformGrid3D<float>>(grid.getDimensions(), grid.getCellDimension(), BufferUsage::Static, grid.getLayout());
+            std::copy(values.begin(), values.end(), static_cast<float*>(floatGrid->getData()));
+            out = floatGrid;
+            break;
+        }
+        case DataFormatId::UInt8:
+        case DataFormatId::UInt16: {
+            const auto maxValue = values.empty() ? 0.f : *std::max_element(values.begin(), values.end());
+            out = format->getId() == DataFormatId::UInt8 ? valuesToQuantized<unsigned char>(values, grid, maxValue) : valuesToQuantized<unsigned short>(values, grid, maxValue);
+            break;
+        }
+        default:
+            throw Exception("Grids can only be quantized to float32, uint8 or uint16, got " + std::string(format->getString()),
+                            IVW_CONTEXT_CUSTOM("util::quantizeUniformGrid3D"));
+    }
+    out->setModelMatrix(grid.getModelMatrix());
+    out->setWorldMatrix(grid.getWorldMatrix());
+    return out;
+}
+
 } // namespace
 
 
@@ -40,6 +40,19 @@
 
 namespace inviwo {
 
+/**
+ * Order in which the cells of a UniformGrid3D are stored.
+ *
+ * Linear: id = cellCoordinate.x + cellCoordinate.y*dimension.x + cellCoordinate.z*dimension.x*dimension.y
+ * Morton: Cells are grouped into tiles of 4x4x4 cells, which are stored in linear order.
+ *         Cells within a tile are stored in Morton (Z-) order so that neighboring cells
+ *         in all directions are close in memory, improving cache hit rates when the grid
+ *         is traversed along rays. Dimensions are padded to whole tiles.
+ *
+ * The OpenCL equivalent is uniformGridCellIndex in uniformgrid/uniformgrid.cl
+ */
+enum class UniformGrid3DLayout { Linear = 0, Morton = 1 };
+
 /**
  * \class UniformGrid3D
  *
@@ -57,8 +70,9 @@ namespace inviwo {
  * Cell coordinate is easily computed using input position p:
  * cellCoordinate = floor(p/cellDimension)
  *
- * The underlying data is stored in a linear array:
+ * The underlying data is stored in a linear array, by default:
  * id = cellCoordinate.x + cellCoordinate.y*dimension.x + cellCoordinate.z*dimension.x*dimension.y
+ * See UniformGrid3DLayout for other orders and util::uniformGrid3DIndex for computing the id.
  */
 class IVW_MODULE_UNIFORMGRIDCL_API UniformGrid3DBase : public StructuredGridEntity<3> {
 public:
@@ -81,8 +95,39 @@ public:
     
     size3_t getCellDimension() const { return cellDimension_; }
     void setCellDimension(size3_t val) { cellDimension_ = val; }
+    
+    UniformGrid3DLayout getLayout() const { return layout_; }
+    /**
+     * Change the order in which cells are stored. Existing data
+     * is reordered on the host.
+     */
+    virtual void setLayout(UniformGrid3DLayout layout) = 0;
+    
+    /**
+     * Factor converting stored values to actual values.
+     * Grids of unsigned integer formats store values normalized to [0 1],
+     * i.e. stored/255*valueScale for 8-bit grids, see util::quantizeUniformGrid3D.
+     * Returns 1 if the stored scale is not positive, in which case all stored values are zero.
+     * Reading it waits for the scale if it was last written on the device.
+     */
+    float getValueScale() const;
+    void setValueScale(float val);
+    /**
+     * Value scale as a buffer with one float, so that it can be computed, see UniformGrid3DQuantizerCL,
+     * and read by kernels, see uniformGridValueScale in uniformgrid/uniformgrid.cl,
+     * without synchronizing with the host.
+     */
+    const Buffer<float>& getValueScaleBuffer() const { return valueScale_; }
+    Buffer<float>& getEditableValueScaleBuffer() { return valueScale_; }
+    
+    // Data independent of format, for example to get its OpenCL representations
+    virtual const BufferBase& getBuffer() const = 0;
+    virtual BufferBase& getEditableBuffer() = 0;
+    protected:
+    UniformGrid3DLayout layout_ = UniformGrid3DLayout::Linear;
     private:
     size3_t cellDimension_; //< Size of one grid cell
+    Buffer<float> valueScale_;
 };
 
 using UniformGrid3DInport = DataInport<UniformGrid3DBase>;
@@ -106,7 +151,9 @@ struct DataTraits<UniformGrid3DBase> {
         utildoc::TableBuilder tb(doc.handle(), P::end());
         tb(H("Size (bytes)"), data.getSizeInBytes());
         tb(H("Celldimension"), data.getCellDimension());
+        tb(H("Layout"), data.getLayout() == UniformGrid3DLayout::Morton ? "Morton" : "Linear");
         tb(H("Format"), data.getDataFormat()->getString());
+        tb(H("Value scale"), data.getValueScale());
         return doc;
     }
 };
@@ -114,7 +161,7 @@ struct DataTraits<UniformGrid3DBase> {
 template < typename T>
 class UniformGrid3D : public UniformGrid3DBase {
 public:
-    UniformGrid3D(size3_t gridDimensions, size3_t cellDimension, BufferUsage usage = BufferUsage::Static);
+    UniformGrid3D(size3_t gridDimensions, size3_t cellDimension, BufferUsage usage = BufferUsage::Static, UniformGrid3DLayout layout = UniformGrid3DLayout::Linear);
     UniformGrid3D(size3_t cellDimension = size3_t(1));
     virtual ~UniformGrid3D() = default;
     virtual UniformGrid3D* clone() const override;
@@ -124,11 +171,14 @@ public:
      * preserved.
      */
     virtual void setDimensions(const size3_t& dim) override;
+    virtual void setLayout(UniformGrid3DLayout layout) override;
     
     virtual void* getData() override;
     virtual const void* getData() const override;
     virtual size_t getSizeInBytes() const override;
     virtual const DataFormatBase* getDataFormat() const override;
+    virtual const BufferBase& getBuffer() const override { return data; }
+    virtual BufferBase& getEditableBuffer() override { return data; }
     
     Buffer<T> data;
     private:
@@ -140,22 +190,108 @@ namespace util {
     struct IVW_MODULE_UNIFORMGRIDCL_API UniformGrid3DDispatcher {
         using type = std::shared_ptr < UniformGrid3DBase >;
         template <class T>
-        std::shared_ptr<UniformGrid3DBase> dispatch(size3_t gridDimensions, size3_t cellDimension, BufferUsage usage) const {
+        std::shared_ptr<UniformGrid3DBase> dispatch(size3_t gridDimensions, size3_t cellDimension, BufferUsage usage, UniformGrid3DLayout layout = UniformGrid3DLayout::Linear) const {
             typedef typename T::type F;
-            return std::make_shared<UniformGrid3D<F>>(gridDimensions, cellDimension, usage);
+            return std::make_shared<UniformGrid3D<F>>(gridDimensions, cellDimension, usage, layout);
         }
         template <typename Result, typename T>
-        std::shared_ptr<UniformGrid3DBase> operator()(size3_t gridDimensions, size3_t cellDimension, BufferUsage usage) const {
+        std::shared_ptr<UniformGrid3DBase> operator()(size3_t gridDimensions, size3_t cellDimension, BufferUsage usage, UniformGrid3DLayout layout = UniformGrid3DLayout::Linear) const {
             typedef typename T::type F;
-            return std::make_shared<UniformGrid3D<F>>(gridDimensions, cellDimension, usage);
+            return std::make_shared<UniformGrid3D<F>>(gridDimensions, cellDimension, usage, layout);
         }
     };
     
+    // Number of cells along each dimension of a tile in the Morton layout
+    constexpr size_t uniformGrid3DTileSize = 4;
+    
+    /**
+     * Number of elements required to store a grid of dimension dim, 
+     * larger than the number of cells if padding is required by the layout.
+     */
+    inline size_t uniformGrid3DStorageSize(const size3_t& dim, UniformGrid3DLayout layout) {
+        if (layout == UniformGrid3DLayout::Morton) {
+            const size3_t tiles{ (dim + uniformGrid3DTileSize - size_t(1)) / uniformGrid3DTileSize };
+            return tiles.x * tiles.y * tiles.z * uniformGrid3DTileSize * uniformGrid3DTileSize * uniformGrid3DTileSize;
+        }
+        return dim.x * dim.y * dim.z;
+    }
+    
+    /**
+     * Index of the element storing cellCoord, see UniformGrid3DLayout.
+     */
+    inline size_t uniformGrid3DIndex(const size3_t& cellCoord, const size3_t& dim, UniformGrid3DLayout layout) {
+        if (layout == UniformGrid3DLayout::Morton) {
+            // Tiles of uniformGrid3DTileSize=4 cells, giving two bits per local coordinate
+            const size3_t tiles{ (dim + size_t(3)) / size_t(4) };
+            const size3_t tile{ cellCoord / size_t(4) };
+            const size3_t local{ cellCoord % size_t(4) };
+            const size_t tileIndex = tile.x + tiles.x * (tile.y + tiles.y * tile.z);
+            // Interleave the two bits of each local coordinate: zyxzyx
+            return (tileIndex << 6) | (local.x & 1) | ((local.y & 1) << 1) | ((local.z & 1) << 2) |
+                   ((local.x & 2) << 2) | ((local.y & 2) << 3) | ((local.z & 2) << 4);
+        }
+        return cellCoord.x + dim.x * (cellCoord.y + dim.y * cellCoord.z);
+    }
+    
+    /**
+     * Cell coordinate stored at index, inverse of uniformGrid3DIndex. 
+     * Padding elements map to coordinates outside of dim.
+     */
+    inline size3_t uniformGrid3DCellCoordinate(size_t index, const size3_t& dim, UniformGrid3DLayout layout) {
+        if (layout == UniformGrid3DLayout::Morton) {
+            const size3_t tiles{ (dim + size_t(3)) / size_t(4) };
+            const size_t tileIndex = index >> 6;
+            const size_t m = index & 63;
+            const size3_t tile(tileIndex % tiles.x, (tileIndex / tiles.x) % tiles.y, tileIndex / (tiles.x * tiles.y));
+            const size3_t local((m & 1) | ((m >> 2) & 2), ((m >> 1) & 1) | ((m >> 3) & 2), ((m >> 2) & 1) | ((m >> 4) & 2));
+            return tile * size_t(4) + local;
+        }
+        return size3_t(index % dim.x, (index / dim.x) % dim.y, index / (dim.x * dim.y));
+    }
+    
+    /**
+     * Grid dimensions as passed to OpenCL kernels using uniformGridCellIndex:
+     * xyz number of cells, w layout.
+     */
+    inline ivec4 uniformGrid3DDimensionsCL(const UniformGrid3DBase& grid) {
+        return ivec4(ivec3(grid.getDimensions()), static_cast<int>(grid.getLayout()));
+    }
+    
+    /**
+     * True if grids of format can be read by uniformGridValue in uniformgrid/uniformgrid.cl,
+     * i.e. scalar float32, uint8 or uint16.
+     */
+    IVW_MODULE_UNIFORMGRIDCL_API bool isScalarUniformGrid3DFormat(const DataFormatBase* format);
+    
+    /**
+     * Scale converting stored values to actual values: getValueScale() for float grids 
+     * and getValueScale()/255 or getValueScale()/65535 for 8-bit and 16-bit grids.
+     * Host equivalent of uniformGridValueScale in uniformgrid/uniformgrid.cl.
+     */
+    IVW_MODULE_UNIFORMGRIDCL_API float uniformGrid3DValueScaleCL(const UniformGrid3DBase& grid);
+    
+    /**
+     * Actual values of a scalar grid, see isScalarUniformGrid3DFormat.
+     * Stored values are multiplied by their scale, one value per element including padding.
+     */
+    IVW_MODULE_UNIFORMGRIDCL_API std::vector<float> uniformGrid3DValues(const UniformGrid3DBase& grid);
+    
+    /**
+     * Quantize a scalar grid to format (uint8, uint16 or float32).
+     * Values are normalized by the largest value, which becomes the value scale of the result.
+     * Negative values are clamped to zero and positive values are stored as at least one, 
+     * so that zero only represents values that are not positive.
+     * Converting to float32 stores the actual values with scale 1.
+     * @return Quantized copy of grid with the same dimensions, layout and transformations.
+     */
+    IVW_MODULE_UNIFORMGRIDCL_API std::shared_ptr<UniformGrid3DBase> quantizeUniformGrid3D(const UniformGrid3DBase& grid, const DataFormatBase* format);
+    
 }  // namespace
 
 template < typename T>
-inviwo::UniformGrid3D<T>::UniformGrid3D(size3_t gridDimensions, size3_t cellDimension, BufferUsage usage)
-: UniformGrid3DBase(cellDimension), data(gridDimensions.x*gridDimensions.y*gridDimensions.z, usage) {
+inviwo::UniformGrid3D<T>::UniformGrid3D(size3_t gridDimensions, size3_t cellDimension, BufferUsage usage, UniformGrid3DLayout layout)
+: UniformGrid3DBase(cellDimension), data(util::uniformGrid3DStorageSize(gridDimensions, layout), usage) {
+    layout_ = layout;
     setDimensions(gridDimensions);
 }
 template < typename T>
@@ -184,7 +320,33 @@ void UniformGrid3D<T>::setDimensions(const size3_t& dim) {
     // Implement function directly until cause of error is found.
     //UniformGrid3DBase::setDimensions(dim);
     dimensions_ = dim;
-    data.setSize(dim.x*dim.y*dim.z);
+    data.setSize(util::uniformGrid3DStorageSize(dim, layout_));
+}
+
+template < typename T >
+void UniformGrid3D<T>::setLayout(UniformGrid3DLayout layout) {
+    if (layout == layout_) {
+        return;
+    }
+    if (data.getSize() == 0) {
+        layout_ = layout;
+        data.setSize(util::uniformGrid3DStorageSize(dimensions_, layout_));
+        return;
+    }
+    // Padding elements are zero
+    std::vector<T> reordered(util::uniformGrid3DStorageSize(dimensions_, layout), T(0));
+    const auto src = static_cast<const T*>(data.getRAMRepresentation()->getData());
+    for (size_t z = 0; z < dimensions_.z; ++z) {
+        for (size_t y = 0; y < dimensions_.y; ++y) {
+            for (size_t x = 0; x < dimensions_.x; ++x) {
+                const size3_t cellCoord(x, y, z);
+                reordered[util::uniformGrid3DIndex(cellCoord, dimensions_, layout)] = src[util::uniformGrid3DIndex(cellCoord, dimensions_, layout_)];
+            }
+        }
+    }
+    layout_ = layout;
+    data.setSize(reordered.size());
+    std::copy(reordered.begin(), reordered.end(), static_cast<T*>(data.getEditableRAMRepresentation()->getData()));
 }
 
 template <typename T>
@@ -0,0 +1,147 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2016 Daniel Jönsson
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include "uniformgrid3dprefetchercl.h"
+#include <inviwo/core/datastructures/volume/volumeram.h>
+
+namespace inviwo {
+
+UniformGrid3DPrefetcherCL::UniformGrid3DPrefetcherCL(size_t maxResidentTimesteps)
+    : maxResidentTimesteps_(std::max<size_t>(maxResidentTimesteps, 2)) {}
+
+UniformGrid3DPrefetcherCL::~UniformGrid3DPrefetcherCL() {
+    clear();
+}
+
+namespace {
+// Host data and its size in bytes
+std::pair<const void*, size_t> getHostData(const UniformGrid3DBase& grid) {
+    return { grid.getData(), grid.getSizeInBytes() };
+}
+std::pair<const void*, size_t> getHostData(const Volume& volume) {
+    auto volumeRAM = volume.getRepresentation<VolumeRAM>();
+    return { volumeRAM->getData(), glm::compMul(volume.getDimensions()) * volume.getDataFormat()->getSize() };
+}
+}
+
+void UniformGrid3DPrefetcherCL::prefetch(const UniformGrid3DVector& sequence, size_t timestep, int direction, size_t nTimesteps) {
+    prefetchSequence(sequence, timestep, direction, nTimesteps);
+}
+
+void UniformGrid3DPrefetcherCL::prefetch(const VolumeSequence& sequence, size_t timestep, int direction, size_t nTimesteps) {
+    prefetchSequence(sequence, timestep, direction, nTimesteps);
+}
+
+template <typename Sequence>
+void UniformGrid3DPrefetcherCL::prefetchSequence(const Sequence& sequence, size_t timestep, int direction, size_t nTimesteps) {
+    if (sequence.empty()) {
+        return;
+    }
+    // Never evict the timesteps in use
+    nTimesteps = std::min(nTimesteps, std::min(maxResidentTimesteps_ - 2, sequence.size() - 1));
+    try {
+        auto n = static_cast<long long>(sequence.size());
+        for (size_t i = 1; i <= nTimesteps; ++i) {
+            auto next = ((static_cast<long long>(timestep) + direction * static_cast<long long>(i)) % n + n) % n;
+            upload(sequence, static_cast<size_t>(next));
+        }
+        // Start transfers, do not wait for them
+        OpenCL::getPtr()->getAsyncQueue().flush();
+    } catch (cl::Error& err) {
+        LogError(getCLErrorString(err));
+    }
+}
+
+const cl::Buffer& UniformGrid3DPrefetcherCL::get(const UniformGrid3DVector& sequence, size_t timestep, std::vector<cl::Event>& waitForEvents) {
+    auto& entry = upload(sequence, timestep);
+    entry.lastUsed = ++useCounter_;
+    waitForEvents.push_back(entry.uploaded);
+    return entry.buffer;
+}
+
+const cl::Buffer& UniformGrid3DPrefetcherCL::get(const VolumeSequence& sequence, size_t timestep, std::vector<cl::Event>& waitForEvents) {
+    auto& entry = upload(sequence, timestep);
+    entry.lastUsed = ++useCounter_;
+    waitForEvents.push_back(entry.uploaded);
+    return entry.buffer;
+}
+
+template <typename Sequence>
+UniformGrid3DPrefetcherCL::ResidentTimestep& UniformGrid3DPrefetcherCL::upload(const Sequence& sequence, size_t timestep) {
+    if (sequence.front().get() != sequenceFront_ || sequence.size() != sequenceSize_) {
+        clear();
+        sequenceFront_ = sequence.front().get();
+        sequenceSize_ = sequence.size();
+    }
+    auto it = resident_.find(timestep);
+    if (it != resident_.end()) {
+        return it->second;
+    }
+    evict(maxResidentTimesteps_ - 1);
+    
+    ResidentTimestep entry;
+    entry.data = sequence[timestep];
+    entry.lastUsed = ++useCounter_;
+    auto hostData = getHostData(*sequence[timestep]);
+    auto sizeInBytes = hostData.second;
+    // Evicted buffers are not reused since they may still be read by kernels on the main queue.
+    // OpenCL defers releasing them until those have finished.
+    entry.buffer = cl::Buffer(OpenCL::getPtr()->getContext(), CL_MEM_READ_ONLY, sizeInBytes);
+    OpenCL::getPtr()->getAsyncQueue().enqueueWriteBuffer(entry.buffer, CL_FALSE, 0, sizeInBytes, hostData.first, nullptr, &entry.uploaded);
+    return resident_.emplace(timestep, std::move(entry)).first->second;
+}
+
+void UniformGrid3DPrefetcherCL::evict(size_t nResident) {
+    while (resident_.size() > nResident) {
+        auto lru = std::min_element(resident_.begin(), resident_.end(), [](const std::pair<const size_t, ResidentTimestep>& a, const std::pair<const size_t, ResidentTimestep>& b) {
+            return a.second.lastUsed < b.second.lastUsed;
+        });
+        // Host data must be valid until the transfer has completed
+        lru->second.uploaded.wait();
+        resident_.erase(lru);
+    }
+}
+
+void UniformGrid3DPrefetcherCL::clear() {
+    try {
+        evict(0);
+    } catch (cl::Error& err) {
+        LogError(getCLErrorString(err));
+    }
+    sequenceFront_ = nullptr;
+    sequenceSize_ = 0;
+}
+
+void UniformGrid3DPrefetcherCL::setMaxResidentTimesteps(size_t val) {
+    maxResidentTimesteps_ = std::max<size_t>(val, 2);
+    evict(maxResidentTimesteps_);
+}
+
+} // namespace
+
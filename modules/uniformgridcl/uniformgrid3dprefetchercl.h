@@ -0,0 +1,103 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2016 Daniel Jönsson
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#ifndef IVW_UNIFORMGRID3DPREFETCHERCL_H
+#define IVW_UNIFORMGRID3DPREFETCHERCL_H
+
+#include <modules/uniformgridcl/uniformgridclmoduledefine.h>
+#include <inviwo/core/common/inviwo.h>
+#include <modules/uniformgridcl/uniformgrid3d.h>
+#include <inviwo/core/datastructures/volume/volume.h>
+
+#include <modules/opencl/inviwoopencl.h>
+
+#include <map>
+
+namespace inviwo {
+
+/**
+ * \class UniformGrid3DPrefetcherCL
+ * \brief Keeps upcoming timesteps of a grid sequence resident on the device.
+ *
+ * Timesteps predicted to be needed are uploaded using non-blocking writes on the 
+ * asynchronous queue, so that the transfer overlaps with computations on the main queue.
+ * At most maxResidentTimesteps are kept on the device, the least recently used are evicted first.
+ * Volume sequences are uploaded as raw voxel data from their RAM representation.
+ */
+class IVW_MODULE_UNIFORMGRIDCL_API UniformGrid3DPrefetcherCL {
+public:
+    UniformGrid3DPrefetcherCL(size_t maxResidentTimesteps = 6);
+    virtual ~UniformGrid3DPrefetcherCL();
+
+    /**
+     * \brief Start uploading the timesteps following timestep in the playback direction.
+     * Wraps around at the ends of the sequence.
+     *
+     * @param sequence Timesteps, all must have the same size
+     * @param timestep Last timestep that is in use
+     * @param direction 1 when playing forward, -1 when playing backwards
+     * @param nTimesteps Number of timesteps to prefetch
+     */
+    void prefetch(const UniformGrid3DVector& sequence, size_t timestep, int direction, size_t nTimesteps);
+    /**
+     * \brief Get device buffer of timestep. The upload is started if it has not been prefetched.
+     * @param waitForEvents Upload event is added to the list, must be waited for before using the buffer.
+     */
+    const cl::Buffer& get(const UniformGrid3DVector& sequence, size_t timestep, std::vector<cl::Event>& waitForEvents);
+    
+    void prefetch(const VolumeSequence& sequence, size_t timestep, int direction, size_t nTimesteps);
+    const cl::Buffer& get(const VolumeSequence& sequence, size_t timestep, std::vector<cl::Event>& waitForEvents);
+    
+    void clear();
+    size_t getMaxResidentTimesteps() const { return maxResidentTimesteps_; }
+    void setMaxResidentTimesteps(size_t val);
+private:
+    struct ResidentTimestep {
+        std::shared_ptr<const void> data; // Keep host data alive during upload
+        cl::Buffer buffer;
+        cl::Event uploaded;
+        size_t lastUsed;
+    };
+    template <typename Sequence>
+    void prefetchSequence(const Sequence& sequence, size_t timestep, int direction, size_t nTimesteps);
+    template <typename Sequence>
+    ResidentTimestep& upload(const Sequence& sequence, size_t timestep);
+    void evict(size_t nResident);
+
+    size_t maxResidentTimesteps_;
+    size_t useCounter_ = 0;
+    const void* sequenceFront_ = nullptr; // Identifies the sequence
+    size_t sequenceSize_ = 0;
+    std::map<size_t, ResidentTimestep> resident_;
+};
+
+} // namespace
+
+#endif // IVW_UNIFORMGRID3DPREFETCHERCL_H
+
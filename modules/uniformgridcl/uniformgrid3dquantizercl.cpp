@@ -0,0 +1,99 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2016 Daniel Jönsson
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include "uniformgrid3dquantizercl.h"
+#include <modules/opencl/buffer/buffercl.h>
+#include <modules/opencl/buffer/bufferclgl.h>
+#include <modules/opencl/syncclgl.h>
+
+namespace inviwo {
+
+UniformGrid3DQuantizerCL::UniformGrid3DQuantizerCL(size_t workGroupSize)
+    : KernelOwner(), workGroupSize_(workGroupSize) {
+    maxValueKernel_ = addKernel("uniformgrid/uniformgridquantization.cl", "uniformGridMaxValueKernel");
+    quantizeUInt8Kernel_ = addKernel("uniformgrid/uniformgridquantization.cl", "uniformGridQuantizeKernel", "",
+                                     " -D QUANTIZED_T=uchar -D CONVERT_TO_QUANTIZED=convert_uchar_sat_rte");
+    quantizeUInt16Kernel_ = addKernel("uniformgrid/uniformgridquantization.cl", "uniformGridQuantizeKernel", "",
+                                      " -D QUANTIZED_T=ushort -D CONVERT_TO_QUANTIZED=convert_ushort_sat_rte");
+}
+
+void UniformGrid3DQuantizerCL::quantize(const BufferCLBase* gridCL, size_t nElements, UniformGrid3DBase& out, bool useGLSharing, const VECTOR_CLASS<cl::Event>* waitForEvents, cl::Event* event) {
+    cl::Kernel* quantizeKernel = nullptr;
+    float maxStored = 0.f;
+    switch (out.getDataFormat()->getId()) {
+        case DataFormatId::UInt8:
+            quantizeKernel = quantizeUInt8Kernel_;
+            maxStored = 255.f;
+            break;
+        case DataFormatId::UInt16:
+            quantizeKernel = quantizeUInt16Kernel_;
+            maxStored = 65535.f;
+            break;
+        default:
+            LogError("Grids can only be quantized to uint8 or uint16, got " << out.getDataFormat()->getString());
+            return;
+    }
+    if (!maxValueKernel_ || !quantizeKernel) {
+        return;
+    }
+    auto& queue = OpenCL::getPtr()->getQueue();
+    // Bits of the largest, non-negative, float value become the value scale
+    auto maxValueCL = out.getEditableValueScaleBuffer().getEditableRepresentation<BufferCL>();
+    std::vector<cl::Event> maxEvent(1);
+    queue.enqueueFillBuffer<cl_uint>(maxValueCL->getEditable(), 0u, 0, sizeof(cl_uint), waitForEvents, &maxEvent[0]);
+
+    size_t globalWorkGroupSize(getGlobalWorkGroupSize(nElements, workGroupSize_));
+    int argIndex = 0;
+    maxValueKernel_->setArg(argIndex++, *gridCL);
+    maxValueKernel_->setArg(argIndex++, static_cast<int>(nElements));
+    maxValueKernel_->setArg(argIndex++, cl::Local(sizeof(cl_float) * workGroupSize_));
+    maxValueKernel_->setArg(argIndex++, *maxValueCL);
+    queue.enqueueNDRangeKernel(*maxValueKernel_, cl::NullRange, globalWorkGroupSize, workGroupSize_, &maxEvent, &maxEvent[0]);
+
+    auto quantize = [&](BufferCLBase* outCL) {
+        argIndex = 0;
+        quantizeKernel->setArg(argIndex++, *gridCL);
+        quantizeKernel->setArg(argIndex++, static_cast<int>(nElements));
+        quantizeKernel->setArg(argIndex++, *maxValueCL);
+        quantizeKernel->setArg(argIndex++, maxStored);
+        quantizeKernel->setArg(argIndex++, *outCL);
+        queue.enqueueNDRangeKernel(*quantizeKernel, cl::NullRange, globalWorkGroupSize, workGroupSize_, &maxEvent, event);
+    };
+    if (useGLSharing) {
+        SyncCLGL glSync;
+        auto outCL = out.getEditableBuffer().getEditableRepresentation<BufferCLGL>();
+        glSync.addToAquireGLObjectList(outCL);
+        glSync.aquireAllObjects();
+        quantize(outCL);
+    } else {
+        quantize(out.getEditableBuffer().getEditableRepresentation<BufferCL>());
+    }
+}
+
+} // namespace
@@ -0,0 +1,76 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2016 Daniel Jönsson
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#ifndef IVW_UNIFORMGRID3DQUANTIZERCL_H
+#define IVW_UNIFORMGRID3DQUANTIZERCL_H
+
+#include <modules/uniformgridcl/uniformgridclmoduledefine.h>
+#include <inviwo/core/common/inviwo.h>
+#include <modules/uniformgridcl/uniformgrid3d.h>
+
+#include <modules/opencl/inviwoopencl.h>
+#include <modules/opencl/kernelowner.h>
+#include <modules/opencl/buffer/bufferclbase.h>
+
+namespace inviwo {
+
+/**
+ * \class UniformGrid3DQuantizerCL
+ * \brief Quantize float grids on the device to 8-bit or 16-bit normalized grids.
+ *
+ * Values are normalized by the largest value of the grid, which becomes the value scale
+ * of the quantized grid, see UniformGrid3DBase::getValueScale. Negative values are clamped to zero.
+ * The largest value is only written to the value scale buffer on the device,
+ * so kernels can read it without waiting for the host, see UniformGrid3DBase::getValueScaleBuffer.
+ * Device equivalent of util::quantizeUniformGrid3D.
+ */
+class IVW_MODULE_UNIFORMGRIDCL_API UniformGrid3DQuantizerCL : public KernelOwner {
+public:
+    UniformGrid3DQuantizerCL(size_t workGroupSize = 128);
+    virtual ~UniformGrid3DQuantizerCL() = default;
+
+    /**
+     * \brief Quantize float values of gridCL into out, which must be uint8 or uint16 and hold nElements.
+     * The largest value is written to the value scale buffer of out without reading it back.
+     * @param nElements Number of elements including padding of the grid layout
+     */
+    void quantize(const BufferCLBase* gridCL, size_t nElements, UniformGrid3DBase& out, bool useGLSharing, const VECTOR_CLASS<cl::Event>* waitForEvents = nullptr, cl::Event* event = nullptr);
+
+    size_t workGroupSize() const { return workGroupSize_; }
+    void workGroupSize(size_t val) { workGroupSize_ = val; }
+private:
+    size_t workGroupSize_;
+    cl::Kernel* maxValueKernel_;
+    cl::Kernel* quantizeUInt8Kernel_;
+    cl::Kernel* quantizeUInt16Kernel_;
+};
+
+} // namespace
+
+#endif // IVW_UNIFORMGRID3DQUANTIZERCL_H
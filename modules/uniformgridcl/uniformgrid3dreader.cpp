@@ -28,6 +28,7 @@
  *********************************************************************************/
 
 #include "uniformgrid3dreader.h"
+#include "gridcompression.h"
 #include <inviwo/core/io/datareaderexception.h>
 #include <inviwo/core/util/filesystem.h>
 #include <inviwo/core/util/formatconversion.h>
@@ -56,20 +57,14 @@ UniformGrid3DReader& UniformGrid3DReader::operator=(const UniformGrid3DReader& t
 
 UniformGrid3DReader* UniformGrid3DReader::clone() const { return new UniformGrid3DReader(*this); }
 
-std::shared_ptr<UniformGrid3DVector> UniformGrid3DReader::readData(const std::filesystem::path& filePath) {
+UniformGrid3DReader::Header UniformGrid3DReader::readHeader(const std::filesystem::path& filePath) const {
     
     const auto fileDirectory = filePath.parent_path();
     // Read the file content
     auto f = open(filePath);
     std::string textLine;
-    std::filesystem::path rawFile_;
     std::string formatFlag = "";
-    glm::mat4 modelMatrix(1.0f);
-    glm::mat4 worldMatrix(1.0f);
-    size3_t cellDimensions(0);
-    glm::size4_t resolution(0);
-    
-    const DataFormatBase* format_ = nullptr;
+    Header header;
     
     std::vector<std::string> parts;
     std::string key;
@@ -88,51 +83,73 @@ std::shared_ptr<UniformGrid3DVector> UniformGrid3DReader::readData(const std::fi
         value = trim(parts[1]);
         
         std::stringstream ss(value);
-        if (key == "objectfilename" || key == "rawfile") {
-            rawFile_ = fileDirectory / value;
+        if (key == "version") {
+            ss >> header.version;
+        } else if (key == "objectfilename" || key == "rawfile") {
+            header.rawFile = fileDirectory / value;
         } else if (key == "resolution" || key == "dimensions") {
-            ss >> resolution.x;
-            ss >> resolution.y;
-            ss >> resolution.z;
-            ss >> resolution.w;
+            ss >> header.resolution.x;
+            ss >> header.resolution.y;
+            ss >> header.resolution.z;
+            ss >> header.resolution.w;
         } else if (key == "format") {
             ss >> formatFlag;
-            format_ = DataFormatBase::get(formatFlag);
+            header.format = DataFormatBase::get(formatFlag);
         } else if (key == "modelmatrix") {
             for (int i = 0; i < 4; ++i) {
                 for (int j = 0; j < 4; ++j) {
-                    ss >> modelMatrix[i][j];
+                    ss >> header.modelMatrix[i][j];
                 }
             }
-            modelMatrix = glm::transpose(modelMatrix);
+            header.modelMatrix = glm::transpose(header.modelMatrix);
         } else if (key == "worldmatrix") {
             for (int i = 0; i < 4; ++i) {
                 for (int j = 0; j < 4; ++j) {
-                    ss >> worldMatrix[i][j];
+                    ss >> header.worldMatrix[i][j];
                 }
             }
-            worldMatrix = glm::transpose(worldMatrix);
+            header.worldMatrix = glm::transpose(header.worldMatrix);
         } else if (key == "celldimensions") {
-            ss >> cellDimensions.x;
-            ss >> cellDimensions.y;
-            ss >> cellDimensions.z;
+            ss >> header.cellDimensions.x;
+            ss >> header.cellDimensions.y;
+            ss >> header.cellDimensions.z;
+        } else if (key == "compression") {
+            ss >> header.compression;
+            header.compression = toLower(header.compression);
+        } else if (key == "layout") {
+            std::string layout;
+            ss >> layout;
+            layout = toLower(layout);
+            if (layout == "morton") {
+                header.layout = UniformGrid3DLayout::Morton;
+            } else if (layout != "linear") {
+                throw DataReaderException(
+                    IVW_CONTEXT_CUSTOM("UniformGrid3DReader::readHeader"), "Error: Unsupported layout \"{}\" in file: {}", layout, filePath);
+            }
+        } else if (key == "valuescales") {
+            float valueScale;
+            while (ss >> valueScale) {
+                header.valueScales.push_back(valueScale);
+            }
+        } else if (key == "chunkoffsets") {
+            size_t offset;
+            while (ss >> offset) {
+                header.chunkOffsets.push_back(offset);
+            }
         }
     };
     
-    // Check if other dat files where specified, and then only consider them as a sequence
-    auto dataVector = std::make_shared<UniformGrid3DVector>();
-    
-    if (resolution == size4_t(0)) {
+    if (header.resolution == size4_t(0)) {
         throw DataReaderException(
-            IVW_CONTEXT, "Error: Unable to find \"Resolution\" tag in file: {}", filePath);
+            IVW_CONTEXT_CUSTOM("UniformGrid3DReader::readHeader"), "Error: Unable to find \"Resolution\" tag in file: {}", filePath);
     }
-    else if (format_ == nullptr) {
+    else if (header.format == nullptr) {
         throw DataReaderException(
-            IVW_CONTEXT, "Error: Unable to find \"Format\" tag in file: {}", filePath);
+            IVW_CONTEXT_CUSTOM("UniformGrid3DReader::readHeader"), "Error: Unable to find \"Format\" tag in file: {}", filePath);
     }
-    else if (format_->getId() == DataFormatId::NotSpecialized) {
+    else if (header.format->getId() == DataFormatId::NotSpecialized) {
         throw DataReaderException(
-            IVW_CONTEXT,
+            IVW_CONTEXT_CUSTOM("UniformGrid3DReader::readHeader"),
             "Error: Invalid format string found: {} in {} \nThe valid formats are:\n"
             "FLOAT16, FLOAT32, FLOAT64, INT8, INT16, INT32, INT64, UINT8, UINT16, UINT32, "
             "UINT64, Vec2FLOAT16, Vec2FLOAT32, Vec2FLOAT64, Vec2INT8, Vec2INT16, "
@@ -143,43 +160,113 @@ std::shared_ptr<UniformGrid3DVector> UniformGrid3DReader::readData(const std::fi
             "Vec4UINT8, Vec4UINT16, Vec4UINT32, Vec4UINT64",
             formatFlag, filePath);
     }
-    
+    if (header.version > 4) {
+        throw DataReaderException(
+            IVW_CONTEXT_CUSTOM("UniformGrid3DReader::readHeader"), "Error: Unsupported version {} in file: {}", header.version, filePath);
+    }
+    if (header.version >= 2) {
+        if (header.compression != "none" && header.compression != "shufflelz") {
+            throw DataReaderException(
+                IVW_CONTEXT_CUSTOM("UniformGrid3DReader::readHeader"), "Error: Unsupported compression \"{}\" in file: {}", header.compression, filePath);
+        }
+        if (header.chunkOffsets.size() != header.resolution.w + 1) {
+            throw DataReaderException(
+                IVW_CONTEXT_CUSTOM("UniformGrid3DReader::readHeader"), "Error: Expected {} \"ChunkOffsets\" in file: {}", header.resolution.w + 1, filePath);
+        }
+    }
+    if (!header.valueScales.empty() && header.valueScales.size() != header.resolution.w) {
+        throw DataReaderException(
+            IVW_CONTEXT_CUSTOM("UniformGrid3DReader::readHeader"), "Error: Expected {} \"ValueScales\" in file: {}", header.resolution.w, filePath);
+    }
+    return header;
+}
+
+std::shared_ptr<UniformGrid3DBase> UniformGrid3DReader::createGrid(const Header& header) {
     std::shared_ptr<UniformGrid3DBase> data =
-    dispatching::dispatch<std::shared_ptr<UniformGrid3DBase>, dispatching::filter::All>(format_->getId(), util::UniformGrid3DDispatcher(), size3_t(resolution), size3_t(cellDimensions), BufferUsage::Static);
+    dispatching::dispatch<std::shared_ptr<UniformGrid3DBase>, dispatching::filter::All>(header.format->getId(), util::UniformGrid3DDispatcher(), size3_t(header.resolution), size3_t(header.cellDimensions), BufferUsage::Static, header.layout);
     
     if (!data) {
         throw DataReaderException(
-            IVW_CONTEXT, "Error: Unsupported data fromat \"Format\" tag in file: {}", filePath);
+            IVW_CONTEXT_CUSTOM("UniformGrid3DReader::createGrid"), "Error: Unsupported data fromat \"Format\" tag in file: {}", header.rawFile);
     }
-    data->setModelMatrix(modelMatrix);
-    data->setWorldMatrix(worldMatrix);
-    data->setDimensions(size3_t(resolution));
+    data->setModelMatrix(header.modelMatrix);
+    data->setWorldMatrix(header.worldMatrix);
+    data->setDimensions(size3_t(header.resolution));
+    return data;
+}
+
+void UniformGrid3DReader::readTimestep(std::istream& in, const Header& header, size_t timestep, UniformGrid3DBase* data) {
+    size_t bytes = data->getSizeInBytes();
+    if (header.version < 2) {
+        // Uncompressed timesteps stored after each other
+        in.seekg(timestep * bytes);
+        in.read(static_cast<char*>(data->getData()), bytes);
+    } else {
+        auto chunkSize = header.chunkOffsets[timestep + 1] - header.chunkOffsets[timestep];
+        in.seekg(header.chunkOffsets[timestep]);
+        if (header.compression == "none" || chunkSize == bytes) {
+            // Chunks that did not compress are stored as is
+            in.read(static_cast<char*>(data->getData()), bytes);
+        } else {
+            std::vector<char> chunk(chunkSize);
+            in.read(chunk.data(), chunkSize);
+            if (in.good()) {
+                util::decompressGridChunk(chunk.data(), chunkSize, data->getData(), bytes, header.format->getSize());
+            }
+        }
+    }
+    if (!in.good()) {
+        throw DataReaderException(
+            IVW_CONTEXT_CUSTOM("UniformGrid3DReader::readTimestep"), "Error: Unable to read timestep {} from file: {}", timestep, header.rawFile);
+    }
+    if (!header.valueScales.empty()) {
+        data->setValueScale(header.valueScales[timestep]);
+    }
+}
+
+std::shared_ptr<UniformGrid3DVector> UniformGrid3DReader::readData(const std::filesystem::path& filePath) {
+    auto header = readHeader(filePath);
     
-    size_t bytes = resolution.x * resolution.y * resolution.z * (format_->getSize());
+    // Check if other dat files where specified, and then only consider them as a sequence
+    auto dataVector = std::make_shared<UniformGrid3DVector>();
+    auto data = createGrid(header);
     
-    std::fstream fin(rawFile_.c_str(), std::ios::in | std::ios::binary);
+    std::fstream fin(header.rawFile.c_str(), std::ios::in | std::ios::binary);
     util::OnScopeExit close([&fin]() { fin.close(); });
     
     if (fin.good()) {
-        for (size_t t = 0; t < resolution.w; ++t) {
+        for (size_t t = 0; t < header.resolution.w; ++t) {
             if (t == 0)
             dataVector->push_back(std::move(data));
             else
             dataVector->push_back(
                                   std::shared_ptr<UniformGrid3DBase>(dataVector->front()->clone()));
             
-            fin.read(static_cast<char*>(dataVector->back()->getData()), bytes);
+            readTimestep(fin, header, t, dataVector->back().get());
         }
     } else {
         throw DataReaderException(
-            IVW_CONTEXT, "Error: Unable to read from  file: {}", rawFile_.string());
+            IVW_CONTEXT, "Error: Unable to read from  file: {}", header.rawFile.string());
     }
     
-    std::string size = util::formatBytesToString(bytes * resolution.w);
-    // if (enableLogOutput_) {
-    //    LogInfo("Loaded volume sequence: " << filePath << " size: " << size);
-    //}
     return dataVector;
 }
 
+std::shared_ptr<UniformGrid3DBase> UniformGrid3DReader::readTimestep(const std::filesystem::path& filePath, size_t timestep) {
+    auto header = readHeader(filePath);
+    if (timestep >= header.resolution.w) {
+        throw DataReaderException(
+            IVW_CONTEXT, "Error: Timestep {} out of range, file contains {} timesteps: {}", timestep, header.resolution.w, filePath);
+    }
+    auto data = createGrid(header);
+    std::fstream fin(header.rawFile.c_str(), std::ios::in | std::ios::binary);
+    util::OnScopeExit close([&fin]() { fin.close(); });
+    if (!fin.good()) {
+        throw DataReaderException(
+            IVW_CONTEXT, "Error: Unable to read from  file: {}", header.rawFile.string());
+    }
+    readTimestep(fin, header, timestep, data.get());
+    return data;
+}
+
 }  // namespace inviwo
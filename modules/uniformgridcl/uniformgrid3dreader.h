@@ -51,6 +51,28 @@ public:
     virtual ~UniformGrid3DReader() = default;
     
     virtual std::shared_ptr<UniformGrid3DVector> readData(const std::filesystem::path& filePath) override;
+    /**
+     * \brief Read a single timestep. 
+     * Only the data of the requested timestep is read, also for version 1 (uncompressed) files.
+     */
+    std::shared_ptr<UniformGrid3DBase> readTimestep(const std::filesystem::path& filePath, size_t timestep);
+private:
+    struct Header {
+        int version = 1; // 1: raw timesteps after each other, 2: one (compressed) chunk per timestep, 3: 2 with non-linear layout, 4: 3 with value scales
+        std::filesystem::path rawFile;
+        glm::size4_t resolution = glm::size4_t(0); // Grid dimensions and number of timesteps
+        size3_t cellDimensions = size3_t(0);
+        glm::mat4 modelMatrix = glm::mat4(1.0f);
+        glm::mat4 worldMatrix = glm::mat4(1.0f);
+        const DataFormatBase* format = nullptr;
+        std::string compression = "none";
+        std::vector<size_t> chunkOffsets; // Byte offset of each chunk in raw file + end of last chunk
+        UniformGrid3DLayout layout = UniformGrid3DLayout::Linear; // Files without "Layout" tag are linear
+        std::vector<float> valueScales; // One per timestep, see UniformGrid3DBase::getValueScale. Empty if all are 1
+    };
+    Header readHeader(const std::filesystem::path& filePath) const;
+    static std::shared_ptr<UniformGrid3DBase> createGrid(const Header& header);
+    static void readTimestep(std::istream& in, const Header& header, size_t timestep, UniformGrid3DBase* data);
 };
 
 } // namespace
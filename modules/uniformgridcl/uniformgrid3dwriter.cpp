@@ -28,6 +28,7 @@
  *********************************************************************************/
 
 #include "uniformgrid3dwriter.h"
+#include "gridcompression.h"
 #include <inviwo/core/io/datawriterexception.h>
 
 #include <fmt/std.h>
@@ -50,7 +51,7 @@ void UniformGrid3DWriter::writeData(const UniformGrid3DVector* vectorData,
         throw DataWriterException("Error: Cannot write empty vector", IvwContext);
     }
     auto rawPath = filePath;
-    rawPath.replace_extension("raw");
+    rawPath.replace_extension("u3dc");
 
     auto overwrite = getOverwrite();
     DataWriter::checkOverwrite(filePath, overwrite);
@@ -59,6 +60,40 @@ void UniformGrid3DWriter::writeData(const UniformGrid3DVector* vectorData,
     std::string fileName = filePath.stem().string();
     
     auto data = vectorData->front().get();
+    auto elementSize = data->getDataFormat()->getSize();
+    // Quantized grids have one value scale per timestep
+    bool hasValueScales = false;
+    for (const auto& element : *vectorData) {
+        if (element->getLayout() != data->getLayout()) {
+            throw DataWriterException("Error: All grids must have the same layout", IvwContext);
+        }
+        hasValueScales |= element->getValueScale() != 1.f;
+    }
+    // Write one chunk per timestep so that a single timestep can be read
+    // without touching the others. Chunks that do not compress are stored as is.
+    std::vector<size_t> chunkOffsets(1, 0);
+    std::fstream fout(rawPath.c_str(), std::ios::out | std::ios::binary);
+    
+    if (fout.good()) {
+        for (auto element : *vectorData) {
+            auto compressed = util::compressGridChunk(element->getData(), element->getSizeInBytes(), elementSize);
+            if (compressed.size() < element->getSizeInBytes()) {
+                fout.write(compressed.data(), compressed.size());
+                chunkOffsets.push_back(chunkOffsets.back() + compressed.size());
+            } else {
+                fout.write((char*)element->getData(), element->getSizeInBytes());
+                chunkOffsets.push_back(chunkOffsets.back() + element->getSizeInBytes());
+            }
+        }
+        
+    }
+    else {
+        throw DataWriterException(IVW_CONTEXT_CUSTOM("UniformGrid3DWriter::writeData"),
+            "Could not write to raw file: {}", rawPath);
+    }
+    
+    fout.close();
+
     // Write the header file content
     std::stringstream ss;
     auto modelMatrix = glm::transpose(data->getModelMatrix());
@@ -66,12 +101,30 @@ void UniformGrid3DWriter::writeData(const UniformGrid3DVector* vectorData,
     auto structuredGridDim = data->getDimensions();
     auto cellDim = data->getCellDimension();
     
-    writeKeyToString(ss, "RawFile", fileName + ".raw");
+    // Version 3 makes older readers reject grids they would read in the wrong order,
+    // version 4 grids they would read without value scales
+    writeKeyToString(ss, "Version", std::string(hasValueScales ? "4" : (data->getLayout() == UniformGrid3DLayout::Linear ? "2" : "3")));
+    writeKeyToString(ss, "RawFile", fileName + ".u3dc");
     writeKeyToString(ss, "Resolution", size4_t(data->getDimensions(), vectorData->size()));
     writeKeyToString(ss, "Format", data->getDataFormat()->getString());
     writeKeyToString(ss, "ModelMatrix", modelMatrix);
     writeKeyToString(ss, "WorldMatrix", worldMatrix);
     writeKeyToString(ss, "CellDimensions", cellDim);
+    // Data is written in the order it is stored, see UniformGrid3DLayout
+    writeKeyToString(ss, "Layout", std::string(data->getLayout() == UniformGrid3DLayout::Morton ? "Morton" : "Linear"));
+    writeKeyToString(ss, "Compression", std::string("ShuffleLZ"));
+    ss << "ChunkOffsets:";
+    for (auto offset : chunkOffsets) {
+        ss << " " << offset;
+    }
+    ss << std::endl;
+    if (hasValueScales) {
+        ss << "ValueScales:";
+        for (const auto& element : *vectorData) {
+            ss << " " << element->getValueScale();
+        }
+        ss << std::endl;
+    }
     
     std::ofstream f(filePath.c_str());
     
@@ -84,21 +137,6 @@ void UniformGrid3DWriter::writeData(const UniformGrid3DVector* vectorData,
     }
     
     f.close();
-    
-    std::fstream fout(rawPath.c_str(), std::ios::out | std::ios::binary);
-    
-    if (fout.good()) {
-        for (auto element : *vectorData) {
-            fout.write((char*)element->getData(), element->getSizeInBytes());
-        }
-        
-    }
-    else {
-        throw DataWriterException(IVW_CONTEXT_CUSTOM("UniformGrid3DWriter::writeData"),
-            "Could not write to raw file: {}", rawPath);
-    }
-    
-    fout.close();
 }
 
 }  // namespace inviwo
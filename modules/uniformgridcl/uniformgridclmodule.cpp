@@ -38,6 +38,7 @@
 #include <modules/uniformgridcl/processors/uniformgrid3dsourceprocessor.h>
 #include <modules/uniformgridcl/processors/volumeminmaxclprocessor.h>
 #include <modules/uniformgridcl/processors/volumesequenceplayer.h>
+#include <modules/uniformgridcl/processors/volumesequenceplayercl.h>
 
 
 #include <modules/opencl/inviwoopencl.h>
@@ -58,6 +59,7 @@ UniformGridCLModule::UniformGridCLModule(InviwoApplication* app) : InviwoModule(
     registerProcessor<UniformGrid3DSourceProcessor>();
     registerProcessor<VolumeMinMaxCLProcessor>();
     registerProcessor<VolumeSequencePlayer>();
+    registerProcessor<VolumeSequencePlayerCL>();
 
     registerDataReader(std::make_unique<UniformGrid3DReader>());
     registerDataWriter(std::make_unique<UniformGrid3DWriter>());